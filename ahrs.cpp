@@ -0,0 +1,228 @@
+#include <math.h>
+
+#include "ahrs.hpp"
+#include "imu_kernels.hpp"
+
+/*
+ * Both filters follow the reference MahonyAHRS formulation: errors are
+ * computed as "half" vectors so the factor two folds into the gains.
+ */
+
+/*===========================================================================*/
+/* Fixed point.                                                              */
+/*===========================================================================*/
+
+MahonyQ31::MahonyQ31(const AhrsConfig * config) {
+	float dt = 1.0f / config->rate;
+
+	/* Run time is float free, the constants are converted once here. */
+	_gyro_scale = Q31(config->gyro_scale);
+	_two_kp = (q31_t) (2.0f * config->kp * 65536.0f);
+	_two_ki_dt = Q31(2.0f * config->ki * dt);
+	_half_dt = Q31(0.5f * dt);
+
+	reset();
+}
+
+void MahonyQ31::reset(void) {
+
+	_q[0] = Q30(1.0f);
+	_q[1] = 0;
+	_q[2] = 0;
+	_q[3] = 0;
+	_integral[0] = 0;
+	_integral[1] = 0;
+	_integral[2] = 0;
+}
+
+void MahonyQ31::update(const int16_t gyro[3], const int16_t acc[3],
+		const int16_t * mag) {
+	q31_t q0 = _q[0], q1 = _q[1], q2 = _q[2], q3 = _q[3];
+	q31_t a[3], m[3];
+	q31_t halfe[3] = { 0, 0, 0 };
+	int32_t raw[3];
+	q31_t w[3];
+	bool acc_ok;
+
+	raw[0] = acc[0];
+	raw[1] = acc[1];
+	raw[2] = acc[2];
+	acc_ok = q30_normalize3(raw, a);
+
+	if (acc_ok) {
+		q31_t q0q0 = q30_mul(q0, q0);
+		q31_t q0q1 = q30_mul(q0, q1);
+		q31_t q0q2 = q30_mul(q0, q2);
+		q31_t q0q3 = q30_mul(q0, q3);
+		q31_t q1q1 = q30_mul(q1, q1);
+		q31_t q1q2 = q30_mul(q1, q2);
+		q31_t q1q3 = q30_mul(q1, q3);
+		q31_t q2q2 = q30_mul(q2, q2);
+		q31_t q2q3 = q30_mul(q2, q3);
+		q31_t q3q3 = q30_mul(q3, q3);
+		const q31_t half = Q30(0.5f);
+
+		/* Estimated gravity direction, halved. */
+		q31_t hvx = q1q3 - q0q2;
+		q31_t hvy = q0q1 + q2q3;
+		q31_t hvz = q0q0 - half + q3q3;
+
+		halfe[0] = q30_mul(a[1], hvz) - q30_mul(a[2], hvy);
+		halfe[1] = q30_mul(a[2], hvx) - q30_mul(a[0], hvz);
+		halfe[2] = q30_mul(a[0], hvy) - q30_mul(a[1], hvx);
+
+		if (mag != NULL) {
+			raw[0] = mag[0];
+			raw[1] = mag[1];
+			raw[2] = mag[2];
+		}
+
+		if (mag != NULL && q30_normalize3(raw, m)) {
+			/* Earth field in the body frame, reference direction on the x-z plane. */
+			q31_t hx = 2 * (q30_mul(m[0], half - q2q2 - q3q3)
+					+ q30_mul(m[1], q1q2 - q0q3) + q30_mul(m[2], q1q3 + q0q2));
+			q31_t hy = 2 * (q30_mul(m[0], q1q2 + q0q3)
+					+ q30_mul(m[1], half - q1q1 - q3q3) + q30_mul(m[2], q2q3 - q0q1));
+			q31_t bz = 2 * (q30_mul(m[0], q1q3 - q0q2)
+					+ q30_mul(m[1], q2q3 + q0q1) + q30_mul(m[2], half - q1q1 - q2q2));
+			int32_t hx15 = hx >> 15;
+			int32_t hy15 = hy >> 15;
+			q31_t bx = (q31_t) (isqrt32((uint32_t) (hx15 * hx15)
+					+ (uint32_t) (hy15 * hy15)) << 15);
+
+			q31_t hwx = q30_mul(bx, half - q2q2 - q3q3) + q30_mul(bz, q1q3 - q0q2);
+			q31_t hwy = q30_mul(bx, q1q2 - q0q3) + q30_mul(bz, q0q1 + q2q3);
+			q31_t hwz = q30_mul(bx, q0q2 + q1q3) + q30_mul(bz, half - q1q1 - q2q2);
+
+			halfe[0] += q30_mul(m[1], hwz) - q30_mul(m[2], hwy);
+			halfe[1] += q30_mul(m[2], hwx) - q30_mul(m[0], hwz);
+			halfe[2] += q30_mul(m[0], hwy) - q30_mul(m[1], hwx);
+		}
+	}
+
+	for (int i = 0; i < 3; i++) {
+		/* Gyro rate in Q24: raw * Q31 >> 7. */
+		w[i] = fx_mul(gyro[i], _gyro_scale, 7);
+
+		if (acc_ok) {
+			_integral[i] += fx_mul(halfe[i], _two_ki_dt, 31);
+			w[i] += fx_mul(halfe[i], _two_kp, 22) + (_integral[i] >> 6);
+		}
+
+		/* w * dt / 2, Q24 * Q31 >> 25 = Q30. */
+		w[i] = fx_mul(w[i], _half_dt, 25);
+	}
+
+	quat_integrate_q30(_q, w);
+}
+
+/*===========================================================================*/
+/* Float reference.                                                          */
+/*===========================================================================*/
+
+MahonyFloat::MahonyFloat(const AhrsConfig * config) :
+		_gyro_scale(config->gyro_scale), _two_kp(2.0f * config->kp),
+		_two_ki(2.0f * config->ki), _dt(1.0f / config->rate) {
+
+	reset();
+}
+
+void MahonyFloat::reset(void) {
+
+	_q[0] = 1.0f;
+	_q[1] = 0.0f;
+	_q[2] = 0.0f;
+	_q[3] = 0.0f;
+	_integral[0] = 0.0f;
+	_integral[1] = 0.0f;
+	_integral[2] = 0.0f;
+}
+
+void MahonyFloat::update(const int16_t gyro[3], const int16_t acc[3],
+		const int16_t * mag) {
+	float q0 = _q[0], q1 = _q[1], q2 = _q[2], q3 = _q[3];
+	float halfe[3] = { 0.0f, 0.0f, 0.0f };
+	float w[3];
+	float a[3], m[3];
+	float norm;
+	bool acc_ok;
+
+	norm = sqrtf((float) acc[0] * acc[0] + (float) acc[1] * acc[1]
+			+ (float) acc[2] * acc[2]);
+	acc_ok = (norm > 0.0f);
+
+	if (acc_ok) {
+		a[0] = acc[0] / norm;
+		a[1] = acc[1] / norm;
+		a[2] = acc[2] / norm;
+
+		float q0q0 = q0 * q0;
+		float q0q1 = q0 * q1;
+		float q0q2 = q0 * q2;
+		float q0q3 = q0 * q3;
+		float q1q1 = q1 * q1;
+		float q1q2 = q1 * q2;
+		float q1q3 = q1 * q3;
+		float q2q2 = q2 * q2;
+		float q2q3 = q2 * q3;
+		float q3q3 = q3 * q3;
+
+		float hvx = q1q3 - q0q2;
+		float hvy = q0q1 + q2q3;
+		float hvz = q0q0 - 0.5f + q3q3;
+
+		halfe[0] = a[1] * hvz - a[2] * hvy;
+		halfe[1] = a[2] * hvx - a[0] * hvz;
+		halfe[2] = a[0] * hvy - a[1] * hvx;
+
+		norm = 0.0f;
+		if (mag != NULL) {
+			norm = sqrtf((float) mag[0] * mag[0] + (float) mag[1] * mag[1]
+					+ (float) mag[2] * mag[2]);
+		}
+
+		if (norm > 0.0f) {
+			m[0] = mag[0] / norm;
+			m[1] = mag[1] / norm;
+			m[2] = mag[2] / norm;
+
+			float hx = 2.0f * (m[0] * (0.5f - q2q2 - q3q3) + m[1] * (q1q2 - q0q3)
+					+ m[2] * (q1q3 + q0q2));
+			float hy = 2.0f * (m[0] * (q1q2 + q0q3) + m[1] * (0.5f - q1q1 - q3q3)
+					+ m[2] * (q2q3 - q0q1));
+			float bz = 2.0f * (m[0] * (q1q3 - q0q2) + m[1] * (q2q3 + q0q1)
+					+ m[2] * (0.5f - q1q1 - q2q2));
+			float bx = sqrtf(hx * hx + hy * hy);
+
+			float hwx = bx * (0.5f - q2q2 - q3q3) + bz * (q1q3 - q0q2);
+			float hwy = bx * (q1q2 - q0q3) + bz * (q0q1 + q2q3);
+			float hwz = bx * (q0q2 + q1q3) + bz * (0.5f - q1q1 - q2q2);
+
+			halfe[0] += m[1] * hwz - m[2] * hwy;
+			halfe[1] += m[2] * hwx - m[0] * hwz;
+			halfe[2] += m[0] * hwy - m[1] * hwx;
+		}
+	}
+
+	for (int i = 0; i < 3; i++) {
+		w[i] = gyro[i] * _gyro_scale;
+
+		if (acc_ok) {
+			_integral[i] += _two_ki * halfe[i] * _dt;
+			w[i] += _two_kp * halfe[i] + _integral[i];
+		}
+
+		w[i] *= 0.5f * _dt;
+	}
+
+	_q[0] = q0 + (-q1 * w[0] - q2 * w[1] - q3 * w[2]);
+	_q[1] = q1 + (q0 * w[0] + q2 * w[2] - q3 * w[1]);
+	_q[2] = q2 + (q0 * w[1] - q1 * w[2] + q3 * w[0]);
+	_q[3] = q3 + (q0 * w[2] + q1 * w[1] - q2 * w[0]);
+
+	norm = 1.0f / sqrtf(_q[0] * _q[0] + _q[1] * _q[1] + _q[2] * _q[2]
+			+ _q[3] * _q[3]);
+	for (int i = 0; i < 4; i++) {
+		_q[i] *= norm;
+	}
+}
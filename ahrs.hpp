@@ -0,0 +1,71 @@
+#ifndef AHRS_HPP_
+#define AHRS_HPP_
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "fixmath.hpp"
+
+/*
+ * Mahony attitude estimator.
+ *
+ * Inputs are the raw int16_t sensor axes as published on the "imu" topic;
+ * gyro_scale converts gyro LSBs to rad/s, accelerometer and magnetometer
+ * only contribute a direction so their scale does not matter.
+ *
+ * MahonyQ31 is the embedded implementation: quaternion and errors in Q30,
+ * rates in Q24, no float at run time. MahonyFloat is the reference it is
+ * checked against on the host, same algorithm and same inputs.
+ */
+
+struct AhrsConfig {
+	float gyro_scale;	/* rad/s per LSB */
+	float kp;
+	float ki;
+	uint32_t rate;		/* Update rate [Hz] */
+};
+
+class MahonyQ31 {
+public:
+	MahonyQ31(const AhrsConfig * config);
+
+	void reset(void);
+	void update(const int16_t gyro[3], const int16_t acc[3],
+			const int16_t * mag);
+
+	/* Attitude quaternion (w, x, y, z), Q30. */
+	const q31_t * quaternion(void) const {
+		return _q;
+	}
+
+private:
+	q31_t _q[4];			/* Q30 */
+	q31_t _integral[3];		/* rad/s, Q30 */
+	q31_t _gyro_scale;		/* rad/s per LSB, Q31 */
+	q31_t _two_kp;			/* Q16 */
+	q31_t _two_ki_dt;		/* Q31 */
+	q31_t _half_dt;			/* Q31 */
+};
+
+class MahonyFloat {
+public:
+	MahonyFloat(const AhrsConfig * config);
+
+	void reset(void);
+	void update(const int16_t gyro[3], const int16_t acc[3],
+			const int16_t * mag);
+
+	const float * quaternion(void) const {
+		return _q;
+	}
+
+private:
+	float _q[4];
+	float _integral[3];
+	float _gyro_scale;
+	float _two_kp;
+	float _two_ki;
+	float _dt;
+};
+
+#endif /* AHRS_HPP_ */
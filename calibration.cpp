@@ -0,0 +1,216 @@
+#include <string.h>
+
+#include "calibration.hpp"
+
+Calibration::Calibration(const char * raw, const char * calibrated,
+		const char * coeffs) :
+		_raw(raw), _calibrated(calibrated), _coeffs(coeffs), _fit(0.999f, 200) {
+
+	for (int s = 0; s < CALIB_SENSORS; s++) {
+		calib_identity(&_calib[s]);
+	}
+
+	/* Static instances are built before chSysInit(): no kernel calls. */
+	memset(&_stats, 0, sizeof(_stats));
+}
+
+void Calibration::stats(CalibStats * stats) {
+
+	chSysLock();
+	*stats = _stats;
+	chSysUnlock();
+}
+
+void Calibration::resetStats(void) {
+
+	chSysLock();
+	_stats.samples = 0;
+	_stats.cycles_sum = 0;
+	_stats.cycles_max = 0;
+	_stats.over_budget = 0;
+	_stats.fit_samples = _fit.samples();
+	_stats.updates = 0;
+	chSysUnlock();
+}
+
+void Calibration::setCoefficients(const CalibData * d) {
+	CalibQ30 * c;
+
+	if (d->sensor >= CALIB_SENSORS) {
+		return;
+	}
+
+	c = &_calib[d->sensor];
+	for (int i = 0; i < 3; i++) {
+		c->bias[i] = d->bias[i];
+		for (int j = 0; j < 3; j++) {
+			c->m[i][j] = d->m[i][j];
+		}
+	}
+
+	chSysLock();
+	_stats.updates++;
+	chSysUnlock();
+}
+
+/*
+ * Apply thread, arg is the Calibration instance.
+ */
+msg_t Calibration::applyThread(void * arg) {
+	Calibration * cal = (Calibration *) arg;
+	Middleware & mw = Middleware::instance();
+	Node n("calib");
+	Subscriber<ImuSample, 5> sub(cal->_raw);
+	Subscriber<CalibData, 3> coeffs(cal->_coeffs);
+	Publisher<ImuSample> pub(cal->_calibrated);
+	ImuSample *d, *out;
+	CalibData *c;
+	int16_t in[CALIB_SENSORS][3], res[CALIB_SENSORS][3];
+	uint32_t start, cycles;
+	uint8_t valid;
+
+	chRegSetThreadName("CALIB");
+
+	mw.newNode(&n);
+	n.subscribe(&sub);
+	n.subscribe(&coeffs);
+	n.advertise(&pub);
+
+	while (!chThdShouldTerminate()) {
+		n.spin();
+
+		while ((c = coeffs.get()) != NULL) {
+			cal->setCoefficients(c);
+			coeffs.release(c);
+		}
+
+		while ((d = sub.get()) != NULL) {
+			out = pub.alloc();
+			if (out == NULL) {
+				sub.release(d);
+				continue;
+			}
+
+			valid = d->valid;
+			out->timestamp = d->timestamp;
+			out->valid = valid;
+			for (int k = 0; k < 3; k++) {
+				in[CALIB_GYRO][k] = d->gyro[k];
+				in[CALIB_ACC][k] = d->acc[k];
+				in[CALIB_MAG][k] = d->mag[k];
+				out->gps[k] = d->gps[k];
+			}
+			sub.release(d);
+
+			/* Budgeted part: the three fixed point calibrations. */
+			start = halGetCounterValue();
+			for (int s = 0; s < CALIB_SENSORS; s++) {
+				if (valid & (1 << s)) {
+					calib_apply(&cal->_calib[s], in[s], res[s]);
+				} else {
+					res[s][0] = res[s][1] = res[s][2] = 0;
+				}
+			}
+			cycles = halGetCounterValue() - start;
+
+			for (int k = 0; k < 3; k++) {
+				out->gyro[k] = res[CALIB_GYRO][k];
+				out->acc[k] = res[CALIB_ACC][k];
+				out->mag[k] = res[CALIB_MAG][k];
+			}
+			pub.broadcast(out);
+
+			chSysLock();
+			cal->_stats.samples++;
+			cal->_stats.cycles_sum += cycles;
+			if (cycles > cal->_stats.cycles_max) {
+				cal->_stats.cycles_max = cycles;
+			}
+			if (cycles > CALIB_CYCLE_BUDGET) {
+				cal->_stats.over_budget++;
+			}
+			chSysUnlock();
+		}
+	}
+
+	mw.delNode(&n);
+	chThdExit(RDY_OK);
+
+	return 0;
+}
+
+/*
+ * Magnetometer fit thread, arg is the Calibration instance.
+ * Runs below the apply thread: the RLS update is float and costs far more
+ * than the per-sample budget.
+ */
+msg_t Calibration::fitThread(void * arg) {
+	Calibration * cal = (Calibration *) arg;
+	Middleware & mw = Middleware::instance();
+	Node n("magfit");
+	Subscriber<ImuSample, 2> sub(cal->_raw);
+	Publisher<CalibData> pub(cal->_coeffs);
+	ImuSample *d;
+	CalibData *c;
+	CalibQ30 fit;
+	float radius;
+	int16_t m[3];
+	uint32_t decimation = 0;
+	bool mag_ok;
+	systime_t next;
+
+	chRegSetThreadName("MAG FIT");
+
+	mw.newNode(&n);
+	n.subscribe(&sub);
+	n.advertise(&pub);
+
+	next = chTimeNow() + MAG_FIT_PERIOD;
+	while (!chThdShouldTerminate()) {
+		n.spin();
+		while ((d = sub.get()) != NULL) {
+			mag_ok = (d->valid & IMU_MAG_VALID) && (++decimation >= MAG_FIT_DECIMATION);
+			if (mag_ok) {
+				m[0] = d->mag[0];
+				m[1] = d->mag[1];
+				m[2] = d->mag[2];
+			}
+			sub.release(d);
+
+			if (mag_ok) {
+				decimation = 0;
+				cal->_fit.update(m[0], m[1], m[2]);
+			}
+		}
+
+		if ((int32_t) (chTimeNow() - next) < 0) {
+			continue;
+		}
+		next += MAG_FIT_PERIOD;
+
+		chSysLock();
+		cal->_stats.fit_samples = cal->_fit.samples();
+		chSysUnlock();
+		if (!cal->_fit.solve(&fit, &radius)) {
+			continue;
+		}
+
+		c = pub.alloc();
+		if (c != NULL) {
+			c->sensor = CALIB_MAG;
+			for (int i = 0; i < 3; i++) {
+				c->bias[i] = fit.bias[i];
+				for (int j = 0; j < 3; j++) {
+					c->m[i][j] = fit.m[i][j];
+				}
+			}
+			c->radius = (uint16_t) radius;
+			pub.broadcast(c);
+		}
+	}
+
+	mw.delNode(&n);
+	chThdExit(RDY_OK);
+
+	return 0;
+}
@@ -0,0 +1,60 @@
+#ifndef CALIBRATION_HPP_
+#define CALIBRATION_HPP_
+
+#include "ch.h"
+#include "hal.h"
+
+#include "Middleware.hpp"
+#include "imu_messages.hpp"
+#include "imu_kernels.hpp"
+#include "mag_calib.hpp"
+
+/*
+ * Sensor calibration stage.
+ *
+ * The apply thread runs M * (x - bias) in fixed point on every sample of
+ * the raw topic and republishes it; coefficients come from the coefficient
+ * topic, so they can be replaced at run time by the fit thread or from
+ * the ground.
+ *
+ * The fit thread feeds a decimated stream of raw magnetometer samples to
+ * MagCalib and publishes the hard/soft-iron fit once per period.
+ */
+
+/* Cycles per sample for the three sensors, checked by the apply thread. */
+#define CALIB_CYCLE_BUDGET		600
+
+#define MAG_FIT_DECIMATION		10
+#define MAG_FIT_PERIOD			S2ST(1)
+
+struct CalibStats {
+	uint32_t samples;
+	uint32_t cycles_sum;
+	uint32_t cycles_max;
+	uint32_t over_budget;
+	uint32_t fit_samples;
+	uint32_t updates;
+};
+
+class Calibration {
+public:
+	Calibration(const char * raw, const char * calibrated, const char * coeffs);
+
+	void stats(CalibStats * stats);
+	void resetStats(void);
+
+	static msg_t applyThread(void * arg);
+	static msg_t fitThread(void * arg);
+
+private:
+	void setCoefficients(const CalibData * d);
+
+	const char * _raw;
+	const char * _calibrated;
+	const char * _coeffs;
+	CalibQ30 _calib[CALIB_SENSORS];
+	MagCalib _fit;
+	CalibStats _stats;
+};
+
+#endif /* CALIBRATION_HPP_ */
@@ -485,7 +485,22 @@
 /**
  * @brief   Context switch hook.
  * @details This hook is invoked just before switching between threads.
+ * @note    With USE_TRACE it records the switch in the middleware trace,
+ *          see trace.hpp.
  */
+#if USE_TRACE && !defined(__DOXYGEN__)
+#ifdef __cplusplus
+extern "C" {
+#endif
+  void trace_switch(void *ntp, void *otp);
+#ifdef __cplusplus
+}
+#endif
+#define THREAD_CONTEXT_SWITCH_HOOK(ntp, otp) {                              \
+  trace_switch(ntp, otp);                                                   \
+}
+#endif
+
 #if !defined(THREAD_CONTEXT_SWITCH_HOOK) || defined(__DOXYGEN__)
 #define THREAD_CONTEXT_SWITCH_HOOK(ntp, otp) {                              \
   /* System halt code here.*/                                               \
@@ -0,0 +1,24 @@
+#include "ch.h"
+
+#include "decimating_relay.hpp"
+
+DecimatingRelayBase::DecimatingRelayBase(const q31_t * taps, uint16_t ntaps,
+		uint16_t factor, uint8_t channels) :
+		_fir(taps, ntaps, factor, channels), _factor(factor), _phase(0),
+		_inputs(0), _outputs(0) {
+}
+
+bool DecimatingRelayBase::input(const int16_t * x) {
+
+	_inputs++;
+	if (x != NULL) {
+		return _fir.push(x);
+	}
+
+	if (++_phase < _factor) {
+		return false;
+	}
+	_phase = 0;
+
+	return true;
+}
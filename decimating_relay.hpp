@@ -0,0 +1,138 @@
+#ifndef DECIMATING_RELAY_HPP_
+#define DECIMATING_RELAY_HPP_
+
+#include "ch.h"
+
+#include "Middleware.hpp"
+#include "payload.hpp"
+#include "decimator.hpp"
+#include "node_lifecycle.hpp"
+
+/*
+ * Rate-adapting topic relay.
+ *
+ * Subscribes to a topic at its publisher rate and republishes it at the
+ * rate slow subscribers declared, either by latest-value sampling or
+ * through a FIR decimator on the integer channels of the message. All
+ * subscribers of the output topic share the one full-rate subscription:
+ * they cost O(their rate) instead of O(publisher rate).
+ */
+
+template<typename T>
+struct DecimationConfig {
+	const char * input;
+	const char * output;
+	uint32_t input_rate;	/* [Hz] */
+	uint32_t output_rate;	/* [Hz], must divide input_rate */
+
+	/* FIR mode; taps == NULL selects latest-value sampling. */
+	const q31_t * taps;
+	uint16_t ntaps;
+	uint8_t channels;
+	void (*unpack)(const T * msg, int16_t * x);
+	void (*pack)(T * msg, const int16_t * y);
+};
+
+/*
+ * Type independent part: rate counting, FIR and statistics.
+ */
+class DecimatingRelayBase {
+public:
+	uint32_t inputs(void) const {
+		return _inputs;
+	}
+
+	uint32_t outputs(void) const {
+		return _outputs;
+	}
+
+protected:
+	DecimatingRelayBase(const q31_t * taps, uint16_t ntaps, uint16_t factor,
+			uint8_t channels);
+
+	/* x: unpacked channels, NULL when sampling. True at an output instant. */
+	bool input(const int16_t * x);
+
+	const int16_t * output(void) const {
+		return _fir.output();
+	}
+
+	void emitted(void) {
+		_outputs++;
+	}
+
+private:
+	FirDecimator _fir;
+	uint16_t _factor;
+	uint16_t _phase;
+	uint32_t _inputs;
+	uint32_t _outputs;
+};
+
+template<typename T>
+class DecimatingRelay: public DecimatingRelayBase {
+public:
+	DecimatingRelay(const DecimationConfig<T> * config) :
+			DecimatingRelayBase(config->taps, config->ntaps,
+					config->input_rate / config->output_rate, config->channels),
+			_config(config) {
+	}
+
+	static msg_t thread(void * arg);
+
+private:
+	const DecimationConfig<T> * _config;
+};
+
+/*
+ * Relay thread, arg is the DecimatingRelay instance. A node: create it
+ * with node_create() and stop it with node_stop().
+ */
+template<typename T>
+msg_t DecimatingRelay<T>::thread(void * arg) {
+	DecimatingRelay<T> * relay = (DecimatingRelay<T> *) arg;
+	const DecimationConfig<T> * cfg = relay->_config;
+	Middleware & mw = Middleware::instance();
+	Node n("decimator");
+	Subscriber<T, 2> sub(cfg->input);
+	Publisher<T> pub(cfg->output);
+	NodeStop stop;
+	int16_t x[DECIMATOR_MAX_CHANNELS];
+	T *d, *out;
+
+	chRegSetThreadName("DECIMATOR");
+
+	mw.newNode(&n);
+	n.subscribe(&sub);
+	n.advertise(&pub);
+	stop.subscribe(&n);
+
+	while (!stop.requested()) {
+		n.spin();
+		while ((d = sub.get()) != NULL) {
+			if (cfg->taps != NULL) {
+				cfg->unpack(d, x);
+			}
+
+			if (relay->input((cfg->taps != NULL) ? x : NULL)
+					&& (out = pub.alloc()) != NULL) {
+				/* Non filtered fields (timestamps, flags) from the newest input. */
+				copyPayload(out, d);
+				if (cfg->taps != NULL) {
+					cfg->pack(out, relay->output());
+				}
+				pub.broadcast(out);
+				relay->emitted();
+			}
+
+			sub.release(d);
+		}
+	}
+
+	mw.delNode(&n);
+	chThdExit(RDY_OK);
+
+	return 0;
+}
+
+#endif /* DECIMATING_RELAY_HPP_ */
@@ -0,0 +1,68 @@
+#include "decimator.hpp"
+
+const q31_t decimator_lowpass_10x[DECIMATOR_LOWPASS_10X_TAPS] = {
+	-2004371, -1260735, 0, 2834223, 8380019,
+	17634713, 31231555, 49256586, 71141816, 95659109,
+	121022583, 145088695, 165625911, 180612969, 188518750,
+	188518751, 180612969, 165625911, 145088695, 121022583,
+	95659109, 71141816, 49256586, 31231555, 17634713,
+	8380019, 2834223, 0, -1260735, -2004371
+};
+
+FirDecimator::FirDecimator(const q31_t * taps, uint16_t ntaps, uint16_t factor,
+		uint8_t channels) :
+		_taps(taps), _ntaps(ntaps > FIR_MAX_TAPS ? FIR_MAX_TAPS : ntaps),
+		_factor(factor ? factor : 1),
+		_channels(channels > DECIMATOR_MAX_CHANNELS ? DECIMATOR_MAX_CHANNELS : channels) {
+
+	reset();
+}
+
+void FirDecimator::reset(void) {
+
+	_head = 0;
+	_phase = 0;
+	for (int c = 0; c < DECIMATOR_MAX_CHANNELS; c++) {
+		_y[c] = 0;
+		for (int k = 0; k < FIR_MAX_TAPS; k++) {
+			_history[c][k] = 0;
+		}
+	}
+}
+
+/*
+ * Returns true when the input completes an output period; output() then
+ * holds the filtered, decimated sample.
+ */
+bool FirDecimator::push(const int16_t * x) {
+	uint16_t idx;
+	int64_t acc;
+
+	for (uint8_t c = 0; c < _channels; c++) {
+		_history[c][_head] = x[c];
+	}
+
+	idx = _head;
+	if (++_head >= _ntaps) {
+		_head = 0;
+	}
+
+	if (++_phase < _factor) {
+		return false;
+	}
+	_phase = 0;
+
+	/* Same arithmetic as FirQ31, taps[0] on the newest sample. */
+	for (uint8_t c = 0; c < _channels; c++) {
+		uint16_t i = idx;
+
+		acc = 0;
+		for (uint16_t k = 0; k < _ntaps; k++) {
+			acc += (int64_t) _taps[k] * _history[c][i];
+			i = (i == 0) ? _ntaps - 1 : i - 1;
+		}
+		_y[c] = sat16((int32_t) (acc >> 31));
+	}
+
+	return true;
+}
@@ -0,0 +1,50 @@
+#ifndef DECIMATOR_HPP_
+#define DECIMATOR_HPP_
+
+#include <stdint.h>
+
+#include "imu_kernels.hpp"
+
+/*
+ * Multichannel FIR decimator, Q31 taps on int16_t samples.
+ *
+ * Inputs only go into the delay line; the dot product is evaluated once
+ * every factor inputs, at the output instants (the polyphase form of
+ * filter-then-downsample). Cost is O(1) per input plus O(taps) per output.
+ */
+
+#define DECIMATOR_MAX_CHANNELS	9
+
+/*
+ * Anti-alias low-pass for 100 Hz to 10 Hz, Hamming windowed sinc with a
+ * 4 Hz cutoff, unity DC gain: -1.2 dB at 2 Hz, -18 dB at 7 Hz, below
+ * -60 dB from 13 Hz on (what aliases back under 3 Hz).
+ */
+#define DECIMATOR_LOWPASS_10X_TAPS	30
+
+extern const q31_t decimator_lowpass_10x[DECIMATOR_LOWPASS_10X_TAPS];
+
+class FirDecimator {
+public:
+	FirDecimator(const q31_t * taps, uint16_t ntaps, uint16_t factor,
+			uint8_t channels);
+
+	bool push(const int16_t * x);
+	void reset(void);
+
+	const int16_t * output(void) const {
+		return _y;
+	}
+
+private:
+	const q31_t * _taps;
+	uint16_t _ntaps;
+	uint16_t _factor;
+	uint8_t _channels;
+	uint16_t _head;
+	uint16_t _phase;
+	int16_t _history[DECIMATOR_MAX_CHANNELS][FIR_MAX_TAPS];
+	int16_t _y[DECIMATOR_MAX_CHANNELS];
+};
+
+#endif /* DECIMATOR_HPP_ */
@@ -0,0 +1,234 @@
+#include <string.h>
+
+#include "delta_codec.hpp"
+
+static inline uint32_t field_mask(uint8_t size) {
+	return (size >= 4) ? 0xFFFFFFFF : (1u << (size * 8)) - 1;
+}
+
+static inline uint32_t load(const uint8_t * p, uint8_t size) {
+	uint32_t v = 0;
+
+	for (uint8_t i = size; i-- > 0;) {
+		v = (v << 8) | p[i];
+	}
+
+	return v;
+}
+
+static inline void store(uint8_t * p, uint8_t size, uint32_t v) {
+
+	for (uint8_t i = 0; i < size; i++) {
+		p[i] = v & 0xFF;
+		v >>= 8;
+	}
+}
+
+/* Sign extends a residual of the field size, then zig-zag: -1 -> 1, 1 -> 2. */
+static inline uint32_t zigzag(uint32_t r, uint8_t size) {
+	unsigned shift = 32 - size * 8;
+	int32_t s = ((int32_t) (r << shift)) >> shift;
+
+	return ((uint32_t) s << 1) ^ (uint32_t) (s >> 31);
+}
+
+static inline uint32_t unzigzag(uint32_t z) {
+
+	return (z >> 1) ^ (0 - (z & 1));
+}
+
+static inline size_t put_varint(uint32_t v, uint8_t * out) {
+	size_t n = 0;
+
+	while (v >= 0x80) {
+		out[n++] = (v & 0x7F) | 0x80;
+		v >>= 7;
+	}
+	out[n++] = v;
+
+	return n;
+}
+
+/* Returns the bytes read, 0 if truncated or longer than 5 bytes. */
+static inline size_t get_varint(const uint8_t * in, size_t len, uint32_t * v) {
+	uint32_t x = 0;
+
+	for (size_t n = 0; n < len && n < 5; n++) {
+		x |= (uint32_t) (in[n] & 0x7F) << (7 * n);
+		if ((in[n] & 0x80) == 0) {
+			*v = x;
+			return n + 1;
+		}
+	}
+
+	return 0;
+}
+
+size_t delta_size(const uint8_t * layout, uint8_t fields) {
+	size_t size = 0;
+
+	for (uint8_t i = 0; i < fields; i++) {
+		size += layout[i] & DELTA_SIZE_MASK;
+	}
+
+	return size;
+}
+
+DeltaEncoder::DeltaEncoder(const uint8_t * layout, uint8_t fields,
+		uint8_t interval) :
+		_layout(layout), _fields(fields), _interval(interval), _countdown(0),
+		_seq(0) {
+
+	if (_fields > DELTA_MAX_FIELDS) {
+		_fields = DELTA_MAX_FIELDS;
+	}
+	if (_interval == 0) {
+		_interval = 1;
+	}
+	_size = delta_size(_layout, _fields);
+	memset(_prev, 0, sizeof(_prev));
+	memset(_step, 0, sizeof(_step));
+	memset(&_stats, 0, sizeof(_stats));
+}
+
+size_t DeltaEncoder::encode(const uint8_t * payload, uint8_t * out) {
+	uint32_t value[DELTA_MAX_FIELDS];
+	uint32_t step[DELTA_MAX_FIELDS];
+	const uint8_t * p = payload;
+	bool key = (_countdown == 0);
+	size_t n = 1;
+
+	for (uint8_t i = 0; i < _fields; i++) {
+		uint8_t size = _layout[i] & DELTA_SIZE_MASK;
+		uint32_t mask = field_mask(size);
+		uint32_t r;
+
+		value[i] = load(p, size);
+		p += size;
+		step[i] = (value[i] - _prev[i]) & mask;
+		r = step[i];
+		if (_layout[i] & DELTA_ORDER2) {
+			r = (r - _step[i]) & mask;
+		}
+		if (!key) {
+			n += put_varint(zigzag(r, size), &out[n]);
+		}
+	}
+
+	/* Deltas must save something, else the raw payload resynchronizes. */
+	if (key || n > _size) {
+		key = true;
+		memcpy(&out[1], payload, _size);
+		n = 1 + _size;
+		memset(step, 0, sizeof(step));
+		_countdown = _interval;
+		_stats.keyframes++;
+	}
+	_countdown--;
+
+	memcpy(_prev, value, sizeof(uint32_t) * _fields);
+	memcpy(_step, step, sizeof(uint32_t) * _fields);
+	out[0] = (key ? DELTA_KEYFRAME : 0) | (_seq & DELTA_SEQ_MASK);
+	_seq++;
+
+	_stats.samples++;
+	_stats.bytes += n;
+
+	return n;
+}
+
+DeltaDecoder::DeltaDecoder(const uint8_t * layout, uint8_t fields) :
+		_layout(layout), _fields(fields), _seq(0), _seen(false), _synced(false) {
+
+	if (_fields > DELTA_MAX_FIELDS) {
+		_fields = DELTA_MAX_FIELDS;
+	}
+	_size = delta_size(_layout, _fields);
+	memset(_prev, 0, sizeof(_prev));
+	memset(_step, 0, sizeof(_step));
+	memset(&_stats, 0, sizeof(_stats));
+}
+
+bool DeltaDecoder::decode(const uint8_t * in, size_t len, uint8_t * payload) {
+	uint32_t value[DELTA_MAX_FIELDS];
+	uint32_t step[DELTA_MAX_FIELDS];
+	uint8_t seq, i;
+	size_t n = 1;
+
+	if (len < 1) {
+		_stats.malformed++;
+		return false;
+	}
+
+	seq = in[0] & DELTA_SEQ_MASK;
+	if (_seen && seq != ((_seq + 1) & DELTA_SEQ_MASK)) {
+		_stats.lost += (seq - _seq - 1) & DELTA_SEQ_MASK;
+		_synced = false;
+	}
+	_seq = seq;
+	_seen = true;
+
+	if (in[0] & DELTA_KEYFRAME) {
+		if (len != 1 + _size) {
+			_stats.malformed++;
+			_synced = false;
+			return false;
+		}
+		for (i = 0; i < _fields; i++) {
+			uint8_t size = _layout[i] & DELTA_SIZE_MASK;
+
+			_prev[i] = load(&in[n], size);
+			_step[i] = 0;
+			n += size;
+		}
+		memcpy(payload, &in[1], _size);
+		_synced = true;
+		_stats.keyframes++;
+		_stats.samples++;
+		_stats.bytes += len;
+
+		return true;
+	}
+
+	if (!_synced) {
+		_stats.skipped++;
+		return false;
+	}
+
+	for (i = 0; i < _fields; i++) {
+		uint8_t size = _layout[i] & DELTA_SIZE_MASK;
+		uint32_t mask = field_mask(size);
+		uint32_t z;
+		size_t k = get_varint(&in[n], len - n, &z);
+
+		if (k == 0) {
+			break;
+		}
+		n += k;
+		step[i] = unzigzag(z) & mask;
+		if (_layout[i] & DELTA_ORDER2) {
+			step[i] = (step[i] + _step[i]) & mask;
+		}
+		value[i] = (_prev[i] + step[i]) & mask;
+	}
+
+	/* Every field decoded, nothing left over. */
+	if (i < _fields || n != len) {
+		_stats.malformed++;
+		_synced = false;
+		return false;
+	}
+
+	for (i = 0; i < _fields; i++) {
+		uint8_t size = _layout[i] & DELTA_SIZE_MASK;
+
+		store(payload, size, value[i]);
+		payload += size;
+	}
+	memcpy(_prev, value, sizeof(uint32_t) * _fields);
+	memcpy(_step, step, sizeof(uint32_t) * _fields);
+	_stats.samples++;
+	_stats.bytes += len;
+
+	return true;
+}
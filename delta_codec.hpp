@@ -0,0 +1,112 @@
+#ifndef DELTA_CODEC_HPP_
+#define DELTA_CODEC_HPP_
+
+#include <stdint.h>
+#include <stddef.h>
+
+/*
+ * Delta encoding of integer sensor payloads for remote links.
+ *
+ * A payload is described by its layout: one byte per field, the field
+ * size (1, 2 or 4 bytes, little endian) optionally or'ed with
+ * DELTA_ORDER2. Each field is sent as the difference from the same field
+ * of the previous sample (DELTA_ORDER2: the difference from the previous
+ * difference, for timestamps and counters), modulo its size, zig-zag
+ * mapped and written as a base 128 varint: slow axes and sensor noise
+ * take one byte instead of two or four.
+ *
+ * Encoded message: header [1] | body. Header bit 7 marks a keyframe, whose
+ * body is the raw payload; bits 0..6 are a sequence number. The decoder
+ * can only rebuild a delta on top of the previous sample, so after a
+ * missing sequence number it drops samples until the next keyframe. The
+ * encoder sends one every `interval` samples, and whenever the deltas
+ * would not be smaller than the payload.
+ *
+ * Both ends are portable; see delta_topics.hpp for the middleware side and
+ * host/delta_bench.cpp for bus load and cycle measurements.
+ */
+
+#define DELTA_MAX_FIELDS	16
+#define DELTA_ORDER2		0x80
+#define DELTA_SIZE_MASK		0x07
+
+#define DELTA_KEYFRAME_INTERVAL	32
+
+#define DELTA_KEYFRAME		0x80
+#define DELTA_SEQ_MASK		0x7F
+
+/* Worst case encoded size of a payload of n bytes in f fields. */
+#define DELTA_MAX_SIZE(n, f)	(1 + (n) + (f))
+
+/* Payload size of a layout. */
+size_t delta_size(const uint8_t * layout, uint8_t fields);
+
+struct DeltaStats {
+	uint32_t samples;
+	uint32_t keyframes;
+	uint32_t bytes;		/* Encoded, headers included. */
+	uint32_t lost;		/* Missing sequence numbers (decoder). */
+	uint32_t skipped;	/* Deltas dropped waiting for a keyframe (decoder). */
+	uint32_t malformed;	/* Decoder. */
+};
+
+class DeltaEncoder {
+public:
+	DeltaEncoder(const uint8_t * layout, uint8_t fields, uint8_t interval);
+
+	/* Returns the encoded length, at most DELTA_MAX_SIZE(). */
+	size_t encode(const uint8_t * payload, uint8_t * out);
+
+	/* Next sample goes out as a keyframe. */
+	void keyframe(void) {
+		_countdown = 0;
+	}
+
+	size_t size(void) const {
+		return _size;
+	}
+
+	const DeltaStats & stats(void) const {
+		return _stats;
+	}
+
+private:
+	const uint8_t * _layout;
+	uint8_t _fields;
+	uint8_t _interval;
+	uint8_t _countdown;
+	uint8_t _seq;
+	size_t _size;
+	uint32_t _prev[DELTA_MAX_FIELDS];
+	uint32_t _step[DELTA_MAX_FIELDS];
+	DeltaStats _stats;
+};
+
+class DeltaDecoder {
+public:
+	DeltaDecoder(const uint8_t * layout, uint8_t fields);
+
+	/* False if no sample could be rebuilt from this message. */
+	bool decode(const uint8_t * in, size_t len, uint8_t * payload);
+
+	size_t size(void) const {
+		return _size;
+	}
+
+	const DeltaStats & stats(void) const {
+		return _stats;
+	}
+
+private:
+	const uint8_t * _layout;
+	uint8_t _fields;
+	uint8_t _seq;
+	bool _seen;
+	bool _synced;
+	size_t _size;
+	uint32_t _prev[DELTA_MAX_FIELDS];
+	uint32_t _step[DELTA_MAX_FIELDS];
+	DeltaStats _stats;
+};
+
+#endif /* DELTA_CODEC_HPP_ */
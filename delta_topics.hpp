@@ -0,0 +1,175 @@
+#ifndef DELTA_TOPICS_HPP_
+#define DELTA_TOPICS_HPP_
+
+#include <string.h>
+
+#include "ch.h"
+
+#include "Middleware.hpp"
+#include "payload.hpp"
+#include "delta_codec.hpp"
+#include "serial_topics.hpp"
+
+/*
+ * Delta encoded remote topics (delta_codec.hpp), for high rate integer
+ * sensor topics such as "imu". Only the link sees the encoding: local
+ * publishers and Subscriber<T,N> users on both ends are unchanged.
+ *
+ * Sender: a DeltaForwarder<T,N,Links> in place of a Forwarder, or a
+ * DeltaSubscriber<T,N> in place of a SerialSubscriber on the serial
+ * transport. Receiver: a DeltaPublisher<T> in place of a SerialPublisher,
+ * with the same layout.
+ */
+
+template<typename T, int N, typename Links>
+class DeltaForwarder {
+public:
+	DeltaForwarder(const char * topic, uint16_t id, const uint8_t * layout,
+			uint8_t fields, uint8_t interval = DELTA_KEYFRAME_INTERVAL) :
+			_topic(topic), _id(id), _enc(layout, fields, interval) {
+	}
+
+	void stats(DeltaStats * stats) {
+		chSysLock();
+		*stats = _enc.stats();
+		chSysUnlock();
+	}
+
+	static msg_t thread(void * arg);
+
+private:
+	const char * _topic;
+	uint16_t _id;
+	DeltaEncoder _enc;
+};
+
+/*
+ * Forwarder thread, arg is the DeltaForwarder instance.
+ */
+template<typename T, int N, typename Links>
+msg_t DeltaForwarder<T, N, Links>::thread(void * arg) {
+	DeltaForwarder<T, N, Links> * fwd = (DeltaForwarder<T, N, Links> *) arg;
+	Middleware & mw = Middleware::instance();
+	Node n("dforwarder");
+	Subscriber<T, N> sub(fwd->_topic);
+	uint8_t buf[DELTA_MAX_SIZE(sizeof(T) - sizeof(BaseMessage), DELTA_MAX_FIELDS)];
+	size_t len;
+	T *d;
+
+	chRegSetThreadName("DFORWARDER");
+
+	mw.newNode(&n);
+	n.subscribe(&sub);
+
+	while (!chThdShouldTerminate()) {
+		n.spin();
+		while ((d = sub.get()) != NULL) {
+			len = fwd->_enc.encode(payload(d), buf);
+			sub.release(d);
+			Links::send(fwd->_id, buf, len);
+		}
+	}
+
+	mw.delNode(&n);
+	chThdExit(RDY_OK);
+
+	return 0;
+}
+
+template<typename T, int N>
+class DeltaSubscriber: public SerialTopicTx {
+public:
+	DeltaSubscriber(const char * topic, uint16_t id, const uint8_t * layout,
+			uint8_t fields, uint8_t interval = DELTA_KEYFRAME_INTERVAL,
+			systime_t latency = 0) :
+			SerialTopicTx(id, DELTA_MAX_SIZE(payloadSize<T>(), fields), latency),
+			_sub(topic), _msg(NULL), _enc(layout, fields, interval), _len(0) {
+	}
+
+	bool subscribe(Node * n) {
+		return n->subscribe(&_sub);
+	}
+
+	const uint8_t * get(void) {
+		_msg = _sub.get();
+		if (_msg == NULL) {
+			return NULL;
+		}
+		_len = _enc.encode(payload(_msg), _buf);
+
+		return _buf;
+	}
+
+	void release(void) {
+		_sub.release(_msg);
+		_msg = NULL;
+	}
+
+	size_t length(void) const {
+		return _len;
+	}
+
+	void stats(DeltaStats * stats) {
+		chSysLock();
+		*stats = _enc.stats();
+		chSysUnlock();
+	}
+
+private:
+	Subscriber<T, N> _sub;
+	T * _msg;
+	DeltaEncoder _enc;
+	uint8_t _buf[DELTA_MAX_SIZE(sizeof(T) - sizeof(BaseMessage), DELTA_MAX_FIELDS)];
+	size_t _len;
+};
+
+template<typename T>
+class DeltaPublisher: public SerialTopicRx {
+public:
+	DeltaPublisher(const char * topic, uint16_t id, const uint8_t * layout,
+			uint8_t fields) :
+			SerialTopicRx(id, DELTA_MAX_SIZE(payloadSize<T>(), fields)),
+			_pub(topic), _dec(layout, fields) {
+	}
+
+	bool advertise(Node * n) {
+		return n->advertise(&_pub);
+	}
+
+	bool accepts(size_t len) const {
+		return len > 0 && len <= size;
+	}
+
+	/*
+	 * Every message is decoded, buffer or not, to keep up with the
+	 * sender; samples that cannot be rebuilt only show in stats().
+	 */
+	bool publish(const uint8_t * data, size_t len) {
+		uint8_t sample[sizeof(T) - sizeof(BaseMessage)];
+		T * msg;
+
+		if (!_dec.decode(data, len, sample)) {
+			return true;
+		}
+		msg = _pub.alloc();
+		if (msg == NULL) {
+			return false;
+		}
+		memcpy(payload(msg), sample, sizeof(sample));
+		_pub.broadcast(msg);
+
+		return true;
+	}
+
+	void stats(DeltaStats * stats) {
+		chSysLock();
+		*stats = _dec.stats();
+		chSysUnlock();
+	}
+
+private:
+	Publisher<T> _pub;
+	DeltaDecoder _dec;
+};
+
+#endif /* DELTA_TOPICS_HPP_ */
@@ -0,0 +1,311 @@
+#include <string.h>
+
+#include "discovery.hpp"
+
+/*
+ * FNV-1a, 32 bit.
+ */
+uint32_t topic_hash(const char * name) {
+	uint32_t hash = 2166136261u;
+
+	while (*name) {
+		hash ^= (uint8_t) *name++;
+		hash *= 16777619u;
+	}
+
+	return hash;
+}
+
+Discovery::Discovery(uint8_t uid, SendFn send, void * arg) :
+		_uid(uid), _send(send), _send_arg(arg), _seed(0x9E3779B9u * (uid + 1u)),
+		_ntopics(0) {
+
+	memset(&_stats, 0, sizeof(_stats));
+}
+
+bool Discovery::advertise(const char * name, uint8_t size, BindFn bind,
+		void * arg) {
+	Entry * e = local(name, size, bind, arg);
+
+	if (e == NULL || (e->flags & SUBSCRIBE)) {
+		return false;
+	}
+	e->flags |= PUBLISH;
+
+	return true;
+}
+
+/*
+ * Topics published by this node are delivered locally, a subscription to
+ * one of them is refused.
+ */
+bool Discovery::subscribe(const char * name, uint8_t size, BindFn bind,
+		void * arg) {
+	Entry * e = local(name, size, bind, arg);
+
+	if (e == NULL || (e->flags & PUBLISH)) {
+		return false;
+	}
+	e->flags |= SUBSCRIBE;
+
+	return true;
+}
+
+uint8_t Discovery::cid(const char * name) const {
+	const Entry * e = find(topic_hash(name));
+
+	return (e != NULL) ? e->cid : 0;
+}
+
+void Discovery::receive(const DiscoveryFrame * frame, uint32_t now) {
+	Entry * e;
+	Entry * other;
+
+	_stats.rx_frames++;
+	if (frame->uid == _uid) {
+		return;
+	}
+
+	if (frame->type == DISCOVERY_QUERY) {
+		e = find(frame->hash);
+		if (e != NULL && (e->flags & PUBLISH) && e->owner == _uid
+				&& e->cid != 0) {
+			reset(e, now);
+		}
+		return;
+	}
+
+	if (frame->type != DISCOVERY_ADVERTISE || frame->cid == 0
+			|| frame->cid >= TIMESYNC_CID) {
+		return;
+	}
+
+	e = insert(frame->hash, frame->size);
+	if (e == NULL || e->size != frame->size) {
+		return;
+	}
+
+	if (e->cid != 0 && frame->uid > e->owner) {
+		/* The sender has not heard the owner yet: correct it. */
+		if (frame->cid != e->cid && (e->flags & PUBLISH) && e->owner == _uid) {
+			reset(e, now);
+		}
+		return;
+	}
+
+	if (e->cid == frame->cid && e->owner == frame->uid) {
+		return;
+	}
+
+	e->cid = frame->cid;
+	e->owner = frame->uid;
+	if (e->flags & PUBLISH) {
+		/* Not the owner any more, the owner advertises. */
+		e->period = 0;
+	}
+
+	/* Same compact id claimed for two topics: the lower owner keeps it. */
+	other = holder(e->cid, e);
+	if (other != NULL) {
+		_stats.conflicts++;
+		release((other->owner < e->owner) ? e : other, now);
+	}
+
+	notify(e);
+}
+
+void Discovery::tick(uint32_t now) {
+	DiscoveryFrame frame;
+
+	for (uint8_t i = 0; i < _ntopics; i++) {
+		Entry * e = &_topics[i];
+
+		if (!(e->flags & (PUBLISH | SUBSCRIBE))) {
+			continue;
+		}
+
+		if (!(e->flags & STARTED)) {
+			e->flags |= STARTED;
+			if ((e->flags & PUBLISH) && e->cid == 0) {
+				claim(e, now);
+			} else if ((e->flags & PUBLISH) && e->owner > _uid) {
+				e->owner = _uid;
+				notify(e);
+			} else if (e->flags & SUBSCRIBE) {
+				notify(e);
+			}
+			/* First frame anywhere in the first interval. */
+			e->period = DISCOVERY_PERIOD_MIN;
+			e->due = now + random(DISCOVERY_PERIOD_MIN);
+		}
+
+		if (e->period == 0 || (int32_t) (now - e->due) < 0) {
+			continue;
+		}
+
+		frame.uid = _uid;
+		frame.size = e->size;
+		frame.hash = e->hash;
+		if (e->flags & PUBLISH) {
+			if (e->owner != _uid) {
+				e->period = 0;
+				continue;
+			}
+			frame.type = DISCOVERY_ADVERTISE;
+			frame.cid = e->cid;
+		} else {
+			if (e->cid != 0) {
+				e->period = 0;
+				continue;
+			}
+			frame.type = DISCOVERY_QUERY;
+			frame.cid = 0;
+		}
+
+		if (!_send(_send_arg, &frame)) {
+			_stats.tx_busy++;
+			continue;
+		}
+		_stats.tx_frames++;
+
+		e->period = (e->period < DISCOVERY_PERIOD_MAX / 2) ?
+				e->period * 2 : DISCOVERY_PERIOD_MAX;
+		e->due = now + e->period / 2 + random(e->period / 2);
+	}
+}
+
+Discovery::Entry * Discovery::find(uint32_t hash) {
+	for (uint8_t i = 0; i < _ntopics; i++) {
+		if (_topics[i].hash == hash) {
+			return &_topics[i];
+		}
+	}
+
+	return NULL;
+}
+
+const Discovery::Entry * Discovery::find(uint32_t hash) const {
+	return const_cast<Discovery *>(this)->find(hash);
+}
+
+Discovery::Entry * Discovery::insert(uint32_t hash, uint8_t size) {
+	Entry * e = find(hash);
+
+	if (e != NULL) {
+		return e;
+	}
+	if (_ntopics >= DISCOVERY_MAX_TOPICS) {
+		_stats.full++;
+		return NULL;
+	}
+
+	e = &_topics[_ntopics++];
+	memset(e, 0, sizeof(*e));
+	e->hash = hash;
+	e->size = size;
+
+	return e;
+}
+
+Discovery::Entry * Discovery::local(const char * name, uint8_t size,
+		BindFn bind, void * arg) {
+	Entry * e = insert(topic_hash(name), size);
+
+	/* Hash collision between two local names, or a size mismatch. */
+	if (e == NULL || (e->name != NULL && strcmp(e->name, name) != 0)
+			|| e->size != size) {
+		return NULL;
+	}
+	e->name = name;
+	e->bind = bind;
+	e->bind_arg = arg;
+
+	return e;
+}
+
+Discovery::Entry * Discovery::holder(uint8_t cid, const Entry * except) {
+	for (uint8_t i = 0; i < _ntopics; i++) {
+		if (_topics[i].cid == cid && &_topics[i] != except) {
+			return &_topics[i];
+		}
+	}
+
+	return NULL;
+}
+
+uint8_t Discovery::freeCid(void) {
+	for (uint8_t cid = 1; cid < TIMESYNC_CID; cid++) {
+		if (holder(cid, NULL) == NULL) {
+			return cid;
+		}
+	}
+
+	return 0;
+}
+
+/*
+ * Claims the lowest free compact id for a local topic.
+ */
+void Discovery::claim(Entry * e, uint32_t now) {
+
+	e->cid = 0;
+	e->cid = freeCid();
+	e->owner = _uid;
+	reset(e, now);
+	notify(e);
+}
+
+/*
+ * The entry lost its compact id to another topic.
+ */
+void Discovery::release(Entry * e, uint32_t now) {
+
+	if (e->flags & PUBLISH) {
+		claim(e, now);
+		return;
+	}
+
+	e->cid = 0;
+	if (e->flags & SUBSCRIBE) {
+		reset(e, now);
+	}
+}
+
+/*
+ * Restarts the trickle timer from the minimum interval.
+ */
+void Discovery::reset(Entry * e, uint32_t now) {
+
+	if (!(e->flags & STARTED)) {
+		return;
+	}
+	if (e->period == DISCOVERY_PERIOD_MIN
+			&& (int32_t) (e->due - now) < DISCOVERY_PERIOD_MIN) {
+		return;
+	}
+	e->period = DISCOVERY_PERIOD_MIN;
+	e->due = now + DISCOVERY_PERIOD_MIN / 2 + random(DISCOVERY_PERIOD_MIN / 2);
+}
+
+void Discovery::notify(Entry * e) {
+	uint8_t uid;
+
+	if (e->cid == 0 || e->bind == NULL) {
+		return;
+	}
+
+	uid = (e->flags & PUBLISH) ? _uid : e->owner;
+	if (uid == e->bound_uid && e->cid == e->bound_cid) {
+		return;
+	}
+	e->bound_uid = uid;
+	e->bound_cid = e->cid;
+	e->bind(e->bind_arg, e->name, uid, e->cid);
+}
+
+uint32_t Discovery::random(uint32_t range) {
+
+	_seed = _seed * 1664525u + 1013904223u;
+
+	return (range != 0) ? (_seed >> 8) % range : 0;
+}
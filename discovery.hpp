@@ -0,0 +1,134 @@
+#ifndef DISCOVERY_HPP_
+#define DISCOVERY_HPP_
+
+#include <stdint.h>
+#include <stddef.h>
+
+/*
+ * Topic discovery and compact id negotiation.
+ *
+ * Every node periodically advertises the topics it publishes as
+ * (name hash, compact id, publisher uid); remote ids are then
+ * (cid << 8) | uid, as with the hardcoded ids before. Subscribers query
+ * for the topics they need and are bound to the advertising node as soon
+ * as it answers.
+ *
+ * Compact ids are claimed, not assigned: a publisher takes the lowest id
+ * it has not seen in use and advertises it. Two claims on the same id, or
+ * two ids for the same topic, are resolved in favour of the lower uid, and
+ * the loser claims again. Transmissions follow a trickle timer: random
+ * within [I/2, I), I doubling from DISCOVERY_PERIOD_MIN up to
+ * DISCOVERY_PERIOD_MAX and falling back to the minimum on any
+ * inconsistency, so a bus converges in a few minimum periods and then
+ * costs one frame per topic per second.
+ *
+ * Frames are 8 bytes (one CAN frame). Each node sends them on its own id,
+ * (DISCOVERY_CID << 8) | uid, so frames that start together go out one
+ * after the other, lowest uid first, with the controller's usual automatic
+ * retransmission; the randomized timers only spread the load. Compact ids
+ * stop below TIMESYNC_CID, the range kept for clock synchronization
+ * frames, sent the same way. The engine is portable, time is passed in by the caller in
+ * milliseconds; see discovery_node.hpp for the middleware side and
+ * host/discovery_sim.cpp for convergence measurements.
+ */
+
+#define DISCOVERY_MAX_TOPICS	32
+#define DISCOVERY_CID			255	/* Reserved for discovery frames. */
+#define TIMESYNC_CID			254	/* Reserved for timesync frames. */
+#define DISCOVERY_PERIOD_MIN	32	/* [ms] */
+#define DISCOVERY_PERIOD_MAX	1024	/* [ms] */
+
+enum DiscoveryType {
+	DISCOVERY_ADVERTISE = 1, DISCOVERY_QUERY = 2
+};
+
+struct DiscoveryFrame {
+	uint8_t type;
+	uint8_t uid;
+	uint8_t cid;		/* 0 in queries. */
+	uint8_t size;
+	uint32_t hash;
+}__attribute__((packed));
+
+struct DiscoveryStats {
+	uint32_t tx_frames;
+	uint32_t tx_busy;
+	uint32_t rx_frames;
+	uint32_t conflicts;	/* Compact id claimed by two topics. */
+	uint32_t full;		/* Topic table full. */
+};
+
+uint32_t topic_hash(const char * name);
+
+class Discovery {
+public:
+	/* Returns false if the frame could not be queued, it is sent again on
+	 * the next tick. */
+	typedef bool (*SendFn)(void * arg, const DiscoveryFrame * frame);
+
+	/* Called when the (uid, cid) pair of a topic changes: the own pair for
+	 * advertised topics, the publisher's for subscribed ones. */
+	typedef void (*BindFn)(void * arg, const char * name, uint8_t uid,
+			uint8_t cid);
+
+	Discovery(uint8_t uid, SendFn send, void * arg);
+
+	bool advertise(const char * name, uint8_t size, BindFn bind, void * arg);
+	bool subscribe(const char * name, uint8_t size, BindFn bind, void * arg);
+
+	void receive(const DiscoveryFrame * frame, uint32_t now);
+	void tick(uint32_t now);
+
+	/* Compact id of a topic, 0 while unknown. */
+	uint8_t cid(const char * name) const;
+
+	uint8_t uid(void) const {
+		return _uid;
+	}
+
+	const DiscoveryStats & stats(void) const {
+		return _stats;
+	}
+
+private:
+	enum {
+		PUBLISH = 0x01, SUBSCRIBE = 0x02, STARTED = 0x04
+	};
+
+	struct Entry {
+		uint32_t hash;
+		const char * name;	/* Local topics only. */
+		BindFn bind;
+		void * bind_arg;
+		uint32_t due;
+		uint16_t period;	/* 0: nothing scheduled. */
+		uint8_t cid;
+		uint8_t owner;		/* Lowest uid advertising the topic. */
+		uint8_t size;
+		uint8_t flags;
+		uint8_t bound_uid;
+		uint8_t bound_cid;
+	};
+
+	Entry * find(uint32_t hash);
+	const Entry * find(uint32_t hash) const;
+	Entry * insert(uint32_t hash, uint8_t size);
+	Entry * local(const char * name, uint8_t size, BindFn bind, void * arg);
+	Entry * holder(uint8_t cid, const Entry * except);
+	uint8_t freeCid(void);
+	void claim(Entry * e, uint32_t now);
+	void release(Entry * e, uint32_t now);
+	void reset(Entry * e, uint32_t now);
+	void notify(Entry * e);
+	uint32_t random(uint32_t range);
+
+	uint8_t _uid;
+	SendFn _send;
+	void * _send_arg;
+	uint32_t _seed;
+	Entry _topics[DISCOVERY_MAX_TOPICS];
+	uint8_t _ntopics;
+	DiscoveryStats _stats;
+};
+
+#endif /* DISCOVERY_HPP_ */
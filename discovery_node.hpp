@@ -0,0 +1,107 @@
+#ifndef DISCOVERY_NODE_HPP_
+#define DISCOVERY_NODE_HPP_
+
+#include "ch.h"
+
+#include "Middleware.hpp"
+#include "discovery.hpp"
+#include "rtcan_range.hpp"
+
+#if CH_FREQUENCY != 1000
+#error "DiscoveryNode expects a 1 ms system tick"
+#endif
+
+/*
+ * Discovery (discovery.hpp) over the middleware's remote topics.
+ *
+ * Outgoing frames are published on "discovery/out", which a remote
+ * subscriber sends on the bus with id (DISCOVERY_CID << 8) | uid: each
+ * node has its own id, so simultaneous frames are serialized by CAN
+ * arbitration, as any other traffic, and the controller's automatic
+ * retransmission never repeats a frame that lost against a different
+ * payload on the same id. Frames from the other nodes come in through an
+ * RTCANRange on the whole DISCOVERY_CID range. Topics are added with discovery().advertise() / subscribe() before the
+ * thread starts; bind callbacks run in the discovery thread.
+ */
+
+#define DISCOVERY_TICK_MS	4
+
+struct DiscoveryMsg: public BaseMessage {
+	DiscoveryFrame frame;
+}__attribute__((packed));
+
+class DiscoveryNode {
+public:
+	DiscoveryNode(uint8_t uid) :
+			_discovery(uid, send, this), _pub("discovery/out"),
+			_rsub("discovery/out"), _rx(DISCOVERY_CID, sizeof(DiscoveryFrame)) {
+	}
+
+	Discovery & discovery(void) {
+		return _discovery;
+	}
+
+	static msg_t thread(void * arg);
+
+private:
+	static bool send(void * arg, const DiscoveryFrame * frame);
+
+	Discovery _discovery;
+	Publisher<DiscoveryMsg> _pub;
+	RemoteSubscriberT<DiscoveryMsg, 4> _rsub;
+	RTCANRange<4> _rx;
+};
+
+inline bool DiscoveryNode::send(void * arg, const DiscoveryFrame * frame) {
+	DiscoveryNode * d = (DiscoveryNode *) arg;
+	DiscoveryMsg * msg = d->_pub.alloc();
+
+	if (msg == NULL) {
+		return false;
+	}
+	msg->frame = *frame;
+	d->_pub.broadcast(msg);
+
+	return true;
+}
+
+/*
+ * Discovery thread, arg is the DiscoveryNode instance.
+ */
+inline msg_t DiscoveryNode::thread(void * arg) {
+	DiscoveryNode * d = (DiscoveryNode *) arg;
+	Middleware & mw = Middleware::instance();
+	Node n("discovery");
+	LocalPublisher * pub;
+	DiscoveryFrame frame;
+
+	chRegSetThreadName("DISCOVERY");
+
+	mw.newNode(&n);
+	n.advertise(&d->_pub);
+
+	d->_rx.start();
+
+	pub = mw.findLocalPublisher("discovery/out");
+	if (pub) {
+		d->_rsub.id((DISCOVERY_CID << 8) | d->_discovery.uid());
+		d->_rsub.subscribe(pub);
+	}
+
+	/* Polled: the trickle timers need ticks whether frames come in or not. */
+	while (!chThdShouldTerminate()) {
+		chThdSleepMilliseconds(DISCOVERY_TICK_MS);
+
+		while (d->_rx.get(&frame, TIME_IMMEDIATE)) {
+			d->_discovery.receive(&frame, chTimeNow());
+		}
+		d->_discovery.tick(chTimeNow());
+	}
+
+	mw.delNode(&n);
+	chThdExit(RDY_OK);
+
+	return 0;
+}
+
+#endif /* DISCOVERY_NODE_HPP_ */
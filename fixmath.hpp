@@ -0,0 +1,90 @@
+#ifndef FIXMATH_HPP_
+#define FIXMATH_HPP_
+
+#include <stdint.h>
+
+/*
+ * Fixed point helpers, CMSIS-DSP style naming.
+ * Cortex-M3 has a single cycle 32x32->64 SMULL and a hardware UDIV, no FPU:
+ * everything here sticks to those.
+ */
+
+typedef int16_t q15_t;
+typedef int32_t q31_t;
+
+#define Q15(x)		((q15_t) ((x) * 32768.0f))
+#define Q30(x)		((q31_t) ((x) * 1073741824.0f))
+#define Q31(x)		((q31_t) ((x) * 2147483648.0f))
+
+static inline q31_t q31_sat(int64_t x) {
+	if (x > INT32_MAX) {
+		return INT32_MAX;
+	}
+	if (x < INT32_MIN) {
+		return INT32_MIN;
+	}
+	return (q31_t) x;
+}
+
+/* Product of two values with a and b fractional bits, returned with a + b - shift. */
+static inline int32_t fx_mul(int32_t a, int32_t b, int shift) {
+	return (int32_t) (((int64_t) a * b) >> shift);
+}
+
+static inline q31_t q30_mul(q31_t a, q31_t b) {
+	return (q31_t) (((int64_t) a * b) >> 30);
+}
+
+static inline q31_t q31_mul(q31_t a, q31_t b) {
+	return (q31_t) (((int64_t) a * b) >> 31);
+}
+
+/*
+ * Integer square root, bit by bit: 16 iterations, no multiply.
+ */
+static inline uint32_t isqrt32(uint32_t x) {
+	uint32_t root = 0;
+	uint32_t bit = 1UL << 30;
+
+	while (bit > x) {
+		bit >>= 2;
+	}
+
+	while (bit != 0) {
+		if (x >= root + bit) {
+			x -= root + bit;
+			root = (root >> 1) + bit;
+		} else {
+			root >>= 1;
+		}
+		bit >>= 2;
+	}
+
+	return root;
+}
+
+/*
+ * Normalizes a raw int16_t vector to unit length in Q30.
+ * Returns false for the zero vector.
+ */
+static inline bool q30_normalize3(const int32_t in[3], q31_t out[3]) {
+	uint32_t norm;
+	uint32_t r;
+
+	/* Three squared int16_t fit in 32 bit unsigned. */
+	norm = isqrt32((uint32_t) (in[0] * in[0]) + (uint32_t) (in[1] * in[1])
+			+ (uint32_t) (in[2] * in[2]));
+	if (norm == 0) {
+		return false;
+	}
+
+	/* Single hardware division, the reciprocal keeps ~19 bits at 1 g. */
+	r = (1UL << 31) / norm;
+	out[0] = (q31_t) (((int64_t) in[0] * r) >> 1);
+	out[1] = (q31_t) (((int64_t) in[1] * r) >> 1);
+	out[2] = (q31_t) (((int64_t) in[2] * r) >> 1);
+
+	return true;
+}
+
+#endif /* FIXMATH_HPP_ */
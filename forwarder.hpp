@@ -0,0 +1,67 @@
+#ifndef FORWARDER_HPP_
+#define FORWARDER_HPP_
+
+#include "ch.h"
+
+#include "Middleware.hpp"
+#include "payload.hpp"
+#include "probe.hpp"
+#include "transports.hpp"
+
+/*
+ * Forwards a local topic to every link of a Transports<> list, e.g.
+ *     Forwarder<ImuSample, 5, Transports<SerialLink<serial>, LoopbackLink> >
+ * The per-message dispatch is fully static (see transports.hpp).
+ */
+
+template<typename T, int N, typename Links>
+class Forwarder {
+public:
+	Forwarder(const char * topic, uint16_t id) :
+			_topic(topic), _id(id), _forwarded(0) {
+	}
+
+	uint32_t forwarded(void) const {
+		return _forwarded;
+	}
+
+	static msg_t thread(void * arg);
+
+private:
+	const char * _topic;
+	uint16_t _id;
+	uint32_t _forwarded;
+};
+
+/*
+ * Forwarder thread, arg is the Forwarder instance.
+ */
+template<typename T, int N, typename Links>
+msg_t Forwarder<T, N, Links>::thread(void * arg) {
+	Forwarder<T, N, Links> * fwd = (Forwarder<T, N, Links> *) arg;
+	Middleware & mw = Middleware::instance();
+	Node n("forwarder");
+	Subscriber<T, N> sub(fwd->_topic);
+	T *d;
+
+	chRegSetThreadName("FORWARDER");
+
+	mw.newNode(&n);
+	n.subscribe(&sub);
+
+	while (!chThdShouldTerminate()) {
+		n.spin();
+		while ((d = sub.get()) != NULL) {
+			PROBE(PROBE_POST, Links::send(fwd->_id, payload(d), payloadSize<T>()));
+			sub.release(d);
+			fwd->_forwarded++;
+		}
+	}
+
+	mw.delNode(&n);
+	chThdExit(RDY_OK);
+
+	return 0;
+}
+
+#endif /* FORWARDER_HPP_ */
@@ -0,0 +1,178 @@
+/*
+ * Host-side accuracy and cost check of the Q31 Mahony filter against the
+ * float reference, fed with the same synthetic raw sensor stream.
+ *
+ * Usage: ahrs_compare [seconds] [rate]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <time.h>
+
+#include "ahrs.hpp"
+
+#define GYRO_SCALE	(0.0175f * 3.14159265f / 180.0f)	/* L3GD20, 500 dps */
+#define ACC_LSB_G	1000.0								/* LSM303, 2 g, 12 bit */
+#define MAG_LSB		500.0
+
+struct Quat {
+	double w, x, y, z;
+};
+
+static Quat qmul(const Quat & a, const Quat & b) {
+	Quat r;
+
+	r.w = a.w * b.w - a.x * b.x - a.y * b.y - a.z * b.z;
+	r.x = a.w * b.x + a.x * b.w + a.y * b.z - a.z * b.y;
+	r.y = a.w * b.y - a.x * b.z + a.y * b.w + a.z * b.x;
+	r.z = a.w * b.z + a.x * b.y - a.y * b.x + a.z * b.w;
+	return r;
+}
+
+/* Earth to body: q* v q. */
+static void to_body(const Quat & q, const double e[3], double b[3]) {
+	Quat v = { 0.0, e[0], e[1], e[2] };
+	Quat c = { q.w, -q.x, -q.y, -q.z };
+	Quat r = qmul(qmul(c, v), q);
+
+	b[0] = r.x;
+	b[1] = r.y;
+	b[2] = r.z;
+}
+
+static double angle(const Quat & a, double w, double x, double y, double z) {
+	double d = fabs(a.w * w + a.x * x + a.y * y + a.z * z);
+
+	if (d > 1.0) {
+		d = 1.0;
+	}
+	return 2.0 * acos(d) * 180.0 / M_PI;
+}
+
+static int16_t clamp16(double v) {
+	if (v > 32767.0) {
+		return 32767;
+	}
+	if (v < -32768.0) {
+		return -32768;
+	}
+	return (int16_t) lrint(v);
+}
+
+static double now(void) {
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+int main(int argc, char * argv[]) {
+	double seconds = (argc > 1) ? atof(argv[1]) : 60.0;
+	uint32_t rate = (argc > 2) ? atoi(argv[2]) : 1000;
+	AhrsConfig config = { GYRO_SCALE, 2.0f, 0.005f, rate };
+	MahonyQ31 fixed(&config);
+	MahonyFloat ref(&config);
+	const double gravity[3] = { 0.0, 0.0, 1.0 };
+	const double field[3] = { 0.4, 0.0, 0.9 };
+	uint32_t steps = (uint32_t) (seconds * rate);
+	double dt = 1.0 / rate;
+	Quat truth = { 1.0, 0.0, 0.0, 0.0 };
+	double max_qf = 0.0, sum_qf = 0.0, max_ft = 0.0, max_qt = 0.0;
+	double t_fixed = 0.0, t_float = 0.0, t0;
+	int16_t (*gyro)[3] = new int16_t[steps][3];
+	int16_t (*acc)[3] = new int16_t[steps][3];
+	int16_t (*mag)[3] = new int16_t[steps][3];
+	Quat * q = new Quat[steps];
+
+	srand(1);
+
+	/* Smooth motion, all three axes, up to ~3 rad/s. */
+	for (uint32_t i = 0; i < steps; i++) {
+		double t = i * dt;
+		double w[3] = { 2.0 * sin(0.7 * t), 1.5 * sin(1.3 * t + 1.0), 3.0
+				* sin(0.31 * t + 2.0) };
+		double b[3];
+		Quat dq = { 1.0, 0.5 * w[0] * dt, 0.5 * w[1] * dt, 0.5 * w[2] * dt };
+		double n;
+
+		for (int k = 0; k < 3; k++) {
+			gyro[i][k] = clamp16(w[k] / GYRO_SCALE + (rand() % 5 - 2));
+		}
+
+		to_body(truth, gravity, b);
+		for (int k = 0; k < 3; k++) {
+			acc[i][k] = clamp16(b[k] * ACC_LSB_G + (rand() % 21 - 10));
+		}
+
+		to_body(truth, field, b);
+		for (int k = 0; k < 3; k++) {
+			mag[i][k] = clamp16(b[k] * MAG_LSB + (rand() % 5 - 2));
+		}
+
+		/* Samples are taken at the start of the step, truth at its end. */
+		truth = qmul(truth, dq);
+		n = sqrt(truth.w * truth.w + truth.x * truth.x + truth.y * truth.y
+				+ truth.z * truth.z);
+		truth.w /= n;
+		truth.x /= n;
+		truth.y /= n;
+		truth.z /= n;
+		q[i] = truth;
+	}
+
+	for (uint32_t i = 0; i < steps; i++) {
+		const q31_t * qf;
+		const float * qr;
+		Quat fq;
+		double e;
+
+		t0 = now();
+		fixed.update(gyro[i], acc[i], mag[i]);
+		t_fixed += now() - t0;
+
+		t0 = now();
+		ref.update(gyro[i], acc[i], mag[i]);
+		t_float += now() - t0;
+
+		qf = fixed.quaternion();
+		qr = ref.quaternion();
+		fq.w = qf[0] / 1073741824.0;
+		fq.x = qf[1] / 1073741824.0;
+		fq.y = qf[2] / 1073741824.0;
+		fq.z = qf[3] / 1073741824.0;
+
+		e = angle(fq, qr[0], qr[1], qr[2], qr[3]);
+		sum_qf += e * e;
+		if (e > max_qf) {
+			max_qf = e;
+		}
+
+		/* Skip the initial convergence when comparing against truth. */
+		if (i > 10 * rate) {
+			e = angle(q[i], qr[0], qr[1], qr[2], qr[3]);
+			if (e > max_ft) {
+				max_ft = e;
+			}
+			e = angle(q[i], fq.w, fq.x, fq.y, fq.z);
+			if (e > max_qt) {
+				max_qt = e;
+			}
+		}
+	}
+
+	printf("%u updates at %u Hz\r\n", steps, rate);
+	printf("Q31 vs float  : max %.5f deg, rms %.5f deg\r\n", max_qf,
+			sqrt(sum_qf / steps));
+	printf("float vs truth: max %.4f deg\r\n", max_ft);
+	printf("Q31 vs truth  : max %.4f deg\r\n", max_qt);
+	printf("host cost     : Q31 %.1f ns, float %.1f ns per update\r\n",
+			t_fixed * 1e9 / steps, t_float * 1e9 / steps);
+
+	delete[] gyro;
+	delete[] acc;
+	delete[] mag;
+	delete[] q;
+
+	return 0;
+}
@@ -0,0 +1,178 @@
+#include <string.h>
+#include <unistd.h>
+#include <sys/select.h>
+
+#include "bridge.hpp"
+#include "tty.hpp"
+
+Bridge::Bridge(void) :
+		_fd(-1), _own_fd(false), _run(false), _ntopics(0) {
+
+	pthread_mutex_init(&_lock, NULL);
+	memset(&_stats, 0, sizeof(_stats));
+}
+
+Bridge::~Bridge(void) {
+
+	stop();
+	if (_own_fd && _fd >= 0) {
+		close(_fd);
+	}
+	pthread_mutex_destroy(&_lock);
+}
+
+bool Bridge::open(const char * device, unsigned baud) {
+
+	_fd = tty_open(device, baud);
+	_own_fd = true;
+
+	return _fd >= 0;
+}
+
+void Bridge::attach(int fd) {
+
+	_fd = fd;
+	_own_fd = false;
+}
+
+ShmRing * Bridge::add(uint16_t id, const char * name, uint32_t size,
+		uint32_t slots) {
+	ShmRing * ring = NULL;
+	int n;
+
+	pthread_mutex_lock(&_lock);
+	n = _ntopics;
+	for (int i = 0; i < n; i++) {
+		if (_topics[i].id == id) {
+			ring = &_topics[i].ring;
+		}
+	}
+	if (ring == NULL && n < BRIDGE_MAX_TOPICS
+			&& _topics[n].ring.create(name, size, slots)) {
+		_topics[n].id = id;
+		ring = &_topics[n].ring;
+		__atomic_store_n(&_ntopics, n + 1, __ATOMIC_RELEASE);
+	}
+	pthread_mutex_unlock(&_lock);
+
+	return ring;
+}
+
+ShmRing * Bridge::ring(uint16_t id) {
+	int n = __atomic_load_n(&_ntopics, __ATOMIC_ACQUIRE);
+
+	for (int i = 0; i < n; i++) {
+		if (_topics[i].id == id) {
+			return &_topics[i].ring;
+		}
+	}
+
+	return NULL;
+}
+
+bool Bridge::start(void) {
+
+	if (_fd < 0 || _run) {
+		return false;
+	}
+	_run = true;
+
+	return pthread_create(&_thread, NULL, rxThread, this) == 0;
+}
+
+void Bridge::stop(void) {
+
+	if (_run) {
+		_run = false;
+		pthread_join(_thread, NULL);
+	}
+}
+
+/*
+ * Frames and writes one message; callable from any thread.
+ */
+bool Bridge::send(uint16_t id, const void * payload, size_t len) {
+	uint8_t frame[SERIAL_FRAME_SIZE(SERIAL_MAX_PAYLOAD)];
+	size_t n, off = 0;
+	ssize_t w;
+
+	if (len > SERIAL_MAX_PAYLOAD) {
+		return false;
+	}
+	n = frame_encode(id, (const uint8_t *) payload, len, frame);
+
+	pthread_mutex_lock(&_lock);
+	while (off < n) {
+		w = write(_fd, frame + off, n - off);
+		if (w < 0) {
+			break;
+		}
+		off += w;
+	}
+	if (off == n) {
+		_stats.tx_frames++;
+	}
+	pthread_mutex_unlock(&_lock);
+
+	return off == n;
+}
+
+void Bridge::stats(BridgeStats * stats) {
+
+	pthread_mutex_lock(&_lock);
+	*stats = _stats;
+	stats->frames = _decoder.stats();
+	pthread_mutex_unlock(&_lock);
+}
+
+/*
+ * Decoded frame to its topic rings, one per message of a batch: the only
+ * copy on the receive path.
+ */
+void Bridge::dispatch(void) {
+	FrameReader reader(_decoder.topic(), _decoder.payload(), _decoder.length());
+
+	while (reader.next()) {
+		ShmRing * r = ring(reader.topic());
+
+		if (r == NULL || r->slotSize() != reader.length()) {
+			_stats.rx_unknown++;
+			continue;
+		}
+		PROBE(PROBE_POST, r->write(reader.payload(), reader.length()));
+	}
+	if (reader.malformed()) {
+		_stats.rx_unknown++;
+	}
+}
+
+void * Bridge::rxThread(void * arg) {
+	Bridge * b = (Bridge *) arg;
+	uint8_t buf[4096];
+	ssize_t n;
+
+	while (b->_run) {
+		struct timeval tv = { 0, 100000 };
+		fd_set set;
+
+		FD_ZERO(&set);
+		FD_SET(b->_fd, &set);
+		if (select(b->_fd + 1, &set, NULL, NULL, &tv) <= 0) {
+			continue;
+		}
+
+		n = read(b->_fd, buf, sizeof(buf));
+		if (n <= 0) {
+			continue;
+		}
+		b->_stats.rx_wire_bytes += n;
+
+		for (ssize_t i = 0; i < n; i++) {
+			if (b->_decoder.push(buf[i])) {
+				b->dispatch();
+			}
+		}
+	}
+
+	return NULL;
+}
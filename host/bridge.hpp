@@ -0,0 +1,145 @@
+#ifndef BRIDGE_HPP_
+#define BRIDGE_HPP_
+
+#include <stdio.h>
+#include <stdint.h>
+#include <pthread.h>
+
+#include "probe.hpp"
+#include "serial_frame.hpp"
+#include "shm_ring.hpp"
+
+/*
+ * Host side of the serial transport: decodes the frames the firmware
+ * SerialTransport sends and exposes each topic as a ShmRing, with the same
+ * Publisher<T> / Subscriber<T,N> shape as on the board. T is the payload
+ * struct, without the BaseMessage header (see imu_log.hpp).
+ *
+ * Topic rings can be named: other processes then attach() to them and
+ * read with a RingReader, zero copy, without going through the bridge.
+ */
+
+#define BRIDGE_MAX_TOPICS	32
+
+struct BridgeStats {
+	uint64_t rx_wire_bytes;
+	uint64_t rx_unknown;
+	uint64_t tx_frames;
+	FrameStats frames;
+};
+
+class Bridge {
+public:
+	Bridge(void);
+	~Bridge(void);
+
+	bool open(const char * device, unsigned baud);
+	void attach(int fd);
+
+	/* Safe while running: the receive thread only sees complete entries. */
+	ShmRing * add(uint16_t id, const char * name, uint32_t size, uint32_t slots);
+	ShmRing * ring(uint16_t id);
+
+	bool start(void);
+	void stop(void);
+
+	bool send(uint16_t id, const void * payload, size_t len);
+	void stats(BridgeStats * stats);
+
+private:
+	struct Topic {
+		uint16_t id;
+		ShmRing ring;
+	};
+
+	static void * rxThread(void * arg);
+	void dispatch(void);
+
+	int _fd;
+	bool _own_fd;
+	pthread_t _thread;
+	volatile bool _run;
+	pthread_mutex_t _lock;
+	FrameDecoder _decoder;
+	Topic _topics[BRIDGE_MAX_TOPICS];
+	int _ntopics;
+	BridgeStats _stats;
+};
+
+template<typename T, int N>
+class Subscriber {
+public:
+	Subscriber(const char * topic, uint16_t id) :
+			_topic(topic), _id(id) {
+	}
+
+	/* Ring named "/r2p.<topic>", shared with other subscribers of the id. */
+	bool subscribe(Bridge * bridge) {
+		ShmRing * ring = bridge->ring(_id);
+		char name[64];
+
+		if (ring == NULL) {
+			snprintf(name, sizeof(name), "/r2p.%s", _topic);
+			ring = bridge->add(_id, name, sizeof(T), N);
+		}
+		if (ring == NULL || ring->slotSize() != sizeof(T)) {
+			return false;
+		}
+		_reader.init(ring);
+
+		return true;
+	}
+
+	const T * get(void) {
+		return (const T *) PROBE_EXPR(PROBE_GET, _reader.get());
+	}
+
+	/* False if the message was overwritten while in use. */
+	bool release(const T * msg) {
+		(void) msg;
+		return PROBE_EXPR(PROBE_RELEASE, _reader.release());
+	}
+
+	/* The spin() of the board API. */
+	bool wait(int timeout_ms) {
+		return PROBE_EXPR(PROBE_SPIN, _reader.wait(timeout_ms));
+	}
+
+	uint64_t lost(void) const {
+		return _reader.lost();
+	}
+
+private:
+	const char * _topic;
+	uint16_t _id;
+	RingReader _reader;
+};
+
+template<typename T>
+class Publisher {
+public:
+	Publisher(const char * topic, uint16_t id) :
+			_topic(topic), _id(id), _bridge(NULL) {
+	}
+
+	bool advertise(Bridge * bridge) {
+		_bridge = bridge;
+		return true;
+	}
+
+	T * alloc(void) {
+		return PROBE_EXPR(PROBE_ALLOC, &_msg);
+	}
+
+	bool broadcast(T * msg) {
+		return PROBE_EXPR(PROBE_BROADCAST, _bridge->send(_id, msg, sizeof(T)));
+	}
+
+private:
+	const char * _topic;
+	uint16_t _id;
+	Bridge * _bridge;
+	T _msg;
+};
+
+#endif /* BRIDGE_HPP_ */
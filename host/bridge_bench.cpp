@@ -0,0 +1,207 @@
+/*
+ * Bridge loopback benchmark through a pseudo terminal pair.
+ *
+ * A writer thread plays the board, sending ImuRecord frames on the master
+ * end at the given rate (0: as fast as the pty takes them). The bridge
+ * decodes the slave end into a named ring; one subscriber reads it through
+ * the Subscriber<T,N> API, a second one attaches to the shared memory by
+ * name as another process would. Latency is from frame encoding to the
+ * subscriber holding the message. Built with the hot path probes
+ * (probe.hpp): cycles per ring post, subscriber wait, get and release.
+ *
+ * Usage: bridge_bench [-r rate] [-s seconds]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <algorithm>
+#include <vector>
+
+#include "bridge.hpp"
+#include "imu_log.hpp"
+#include "tty.hpp"
+
+#define BENCH_ID	3001
+#define BENCH_SLOTS	1024
+
+struct Bench {
+	int fd;
+	unsigned rate;
+	volatile bool stop;
+	uint64_t sent;
+};
+
+static uint32_t now_us(void) {
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint32_t) (ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000);
+}
+
+static void * writer_thread(void * arg) {
+	Bench * b = (Bench *) arg;
+	uint8_t frame[SERIAL_FRAME_SIZE(sizeof(ImuRecord))];
+	ImuRecord r;
+	struct timespec next;
+	size_t n, off;
+	ssize_t w;
+
+	memset(&r, 0, sizeof(r));
+	clock_gettime(CLOCK_MONOTONIC, &next);
+
+	while (!b->stop) {
+		r.gyro[0] = (int16_t) b->sent;
+		r.valid = 0x07;
+		r.timestamp = now_us();
+		n = frame_encode(BENCH_ID, (const uint8_t *) &r, sizeof(r), frame);
+
+		for (off = 0; off < n && !b->stop; off += (w > 0 ? w : 0)) {
+			w = write(b->fd, frame + off, n - off);
+			if (w < 0) {
+				usleep(10);
+			}
+		}
+		b->sent++;
+
+		if (b->rate != 0) {
+			next.tv_nsec += 1000000000L / b->rate;
+			if (next.tv_nsec >= 1000000000L) {
+				next.tv_nsec -= 1000000000L;
+				next.tv_sec++;
+			}
+			clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL);
+		}
+	}
+
+	return NULL;
+}
+
+struct Attached {
+	volatile bool stop;
+	uint64_t received;
+	uint64_t lost;
+};
+
+/*
+ * Reader going only through the shared memory name, like a ground tool.
+ */
+static void * attached_thread(void * arg) {
+	Attached * a = (Attached *) arg;
+	ShmRing ring;
+	RingReader reader;
+
+	if (!ring.attach("/r2p.imu_bench")) {
+		perror("attach");
+		return NULL;
+	}
+	reader.init(&ring);
+
+	while (!a->stop) {
+		if (!reader.wait(100)) {
+			continue;
+		}
+		while (reader.get() != NULL) {
+			if (reader.release()) {
+				a->received++;
+			}
+		}
+	}
+	a->lost = reader.lost();
+
+	return NULL;
+}
+
+int main(int argc, char * argv[]) {
+	Bench bench = { -1, 1000, false, 0 };
+	Attached attached = { false, 0, 0 };
+	Bridge bridge;
+	BridgeStats s;
+	Subscriber<ImuRecord, BENCH_SLOTS> sub("imu_bench", BENCH_ID);
+	std::vector<uint32_t> latency;
+	pthread_t writer, reader;
+	double seconds = 5.0, start, elapsed;
+	const ImuRecord * r;
+	uint64_t received = 0;
+	int slave, c;
+
+	while ((c = getopt(argc, argv, "r:s:")) != -1) {
+		switch (c) {
+		case 'r': bench.rate = atoi(optarg); break;
+		case 's': seconds = atof(optarg); break;
+		default:
+			fprintf(stderr, "usage: bridge_bench [-r rate] [-s seconds]\n");
+			return 1;
+		}
+	}
+
+	if (!pty_pair(&bench.fd, &slave)) {
+		perror("pty");
+		return 1;
+	}
+
+	bridge.attach(slave);
+	if (!sub.subscribe(&bridge)) {
+		perror("subscribe");
+		return 1;
+	}
+	bridge.start();
+	pthread_create(&reader, NULL, attached_thread, &attached);
+	usleep(10000);
+	pthread_create(&writer, NULL, writer_thread, &bench);
+
+	latency.reserve(seconds * (bench.rate ? bench.rate : 100000) + 1000);
+	start = now_us() * 1e-6;
+	while ((elapsed = now_us() * 1e-6 - start) < seconds) {
+		if (!sub.wait(100)) {
+			continue;
+		}
+		while ((r = sub.get()) != NULL) {
+			uint32_t dt = now_us() - r->timestamp;
+
+			if (sub.release(r)) {
+				latency.push_back(dt);
+				received++;
+			}
+		}
+	}
+
+	bench.stop = true;
+	pthread_join(writer, NULL);
+	usleep(100000);
+	attached.stop = true;
+	pthread_join(reader, NULL);
+	bridge.stats(&s);
+	bridge.stop();
+
+	std::sort(latency.begin(), latency.end());
+
+	printf("rate %s, %.1f s, %zu byte payload, %u slot ring\n",
+			bench.rate ? "paced" : "flood", elapsed, sizeof(ImuRecord), BENCH_SLOTS);
+	printf("sent %lu, bridge decoded %u (%.0f msg/s, %.1f MB/s wire)\n",
+			(unsigned long) bench.sent, s.frames.frames, s.frames.frames / elapsed,
+			s.rx_wire_bytes / elapsed / 1e6);
+	printf("subscriber %lu received, %lu lost - attached reader %lu received, %lu lost\n",
+			(unsigned long) received, (unsigned long) sub.lost(),
+			(unsigned long) attached.received, (unsigned long) attached.lost);
+	if (!latency.empty()) {
+		printf("latency us: p50 %u, p99 %u, max %u\n", latency[latency.size() / 2],
+				latency[latency.size() * 99 / 100], latency.back());
+	}
+
+	ProbeStats probes[PROBE_COUNT];
+
+	probe_snapshot(probes);
+	printf("probe       count     min     avg       max  [TSC cycles]\n");
+	for (int i = 0; i < PROBE_COUNT; i++) {
+		if (probes[i].count > 0) {
+			printf("%-9s %7u %7u %7lu %9u\n", probe_names[i], probes[i].count,
+					probes[i].min, (unsigned long) (probes[i].sum / probes[i].count),
+					probes[i].max);
+		}
+	}
+
+	return 0;
+}
@@ -0,0 +1,205 @@
+/*
+ * Serial transport coalescing: bytes on the wire and frames per second
+ * for the pubsub benchmark topics, against one frame per message.
+ *
+ * The transmit side is the firmware SerialTransport::txLoop() policy run
+ * on simulated time: the thread wakes on new messages (or every
+ * SERIAL_POLL_MS while a batch waits), adds them to a FrameBatch due at
+ * arrival + latency budget, and emits the batch once due, waiting for the
+ * UART DMA if the previous buffer is still going out. Topics are "test"
+ * at 100 Hz with its 10 Hz and 1 Hz decimated copies (TestData, 4 byte
+ * payload), plus any extra 100 Hz topics given with -n.
+ *
+ * Usage: coalesce_bench [-b baud] [-n extra topics] [-s seconds]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <vector>
+
+#include "serial_frame.hpp"
+
+#define STEP_US		100
+#define POLL_US		1000	/* SERIAL_POLL_MS */
+
+struct Topic {
+	uint16_t id;
+	unsigned period_us;
+	unsigned phase_us;
+	size_t size;
+};
+
+struct Result {
+	double messages;	/* Per second. */
+	double frames;
+	double wire;		/* Bytes per second. */
+	double mean_delay_us;
+	unsigned max_delay_us;
+};
+
+struct Link {
+	unsigned baud;
+	uint32_t dma_busy_until;
+	uint64_t frames;
+	uint64_t wire;
+	uint64_t delay;
+	unsigned max_delay;
+};
+
+static unsigned wire_us(unsigned baud, size_t bytes) {
+	return (unsigned) (bytes * 10 * 1000000ULL / baud);
+}
+
+/*
+ * Puts n bytes on the wire after whatever is going out; returns the time
+ * the thread could start them, accounts for the messages delivered.
+ */
+static uint32_t transmit(Link * link, uint32_t t, size_t n,
+		const std::vector<uint32_t> & arrivals) {
+	uint32_t start = (link->dma_busy_until > t) ? link->dma_busy_until : t;
+
+	link->dma_busy_until = start + wire_us(link->baud, n);
+	link->frames++;
+	link->wire += n;
+	for (size_t i = 0; i < arrivals.size(); i++) {
+		uint32_t d = link->dma_busy_until - arrivals[i];
+
+		link->delay += d;
+		if (d > link->max_delay) {
+			link->max_delay = d;
+		}
+	}
+
+	return start;
+}
+
+/*
+ * latency_us < 0: one frame per message, as before coalescing.
+ */
+static Result run(const std::vector<Topic> & topics, unsigned baud,
+		int latency_us, unsigned seconds) {
+	uint8_t buffer[SERIAL_FRAME_SIZE(SERIAL_MAX_PAYLOAD)];
+	uint8_t payload[SERIAL_MAX_PAYLOAD] = { 0x55 };
+	std::vector<uint32_t> queued;		/* Arrival times, in the batch. */
+	std::vector<uint32_t> waiting;		/* Arrival times, not gathered yet. */
+	std::vector<const Topic *> waiting_topic;
+	Link link = { baud, 0, 0, 0, 0, 0 };
+	FrameBatch batch;
+	uint32_t blocked_until = 0;
+	uint32_t next_poll = 0;
+	uint64_t messages = 0;
+	Result r;
+
+	for (uint32_t t = 0; t < seconds * 1000000u; t += STEP_US) {
+		for (size_t i = 0; i < topics.size(); i++) {
+			if (t % topics[i].period_us == topics[i].phase_us) {
+				waiting.push_back(t);
+				waiting_topic.push_back(&topics[i]);
+			}
+		}
+
+		/* Thread blocked on the DMA, or asleep. */
+		if (t < blocked_until) {
+			continue;
+		}
+		if (batch.count() == 0 ? waiting.empty() : t < next_poll) {
+			continue;
+		}
+
+		for (size_t i = 0; i < waiting.size(); i++) {
+			const Topic * topic = waiting_topic[i];
+			std::vector<uint32_t> one(1, waiting[i]);
+
+			if (latency_us < 0) {
+				blocked_until = transmit(&link, t,
+						frame_encode(topic->id, payload, topic->size, buffer), one);
+				continue;
+			}
+
+			/* Full batch: out first, as SerialTransport::coalesce(). */
+			if (!batch.add(topic->id, payload, topic->size,
+					waiting[i] + latency_us)) {
+				blocked_until = transmit(&link, t, batch.encode(buffer), queued);
+				queued.clear();
+				batch.add(topic->id, payload, topic->size, waiting[i] + latency_us);
+			}
+			queued.push_back(waiting[i]);
+		}
+		messages += waiting.size();
+		waiting.clear();
+		waiting_topic.clear();
+
+		if (batch.count() > 0 && (int32_t) (t - batch.due()) >= 0) {
+			blocked_until = transmit(&link, t, batch.encode(buffer), queued);
+			queued.clear();
+		}
+		next_poll = t + POLL_US;
+	}
+
+	r.messages = (double) messages / seconds;
+	r.frames = (double) link.frames / seconds;
+	r.wire = (double) link.wire / seconds;
+	r.mean_delay_us = messages ? (double) link.delay / messages : 0;
+	r.max_delay_us = link.max_delay;
+
+	return r;
+}
+
+int main(int argc, char * argv[]) {
+	static const int latencies[] = { 0, 5000, 10000, 20000, 50000 };
+	unsigned baud = 115200, seconds = 60, extra = 0;
+	std::vector<Topic> topics;
+	int c;
+
+	while ((c = getopt(argc, argv, "b:n:s:")) != -1) {
+		switch (c) {
+		case 'b':
+			baud = atoi(optarg);
+			break;
+		case 'n':
+			extra = atoi(optarg);
+			break;
+		case 's':
+			seconds = atoi(optarg);
+			break;
+		default:
+			fprintf(stderr, "Usage: %s [-b baud] [-n extra topics] [-s seconds]\n",
+					argv[0]);
+			return 1;
+		}
+	}
+
+	/* Pubsub benchmark topics; the decimated ones in phase with the source. */
+	Topic test = { 100, 10000, 0, 4 };
+	Topic test10 = { 101, 100000, 0, 4 };
+	Topic test1 = { 102, 1000000, 0, 4 };
+	topics.push_back(test);
+	topics.push_back(test10);
+	topics.push_back(test1);
+	for (unsigned i = 0; i < extra; i++) {
+		Topic t = { (uint16_t) (200 + i), 10000, (i * 1300) % 10000 / STEP_US
+				* STEP_US, 4 };
+		topics.push_back(t);
+	}
+
+	printf("%u bps, %zu topics, %u s\n", baud, topics.size(), seconds);
+	printf("latency   msg/s  frames/s  wire B/s  B/msg  wire%%  mean ms  max ms\n");
+	for (int i = -1; i < (int) (sizeof(latencies) / sizeof(latencies[0])); i++) {
+		int latency = (i < 0) ? -1 : latencies[i];
+		Result r = run(topics, baud, latency, seconds);
+
+		if (latency < 0) {
+			printf("  none ");
+		} else {
+			printf("%4d ms", latency / 1000);
+		}
+		printf(" %7.1f  %8.1f  %8.1f  %5.2f  %4.1f%%  %7.2f  %6.2f\n",
+				r.messages, r.frames, r.wire, r.wire / r.messages,
+				r.wire * 1000 / baud, r.mean_delay_us / 1000,
+				r.max_delay_us / 1000.0);
+	}
+
+	return 0;
+}
@@ -0,0 +1,110 @@
+/*
+ * Output check of the FIR decimator as the pubsub benchmark relay runs it:
+ * decimator_lowpass_10x, 100 Hz to 10 Hz, one channel.
+ *
+ * - Bit exactness against a direct filter-then-downsample in 64 bit.
+ * - DC gain, on a constant input.
+ * - Amplitude of tones through the relay, against latest-value sampling:
+ *   the sampled copy aliases everything above 5 Hz at full amplitude.
+ *
+ * Usage: decimator_check [seconds]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+#include "decimator.hpp"
+
+#define INPUT_RATE		100
+#define FACTOR			10
+#define AMPLITUDE		10000
+
+static int16_t reference(const int16_t * x, uint32_t n) {
+	int64_t acc = 0;
+
+	for (uint16_t k = 0; k < DECIMATOR_LOWPASS_10X_TAPS && k <= n; k++) {
+		acc += (int64_t) decimator_lowpass_10x[k] * x[n - k];
+	}
+
+	return sat16((int32_t) (acc >> 31));
+}
+
+/*
+ * Runs n inputs through the decimator; returns the outputs that differ
+ * from the reference, peak amplitudes of the filtered and of the sampled
+ * outputs after the filter has filled.
+ */
+static uint32_t run(const int16_t * x, uint32_t n, int16_t * fir_peak,
+		int16_t * sampled_peak) {
+	FirDecimator fir(decimator_lowpass_10x, DECIMATOR_LOWPASS_10X_TAPS, FACTOR, 1);
+	uint32_t mismatches = 0;
+
+	*fir_peak = 0;
+	*sampled_peak = 0;
+	for (uint32_t i = 0; i < n; i++) {
+		if (!fir.push(&x[i])) {
+			continue;
+		}
+		if (fir.output()[0] != reference(x, i)) {
+			mismatches++;
+		}
+		if (i >= DECIMATOR_LOWPASS_10X_TAPS) {
+			if (abs(fir.output()[0]) > *fir_peak) {
+				*fir_peak = abs(fir.output()[0]);
+			}
+			if (abs(x[i]) > *sampled_peak) {
+				*sampled_peak = abs(x[i]);
+			}
+		}
+	}
+
+	return mismatches;
+}
+
+int main(int argc, char * argv[]) {
+	static const float tones[] = { 1, 2, 3, 4, 6, 7, 9, 13, 17, 23, 37 };
+	uint32_t n = INPUT_RATE * ((argc > 1) ? atoi(argv[1]) : 60);
+	int16_t * x = new int16_t[n];
+	int16_t fir_peak, sampled_peak;
+	uint32_t mismatches, failed = 0;
+
+	if (n < 2 * DECIMATOR_LOWPASS_10X_TAPS) {
+		return 1;
+	}
+
+	for (uint32_t i = 0; i < n; i++) {
+		x[i] = AMPLITUDE;
+	}
+	mismatches = run(x, n, &fir_peak, &sampled_peak);
+	failed += mismatches;
+	printf("DC %d: output %d, %u mismatches\n", AMPLITUDE, fir_peak, mismatches);
+	if (abs(fir_peak - AMPLITUDE) > 1) {
+		failed++;
+	}
+
+	printf("\ntone Hz   sampled    relay  relay dB  mismatches\n");
+	for (size_t k = 0; k < sizeof(tones) / sizeof(tones[0]); k++) {
+		/* Odd phase step, so the 10 Hz instants do not hit the zeros. */
+		for (uint32_t i = 0; i < n; i++) {
+			x[i] = (int16_t) lrint(AMPLITUDE * sin(2 * M_PI * tones[k] * i / INPUT_RATE + 0.3));
+		}
+		mismatches = run(x, n, &fir_peak, &sampled_peak);
+		failed += mismatches;
+		printf("%7.0f %9d %8d %9.1f %11u\n", tones[k], sampled_peak, fir_peak,
+				20 * log10((fir_peak > 0 ? fir_peak : 1) / (double) AMPLITUDE), mismatches);
+	}
+
+	/* Full scale square wave: the accumulator must saturate, not wrap. */
+	for (uint32_t i = 0; i < n; i++) {
+		x[i] = ((i / 5) & 1) ? INT16_MIN : INT16_MAX;
+	}
+	mismatches = run(x, n, &fir_peak, &sampled_peak);
+	failed += mismatches;
+	printf("\nfull scale 10 Hz square: %u mismatches\n", mismatches);
+
+	printf("%s\n", failed ? "FAILED" : "ok");
+	delete[] x;
+
+	return failed ? 1 : 0;
+}
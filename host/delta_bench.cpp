@@ -0,0 +1,257 @@
+/*
+ * Delta encoding of the "imu" topic: bytes per sample, CAN bus load and
+ * encode/decode cost, raw against delta_codec with a few keyframe
+ * intervals.
+ *
+ * Samples come from a recorded log (imu_log.hpp) or are synthesized as in
+ * imu_replay -g: slow sinusoids plus +-20 LSB noise at 1 kHz, timestamps
+ * on the 72 MHz DWT counter with +-100 cycles of jitter. Every sample is
+ * decoded back and must match.
+ *
+ * CAN load assumes each message is split into 8 byte frames with 11 bit
+ * ids, 47 + 8 * n bits a frame, stuff bits not counted. Messages are lost
+ * with the given probability to show the samples dropped until the next
+ * keyframe; the serial column is the framed size (serial_frame.hpp).
+ *
+ * Usage: delta_bench [-f in.log] [-n samples] [-r rate] [-l loss permille]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+#include <vector>
+
+#include "delta_codec.hpp"
+#include "imu_log.hpp"
+#include "serial_frame.hpp"
+
+#define CAN_BITRATE		1000000
+
+static double now(void) {
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void synthesize(std::vector<ImuRecord> & log, size_t n, uint32_t rate) {
+	ImuRecord r;
+
+	srand(1);
+	memset(&r, 0, sizeof(r));
+	for (size_t i = 0; i < n; i++) {
+		double t = (double) i / rate;
+
+		r.timestamp = (uint32_t) (i * (72000000 / rate) + rand() % 201 - 100);
+		for (int a = 0; a < 3; a++) {
+			r.gyro[a] = (int16_t) (3000.0 * sin(0.7 * t + a) + rand() % 41 - 20 + 15);
+			r.acc[a] = (int16_t) ((a == 2 ? 1000.0 : 0.0) + 200.0 * sin(3.1 * t + a)
+					+ rand() % 41 - 20);
+			r.mag[a] = (int16_t) (400.0 * cos(0.2 * t + a) + 35 + rand() % 11 - 5);
+		}
+		r.valid = 0x07;
+		log.push_back(r);
+	}
+}
+
+static bool load(std::vector<ImuRecord> & log, const char * path) {
+	FILE * f = fopen(path, "rb");
+	ImuRecord r;
+
+	if (f == NULL) {
+		perror(path);
+		return false;
+	}
+	while (fread(&r, sizeof(r), 1, f) == 1) {
+		log.push_back(r);
+	}
+	fclose(f);
+
+	return true;
+}
+
+static unsigned can_bits(size_t len) {
+	unsigned bits = 0;
+
+	while (len > 0) {
+		size_t n = (len > 8) ? 8 : len;
+
+		bits += 47 + 8 * n;
+		len -= n;
+	}
+
+	return bits;
+}
+
+struct Result {
+	double bytes;		/* Per sample, encoded. */
+	double can_bits;	/* Per sample. */
+	double serial;		/* Framed bytes per sample. */
+	double encode_ns;
+	double decode_ns;
+	uint32_t keyframes;
+	uint32_t lost;
+	uint32_t skipped;
+	bool match;
+};
+
+static bool lose(uint32_t * seed, uint32_t loss) {
+
+	*seed = *seed * 1664525u + 1013904223u;
+	return ((*seed >> 8) % 1000) < loss;
+}
+
+/* interval 0: raw payload, no codec. */
+static Result run(const std::vector<ImuRecord> & log, uint8_t interval,
+		uint32_t loss) {
+	std::vector<uint8_t> wire;
+	std::vector<size_t> lengths;
+	uint8_t buf[DELTA_MAX_SIZE(sizeof(ImuRecord), IMU_RECORD_FIELDS)];
+	uint8_t frame[SERIAL_FRAME_SIZE(SERIAL_MAX_PAYLOAD)];
+	DeltaEncoder enc(imu_record_layout, IMU_RECORD_FIELDS, interval);
+	DeltaDecoder dec(imu_record_layout, IMU_RECORD_FIELDS);
+	uint64_t bits = 0, serial = 0;
+	uint32_t seed = 0x2545F491u;
+	double t0;
+	size_t n = log.size(), offset = 0;
+	Result r;
+
+	memset(&r, 0, sizeof(r));
+	r.match = true;
+
+	for (size_t i = 0; i < n; i++) {
+		size_t len = sizeof(ImuRecord);
+
+		if (interval > 0) {
+			len = enc.encode((const uint8_t *) &log[i], buf);
+		} else {
+			memcpy(buf, &log[i], len);
+		}
+		wire.insert(wire.end(), buf, buf + len);
+		lengths.push_back(len);
+	}
+
+	for (size_t i = 0; i < n; i++) {
+		bits += can_bits(lengths[i]);
+		serial += frame_encode(1, &wire[offset], lengths[i], frame);
+		offset += lengths[i];
+	}
+	r.bytes = (double) wire.size() / n;
+	r.can_bits = (double) bits / n;
+	r.serial = (double) serial / n;
+	r.keyframes = enc.stats().keyframes;
+
+	if (interval == 0) {
+		return r;
+	}
+
+	/* Timing on a fresh encoder, then a lossless round trip. */
+	DeltaEncoder timed(imu_record_layout, IMU_RECORD_FIELDS, interval);
+	ImuRecord out;
+
+	t0 = now();
+	for (size_t i = 0; i < n; i++) {
+		offset += timed.encode((const uint8_t *) &log[i], buf);
+	}
+	r.encode_ns = (now() - t0) * 1e9 / n;
+
+	offset = 0;
+	t0 = now();
+	for (size_t i = 0; i < n; i++) {
+		if (!dec.decode(&wire[offset], lengths[i], (uint8_t *) &out)
+				|| memcmp(&out, &log[i], sizeof(out)) != 0) {
+			r.match = false;
+		}
+		offset += lengths[i];
+	}
+	r.decode_ns = (now() - t0) * 1e9 / n;
+
+	/* Lossy: what is still rebuilt must match. */
+	DeltaDecoder lossy(imu_record_layout, IMU_RECORD_FIELDS);
+
+	offset = 0;
+	for (size_t i = 0; i < n; i++) {
+		if (!lose(&seed, loss)
+				&& lossy.decode(&wire[offset], lengths[i], (uint8_t *) &out)
+				&& memcmp(&out, &log[i], sizeof(out)) != 0) {
+			r.match = false;
+		}
+		offset += lengths[i];
+	}
+	r.lost = lossy.stats().lost;
+	r.skipped = lossy.stats().skipped;
+
+	return r;
+}
+
+int main(int argc, char * argv[]) {
+	static const uint8_t intervals[] = { 0, 1, 8, 32, 128 };
+	std::vector<ImuRecord> log;
+	const char * path = NULL;
+	size_t samples = 100000;
+	uint32_t rate = 1000, loss = 10;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "f:n:r:l:")) != -1) {
+		switch (opt) {
+		case 'f':
+			path = optarg;
+			break;
+		case 'n':
+			samples = atoi(optarg);
+			break;
+		case 'r':
+			rate = atoi(optarg);
+			break;
+		case 'l':
+			loss = atoi(optarg);
+			break;
+		default:
+			fprintf(stderr, "Usage: %s [-f in.log] [-n samples] [-r rate] "
+					"[-l loss permille]\n", argv[0]);
+			return 1;
+		}
+	}
+
+	if (path != NULL) {
+		if (!load(log, path)) {
+			return 1;
+		}
+	} else {
+		synthesize(log, samples, rate);
+	}
+	if (log.empty()) {
+		fprintf(stderr, "no samples\n");
+		return 1;
+	}
+
+	printf("%zu samples at %u Hz, %zu byte payload, %.1f%% loss\n", log.size(),
+			rate, sizeof(ImuRecord), loss / 10.0);
+	printf("keyframe  B/sample  serial B  CAN bits  CAN load  boards  enc ns  dec ns"
+			"  rebuilt  match\n");
+	for (size_t i = 0; i < sizeof(intervals) / sizeof(intervals[0]); i++) {
+		Result r = run(log, intervals[i], loss);
+		double load = r.can_bits * rate / CAN_BITRATE;
+		size_t received = log.size() - r.lost;
+
+		if (intervals[i] == 0) {
+			printf("     raw");
+		} else {
+			printf("    %4u", intervals[i]);
+		}
+		printf("  %8.2f  %8.2f  %8.1f  %7.1f%%  %6u", r.bytes, r.serial,
+				r.can_bits, load * 100, (unsigned) (0.8 / load));
+		if (intervals[i] == 0) {
+			printf("       -       -        -      -\n");
+		} else {
+			printf("  %6.1f  %6.1f  %6.1f%%  %5s\n", r.encode_ns, r.decode_ns,
+					100.0 * (received - r.skipped) / received,
+					r.match ? "yes" : "NO");
+		}
+	}
+
+	return 0;
+}
@@ -0,0 +1,359 @@
+/*
+ * Discovery convergence on a simulated CAN bus.
+ *
+ * Each node runs the firmware Discovery engine, ticked every
+ * DISCOVERY_TICK_MS from a random boot time, with a 4 frame transmit
+ * queue. The bus carries one 8 byte frame at a time (FRAME_US); nodes
+ * waiting for it start together when it goes idle, as CAN nodes do, and
+ * as every node sends on its own id, (DISCOVERY_CID << 8) | uid, the
+ * lowest uid wins the arbitration and the others keep their frame for the
+ * next idle bus. Frames are also lost at the given rate; a lost frame is
+ * gone, as a corrupted frame retransmitted by the controller is only a
+ * later arrival.
+ *
+ * Every node publishes a few topics of its own plus one topic published by
+ * all of them, and subscribes to topics of other nodes. The bus has
+ * converged when each topic has one compact id agreed by its publishers,
+ * ids are unique, and every subscriber is bound to (owner uid, id). The
+ * time reported is from the first boot to the last time the state changed
+ * into converged.
+ *
+ * Usage: discovery_sim [-n nodes] [-t topics per node] [-l loss permille]
+ *                      [-b boot spread ms] [-r runs]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <algorithm>
+#include <vector>
+
+#include "discovery.hpp"
+
+#define MAX_NODES		32
+#define MAX_NODE_TOPICS	4
+#define STEP_US			10
+#define FRAME_US		150		/* 8 byte extended frame at 1 Mbit/s, stuffed. */
+#define TICK_MS			4		/* DISCOVERY_TICK_MS */
+#define QUEUE			4
+#define RUN_MS			5000
+
+struct Sim;
+
+struct SimNode {
+	Sim * sim;
+	Discovery * discovery;
+	uint8_t uid;
+	uint32_t boot_us;
+	uint32_t tick_us;
+	DiscoveryFrame queue[QUEUE];
+	int count;
+};
+
+struct Binding {
+	int node;
+	int topic;
+	int uid;
+	int cid;
+};
+
+struct Sim {
+	int nodes;
+	int topics;			/* Per node, the shared one excluded. */
+	unsigned loss;
+	uint32_t seed;
+	SimNode node[MAX_NODES];
+	std::vector<std::vector<char> > names;
+	std::vector<std::vector<int> > publishers;
+	std::vector<Binding> bindings;
+	uint32_t frames;
+	uint32_t lost;
+};
+
+static uint32_t sim_random(Sim * sim, uint32_t range) {
+
+	sim->seed = sim->seed * 1664525u + 1013904223u;
+	return (sim->seed >> 8) % range;
+}
+
+static bool node_send(void * arg, const DiscoveryFrame * frame) {
+	SimNode * n = (SimNode *) arg;
+
+	if (n->count >= QUEUE) {
+		return false;
+	}
+	n->queue[n->count++] = *frame;
+
+	return true;
+}
+
+static void node_pop(SimNode * n) {
+
+	memmove(&n->queue[0], &n->queue[1], (n->count - 1) * sizeof(n->queue[0]));
+	n->count--;
+}
+
+static void bind(void * arg, const char * name, uint8_t uid, uint8_t cid) {
+	Binding * b = (Binding *) arg;
+
+	(void) name;
+	b->uid = uid;
+	b->cid = cid;
+}
+
+static bool converged(Sim * sim) {
+	std::vector<int> cids;
+
+	for (size_t t = 0; t < sim->names.size(); t++) {
+		const char * name = &sim->names[t][0];
+		const std::vector<int> & pubs = sim->publishers[t];
+		int owner = pubs[0];
+		int cid;
+
+		for (size_t i = 1; i < pubs.size(); i++) {
+			if (sim->node[pubs[i]].uid < sim->node[owner].uid) {
+				owner = pubs[i];
+			}
+		}
+		cid = sim->node[owner].discovery->cid(name);
+		if (cid == 0) {
+			return false;
+		}
+		for (size_t i = 0; i < pubs.size(); i++) {
+			if (sim->node[pubs[i]].discovery->cid(name) != cid) {
+				return false;
+			}
+		}
+		for (size_t i = 0; i < sim->bindings.size(); i++) {
+			const Binding & b = sim->bindings[i];
+
+			if (b.topic == (int) t
+					&& (b.uid != sim->node[owner].uid || b.cid != cid)) {
+				return false;
+			}
+		}
+		cids.push_back(cid);
+	}
+
+	std::sort(cids.begin(), cids.end());
+	return std::adjacent_find(cids.begin(), cids.end()) == cids.end();
+}
+
+/*
+ * One run; returns the convergence time in ms, or -1.
+ */
+static int run(Sim * sim, uint32_t seed, unsigned boot_ms) {
+	uint8_t uids[256];
+	int busy = 0;		/* Remaining bus time [steps]. */
+	int sender = -1;
+	DiscoveryFrame frame;
+	int last_change = -1;
+	bool state = false;
+
+	sim->seed = seed;
+	sim->frames = sim->lost = 0;
+	sim->names.clear();
+	sim->publishers.clear();
+	sim->bindings.clear();
+
+	for (int i = 0; i < 256; i++) {
+		uids[i] = i;
+	}
+	for (int i = 255; i > 0; i--) {
+		std::swap(uids[i], uids[sim_random(sim, i + 1)]);
+	}
+
+	/* Topics: own ones, then the shared one. */
+	for (int i = 0; i < sim->nodes; i++) {
+		for (int j = 0; j < sim->topics; j++) {
+			std::vector<char> name(32);
+
+			snprintf(&name[0], name.size(), "node%d/t%d", i, j);
+			sim->names.push_back(name);
+			sim->publishers.push_back(std::vector<int>(1, i));
+		}
+	}
+	sim->names.push_back(std::vector<char>(32));
+	snprintf(&sim->names.back()[0], 32, "status");
+	sim->publishers.push_back(std::vector<int>());
+	for (int i = 0; i < sim->nodes; i++) {
+		sim->publishers.back().push_back(i);
+	}
+
+	/* Each node subscribes to one topic of each of the next two nodes. */
+	if (sim->nodes > 1) {
+		for (int i = 0; i < sim->nodes; i++) {
+			for (int k = 1; k <= 2 && k < sim->nodes; k++) {
+				Binding b = { i, ((i + k) % sim->nodes) * sim->topics
+						+ (int) sim_random(sim, sim->topics), -1, -1 };
+
+				sim->bindings.push_back(b);
+			}
+		}
+	}
+
+	for (int i = 0; i < sim->nodes; i++) {
+		SimNode * n = &sim->node[i];
+
+		n->sim = sim;
+		n->uid = uids[i];
+		n->discovery = new Discovery(n->uid, node_send, n);
+		n->boot_us = sim_random(sim, boot_ms * 1000 + 1) / STEP_US * STEP_US;
+		n->tick_us = n->boot_us;
+		n->count = 0;
+	}
+	for (size_t t = 0; t < sim->names.size(); t++) {
+		for (size_t i = 0; i < sim->publishers[t].size(); i++) {
+			sim->node[sim->publishers[t][i]].discovery->advertise(
+					&sim->names[t][0], 8, NULL, NULL);
+		}
+	}
+	for (size_t i = 0; i < sim->bindings.size(); i++) {
+		Binding * b = &sim->bindings[i];
+
+		sim->node[b->node].discovery->subscribe(&sim->names[b->topic][0], 8,
+				bind, b);
+	}
+
+	for (uint32_t t = 0; t < RUN_MS * 1000; t += STEP_US) {
+		/* End of the frame on the bus. */
+		if (busy > 0 && --busy == 0) {
+			if (sim_random(sim, 1000) < sim->loss) {
+				sim->lost++;
+			} else {
+				for (int i = 0; i < sim->nodes; i++) {
+					if (t >= sim->node[i].boot_us) {
+						sim->node[i].discovery->receive(&frame, t / 1000);
+					}
+				}
+			}
+			node_pop(&sim->node[sender]);
+			sender = -1;
+		}
+
+		for (int i = 0; i < sim->nodes; i++) {
+			SimNode * n = &sim->node[i];
+
+			if (t == n->tick_us) {
+				n->discovery->tick(t / 1000);
+				n->tick_us += TICK_MS * 1000;
+			}
+		}
+
+		/* Bus idle: everybody with a frame starts, the lowest id wins. */
+		if (busy == 0) {
+			for (int i = 0; i < sim->nodes; i++) {
+				if (sim->node[i].count > 0
+						&& (sender < 0 || sim->node[i].uid < sim->node[sender].uid)) {
+					sender = i;
+				}
+			}
+			if (sender >= 0) {
+				frame = sim->node[sender].queue[0];
+				sim->frames++;
+				busy = FRAME_US / STEP_US;
+			}
+		}
+
+		if (t % 1000 == 0) {
+			bool now = converged(sim);
+
+			if (now != state) {
+				state = now;
+				last_change = t / 1000;
+			}
+		}
+	}
+
+	for (int i = 0; i < sim->nodes; i++) {
+		delete sim->node[i].discovery;
+	}
+
+	return state ? last_change : -1;
+}
+
+static void report(int nodes, int topics, unsigned loss, unsigned boot_ms,
+		int runs) {
+	Sim sim;
+	std::vector<int> times;
+	uint64_t frames = 0;
+	int failed = 0;
+
+	sim.nodes = nodes;
+	sim.topics = topics;
+	sim.loss = loss;
+
+	for (int r = 0; r < runs; r++) {
+		int ms = run(&sim, 0x1234567u + r * 7919u, boot_ms);
+
+		if (ms < 0) {
+			failed++;
+		} else {
+			times.push_back(ms);
+		}
+		frames += sim.frames;
+	}
+
+	std::sort(times.begin(), times.end());
+	printf("%5d %6d %5.1f%% %8d", nodes, nodes * topics + 1, loss / 10.0,
+			failed);
+	if (!times.empty()) {
+		printf(" %7d %7d %7d", times[times.size() / 2],
+				times[times.size() * 99 / 100], times.back());
+	}
+	printf(" %9.1f\n", (double) frames / runs);
+}
+
+int main(int argc, char * argv[]) {
+	int nodes = 0, topics = 2, runs = 200;
+	unsigned loss = 0, boot_ms = 100;
+	int c;
+
+	while ((c = getopt(argc, argv, "n:t:l:b:r:")) != -1) {
+		switch (c) {
+		case 'n':
+			nodes = atoi(optarg);
+			break;
+		case 't':
+			topics = atoi(optarg);
+			break;
+		case 'l':
+			loss = atoi(optarg);
+			break;
+		case 'b':
+			boot_ms = atoi(optarg);
+			break;
+		case 'r':
+			runs = atoi(optarg);
+			break;
+		default:
+			fprintf(stderr, "Usage: %s [-n nodes] [-t topics per node] "
+					"[-l loss permille] [-b boot spread ms] [-r runs]\n",
+					argv[0]);
+			return 1;
+		}
+	}
+	if (nodes > MAX_NODES || topics > MAX_NODE_TOPICS
+			|| nodes * topics + 1 > DISCOVERY_MAX_TOPICS) {
+		fprintf(stderr, "too many nodes or topics\n");
+		return 1;
+	}
+
+	printf("boot spread %u ms, %d runs, %d ms per run\n", boot_ms, runs,
+			RUN_MS);
+	printf("nodes topics   loss   failed   p50ms   p99ms   maxms    frames\n");
+	if (nodes > 0) {
+		report(nodes, topics, loss, boot_ms, runs);
+		return 0;
+	}
+
+	/* Default sweep, without and with 5% loss. */
+	for (unsigned l = 0; l <= 50; l += 50) {
+		report(2, topics, l, boot_ms, runs);
+		report(5, topics, l, boot_ms, runs);
+		report(10, topics, l, boot_ms, runs);
+	}
+
+	return 0;
+}
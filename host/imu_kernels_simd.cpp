@@ -0,0 +1,288 @@
+#include <immintrin.h>
+
+#include "imu_kernels_simd.hpp"
+
+/*
+ * The scalar kernels narrow 64 bit accumulators with an arithmetic shift.
+ * AVX2 has no 64 bit arithmetic shift: the accumulators are biased to be
+ * positive, shifted logically and unbiased, which is exact since both are
+ * floor divisions.
+ *
+ *   calibration: |m| < 2^31, |x| < 2^17, 3 terms  -> |acc| < 2^50
+ *   FIR:         |h| < 2^31, |x| <= 2^15, 32 taps -> |acc| < 2^51
+ */
+#define CALIB_BIAS_LOG2		50
+#define FIR_BIAS_LOG2		52
+
+#define TARGET_SSE41	__attribute__((target("sse4.1")))
+#define TARGET_AVX2		__attribute__((target("avx2")))
+
+SimdLevel simd_detect(void) {
+
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2")) {
+		return SIMD_AVX2;
+	}
+	if (__builtin_cpu_supports("sse4.1")) {
+		return SIMD_SSE41;
+	}
+	return SIMD_NONE;
+}
+
+const char * simd_name(SimdLevel level) {
+
+	switch (level) {
+	case SIMD_AVX2:
+		return "avx2";
+	case SIMD_SSE41:
+		return "sse4.1";
+	default:
+		return "scalar";
+	}
+}
+
+/*===========================================================================*/
+/* SSE4.1.                                                                   */
+/*===========================================================================*/
+
+TARGET_SSE41
+static inline __m128i load2_epi64(const int16_t * p) {
+	int32_t v;
+
+	__builtin_memcpy(&v, p, sizeof(v));
+	return _mm_cvtepi16_epi64(_mm_cvtsi32_si128(v));
+}
+
+/* Two 64 bit lanes, already unbiased, to two saturated int16_t. */
+TARGET_SSE41
+static inline void store2_sat16(int16_t * p, __m128i v) {
+	int32_t r;
+
+	v = _mm_shuffle_epi32(v, _MM_SHUFFLE(3, 1, 2, 0));
+	v = _mm_packs_epi32(v, v);
+	r = _mm_cvtsi128_si32(v);
+	__builtin_memcpy(p, &r, sizeof(r));
+}
+
+TARGET_SSE41
+static void bias_remove_sse41(const int16_t * in, int16_t bias, int16_t * out,
+		uint32_t n) {
+	__m128i b = _mm_set1_epi16(bias);
+	uint32_t k = 0;
+
+	for (; k + 8 <= n; k += 8) {
+		__m128i x = _mm_loadu_si128((const __m128i *) (in + k));
+		_mm_storeu_si128((__m128i *) (out + k), _mm_subs_epi16(x, b));
+	}
+	bias_remove_block(in + k, bias, out + k, n - k);
+}
+
+TARGET_SSE41
+static void calib_apply_sse41(const CalibQ30 * c, const int16_t * const in[3],
+		int16_t * const out[3], uint32_t n) {
+	const __m128i bias = _mm_set1_epi64x(1LL << CALIB_BIAS_LOG2);
+	const __m128i unbias = _mm_set1_epi64x(1LL << (CALIB_BIAS_LOG2 - 30));
+	__m128i b[3], m[3][3];
+	uint32_t k = 0;
+
+	for (int i = 0; i < 3; i++) {
+		b[i] = _mm_set1_epi64x(c->bias[i]);
+		for (int j = 0; j < 3; j++) {
+			m[i][j] = _mm_set1_epi64x(c->m[i][j]);
+		}
+	}
+
+	for (; k + 2 <= n; k += 2) {
+		__m128i x[3];
+
+		for (int j = 0; j < 3; j++) {
+			x[j] = _mm_sub_epi64(load2_epi64(in[j] + k), b[j]);
+		}
+		for (int i = 0; i < 3; i++) {
+			__m128i acc = _mm_add_epi64(_mm_mul_epi32(m[i][0], x[0]),
+					_mm_mul_epi32(m[i][1], x[1]));
+			acc = _mm_add_epi64(acc, _mm_mul_epi32(m[i][2], x[2]));
+			acc = _mm_sub_epi64(_mm_srli_epi64(_mm_add_epi64(acc, bias), 30),
+					unbias);
+			store2_sat16(out[i] + k, acc);
+		}
+	}
+
+	if (k < n) {
+		const int16_t * tin[3] = { in[0] + k, in[1] + k, in[2] + k };
+		int16_t * const tout[3] = { out[0] + k, out[1] + k, out[2] + k };
+
+		calib_apply_block(c, tin, tout, n - k);
+	}
+}
+
+TARGET_SSE41
+static void fir_q31_sse41(const q31_t * taps, uint16_t ntaps,
+		const int16_t * in, int16_t * out, uint32_t n) {
+	const __m128i bias = _mm_set1_epi64x(1LL << FIR_BIAS_LOG2);
+	const __m128i unbias = _mm_set1_epi64x(1LL << (FIR_BIAS_LOG2 - 31));
+	uint32_t i = 0;
+
+	for (; i + 2 <= n; i += 2) {
+		__m128i acc = _mm_setzero_si128();
+
+		for (uint16_t k = 0; k < ntaps; k++) {
+			__m128i h = _mm_set1_epi64x(taps[k]);
+			acc = _mm_add_epi64(acc,
+					_mm_mul_epi32(h, load2_epi64(in + (int32_t) i - k)));
+		}
+		acc = _mm_sub_epi64(_mm_srli_epi64(_mm_add_epi64(acc, bias), 31), unbias);
+		store2_sat16(out + i, acc);
+	}
+	fir_q31_block(taps, ntaps, in + i, out + i, n - i);
+}
+
+/*===========================================================================*/
+/* AVX2.                                                                     */
+/*===========================================================================*/
+
+TARGET_AVX2
+static inline __m256i load4_epi64(const int16_t * p) {
+	return _mm256_cvtepi16_epi64(_mm_loadl_epi64((const __m128i *) p));
+}
+
+TARGET_AVX2
+static inline void store4_sat16(int16_t * p, __m256i v) {
+	const __m256i idx = _mm256_setr_epi32(0, 2, 4, 6, 0, 2, 4, 6);
+	__m128i lo = _mm256_castsi256_si128(_mm256_permutevar8x32_epi32(v, idx));
+
+	_mm_storel_epi64((__m128i *) p, _mm_packs_epi32(lo, lo));
+}
+
+TARGET_AVX2
+static void bias_remove_avx2(const int16_t * in, int16_t bias, int16_t * out,
+		uint32_t n) {
+	__m256i b = _mm256_set1_epi16(bias);
+	uint32_t k = 0;
+
+	for (; k + 16 <= n; k += 16) {
+		__m256i x = _mm256_loadu_si256((const __m256i *) (in + k));
+		_mm256_storeu_si256((__m256i *) (out + k), _mm256_subs_epi16(x, b));
+	}
+	bias_remove_block(in + k, bias, out + k, n - k);
+}
+
+TARGET_AVX2
+static void calib_apply_avx2(const CalibQ30 * c, const int16_t * const in[3],
+		int16_t * const out[3], uint32_t n) {
+	const __m256i bias = _mm256_set1_epi64x(1LL << CALIB_BIAS_LOG2);
+	const __m256i unbias = _mm256_set1_epi64x(1LL << (CALIB_BIAS_LOG2 - 30));
+	__m256i b[3], m[3][3];
+	uint32_t k = 0;
+
+	for (int i = 0; i < 3; i++) {
+		b[i] = _mm256_set1_epi64x(c->bias[i]);
+		for (int j = 0; j < 3; j++) {
+			m[i][j] = _mm256_set1_epi64x(c->m[i][j]);
+		}
+	}
+
+	for (; k + 4 <= n; k += 4) {
+		__m256i x[3];
+
+		for (int j = 0; j < 3; j++) {
+			x[j] = _mm256_sub_epi64(load4_epi64(in[j] + k), b[j]);
+		}
+		for (int i = 0; i < 3; i++) {
+			__m256i acc = _mm256_add_epi64(_mm256_mul_epi32(m[i][0], x[0]),
+					_mm256_mul_epi32(m[i][1], x[1]));
+			acc = _mm256_add_epi64(acc, _mm256_mul_epi32(m[i][2], x[2]));
+			acc = _mm256_sub_epi64(
+					_mm256_srli_epi64(_mm256_add_epi64(acc, bias), 30), unbias);
+			store4_sat16(out[i] + k, acc);
+		}
+	}
+
+	if (k < n) {
+		const int16_t * tin[3] = { in[0] + k, in[1] + k, in[2] + k };
+		int16_t * const tout[3] = { out[0] + k, out[1] + k, out[2] + k };
+
+		calib_apply_block(c, tin, tout, n - k);
+	}
+}
+
+TARGET_AVX2
+static void fir_q31_avx2(const q31_t * taps, uint16_t ntaps, const int16_t * in,
+		int16_t * out, uint32_t n) {
+	const __m256i bias = _mm256_set1_epi64x(1LL << FIR_BIAS_LOG2);
+	const __m256i unbias = _mm256_set1_epi64x(1LL << (FIR_BIAS_LOG2 - 31));
+	uint32_t i = 0;
+
+	/* Eight outputs per pass, two independent accumulators. */
+	for (; i + 8 <= n; i += 8) {
+		__m256i acc0 = _mm256_setzero_si256();
+		__m256i acc1 = _mm256_setzero_si256();
+
+		for (uint16_t k = 0; k < ntaps; k++) {
+			__m256i h = _mm256_set1_epi64x(taps[k]);
+			const int16_t * x = in + (int32_t) i - k;
+
+			acc0 = _mm256_add_epi64(acc0, _mm256_mul_epi32(h, load4_epi64(x)));
+			acc1 = _mm256_add_epi64(acc1, _mm256_mul_epi32(h, load4_epi64(x + 4)));
+		}
+		acc0 = _mm256_sub_epi64(
+				_mm256_srli_epi64(_mm256_add_epi64(acc0, bias), 31), unbias);
+		acc1 = _mm256_sub_epi64(
+				_mm256_srli_epi64(_mm256_add_epi64(acc1, bias), 31), unbias);
+		store4_sat16(out + i, acc0);
+		store4_sat16(out + i + 4, acc1);
+	}
+	fir_q31_block(taps, ntaps, in + i, out + i, n - i);
+}
+
+/*===========================================================================*/
+/* Dispatch.                                                                 */
+/*===========================================================================*/
+
+void bias_remove_block_simd(SimdLevel level, const int16_t * in, int16_t bias,
+		int16_t * out, uint32_t n) {
+
+	switch (level) {
+	case SIMD_AVX2:
+		bias_remove_avx2(in, bias, out, n);
+		break;
+	case SIMD_SSE41:
+		bias_remove_sse41(in, bias, out, n);
+		break;
+	default:
+		bias_remove_block(in, bias, out, n);
+		break;
+	}
+}
+
+void calib_apply_block_simd(SimdLevel level, const CalibQ30 * c,
+		const int16_t * const in[3], int16_t * const out[3], uint32_t n) {
+
+	switch (level) {
+	case SIMD_AVX2:
+		calib_apply_avx2(c, in, out, n);
+		break;
+	case SIMD_SSE41:
+		calib_apply_sse41(c, in, out, n);
+		break;
+	default:
+		calib_apply_block(c, in, out, n);
+		break;
+	}
+}
+
+void fir_q31_block_simd(SimdLevel level, const q31_t * taps, uint16_t ntaps,
+		const int16_t * in, int16_t * out, uint32_t n) {
+
+	switch (level) {
+	case SIMD_AVX2:
+		fir_q31_avx2(taps, ntaps, in, out, n);
+		break;
+	case SIMD_SSE41:
+		fir_q31_sse41(taps, ntaps, in, out, n);
+		break;
+	default:
+		fir_q31_block(taps, ntaps, in, out, n);
+		break;
+	}
+}
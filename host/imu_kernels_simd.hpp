@@ -0,0 +1,31 @@
+#ifndef IMU_KERNELS_SIMD_HPP_
+#define IMU_KERNELS_SIMD_HPP_
+
+#include "imu_kernels.hpp"
+
+/*
+ * x86 SSE4.1 / AVX2 versions of the imu_kernels block functions.
+ * Same signatures, bit-identical results; the level is picked at run time
+ * so the tools run on any x86-64 host.
+ *
+ * Quaternion integration has no SIMD version: every step depends on the
+ * previous one and the 4-lane product gains nothing over the scalar code.
+ */
+
+enum SimdLevel {
+	SIMD_NONE = 0,
+	SIMD_SSE41,
+	SIMD_AVX2
+};
+
+SimdLevel simd_detect(void);
+const char * simd_name(SimdLevel level);
+
+void bias_remove_block_simd(SimdLevel level, const int16_t * in, int16_t bias,
+		int16_t * out, uint32_t n);
+void calib_apply_block_simd(SimdLevel level, const CalibQ30 * c,
+		const int16_t * const in[3], int16_t * const out[3], uint32_t n);
+void fir_q31_block_simd(SimdLevel level, const q31_t * taps, uint16_t ntaps,
+		const int16_t * in, int16_t * out, uint32_t n);
+
+#endif /* IMU_KERNELS_SIMD_HPP_ */
@@ -0,0 +1,28 @@
+#ifndef IMU_LOG_HPP_
+#define IMU_LOG_HPP_
+
+#include <stdint.h>
+
+#include "delta_codec.hpp"
+
+/*
+ * Recorded "imu" topic: ImuSample payload without the BaseMessage header,
+ * little endian, back to back.
+ */
+struct ImuRecord {
+	uint32_t timestamp;
+	int16_t gyro[3];
+	int16_t acc[3];
+	int16_t mag[3];
+	int32_t gps[3];
+	uint8_t valid;
+}__attribute__((packed));
+
+/* Same fields as imu_sample_layout (imu_messages.hpp). */
+#define IMU_RECORD_FIELDS	14
+
+static const uint8_t imu_record_layout[IMU_RECORD_FIELDS] = {
+	4 | DELTA_ORDER2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 4, 4, 4, 1
+};
+
+#endif /* IMU_LOG_HPP_ */
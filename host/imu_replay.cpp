@@ -0,0 +1,297 @@
+/*
+ * Offline replay of recorded "imu" topic logs through the firmware kernels:
+ * gyro bias removal, accelerometer/magnetometer calibration, FIR low-pass
+ * on all axes and gyro quaternion integration.
+ *
+ * The log is run through the scalar kernels (the Q31 embedded path) and
+ * then through every SIMD level the host supports; outputs must match bit
+ * for bit.
+ *
+ * Usage: imu_replay [-t taps] [-c cutoff] [-r rate] [-o out.log] in.log
+ *        imu_replay -g samples out.log
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+#include <vector>
+
+#include "imu_kernels.hpp"
+#include "imu_kernels_simd.hpp"
+#include "imu_log.hpp"
+
+#define BATCH		4096
+#define HIST		(FIR_MAX_TAPS - 1)
+#define AXES		9
+
+#define GYRO_SCALE	(0.0175f * 3.14159265f / 180.0f)
+
+struct Pipeline {
+	int16_t gyro_bias[3];
+	CalibQ30 acc_cal;
+	CalibQ30 mag_cal;
+	q31_t taps[FIR_MAX_TAPS];
+	uint16_t ntaps;
+	q31_t gyro_scale;
+	q31_t half_dt;
+};
+
+struct Output {
+	std::vector<int16_t> axis[AXES];
+	std::vector<q31_t> q;
+};
+
+static double now(void) {
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/*
+ * Windowed-sinc (Hamming) low-pass, cutoff as a fraction of the rate.
+ */
+static void design_lowpass(Pipeline * p, uint16_t ntaps, double cutoff) {
+	double h[FIR_MAX_TAPS], sum = 0.0;
+
+	p->ntaps = ntaps;
+	for (int k = 0; k < ntaps; k++) {
+		double m = k - (ntaps - 1) / 2.0;
+		double s = (m == 0.0) ? 2.0 * cutoff : sin(2.0 * M_PI * cutoff * m) / (M_PI * m);
+
+		h[k] = s * (0.54 - 0.46 * cos(2.0 * M_PI * k / (ntaps > 1 ? ntaps - 1 : 1)));
+		sum += h[k];
+	}
+	for (int k = 0; k < ntaps; k++) {
+		p->taps[k] = q31_sat(llround(h[k] / sum * 2147483648.0));
+	}
+}
+
+static void run(const Pipeline * p, SimdLevel level,
+		const std::vector<ImuRecord> & log, Output * out) {
+	static int16_t raw[AXES][BATCH];
+	static int16_t cond[AXES][HIST + BATCH];
+	q31_t q[4] = { Q30(1.0f), 0, 0, 0 };
+	q31_t w[3];
+	int16_t g[3];
+	size_t n = log.size();
+
+	memset(cond, 0, sizeof(cond));
+	for (int a = 0; a < AXES; a++) {
+		out->axis[a].resize(n);
+	}
+	out->q.resize(4 * n);
+
+	for (size_t base = 0; base < n; base += BATCH) {
+		uint32_t len = (n - base < BATCH) ? (uint32_t) (n - base) : BATCH;
+
+		/* Array of structures to structure of arrays. */
+		for (uint32_t k = 0; k < len; k++) {
+			const ImuRecord & r = log[base + k];
+
+			for (int a = 0; a < 3; a++) {
+				raw[a][k] = r.gyro[a];
+				raw[3 + a][k] = r.acc[a];
+				raw[6 + a][k] = r.mag[a];
+			}
+		}
+
+		for (int a = 0; a < 3; a++) {
+			bias_remove_block_simd(level, raw[a], p->gyro_bias[a], cond[a] + HIST,
+					len);
+		}
+
+		const int16_t * acc_in[3] = { raw[3], raw[4], raw[5] };
+		int16_t * const acc_out[3] = { cond[3] + HIST, cond[4] + HIST, cond[5] + HIST };
+		const int16_t * mag_in[3] = { raw[6], raw[7], raw[8] };
+		int16_t * const mag_out[3] = { cond[6] + HIST, cond[7] + HIST, cond[8] + HIST };
+
+		calib_apply_block_simd(level, &p->acc_cal, acc_in, acc_out, len);
+		calib_apply_block_simd(level, &p->mag_cal, mag_in, mag_out, len);
+
+		for (int a = 0; a < AXES; a++) {
+			fir_q31_block_simd(level, p->taps, p->ntaps, cond[a] + HIST,
+					&out->axis[a][base], len);
+			/* Keep the tail as history for the next batch. */
+			memmove(cond[a], cond[a] + len, HIST * sizeof(int16_t));
+		}
+
+		for (uint32_t k = 0; k < len; k++) {
+			g[0] = out->axis[0][base + k];
+			g[1] = out->axis[1][base + k];
+			g[2] = out->axis[2][base + k];
+			gyro_half_angle(g, p->gyro_scale, p->half_dt, w);
+			quat_integrate_q30(q, w);
+			memcpy(&out->q[4 * (base + k)], q, sizeof(q));
+		}
+	}
+}
+
+static bool same(const Output & a, const Output & b) {
+
+	for (int i = 0; i < AXES; i++) {
+		if (a.axis[i] != b.axis[i]) {
+			fprintf(stderr, "axis %d differs\n", i);
+			return false;
+		}
+	}
+	if (a.q != b.q) {
+		fprintf(stderr, "quaternion differs\n");
+		return false;
+	}
+	return true;
+}
+
+static int generate(const char * path, size_t n, uint32_t rate) {
+	FILE * f = fopen(path, "wb");
+	ImuRecord r;
+
+	if (f == NULL) {
+		perror(path);
+		return 1;
+	}
+
+	srand(1);
+	memset(&r, 0, sizeof(r));
+	for (size_t i = 0; i < n; i++) {
+		double t = (double) i / rate;
+
+		r.timestamp = (uint32_t) (i * (72000000 / rate));
+		for (int a = 0; a < 3; a++) {
+			r.gyro[a] = (int16_t) (3000.0 * sin(0.7 * t + a) + rand() % 41 - 20 + 15);
+			r.acc[a] = (int16_t) ((a == 2 ? 1000.0 : 0.0) + 200.0 * sin(3.1 * t + a)
+					+ rand() % 41 - 20);
+			r.mag[a] = (int16_t) (400.0 * cos(0.2 * t + a) + 35 + rand() % 11 - 5);
+		}
+		r.valid = 0x07;
+		fwrite(&r, sizeof(r), 1, f);
+	}
+	fclose(f);
+
+	return 0;
+}
+
+int main(int argc, char * argv[]) {
+	Pipeline p;
+	Output ref, vec;
+	std::vector<ImuRecord> log;
+	SimdLevel level = simd_detect();
+	const char * outpath = NULL;
+	uint16_t ntaps = 16;
+	double cutoff = 0.05;
+	uint32_t rate = 1000;
+	size_t gen = 0;
+	double t0, t_ref, t_vec;
+	ImuRecord r;
+	FILE * f;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "t:c:r:o:g:")) != -1) {
+		switch (opt) {
+		case 't':
+			ntaps = atoi(optarg);
+			break;
+		case 'c':
+			cutoff = atof(optarg);
+			break;
+		case 'r':
+			rate = atoi(optarg);
+			break;
+		case 'o':
+			outpath = optarg;
+			break;
+		case 'g':
+			gen = strtoul(optarg, NULL, 0);
+			break;
+		default:
+			fprintf(stderr, "Usage: %s [-t taps] [-c cutoff] [-r rate] [-o out.log] in.log\n"
+					"       %s -g samples out.log\n", argv[0], argv[0]);
+			return 1;
+		}
+	}
+
+	if (optind >= argc) {
+		fprintf(stderr, "missing log file\n");
+		return 1;
+	}
+
+	if (gen > 0) {
+		return generate(argv[optind], gen, rate);
+	}
+
+	if (ntaps < 1 || ntaps > FIR_MAX_TAPS) {
+		fprintf(stderr, "taps must be 1..%d\n", FIR_MAX_TAPS);
+		return 1;
+	}
+
+	f = fopen(argv[optind], "rb");
+	if (f == NULL) {
+		perror(argv[optind]);
+		return 1;
+	}
+	while (fread(&r, sizeof(r), 1, f) == 1) {
+		log.push_back(r);
+	}
+	fclose(f);
+
+	/* Calibration values of the bench unit, re-tune here. */
+	p.gyro_bias[0] = 15;
+	p.gyro_bias[1] = 15;
+	p.gyro_bias[2] = 15;
+	calib_identity(&p.acc_cal);
+	calib_identity(&p.mag_cal);
+	p.mag_cal.bias[0] = 35;
+	p.mag_cal.bias[1] = 35;
+	p.mag_cal.bias[2] = 35;
+	p.mag_cal.m[0][1] = Q30(0.01f);
+	p.mag_cal.m[1][0] = Q30(0.01f);
+	design_lowpass(&p, ntaps, cutoff);
+	p.gyro_scale = Q31(GYRO_SCALE);
+	p.half_dt = Q31(0.5f / rate);
+
+	t0 = now();
+	run(&p, SIMD_NONE, log, &ref);
+	t_ref = now() - t0;
+
+	printf("%zu samples, %u taps\n", log.size(), ntaps);
+	printf("%-7s: %8.2f Msamples/s (%.0fx real time)\n", simd_name(SIMD_NONE),
+			log.size() / t_ref * 1e-6, log.size() / (double) rate / t_ref);
+
+	/* Every level the host supports, each checked against the scalar run. */
+	for (int l = SIMD_SSE41; l <= level; l++) {
+		t0 = now();
+		run(&p, (SimdLevel) l, log, &vec);
+		t_vec = now() - t0;
+
+		printf("%-7s: %8.2f Msamples/s (%.0fx real time) - ", simd_name((SimdLevel) l),
+				log.size() / t_vec * 1e-6, log.size() / (double) rate / t_vec);
+		if (!same(ref, vec)) {
+			printf("MISMATCH\n");
+			return 2;
+		}
+		printf("bit-exact\n");
+	}
+
+	if (outpath != NULL) {
+		f = fopen(outpath, "wb");
+		if (f == NULL) {
+			perror(outpath);
+			return 1;
+		}
+		for (size_t i = 0; i < log.size(); i++) {
+			r = log[i];
+			for (int a = 0; a < 3; a++) {
+				r.gyro[a] = ref.axis[a][i];
+				r.acc[a] = ref.axis[3 + a][i];
+				r.mag[a] = ref.axis[6 + a][i];
+			}
+			fwrite(&r, sizeof(r), 1, f);
+		}
+		fclose(f);
+	}
+
+	return 0;
+}
@@ -0,0 +1,72 @@
+/*
+ * Convergence check of the incremental magnetometer calibration on a
+ * synthetic hard/soft-iron distorted field.
+ *
+ * Usage: mag_calib_check [samples]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+#include "mag_calib.hpp"
+
+int main(int argc, char * argv[]) {
+	uint32_t n = (argc > 1) ? atoi(argv[1]) : 2000;
+	const float center[3] = { 120.0f, -75.0f, 40.0f };
+	const float scale[3] = { 1.15f, 0.9f, 1.0f };
+	const float field = 500.0f;
+	MagCalib mc(0.999f, 200);
+	CalibQ30 cal;
+	float radius = 0.0f;
+	float err_max = 0.0f, err_sum = 0.0f;
+
+	srand(2);
+
+	for (uint32_t i = 0; i < n; i++) {
+		/* Slow tumbling, roughly uniform over the sphere. */
+		float az = 0.013f * i;
+		float el = 1.4f * sinf(0.0029f * i);
+		float v[3] = { cosf(el) * cosf(az), cosf(el) * sinf(az), sinf(el) };
+		int16_t m[3];
+
+		for (int k = 0; k < 3; k++) {
+			m[k] = (int16_t) lrintf(field * v[k] * scale[k] + center[k] + rand() % 7 - 3);
+		}
+		mc.update(m[0], m[1], m[2]);
+	}
+
+	if (!mc.solve(&cal, &radius)) {
+		printf("no valid fit after %u samples\n", n);
+		return 1;
+	}
+
+	printf("%u samples\n", n);
+	printf("bias  : %d %d %d (true %.0f %.0f %.0f)\n", cal.bias[0], cal.bias[1],
+			cal.bias[2], center[0], center[1], center[2]);
+	printf("scale : %.4f %.4f %.4f\n", cal.m[0][0] / 1073741824.0,
+			cal.m[1][1] / 1073741824.0, cal.m[2][2] / 1073741824.0);
+	printf("radius: %.1f\n", radius);
+
+	/* Calibrated magnitude over a fresh pass should be constant. */
+	for (int i = 0; i < 1000; i++) {
+		float az = 0.37f * i, el = 1.5f * sinf(0.11f * i);
+		float v[3] = { cosf(el) * cosf(az), cosf(el) * sinf(az), sinf(el) };
+		int16_t m[3], o[3];
+		float mag;
+
+		for (int k = 0; k < 3; k++) {
+			m[k] = (int16_t) lrintf(field * v[k] * scale[k] + center[k]);
+		}
+		calib_apply(&cal, m, o);
+		mag = sqrtf((float) o[0] * o[0] + (float) o[1] * o[1] + (float) o[2] * o[2]);
+		err_sum += fabsf(mag - radius);
+		if (fabsf(mag - radius) > err_max) {
+			err_max = fabsf(mag - radius);
+		}
+	}
+	printf("magnitude error: mean %.2f%% max %.2f%%\n", err_sum / 1000 / radius * 100,
+			err_max / radius * 100);
+
+	return 0;
+}
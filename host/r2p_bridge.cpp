@@ -0,0 +1,86 @@
+/*
+ * Serial bridge daemon: opens the board tty and publishes each listed
+ * topic in a shared memory ring "/r2p.<topic>" (/dev/shm/r2p.<topic>).
+ * Ground tools attach with ShmRing::attach() and read with a RingReader.
+ *
+ * Usage: r2p_bridge [-b baud] device topic:id:size[:slots] ...
+ *        e.g. r2p_bridge -b 460800 /dev/ttyUSB0 imu:3001:31:1024
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <signal.h>
+#include <unistd.h>
+
+#include "bridge.hpp"
+
+static volatile bool quit = false;
+
+static void on_signal(int sig) {
+
+	(void) sig;
+	quit = true;
+}
+
+static void usage(void) {
+
+	fprintf(stderr, "usage: r2p_bridge [-b baud] device topic:id:size[:slots] ...\n");
+	exit(1);
+}
+
+int main(int argc, char * argv[]) {
+	Bridge bridge;
+	BridgeStats s;
+	unsigned baud = 115200;
+	uint64_t last_frames = 0;
+	int c;
+
+	while ((c = getopt(argc, argv, "b:")) != -1) {
+		switch (c) {
+		case 'b': baud = atoi(optarg); break;
+		default: usage();
+		}
+	}
+	if (argc - optind < 2) {
+		usage();
+	}
+
+	if (!bridge.open(argv[optind], baud)) {
+		perror(argv[optind]);
+		return 1;
+	}
+
+	for (int i = optind + 1; i < argc; i++) {
+		char topic[48], name[64];
+		unsigned id, size, slots = 256;
+
+		if (sscanf(argv[i], "%47[^:]:%u:%u:%u", topic, &id, &size, &slots) < 3
+				|| size > SERIAL_MAX_PAYLOAD) {
+			usage();
+		}
+		snprintf(name, sizeof(name), "/r2p.%s", topic);
+		if (bridge.add(id, name, size, slots) == NULL) {
+			perror(name);
+			return 1;
+		}
+		printf("%s: id %u, %u bytes, %u slots\n", name, id, size, slots);
+	}
+
+	signal(SIGINT, on_signal);
+	signal(SIGTERM, on_signal);
+	bridge.start();
+
+	while (!quit) {
+		sleep(1);
+		bridge.stats(&s);
+		printf("%lu frames/s, %u crc, %u framing, %lu unknown\n",
+				(unsigned long) (s.frames.frames - last_frames), s.frames.crc_errors,
+				s.frames.framing_errors, (unsigned long) s.rx_unknown);
+		fflush(stdout);
+		last_frames = s.frames.frames;
+	}
+
+	bridge.stop();
+
+	return 0;
+}
@@ -0,0 +1,235 @@
+/*
+ * Reliable topic goodput on a simulated lossy serial link.
+ *
+ * Full duplex link at the given speed, frames sized by the real serial
+ * framing (SERIAL_FRAME_SIZE of the encoded frame), each frame lost with
+ * the given probability in either direction. The sender always has a
+ * message ready; it runs the firmware ReliableTx with the window and
+ * timeout given, the receiver a ReliableRx that acks every message (an
+ * ack waiting for the return link is replaced by the newer one). Goodput
+ * is payload delivered in order, exactly once, against the link's raw
+ * payload capacity; best effort is the same link without sequence numbers
+ * or acks, where losses are simply gone.
+ *
+ * With -r the receiver reboots a third into the run and the sender two
+ * thirds into it, with a new epoch; frames in flight stay on the link.
+ * The receiver's reboot must lose nothing, the sender's its unacked
+ * window at most, and neither may stall the link.
+ *
+ * Usage: reliable_sim [-b baud] [-p payload] [-t timeout ms] [-s seconds] [-r]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <unistd.h>
+
+#include "reliable.hpp"
+#include "serial_frame.hpp"
+
+#define STEP_US		10
+
+struct Link {
+	uint32_t loss;		/* Per million. */
+	uint32_t seed;
+	uint32_t busy_until;
+	bool active;
+	uint32_t frames;
+	uint32_t lost;
+};
+
+static bool lose(Link * link) {
+
+	link->seed = link->seed * 1664525u + 1013904223u;
+	return ((link->seed >> 8) % 1000000) < link->loss;
+}
+
+static uint32_t frame_us(unsigned baud, size_t len) {
+	uint8_t buf[SERIAL_FRAME_SIZE(SERIAL_MAX_PAYLOAD)];
+	uint8_t payload[SERIAL_MAX_PAYLOAD] = { 1 };
+	size_t n = frame_encode(1, payload, len, buf);
+
+	/* 10 bits a byte, rounded up to the step. */
+	return ((n * 10 * 1000000ULL / baud) / STEP_US + 1) * STEP_US;
+}
+
+struct Result {
+	double goodput;		/* Payload delivered / link payload capacity. */
+	uint32_t delivered;
+	uint32_t resent;
+	uint32_t lost;		/* Skipped in the delivered sequence. */
+	bool in_order;		/* Nothing twice or out of order. */
+};
+
+static Result run_best_effort(unsigned baud, size_t payload, uint32_t loss,
+		unsigned seconds) {
+	Link link = { loss, 0x2545F491u, 0, false, 0, 0 };
+	uint32_t t_frame = frame_us(baud, payload);
+	uint32_t frames = seconds * 1000000ULL / t_frame;
+	Result r = { 0, 0, 0, 0, true };
+
+	for (uint32_t i = 0; i < frames; i++) {
+		if (!lose(&link)) {
+			r.delivered++;
+		} else {
+			r.lost++;
+		}
+	}
+	r.goodput = (double) r.delivered * payload / (seconds * baud / 10.0);
+
+	return r;
+}
+
+static Result run_reliable(unsigned baud, size_t payload, uint32_t loss,
+		uint8_t window, uint32_t timeout_us, unsigned seconds, bool reboot) {
+	Link data = { loss, 0x2545F491u, 0, false, 0, 0 };
+	Link back = { loss, 0x9E3779B9u, 0, false, 0, 0 };
+	uint32_t t_data = frame_us(baud, sizeof(ReliableHeader) + payload);
+	uint32_t t_ack = frame_us(baud, sizeof(ReliableAck));
+	ReliableTx tx(window, timeout_us, 1);
+	ReliableRx rx(window);
+	uintptr_t next_msg = 1, expect = 1;
+	uint16_t data_seq = 0;
+	uint8_t data_epoch = 0;
+	uintptr_t data_msg = 0;
+	ReliableAck ack_wire, ack_queued;
+	bool ack_pending = false;
+	Result r = { 0, 0, 0, 0, true };
+
+	for (uint32_t t = 0; t < seconds * 1000000u; t += STEP_US) {
+		if (reboot && t == seconds * 1000000u / 3 / STEP_US * STEP_US) {
+			rx = ReliableRx(window);
+			ack_pending = false;
+		}
+		if (reboot && t == seconds * 2000000u / 3 / STEP_US * STEP_US) {
+			tx = ReliableTx(window, timeout_us, 0xA5);
+		}
+
+		/* Data frame arrives. */
+		if (data.active && t >= data.busy_until) {
+			data.active = false;
+			if (lose(&data)) {
+				data.lost++;
+			} else {
+				void * m;
+
+				if (rx.accept(data_epoch, data_seq)) {
+					rx.store(data_seq, (void *) data_msg);
+				}
+				while ((m = rx.deliver()) != NULL) {
+					if ((uintptr_t) m < expect) {
+						r.in_order = false;
+					} else {
+						r.lost += (uintptr_t) m - expect;
+						expect = (uintptr_t) m + 1;
+					}
+					r.delivered++;
+				}
+				rx.ack(&ack_queued);
+				ack_pending = true;
+			}
+		}
+
+		/* Ack arrives. */
+		if (back.active && t >= back.busy_until) {
+			back.active = false;
+			if (lose(&back)) {
+				back.lost++;
+			} else {
+				tx.ack(&ack_wire);
+				while (tx.release() != NULL) {
+				}
+			}
+		}
+
+		/* Return link free: latest ack. */
+		if (!back.active && ack_pending) {
+			ack_wire = ack_queued;
+			ack_pending = false;
+			back.active = true;
+			back.busy_until = t + t_ack;
+			back.frames++;
+		}
+
+		/* Data link free: retransmissions first, then new messages. */
+		if (!data.active) {
+			void * m = tx.resend(t, &data_seq);
+
+			if (m != NULL) {
+				data_msg = (uintptr_t) m;
+				r.resent++;
+			} else if (!tx.full()) {
+				data_msg = next_msg++;
+				data_seq = tx.push((void *) data_msg, t);
+			} else {
+				continue;
+			}
+			data_epoch = tx.epoch();
+			data.active = true;
+			data.busy_until = t + t_data;
+			data.frames++;
+		}
+	}
+
+	r.goodput = (double) r.delivered * payload / (seconds * baud / 10.0);
+
+	return r;
+}
+
+int main(int argc, char * argv[]) {
+	static const uint32_t losses[] = { 0, 10000, 50000 };
+	static const uint8_t windows[] = { 1, 4, 8, 16 };
+	unsigned baud = 115200, seconds = 20;
+	size_t payload = 8;
+	uint32_t timeout_ms = 20;
+	bool reboot = false;
+	int c;
+
+	while ((c = getopt(argc, argv, "b:p:t:s:r")) != -1) {
+		switch (c) {
+		case 'b':
+			baud = atoi(optarg);
+			break;
+		case 'p':
+			payload = atoi(optarg);
+			break;
+		case 't':
+			timeout_ms = atoi(optarg);
+			break;
+		case 's':
+			seconds = atoi(optarg);
+			break;
+		case 'r':
+			reboot = true;
+			break;
+		default:
+			fprintf(stderr, "Usage: %s [-b baud] [-p payload] [-t timeout ms] "
+					"[-s seconds] [-r]\n", argv[0]);
+			return 1;
+		}
+	}
+	if (payload + sizeof(ReliableHeader) > SERIAL_MAX_PAYLOAD) {
+		fprintf(stderr, "payload too large\n");
+		return 1;
+	}
+
+	printf("%u bps, %zu byte payload, timeout %u ms, %u s%s\n", baud, payload,
+			timeout_ms, seconds, reboot ? ", receiver and sender reboot" : "");
+	printf("  loss  mode         goodput  delivered  resent   lost  in order\n");
+	for (size_t l = 0; l < sizeof(losses) / sizeof(losses[0]); l++) {
+		Result be = run_best_effort(baud, payload, losses[l], seconds);
+
+		printf("%5.1f%%  best effort  %6.1f%%  %9u       -  %5u         -\n",
+				losses[l] / 10000.0, be.goodput * 100, be.delivered, be.lost);
+		for (size_t w = 0; w < sizeof(windows) / sizeof(windows[0]); w++) {
+			Result r = run_reliable(baud, payload, losses[l], windows[w],
+					timeout_ms * 1000, seconds, reboot);
+
+			printf("%5.1f%%  window %2u    %6.1f%%  %9u  %6u  %5u  %8s\n",
+					losses[l] / 10000.0, windows[w], r.goodput * 100,
+					r.delivered, r.resent, r.lost, r.in_order ? "yes" : "NO");
+		}
+	}
+
+	return 0;
+}
@@ -0,0 +1,212 @@
+/*
+ * Host end of the binary serial transport (serial_transport.hpp).
+ *
+ * With a device argument, decodes the frames a board sends on that tty and
+ * reports the sustained payload throughput as a percentage of the line
+ * rate (8N1: baud / 10 bytes per second).
+ *
+ * Without a device, a pseudo terminal stands in for the board: a writer
+ * thread plays the firmware transmit side (fixed-size messages on several
+ * topics, framed back to back in 256 byte DMA buffers, paced at the line
+ * rate) and the same decoder runs on the other end.
+ *
+ * Usage: serial_endpoint [-b baud] [-s seconds] [-n payload] [-t topics] [device]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/select.h>
+#include <time.h>
+
+#include "serial_frame.hpp"
+#include "tty.hpp"
+
+#define TX_BUFFER	256
+#define MAX_TOPICS	16
+
+struct Options {
+	unsigned baud;
+	double seconds;
+	unsigned payload;
+	unsigned topics;
+	const char * device;
+};
+
+struct Writer {
+	int fd;
+	const Options * opt;
+	volatile bool stop;
+	unsigned long frames;
+	unsigned long wire_bytes;
+};
+
+static double now(void) {
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/*
+ * Firmware stand-in: same framing and buffer size as SerialTransport, the
+ * UART replaced by a write paced to the line rate.
+ */
+static void * writer_thread(void * arg) {
+	Writer * w = (Writer *) arg;
+	const Options * opt = w->opt;
+	uint8_t buffer[TX_BUFFER];
+	uint8_t payload[SERIAL_MAX_PAYLOAD];
+	double start = now(), due;
+	size_t len;
+	unsigned topic = 0;
+	uint32_t seq = 0;
+
+	while (!w->stop) {
+		len = 0;
+		while (len + SERIAL_FRAME_SIZE(opt->payload) <= TX_BUFFER) {
+			for (unsigned i = 0; i < opt->payload; i++) {
+				payload[i] = (uint8_t) (seq * 31 + i);
+			}
+			seq++;
+			len += frame_encode(1000 + topic, payload, opt->payload, buffer + len);
+			topic = (topic + 1) % opt->topics;
+			w->frames++;
+		}
+
+		for (size_t off = 0; off < len;) {
+			ssize_t n = write(w->fd, buffer + off, len - off);
+			if (n < 0) {
+				return NULL;
+			}
+			off += n;
+		}
+		w->wire_bytes += len;
+
+		/* Pace to the line rate, 10 bit times per byte. */
+		due = start + w->wire_bytes * 10.0 / opt->baud;
+		while (now() < due) {
+			usleep(100);
+		}
+	}
+
+	return NULL;
+}
+
+static void usage(void) {
+
+	fprintf(stderr, "usage: serial_endpoint [-b baud] [-s seconds] [-n payload] [-t topics] [device]\n");
+	exit(1);
+}
+
+int main(int argc, char * argv[]) {
+	Options opt = { 115200, 5.0, 2, 2, NULL };
+	FrameDecoder decoder;
+	Writer writer;
+	pthread_t tid;
+	uint16_t ids[MAX_TOPICS];
+	unsigned long per_topic[MAX_TOPICS] = { 0 };
+	int ntopics = 0;
+	unsigned long wire = 0;
+	uint8_t buf[4096];
+	double start, elapsed, line;
+	int fd, master = -1, c;
+
+	while ((c = getopt(argc, argv, "b:s:n:t:")) != -1) {
+		switch (c) {
+		case 'b': opt.baud = atoi(optarg); break;
+		case 's': opt.seconds = atof(optarg); break;
+		case 'n': opt.payload = atoi(optarg); break;
+		case 't': opt.topics = atoi(optarg); break;
+		default: usage();
+		}
+	}
+	if (optind < argc) {
+		opt.device = argv[optind];
+	}
+	if (opt.payload > SERIAL_MAX_PAYLOAD || opt.topics == 0 || opt.topics > MAX_TOPICS) {
+		usage();
+	}
+
+	if (opt.device != NULL) {
+		fd = tty_open(opt.device, opt.baud);
+		if (fd < 0) {
+			perror(opt.device);
+			return 1;
+		}
+	} else {
+		if (!pty_pair(&master, &fd)) {
+			perror("pty");
+			return 1;
+		}
+
+		writer.fd = master;
+		writer.opt = &opt;
+		writer.stop = false;
+		writer.frames = 0;
+		writer.wire_bytes = 0;
+		pthread_create(&tid, NULL, writer_thread, &writer);
+	}
+
+	start = now();
+	while ((elapsed = now() - start) < opt.seconds) {
+		struct timeval tv = { 0, 100000 };
+		fd_set set;
+		ssize_t n;
+
+		FD_ZERO(&set);
+		FD_SET(fd, &set);
+		if (select(fd + 1, &set, NULL, NULL, &tv) <= 0) {
+			continue;
+		}
+
+		n = read(fd, buf, sizeof(buf));
+		if (n <= 0) {
+			continue;
+		}
+		wire += n;
+
+		for (ssize_t i = 0; i < n; i++) {
+			int t;
+
+			if (!decoder.push(buf[i])) {
+				continue;
+			}
+			for (t = 0; t < ntopics && ids[t] != decoder.topic(); t++)
+				;
+			if (t == ntopics && ntopics < MAX_TOPICS) {
+				ids[ntopics++] = decoder.topic();
+			}
+			if (t < ntopics) {
+				per_topic[t]++;
+			}
+		}
+	}
+
+	if (master >= 0) {
+		writer.stop = true;
+		pthread_join(tid, NULL);
+	}
+
+	const FrameStats & s = decoder.stats();
+	line = opt.baud / 10.0 * elapsed;
+
+	printf("%s, %u bps, %.1f s\n", opt.device ? opt.device : "pty loopback",
+			opt.baud, elapsed);
+	printf("frames %u, payload %u bytes, wire %lu bytes\n", s.frames, s.bytes, wire);
+	for (int t = 0; t < ntopics; t++) {
+		printf("  topic %u: %lu frames\n", ids[t], per_topic[t]);
+	}
+	printf("errors: crc %u, framing %u, overrun %u\n", s.crc_errors,
+			s.framing_errors, s.overruns);
+	printf("payload throughput %.0f B/s = %.1f%% of line rate (wire %.1f%%)\n",
+			s.bytes / elapsed, 100.0 * s.bytes / line, 100.0 * wire / line);
+	if (s.frames != 0) {
+		printf("framing efficiency %.1f%% (%.1f wire bytes per frame)\n",
+				100.0 * s.bytes / wire, (double) wire / s.frames);
+	}
+
+	return 0;
+}
@@ -0,0 +1,252 @@
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <limits.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+
+#include "shm_ring.hpp"
+
+#define SHM_RING_MAGIC	0x52325052	/* "R2PR" */
+#define SLOT_EMPTY		UINT64_MAX
+
+static size_t slot_stride(uint32_t slot_size) {
+
+	return (sizeof(uint64_t) + slot_size + 7) & ~(size_t) 7;
+}
+
+ShmRing::ShmRing(void) :
+		_header(NULL), _base(NULL), _stride(0), _size(0), _owner(false) {
+
+	_name[0] = '\0';
+}
+
+ShmRing::~ShmRing(void) {
+
+	close();
+}
+
+bool ShmRing::map(int fd, size_t size, bool writable) {
+	void * p;
+
+	p = mmap(NULL, size, writable ? PROT_READ | PROT_WRITE : PROT_READ,
+			fd < 0 ? MAP_SHARED | MAP_ANONYMOUS : MAP_SHARED, fd, 0);
+	if (p == MAP_FAILED) {
+		return false;
+	}
+
+	_header = (ShmRingHeader *) p;
+	_base = (uint8_t *) p + sizeof(ShmRingHeader);
+	_size = size;
+
+	return true;
+}
+
+/*
+ * Creates the ring; name NULL keeps it private to the process, otherwise
+ * it is a POSIX shared memory object other processes can attach() to.
+ */
+bool ShmRing::create(const char * name, uint32_t slot_size, uint32_t slots) {
+	size_t size = sizeof(ShmRingHeader) + slots * slot_stride(slot_size);
+	int fd = -1;
+	bool ok;
+
+	if (slots == 0) {
+		return false;
+	}
+
+	if (name != NULL) {
+		fd = shm_open(name, O_CREAT | O_RDWR | O_TRUNC, 0644);
+		if (fd < 0 || ftruncate(fd, size) < 0) {
+			if (fd >= 0) {
+				::close(fd);
+			}
+			return false;
+		}
+		strncpy(_name, name, sizeof(_name) - 1);
+		_name[sizeof(_name) - 1] = '\0';
+	}
+
+	ok = map(fd, size, true);
+	if (fd >= 0) {
+		::close(fd);
+	}
+	if (!ok) {
+		return false;
+	}
+
+	_owner = true;
+	_stride = slot_stride(slot_size);
+	_header->slot_size = slot_size;
+	_header->slots = slots;
+	_header->wake = 0;
+	_header->head = 0;
+	for (uint32_t i = 0; i < slots; i++) {
+		*(uint64_t *) (_base + i * _stride) = SLOT_EMPTY;
+	}
+	__atomic_store_n(&_header->magic, SHM_RING_MAGIC, __ATOMIC_RELEASE);
+
+	return true;
+}
+
+bool ShmRing::attach(const char * name) {
+	struct stat st;
+	int fd;
+	bool ok;
+
+	fd = shm_open(name, O_RDONLY, 0);
+	if (fd < 0) {
+		return false;
+	}
+
+	ok = fstat(fd, &st) == 0 && (size_t) st.st_size >= sizeof(ShmRingHeader)
+			&& map(fd, st.st_size, false);
+	::close(fd);
+	if (!ok) {
+		return false;
+	}
+
+	if (__atomic_load_n(&_header->magic, __ATOMIC_ACQUIRE) != SHM_RING_MAGIC) {
+		close();
+		return false;
+	}
+	_stride = slot_stride(_header->slot_size);
+
+	return true;
+}
+
+void ShmRing::close(void) {
+
+	if (_header != NULL) {
+		munmap(_header, _size);
+		_header = NULL;
+	}
+	if (_owner && _name[0] != '\0') {
+		shm_unlink(_name);
+	}
+	_owner = false;
+	_name[0] = '\0';
+}
+
+void ShmRing::write(const void * data, size_t len) {
+	uint64_t n = _header->head;
+	uint64_t * seq;
+	uint8_t * p = slot(n, &seq);
+
+	if (len > _header->slot_size) {
+		len = _header->slot_size;
+	}
+
+	__atomic_store_n(seq, SLOT_EMPTY, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+	memcpy(p, data, len);
+	__atomic_store_n(seq, n, __ATOMIC_RELEASE);
+	__atomic_store_n(&_header->head, n + 1, __ATOMIC_RELEASE);
+
+	__atomic_add_fetch(&_header->wake, 1, __ATOMIC_RELEASE);
+	syscall(SYS_futex, &_header->wake, FUTEX_WAKE, INT_MAX, NULL, NULL, 0);
+}
+
+uint64_t ShmRing::head(void) const {
+
+	return __atomic_load_n(&_header->head, __ATOMIC_ACQUIRE);
+}
+
+uint8_t * ShmRing::slot(uint64_t n, uint64_t ** seq) const {
+	uint8_t * p = _base + (n % _header->slots) * _stride;
+
+	*seq = (uint64_t *) p;
+
+	return p + sizeof(uint64_t);
+}
+
+uint32_t ShmRing::wakeCount(void) const {
+
+	return __atomic_load_n(&_header->wake, __ATOMIC_ACQUIRE);
+}
+
+/*
+ * Sleeps until a write after wake count 'wake' was taken, or timeout.
+ */
+bool ShmRing::wait(uint32_t wake, int timeout_ms) const {
+	struct timespec ts = { timeout_ms / 1000, (timeout_ms % 1000) * 1000000L };
+
+	syscall(SYS_futex, &_header->wake, FUTEX_WAIT, wake,
+			timeout_ms < 0 ? NULL : &ts, NULL, 0);
+
+	return wakeCount() != wake;
+}
+
+RingReader::RingReader(void) :
+		_ring(NULL), _next(0), _seq(NULL), _lost(0) {
+}
+
+/*
+ * Starts at the current head: only messages written from now on.
+ */
+void RingReader::init(const ShmRing * ring) {
+
+	_ring = ring;
+	_next = ring->head();
+	_seq = NULL;
+	_lost = 0;
+}
+
+const void * RingReader::get(void) {
+	uint64_t head;
+	uint8_t * p;
+
+	for (;;) {
+		head = _ring->head();
+		if (_next >= head) {
+			return NULL;
+		}
+
+		/* Lapped by the writer: skip to the oldest slot still there. */
+		if (head - _next > _ring->slots()) {
+			_lost += head - _ring->slots() - _next;
+			_next = head - _ring->slots();
+		}
+
+		p = _ring->slot(_next, &_seq);
+		if (__atomic_load_n(_seq, __ATOMIC_ACQUIRE) == _next) {
+			return p;
+		}
+
+		/* Being overwritten right now. */
+		_lost++;
+		_next++;
+	}
+}
+
+/*
+ * Returns false if the slot was overwritten while in use: the data seen
+ * since get() must be discarded.
+ */
+bool RingReader::release(void) {
+	bool ok;
+
+	__atomic_thread_fence(__ATOMIC_ACQUIRE);
+	ok = (__atomic_load_n(_seq, __ATOMIC_RELAXED) == _next);
+	if (!ok) {
+		_lost++;
+	}
+	_next++;
+
+	return ok;
+}
+
+bool RingReader::wait(int timeout_ms) {
+	uint32_t wake = _ring->wakeCount();
+
+	if (_next < _ring->head()) {
+		return true;
+	}
+
+	_ring->wait(wake, timeout_ms);
+
+	return _next < _ring->head();
+}
@@ -0,0 +1,88 @@
+#ifndef SHM_RING_HPP_
+#define SHM_RING_HPP_
+
+#include <stdint.h>
+#include <stddef.h>
+
+/*
+ * Single writer, many reader broadcast ring in shared memory.
+ *
+ * Each slot carries the index of the message it holds; the writer
+ * invalidates a slot before overwriting it, so a reader working in place
+ * on a slot finds out at release() whether it was lapped. Readers never
+ * block the writer: a slow reader loses the oldest messages, counted.
+ * Waiting is a futex on the header, which works across processes.
+ */
+
+struct ShmRingHeader {
+	uint32_t magic;
+	uint32_t slot_size;
+	uint32_t slots;
+	uint32_t wake;
+	uint64_t head;
+};
+
+class ShmRing {
+public:
+	ShmRing(void);
+	~ShmRing(void);
+
+	bool create(const char * name, uint32_t slot_size, uint32_t slots);
+	bool attach(const char * name);
+	void close(void);
+
+	void write(const void * data, size_t len);
+
+	uint64_t head(void) const;
+	uint8_t * slot(uint64_t n, uint64_t ** seq) const;
+	bool wait(uint32_t wake, int timeout_ms) const;
+	uint32_t wakeCount(void) const;
+
+	uint32_t slotSize(void) const {
+		return _header->slot_size;
+	}
+
+	uint32_t slots(void) const {
+		return _header->slots;
+	}
+
+	bool valid(void) const {
+		return _header != NULL;
+	}
+
+private:
+	bool map(int fd, size_t size, bool writable);
+
+	ShmRingHeader * _header;
+	uint8_t * _base;
+	size_t _stride;
+	size_t _size;
+	char _name[64];
+	bool _owner;
+};
+
+/*
+ * Zero copy reader: get() points into the ring, release() moves on.
+ */
+class RingReader {
+public:
+	RingReader(void);
+
+	void init(const ShmRing * ring);
+
+	const void * get(void);
+	bool release(void);
+	bool wait(int timeout_ms);
+
+	uint64_t lost(void) const {
+		return _lost;
+	}
+
+private:
+	const ShmRing * _ring;
+	uint64_t _next;
+	uint64_t * _seq;
+	uint64_t _lost;
+};
+
+#endif /* SHM_RING_HPP_ */
@@ -0,0 +1,69 @@
+#!/bin/sh
+#
+# Size report of a firmware build: section totals, .text/.data/.bss per
+# object file, the largest symbols and the code of each Publisher<T> /
+# Subscriber<T,N> instantiation. Run by the firmware Makefile after every
+# link; works on host binaries too with an empty prefix.
+#
+# Usage: size_report.sh <toolchain prefix> <elf> <object dir> [top symbols]
+#
+
+TRGT=$1
+ELF=$2
+OBJDIR=$3
+TOP=${4:-20}
+
+if [ ! -f "$ELF" ]; then
+	echo "usage: $0 <toolchain prefix> <elf> <object dir> [top symbols]" >&2
+	exit 1
+fi
+
+# nm -S sizes are hex; awk has no portable strtonum.
+HEX='function hex(s,   i, n, c) {
+	n = 0
+	s = tolower(s)
+	for (i = 1; i <= length(s); i++) {
+		c = index("0123456789abcdef", substr(s, i, 1))
+		n = n * 16 + c - 1
+	}
+	return n
+}'
+
+echo "== $ELF"
+${TRGT}size "$ELF"
+
+echo
+echo "== Per object (text data bss, largest text first)"
+${TRGT}size "$OBJDIR"/*.o | awk 'NR > 1 {
+	n = split($6, p, "/")
+	printf "%8d %6d %6d  %s\n", $1, $2, $3, p[n]
+}' | sort -rn
+
+echo
+echo "== Top $TOP symbols"
+${TRGT}nm -S --size-sort -C "$ELF" | awk "$HEX"'
+NF >= 4 {
+	name = $4
+	for (i = 5; i <= NF; i++) {
+		name = name " " $i
+	}
+	printf "%8d %s  %s\n", hex($2), $3, name
+}' | tail -n "$TOP"
+
+echo
+echo "== Middleware templates (bytes of code per instantiation)"
+${TRGT}nm -S -C "$ELF" | awk "$HEX"'
+NF >= 4 && ($3 == "T" || $3 == "t" || $3 == "W" || $3 == "w") {
+	if (match($0, /(Publisher|Subscriber|LocalPublisher|RemoteSubscriberT)<[^>]*>/)) {
+		key = substr($0, RSTART, RLENGTH)
+		bytes[key] += hex($2)
+		count[key]++
+		total += hex($2)
+	}
+}
+END {
+	for (key in bytes) {
+		printf "%8d %4d  %s\n", bytes[key], count[key], key
+	}
+	printf "%8d        total\n", total
+}' | sort -rn
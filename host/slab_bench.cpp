@@ -0,0 +1,237 @@
+/*
+ * Shared slab vs. per-topic pools for the pubsub benchmark topic set.
+ *
+ * Cycles: alloc + free of one block per size class, against malloc/free.
+ * The slab takes a mutex here where the board takes the kernel lock.
+ *
+ * RAM: every topic of main_pubsub_benchmark, plus a GPS NMEA and a log
+ * topic with variable length payloads, publishes at its rate and each
+ * message stays in use a random time up to the topic's hold time, with at
+ * most as many in flight as the topic has buffers (publisher plus
+ * subscriber queues). Per-topic pools need buffers * largest message for
+ * every topic; the shared arena needs the peak number of blocks used per
+ * class at once. The run is replayed on a slab of exactly that arena to
+ * check that nothing fails. Sizes include a BaseMessage header of HEADER
+ * bytes; -b gives the BIG TestData.
+ *
+ * Usage: slab_bench [-b] [-t run s] [-n alloc/free cycles]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <vector>
+#include <x86intrin.h>
+
+#include "slab.hpp"
+
+#define HEADER			8		/* BaseMessage, assumed. */
+#define ALIGN			4
+
+static uint32_t seed = 1;
+
+static uint32_t sim_random(uint32_t range) {
+
+	seed = seed * 1664525u + 1013904223u;
+	return range ? (seed >> 8) % range : 0;
+}
+
+struct TopicLoad {
+	const char * name;
+	uint16_t min;			/* Payload, [bytes]. */
+	uint16_t max;
+	uint16_t rate;			/* [Hz] */
+	uint16_t hold;			/* Longest time in use, [ms]. */
+	uint16_t buffers;		/* Publisher + subscriber queues. */
+};
+
+static TopicLoad topics[] = {
+	{ "test", 4, 4, 100, 5, 1 + 5 + 2 + 2 + 5 },
+	{ "test/10Hz", 4, 4, 10, 20, 1 + 2 },
+	{ "test/1Hz", 4, 4, 1, 20, 1 + 2 },
+	{ "test/remote", 4, 4, 100, 5, 1 + 5 },
+	{ "test/cmd", 4, 4, 10, 50, 1 + 5 },
+	{ "test/cmd/remote", 4, 4, 10, 5, 1 + 5 },
+	{ "test/cmd/ack", 4, 4, 10, 5, 1 + 4 },
+	{ "test/mailbox", 4, 4, 100, 1, 1 + 1 },
+	{ "health", 32, 32, 4, 1, 1 },
+	{ "gps/nmea", 20, 82, 5, 50, 1 + 4 },
+	{ "log", 8, 128, 20, 100, 1 + 8 },
+};
+
+#define TOPICS	(sizeof(topics) / sizeof(topics[0]))
+
+static uint32_t round_up(uint32_t size) {
+
+	return (size + ALIGN - 1) / ALIGN * ALIGN;
+}
+
+struct InUse {
+	size_t topic;
+	uint32_t until;
+	void * block;
+	uint8_t c;
+};
+
+/*
+ * Runs the topic set for ms milliseconds; with a slab allocates from it,
+ * otherwise only counts blocks per class. Returns the failed allocations.
+ */
+static uint32_t run(uint32_t ms, Slab * slab, uint16_t peak[SLAB_CLASSES]) {
+	std::vector<InUse> used;
+	uint16_t count[SLAB_CLASSES] = { 0 };
+	uint16_t inflight[TOPICS] = { 0 };
+	uint32_t failed = 0;
+
+	seed = 1;
+	for (uint8_t c = 0; c < SLAB_CLASSES; c++) {
+		peak[c] = 0;
+	}
+
+	for (uint32_t t = 0; t < ms; t++) {
+		for (size_t i = 0; i < used.size();) {
+			if (used[i].until <= t) {
+				if (slab) {
+					slab->free(used[i].block);
+				}
+				count[used[i].c]--;
+				inflight[used[i].topic]--;
+				used[i] = used.back();
+				used.pop_back();
+			} else {
+				i++;
+			}
+		}
+
+		for (size_t k = 0; k < TOPICS; k++) {
+			const TopicLoad & tl = topics[k];
+			InUse u;
+			uint32_t size;
+
+			if ((t * tl.rate) / 1000 == ((t + 1) * tl.rate) / 1000
+					|| inflight[k] == tl.buffers) {
+				continue;
+			}
+			size = HEADER + tl.min + sim_random(tl.max - tl.min + 1);
+			u.topic = k;
+			u.until = t + 1 + sim_random(tl.hold);
+			u.c = Slab::sizeClass(size);
+			u.block = NULL;
+			if (slab) {
+				u.block = slab->alloc(size);
+				if (u.block == NULL) {
+					failed++;
+					continue;
+				}
+				u.c = Slab::sizeClass(slab->blockSize(u.block));
+			}
+			if (++count[u.c] > peak[u.c]) {
+				peak[u.c] = count[u.c];
+			}
+			inflight[k]++;
+			used.push_back(u);
+		}
+	}
+
+	if (slab) {
+		for (size_t i = 0; i < used.size(); i++) {
+			slab->free(used[i].block);
+		}
+	}
+
+	return failed;
+}
+
+int main(int argc, char * argv[]) {
+	uint32_t run_s = 60, n = 1000000;
+	uint32_t pools = 0, arena = 0;
+	uint16_t peak[SLAB_CLASSES], replay[SLAB_CLASSES];
+	SlabStats stats[SLAB_CLASSES];
+	int c;
+
+	while ((c = getopt(argc, argv, "bt:n:")) != -1) {
+		switch (c) {
+		case 'b':
+			for (size_t k = 0; k < TOPICS; k++) {
+				if (topics[k].max == 4) {
+					topics[k].min = topics[k].max = 128;
+				}
+			}
+			break;
+		case 't':
+			run_s = atoi(optarg);
+			break;
+		case 'n':
+			n = atoi(optarg);
+			break;
+		default:
+			fprintf(stderr, "Usage: %s [-b] [-t run s] [-n alloc/free cycles]\n", argv[0]);
+			return 1;
+		}
+	}
+	if (n == 0) {
+		return 1;
+	}
+
+	/* Cycles per alloc + free, one class at a time. */
+	{
+		static const uint16_t counts[SLAB_CLASSES] = { 4, 4, 4, 4, 4, 4 };
+		static StaticSlab<SLAB_BYTES(4, 4, 4, 4, 4, 4)> slab(counts);
+
+		printf("alloc + free cycles   slab  malloc\n");
+		for (uint8_t k = 0; k < SLAB_CLASSES; k++) {
+			uint32_t size = Slab::classSize(k);
+			uint64_t slab_cycles = 0, malloc_cycles = 0;
+			uint32_t t0;
+			void * p;
+
+			for (uint32_t i = 0; i < n; i++) {
+				t0 = (uint32_t) __rdtsc();
+				p = slab.alloc(size);
+				slab.free(p);
+				slab_cycles += (uint32_t) __rdtsc() - t0;
+
+				t0 = (uint32_t) __rdtsc();
+				p = malloc(size);
+				__asm__ __volatile__("" : : "r"(p) : "memory");
+				free(p);
+				malloc_cycles += (uint32_t) __rdtsc() - t0;
+			}
+			printf("%4u bytes           %6.1f %7.1f\n", size, (double) slab_cycles / n,
+					(double) malloc_cycles / n);
+		}
+	}
+
+	printf("\n%-16s %7s %5s %4s %7s\n", "topic", "payload", "rate", "bufs", "pool B");
+	for (size_t k = 0; k < TOPICS; k++) {
+		const TopicLoad & tl = topics[k];
+		uint32_t bytes = tl.buffers * round_up(HEADER + tl.max);
+
+		printf("%-16s %3u-%-3u %5u %4u %7u\n", tl.name, tl.min, tl.max, tl.rate,
+				tl.buffers, bytes);
+		pools += bytes;
+	}
+
+	run(run_s * 1000, NULL, peak);
+	for (uint8_t k = 0; k < SLAB_CLASSES; k++) {
+		arena += peak[k] * Slab::classSize(k);
+	}
+
+	{
+		uint8_t * mem = new uint8_t[arena];
+		Slab slab(mem, arena, peak);
+		uint32_t failed = run(run_s * 1000, &slab, replay);
+
+		slab.stats(stats);
+		printf("\nclass  peak blocks  spilled  failed\n");
+		for (uint8_t k = 0; k < SLAB_CLASSES; k++) {
+			printf("%5u  %11u  %7u  %6u\n", (unsigned) Slab::classSize(k), peak[k],
+					stats[k].spilled, stats[k].failed);
+		}
+		printf("\nper-topic pools %u B, shared slab %u B (%.0f%%), %u failed in %u s\n",
+				pools, arena, 100.0 * arena / pools, failed, run_s);
+		delete[] mem;
+	}
+
+	return 0;
+}
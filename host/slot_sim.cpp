@@ -0,0 +1,155 @@
+/*
+ * Sample age of remote topics on a simulated RTCAN slot schedule.
+ *
+ * The bus repeats the firmware schedule (slot_schedule.hpp): a cycle of
+ * RTCAN_SLOTS equal slots, RTCAN_CYCLE_HZ times a second. Each remote
+ * topic owns one slot and its frame goes out at the slot start if it was
+ * queued by then, otherwise at the same slot of the next cycle; it reaches
+ * the remote subscriber FRAME_US later.
+ *
+ * Publishers run on a 1 kHz system tick: they wake at a tick, plus up to
+ * the given jitter, sample, and queue the frame QUEUE_US later. Free
+ * running publishers start at an arbitrary tick of their period; aligned
+ * ones use slot_phase() with the given lead, as PeriodicTask::align()
+ * does. The age is from the sample to its arrival at the subscriber.
+ *
+ * Usage: slot_sim [-t topics] [-p period ms] [-l lead us] [-j jitter us]
+ *                 [-n samples per topic]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <algorithm>
+#include <vector>
+
+#include "slot_schedule.hpp"
+
+#define TICK_HZ			1000
+#define FRAME_US		130		/* 8 byte standard frame at 1 Mbit/s, stuffed. */
+#define QUEUE_US		40		/* Sample to frame queued. */
+
+static uint32_t seed = 1;
+
+static uint32_t sim_random(uint32_t range) {
+
+	seed = seed * 1664525u + 1013904223u;
+	return (seed >> 8) % range;
+}
+
+struct AgeStats {
+	double mean;
+	uint32_t p50;
+	uint32_t p99;
+	uint32_t max;
+};
+
+static AgeStats ages(std::vector<uint32_t> & age) {
+	AgeStats s;
+	double sum = 0;
+
+	std::sort(age.begin(), age.end());
+	for (size_t i = 0; i < age.size(); i++) {
+		sum += age[i];
+	}
+	s.mean = sum / age.size();
+	s.p50 = age[age.size() / 2];
+	s.p99 = age[age.size() * 99 / 100];
+	s.max = age.back();
+
+	return s;
+}
+
+/*
+ * Runs every topic for n periods, free running from a random tick or
+ * aligned to its slot.
+ */
+static AgeStats run(const std::vector<uint16_t> & slots, uint32_t period_us,
+		bool aligned, uint32_t lead_us, uint32_t jitter_us, uint32_t n) {
+	uint32_t cycle_us = 1000000 / rtcan_schedule.cycle_hz;
+	uint32_t tick_us = 1000000 / TICK_HZ;
+	std::vector<uint32_t> age;
+
+	for (size_t t = 0; t < slots.size(); t++) {
+		uint32_t slot_us = slot_offset_us(&rtcan_schedule, slots[t]);
+		uint32_t phase_us;
+
+		if (aligned) {
+			phase_us = slot_phase(&rtcan_schedule, slots[t], lead_us, TICK_HZ) * tick_us;
+		} else {
+			phase_us = sim_random(period_us / tick_us) * tick_us;
+		}
+
+		for (uint32_t k = 0; k < n; k++) {
+			uint64_t sample = (uint64_t) k * period_us + phase_us + sim_random(jitter_us + 1);
+			uint64_t queued = sample + QUEUE_US;
+			uint64_t cycle = queued / cycle_us;
+			uint64_t tx = cycle * cycle_us + slot_us;
+
+			if (tx < queued) {
+				tx += cycle_us;
+			}
+			age.push_back((uint32_t) (tx + FRAME_US - sample));
+		}
+	}
+
+	return ages(age);
+}
+
+int main(int argc, char * argv[]) {
+	uint32_t topics = 8, period_ms = 10, lead_us = SLOT_LEAD_US, jitter_us = 50;
+	uint32_t n = 10000;
+	std::vector<uint16_t> slots;
+	AgeStats before, after;
+	int c;
+
+	while ((c = getopt(argc, argv, "t:p:l:j:n:")) != -1) {
+		switch (c) {
+		case 't':
+			topics = atoi(optarg);
+			break;
+		case 'p':
+			period_ms = atoi(optarg);
+			break;
+		case 'l':
+			lead_us = atoi(optarg);
+			break;
+		case 'j':
+			jitter_us = atoi(optarg);
+			break;
+		case 'n':
+			n = atoi(optarg);
+			break;
+		default:
+			fprintf(stderr, "Usage: %s [-t topics] [-p period ms] [-l lead us] "
+					"[-j jitter us] [-n samples per topic]\n", argv[0]);
+			return 1;
+		}
+	}
+	if (topics == 0 || topics > RTCAN_SLOTS || n == 0
+			|| (period_ms * rtcan_schedule.cycle_hz) % 1000 != 0) {
+		fprintf(stderr, "1..%u topics, period a multiple of the %u ms cycle\n",
+				RTCAN_SLOTS, 1000 / rtcan_schedule.cycle_hz);
+		return 1;
+	}
+
+	for (uint16_t s = 0; s < RTCAN_SLOTS; s++) {
+		slots.push_back(s);
+	}
+	for (uint16_t s = 0; s < RTCAN_SLOTS; s++) {
+		std::swap(slots[s], slots[s + sim_random(RTCAN_SLOTS - s)]);
+	}
+	slots.resize(topics);
+
+	printf("%u slots at %u Hz, %u topics every %u ms, lead %u us, jitter %u us\n",
+			RTCAN_SLOTS, RTCAN_CYCLE_HZ, topics, period_ms, lead_us, jitter_us);
+
+	before = run(slots, period_ms * 1000, false, lead_us, jitter_us, n);
+	after = run(slots, period_ms * 1000, true, lead_us, jitter_us, n);
+
+	printf("sample age us     mean    p50    p99    max\n");
+	printf("free running   %7.0f %6u %6u %6u\n", before.mean, before.p50, before.p99, before.max);
+	printf("slot aligned   %7.0f %6u %6u %6u\n", after.mean, after.p50, after.p99, after.max);
+
+	return 0;
+}
@@ -0,0 +1,208 @@
+/*
+ * Clock synchronization on a simulated CAN bus with skewed clocks.
+ *
+ * Each node runs the firmware TimeSync engine on its own microsecond
+ * clock: a random 32 bit offset and a rate error uniform in +-skew ppm.
+ * Nodes boot at random within the boot spread and tick every millisecond.
+ * A frame waits up to the given queue delay (slot wait, arbitration, a
+ * missed slot) before it goes out. As in the firmware, the sender stamps a
+ * SYNC in its transmit complete interrupt and the receivers in their
+ * receive interrupt, both at the end of frame plus up to the given
+ * interrupt latency. Frames are lost per receiver at the given rate.
+ * With -k the master dies at that time and another node takes over.
+ *
+ * Every millisecond the shared time of all running nodes is read at the
+ * same true instant; the sync error is the spread between the earliest
+ * and the latest. The convergence time is from the last boot to the last
+ * spread above THRESHOLD_US, the error statistics are from then on.
+ *
+ * Usage: timesync_sim [-n nodes] [-s skew ppm] [-j jitter us]
+ *                     [-q queue delay us] [-l loss permille]
+ *                     [-k master kill ms] [-t run s]
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <algorithm>
+#include <vector>
+
+#include "timesync.hpp"
+
+#define MAX_NODES		32
+#define FRAME_US		130		/* 8 byte standard frame at 1 Mbit/s, stuffed. */
+#define BOOT_MS			500
+#define THRESHOLD_US	50
+
+static uint32_t seed = 1;
+
+static uint32_t sim_random(uint32_t range) {
+
+	seed = seed * 1664525u + 1013904223u;
+	return range ? (seed >> 8) % range : 0;
+}
+
+struct SimNode {
+	TimeSync * sync;
+	uint32_t offset;
+	double rate;
+	uint32_t boot_ms;
+	bool alive;
+};
+
+static uint32_t local(const SimNode & node, double t_us) {
+
+	return node.offset + (uint32_t) (uint64_t) floor(t_us * node.rate);
+}
+
+int main(int argc, char * argv[]) {
+	int nodes = 4;
+	uint32_t skew_ppm = 50, jitter_us = 10, queue_us = 300, loss = 0;
+	uint32_t kill_ms = 0, run_s = 30;
+	SimNode node[MAX_NODES];
+	std::vector<uint32_t> spread;
+	uint32_t last_boot = 0, converged = 0;
+	int killed = -1;
+	int c;
+
+	while ((c = getopt(argc, argv, "n:s:j:q:l:k:t:")) != -1) {
+		switch (c) {
+		case 'n':
+			nodes = atoi(optarg);
+			break;
+		case 's':
+			skew_ppm = atoi(optarg);
+			break;
+		case 'j':
+			jitter_us = atoi(optarg);
+			break;
+		case 'q':
+			queue_us = atoi(optarg);
+			break;
+		case 'l':
+			loss = atoi(optarg);
+			break;
+		case 'k':
+			kill_ms = atoi(optarg);
+			break;
+		case 't':
+			run_s = atoi(optarg);
+			break;
+		default:
+			fprintf(stderr, "Usage: %s [-n nodes] [-s skew ppm] [-j jitter us] "
+					"[-q queue delay us] [-l loss permille] [-k master kill ms] "
+					"[-t run s]\n", argv[0]);
+			return 1;
+		}
+	}
+	if (nodes < 2 || nodes > MAX_NODES || run_s == 0) {
+		fprintf(stderr, "2..%d nodes\n", MAX_NODES);
+		return 1;
+	}
+
+	for (int i = 0; i < nodes; i++) {
+		int32_t ppm = (int32_t) sim_random(2 * skew_ppm * 1000 + 1) - (int32_t) skew_ppm * 1000;
+
+		node[i].sync = new TimeSync(i + 1);
+		node[i].offset = (sim_random(1 << 16) << 16) | sim_random(1 << 16);
+		node[i].rate = 1.0 + ppm * 1e-9;
+		node[i].boot_ms = sim_random(BOOT_MS);
+		node[i].alive = false;
+		last_boot = std::max(last_boot, node[i].boot_ms);
+	}
+
+	printf("%d nodes, skew +-%u ppm, jitter %u us, queue %u us, loss %u permille\n",
+			nodes, skew_ppm, jitter_us, queue_us, loss);
+
+	for (uint32_t ms = 0; ms < run_s * 1000; ms++) {
+		double t = ms * 1000.0;
+		uint32_t lo = 0, hi = 0;
+		bool first = true;
+
+		for (int i = 0; i < nodes; i++) {
+			if (ms == node[i].boot_ms) {
+				node[i].alive = true;
+			}
+			if (kill_ms != 0 && ms == kill_ms && node[i].alive && node[i].sync->master()) {
+				node[i].alive = false;
+				killed = i;
+				printf("master uid %d killed at %u ms\n", i + 1, ms);
+			}
+		}
+
+		for (int i = 0; i < nodes; i++) {
+			TimeSyncFrame frame;
+
+			if (!node[i].alive) {
+				continue;
+			}
+			node[i].sync->tick(local(node[i], t));
+
+			while (node[i].sync->pending(&frame)) {
+				double eof = t + sim_random(queue_us + 1) + FRAME_US;
+
+				node[i].sync->sent(&frame, local(node[i], eof) + sim_random(jitter_us + 1));
+				for (int j = 0; j < nodes; j++) {
+					if (j == i || !node[j].alive || sim_random(1000) < loss) {
+						continue;
+					}
+					node[j].sync->receive(&frame, local(node[j], eof) + sim_random(jitter_us + 1));
+				}
+			}
+		}
+
+		for (int i = 0; i < nodes; i++) {
+			uint32_t now;
+
+			if (!node[i].alive) {
+				continue;
+			}
+			now = node[i].sync->now(local(node[i], t));
+			if (first || (int32_t) (now - lo) < 0) {
+				lo = now;
+			}
+			if (first || (int32_t) (now - hi) > 0) {
+				hi = now;
+			}
+			first = false;
+		}
+
+		if (ms >= last_boot) {
+			spread.push_back(hi - lo);
+			if (hi - lo > THRESHOLD_US) {
+				converged = spread.size();
+			}
+		}
+	}
+
+	for (int i = 0; i < nodes; i++) {
+		const TimeSyncStats & s = node[i].sync->stats();
+
+		printf("uid %2d %s%-7s skew %+7.2f ppm  tx %5u rx %5u steps %u  drift %+8.3f ppm\n",
+				i + 1, i == killed ? "x" : " ",
+				node[i].sync->master() ? "master" : "slave",
+				(node[i].rate - 1.0) * 1e6, s.syncs_sent, s.follow_ups, s.steps,
+				s.drift * 1e-3);
+	}
+
+	if (converged == spread.size()) {
+		printf("not converged within %u us\n", THRESHOLD_US);
+		return 1;
+	}
+
+	printf("converged %u ms after the last boot\n", converged);
+	spread.erase(spread.begin(), spread.begin() + converged);
+	{
+		double sum = 0;
+
+		for (size_t i = 0; i < spread.size(); i++) {
+			sum += spread[i];
+		}
+		std::sort(spread.begin(), spread.end());
+		printf("sync error us   mean %.1f  p50 %u  p99 %u  max %u\n", sum / spread.size(),
+				spread[spread.size() / 2], spread[spread.size() * 99 / 100], spread.back());
+	}
+
+	return 0;
+}
@@ -0,0 +1,195 @@
+/*
+ * Middleware trace to Chrome trace / Perfetto JSON.
+ *
+ * Reads a serial capture holding a trace_dump() block (trace.hpp), other
+ * lines are skipped, and writes a timeline for chrome://tracing or
+ * ui.perfetto.dev: one track per thread with its running slices from the
+ * context switch events, publish / receive / release as instant events,
+ * and a flow arrow from each publish to the receives of the same message
+ * pointer. The 32 bit cycle timestamps are unwrapped, so the events must
+ * be in order (they are, oldest first).
+ *
+ * Usage: trace_json [capture.log] > trace.json
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <map>
+#include <string>
+
+struct ThreadTrack {
+	unsigned tid;
+	std::string name;
+};
+
+struct Converter {
+	double hz;
+	bool started;
+	uint32_t last;
+	uint64_t time;
+	std::map<unsigned, std::string> topics;
+	std::map<unsigned, ThreadTrack> threads;
+	std::map<uint32_t, unsigned> flows;		/* Message pointer to flow id. */
+	unsigned nflows;
+	unsigned running;						/* Thread id, 0 if not known yet. */
+	uint64_t since;
+	unsigned events;
+	bool comma;
+
+	Converter(double hz) :
+			hz(hz), started(false), last(0), time(0), nflows(0), running(0),
+			since(0), events(0), comma(false) {
+	}
+
+	uint64_t unwrap(uint32_t t) {
+		if (!started) {
+			started = true;
+			last = t;
+		}
+		time += (uint32_t) (t - last);
+		last = t;
+		return time;
+	}
+
+	double us(uint64_t cycles) {
+		return cycles * 1e6 / hz;
+	}
+
+	ThreadTrack & thread(unsigned id) {
+		std::map<unsigned, ThreadTrack>::iterator i = threads.find(id);
+
+		if (i == threads.end()) {
+			ThreadTrack t;
+			char name[16];
+
+			t.tid = threads.size() + 1;
+			snprintf(name, sizeof(name), "%04x", id);
+			t.name = name;
+			i = threads.insert(std::make_pair(id, t)).first;
+		}
+		return i->second;
+	}
+
+	const char * topic(unsigned id) {
+		std::map<unsigned, std::string>::iterator i = topics.find(id);
+
+		return (i != topics.end()) ? i->second.c_str() : "?";
+	}
+
+	void begin(void) {
+		printf("%s\n", comma ? "," : "");
+		comma = true;
+	}
+
+	void slice_end(uint64_t t) {
+		if (running != 0 && t > since) {
+			begin();
+			printf("{\"name\":\"running\",\"cat\":\"sched\",\"ph\":\"X\",\"pid\":1,"
+					"\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}", thread(running).tid,
+					us(since), us(t - since));
+		}
+	}
+
+	void context_switch(uint32_t t, unsigned id, const char * name) {
+		uint64_t now = unwrap(t);
+
+		slice_end(now);
+		thread(id).name = name;
+		running = id;
+		since = now;
+		events++;
+	}
+
+	void event(char type, uint32_t t, unsigned id, unsigned topic_id, uint32_t ptr) {
+		static const char * const names[] = { "publish", "receive", "release", "mark" };
+		static const char types[] = "PRFM";
+		const char * kind = names[strchr(types, type) - types];
+		uint64_t now = unwrap(t);
+		unsigned tid = thread(id).tid;
+
+		begin();
+		printf("{\"name\":\"%s %s\",\"cat\":\"mw\",\"ph\":\"i\",\"s\":\"t\",\"pid\":1,"
+				"\"tid\":%u,\"ts\":%.3f,\"args\":{\"topic\":\"%s\",\"msg\":\"0x%08x\"}}",
+				kind, topic(topic_id), tid, us(now), topic(topic_id), ptr);
+
+		if (type == 'P') {
+			flows[ptr] = ++nflows;
+			begin();
+			printf("{\"name\":\"msg\",\"cat\":\"flow\",\"ph\":\"s\",\"id\":%u,\"pid\":1,"
+					"\"tid\":%u,\"ts\":%.3f}", nflows, tid, us(now));
+		} else if (type == 'R' && flows.count(ptr) != 0) {
+			begin();
+			printf("{\"name\":\"msg\",\"cat\":\"flow\",\"ph\":\"t\",\"id\":%u,\"pid\":1,"
+					"\"tid\":%u,\"ts\":%.3f}", flows[ptr], tid, us(now));
+		}
+		events++;
+	}
+
+	void finish(void) {
+		std::map<unsigned, ThreadTrack>::iterator i;
+
+		slice_end(time);
+		begin();
+		printf("{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"args\":{\"name\":\"r2p\"}}");
+		for (i = threads.begin(); i != threads.end(); ++i) {
+			begin();
+			printf("{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,"
+					"\"args\":{\"name\":\"%s\"}}", i->second.tid, i->second.name.c_str());
+		}
+	}
+};
+
+int main(int argc, char * argv[]) {
+	FILE * in = stdin;
+	Converter * conv = NULL;
+	char line[256], name[128];
+	unsigned hz, written, held, id, thread, topic, ptr, t;
+	char type;
+
+	if (argc > 1 && (in = fopen(argv[1], "r")) == NULL) {
+		perror(argv[1]);
+		return 1;
+	}
+
+	while (fgets(line, sizeof(line), in) != NULL) {
+		line[strcspn(line, "\r\n")] = '\0';
+
+		if (conv == NULL) {
+			if (sscanf(line, "TRACE %u %u %u", &hz, &written, &held) == 3 && hz > 0) {
+				conv = new Converter(hz);
+				printf("{\"displayTimeUnit\":\"ns\",\"traceEvents\":[");
+			}
+			continue;
+		}
+
+		if (strcmp(line, "END") == 0) {
+			break;
+		} else if (sscanf(line, "N %x %127s", &id, name) == 2) {
+			conv->topics[id] = name;
+		} else if (sscanf(line, "S %x %x %127[^\n]", &t, &thread, name) == 3) {
+			conv->context_switch(t, thread, name);
+		} else if (sscanf(line, "%c %x %x %x %x", &type, &t, &thread, &topic, &ptr) == 5
+				&& strchr("PRFM", type) != NULL) {
+			conv->event(type, t, thread, topic, ptr);
+		}
+	}
+
+	if (conv == NULL) {
+		fprintf(stderr, "no TRACE block found\n");
+		return 1;
+	}
+
+	conv->finish();
+	printf("\n]}\n");
+
+	fprintf(stderr, "%u events, %u threads, %.1f us", conv->events,
+			(unsigned) conv->threads.size(), conv->us(conv->time));
+	if (written > held) {
+		fprintf(stderr, " (%u older events overwritten)", written - held);
+	}
+	fprintf(stderr, "\n");
+
+	delete conv;
+	return 0;
+}
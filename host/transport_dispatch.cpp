@@ -0,0 +1,112 @@
+/*
+ * Static Transports<> dispatch vs. a virtual link table on the host: time
+ * per broadcast and code size of each dispatch function (read back from
+ * the binary's own symbol table with nm). Same three counting links as
+ * transport_benchmark() in main_pubsub_benchmark.cpp.
+ *
+ * Usage: transport_dispatch [iterations]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "transports.hpp"
+
+template<int K>
+struct CountLink {
+	static uint32_t bytes;
+
+	static bool send(uint16_t id, const uint8_t * payload, size_t len) {
+		(void) id;
+		(void) payload;
+		bytes += len;
+		return true;
+	}
+};
+
+template<int K>
+uint32_t CountLink<K>::bytes = 0;
+
+typedef Transports<CountLink<0>, CountLink<1>, CountLink<2> > StaticLinks;
+
+static VirtualLinkT<CountLink<0> > vlink0;
+static VirtualLinkT<CountLink<1> > vlink1;
+static VirtualLinkT<CountLink<2> > vlink2;
+VirtualLink * vlinks[] = { &vlink0, &vlink1, &vlink2 };
+
+extern "C" __attribute__((noinline)) unsigned static_dispatch(const uint8_t * msg, size_t len) {
+	return StaticLinks::send(1, msg, len);
+}
+
+extern "C" __attribute__((noinline)) unsigned virtual_dispatch(const uint8_t * msg, size_t len) {
+	return virtual_send(vlinks, 3, 1, msg, len);
+}
+
+extern "C" __attribute__((noinline)) unsigned empty_dispatch(const uint8_t * msg, size_t len) {
+	return Transports<>::send(1, msg, len);
+}
+
+static double now(void) {
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void print_size(const char * exe, const char * symbol) {
+	char cmd[512], line[256];
+	FILE * p;
+
+	snprintf(cmd, sizeof(cmd), "nm -S %s 2>/dev/null", exe);
+	p = popen(cmd, "r");
+	if (p == NULL) {
+		return;
+	}
+	while (fgets(line, sizeof(line), p) != NULL) {
+		char addr[32], size[32], type[4], name[128];
+
+		if (sscanf(line, "%31s %31s %3s %127s", addr, size, type, name) == 4
+				&& strcmp(name, symbol) == 0) {
+			printf("  %-16s %4lu bytes\n", symbol, strtoul(size, NULL, 16));
+		}
+	}
+	pclose(p);
+}
+
+int main(int argc, char * argv[]) {
+	unsigned long n = (argc > 1) ? strtoul(argv[1], NULL, 0) : 100000000UL;
+	uint8_t msg[4] = { 1, 2, 3, 4 };
+	unsigned sent = 0;
+	double t0, ts, tv;
+	char exe[256];
+	ssize_t len;
+
+	t0 = now();
+	for (unsigned long i = 0; i < n; i++) {
+		sent += static_dispatch(msg, sizeof(msg));
+	}
+	ts = now() - t0;
+
+	t0 = now();
+	for (unsigned long i = 0; i < n; i++) {
+		sent += virtual_dispatch(msg, sizeof(msg));
+	}
+	tv = now() - t0;
+
+	printf("3 links, %lu broadcasts: static %.2f ns, virtual %.2f ns per broadcast (%u)\n",
+			n, ts * 1e9 / n, tv * 1e9 / n, sent);
+	/* nm must get the real path: /proc/self would be nm itself. */
+	len = readlink("/proc/self/exe", exe, sizeof(exe) - 1);
+	if (len > 0) {
+		exe[len] = '\0';
+		printf("code size:\n");
+		print_size(exe, "static_dispatch");
+		print_size(exe, "virtual_dispatch");
+		print_size(exe, "empty_dispatch");
+	}
+
+	return 0;
+}
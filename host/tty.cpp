@@ -0,0 +1,69 @@
+#include <stdlib.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <termios.h>
+
+#include "tty.hpp"
+
+static speed_t baud_constant(unsigned baud) {
+
+	switch (baud) {
+	case 9600: return B9600;
+	case 19200: return B19200;
+	case 38400: return B38400;
+	case 57600: return B57600;
+	case 115200: return B115200;
+	case 230400: return B230400;
+	case 460800: return B460800;
+	case 921600: return B921600;
+	default: return 0;
+	}
+}
+
+/*
+ * 8N1, no line discipline processing, non blocking reads (use select).
+ */
+bool tty_raw(int fd, unsigned baud) {
+	struct termios tio;
+	speed_t speed = baud_constant(baud);
+
+	if (tcgetattr(fd, &tio) < 0) {
+		return false;
+	}
+	cfmakeraw(&tio);
+	if (speed != 0) {
+		cfsetispeed(&tio, speed);
+		cfsetospeed(&tio, speed);
+	}
+	tio.c_cc[VMIN] = 0;
+	tio.c_cc[VTIME] = 0;
+
+	return tcsetattr(fd, TCSANOW, &tio) == 0;
+}
+
+int tty_open(const char * device, unsigned baud) {
+	int fd = open(device, O_RDWR | O_NOCTTY);
+
+	if (fd >= 0 && !tty_raw(fd, baud)) {
+		close(fd);
+		return -1;
+	}
+
+	return fd;
+}
+
+/*
+ * Pseudo terminal pair standing in for a board: the master end plays the
+ * firmware, the slave end is what a tool would open as the tty.
+ */
+bool pty_pair(int * master, int * slave) {
+
+	*master = posix_openpt(O_RDWR | O_NOCTTY);
+	if (*master < 0 || grantpt(*master) < 0 || unlockpt(*master) < 0) {
+		return false;
+	}
+
+	*slave = open(ptsname(*master), O_RDWR | O_NOCTTY);
+
+	return *slave >= 0 && tty_raw(*slave, 0) && tty_raw(*master, 0);
+}
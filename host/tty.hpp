@@ -0,0 +1,12 @@
+#ifndef TTY_HPP_
+#define TTY_HPP_
+
+/*
+ * Raw tty helpers for the host serial tools.
+ */
+
+bool tty_raw(int fd, unsigned baud);
+int tty_open(const char * device, unsigned baud);
+bool pty_pair(int * master, int * slave);
+
+#endif /* TTY_HPP_ */
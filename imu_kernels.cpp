@@ -0,0 +1,139 @@
+#include "imu_kernels.hpp"
+
+/*===========================================================================*/
+/* Calibration.                                                              */
+/*===========================================================================*/
+
+void calib_identity(CalibQ30 * c) {
+
+	for (int i = 0; i < 3; i++) {
+		c->bias[i] = 0;
+		for (int j = 0; j < 3; j++) {
+			c->m[i][j] = (i == j) ? Q30(1.0f) : 0;
+		}
+	}
+}
+
+void calib_apply(const CalibQ30 * c, const int16_t in[3], int16_t out[3]) {
+	int32_t x[3];
+	int64_t acc;
+
+	x[0] = (int32_t) in[0] - c->bias[0];
+	x[1] = (int32_t) in[1] - c->bias[1];
+	x[2] = (int32_t) in[2] - c->bias[2];
+
+	for (int i = 0; i < 3; i++) {
+		acc = (int64_t) c->m[i][0] * x[0] + (int64_t) c->m[i][1] * x[1]
+				+ (int64_t) c->m[i][2] * x[2];
+		out[i] = sat16((int32_t) (acc >> 30));
+	}
+}
+
+void calib_apply_block(const CalibQ30 * c, const int16_t * const in[3],
+		int16_t * const out[3], uint32_t n) {
+	int16_t s[3], d[3];
+
+	for (uint32_t k = 0; k < n; k++) {
+		s[0] = in[0][k];
+		s[1] = in[1][k];
+		s[2] = in[2][k];
+		calib_apply(c, s, d);
+		out[0][k] = d[0];
+		out[1][k] = d[1];
+		out[2][k] = d[2];
+	}
+}
+
+void bias_remove_block(const int16_t * in, int16_t bias, int16_t * out,
+		uint32_t n) {
+
+	for (uint32_t k = 0; k < n; k++) {
+		out[k] = sat16((int32_t) in[k] - bias);
+	}
+}
+
+/*===========================================================================*/
+/* FIR.                                                                      */
+/*===========================================================================*/
+
+FirQ31::FirQ31(const q31_t * taps, uint16_t ntaps) :
+		_taps(taps), _ntaps(ntaps > FIR_MAX_TAPS ? FIR_MAX_TAPS : ntaps) {
+
+	reset();
+}
+
+void FirQ31::reset(void) {
+
+	_head = 0;
+	for (int i = 0; i < FIR_MAX_TAPS; i++) {
+		_history[i] = 0;
+	}
+}
+
+int16_t FirQ31::filter(int16_t x) {
+	int64_t acc = 0;
+	uint16_t idx;
+
+	_history[_head] = x;
+
+	/* taps[0] on the newest sample, walking backwards in time. */
+	idx = _head;
+	for (uint16_t k = 0; k < _ntaps; k++) {
+		acc += (int64_t) _taps[k] * _history[idx];
+		idx = (idx == 0) ? _ntaps - 1 : idx - 1;
+	}
+
+	if (++_head >= _ntaps) {
+		_head = 0;
+	}
+
+	return sat16((int32_t) (acc >> 31));
+}
+
+void fir_q31_block(const q31_t * taps, uint16_t ntaps, const int16_t * in,
+		int16_t * out, uint32_t n) {
+	int64_t acc;
+
+	for (uint32_t i = 0; i < n; i++) {
+		acc = 0;
+		for (uint16_t k = 0; k < ntaps; k++) {
+			acc += (int64_t) taps[k] * in[(int32_t) i - k];
+		}
+		out[i] = sat16((int32_t) (acc >> 31));
+	}
+}
+
+/*===========================================================================*/
+/* Quaternion integration.                                                   */
+/*===========================================================================*/
+
+void gyro_half_angle(const int16_t gyro[3], q31_t scale, q31_t half_dt,
+		q31_t out[3]) {
+
+	for (int i = 0; i < 3; i++) {
+		/* raw * Q31 >> 7 = rad/s in Q24, Q24 * Q31 >> 25 = Q30. */
+		out[i] = fx_mul(fx_mul(gyro[i], scale, 7), half_dt, 25);
+	}
+}
+
+void quat_integrate_q30(q31_t q[4], const q31_t w[3]) {
+	q31_t q0 = q[0], q1 = q[1], q2 = q[2], q3 = q[3];
+	int32_t n2;
+	int64_t inv;
+
+	q[0] = q0 + (-q30_mul(q1, w[0]) - q30_mul(q2, w[1]) - q30_mul(q3, w[2]));
+	q[1] = q1 + (q30_mul(q0, w[0]) + q30_mul(q2, w[2]) - q30_mul(q3, w[1]));
+	q[2] = q2 + (q30_mul(q0, w[1]) - q30_mul(q1, w[2]) + q30_mul(q3, w[0]));
+	q[3] = q3 + (q30_mul(q0, w[2]) + q30_mul(q1, w[1]) - q30_mul(q2, w[0]));
+
+	/*
+	 * The quaternion stays close to unit length, one Newton step of
+	 * 1/sqrt(n2) around 1, (3 - n2) / 2, is enough and needs no division.
+	 */
+	n2 = q30_mul(q[0], q[0]) + q30_mul(q[1], q[1]) + q30_mul(q[2], q[2])
+			+ q30_mul(q[3], q[3]);
+	inv = ((3LL << 30) - n2) >> 1;
+	for (int i = 0; i < 4; i++) {
+		q[i] = (q31_t) ((q[i] * inv) >> 30);
+	}
+}
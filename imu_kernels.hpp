@@ -0,0 +1,78 @@
+#ifndef IMU_KERNELS_HPP_
+#define IMU_KERNELS_HPP_
+
+#include <stdint.h>
+
+#include "fixmath.hpp"
+
+/*
+ * IMU signal kernels, fixed point reference implementation.
+ *
+ * These are the kernels the firmware runs; host/imu_kernels_simd.cpp has
+ * vectorized versions of the block functions which must give bit-identical
+ * results. All rounding is floor (arithmetic shift), all narrowing to
+ * int16_t saturates.
+ */
+
+static inline int16_t sat16(int32_t x) {
+	if (x > INT16_MAX) {
+		return INT16_MAX;
+	}
+	if (x < INT16_MIN) {
+		return INT16_MIN;
+	}
+	return (int16_t) x;
+}
+
+/*
+ * Calibration: out = M * (in - bias), M in Q30.
+ */
+struct CalibQ30 {
+	int16_t bias[3];
+	q31_t m[3][3];
+};
+
+void calib_identity(CalibQ30 * c);
+void calib_apply(const CalibQ30 * c, const int16_t in[3], int16_t out[3]);
+
+/*
+ * FIR low-pass, Q31 taps on int16_t samples, 64 bit accumulator.
+ */
+#define FIR_MAX_TAPS	32
+
+class FirQ31 {
+public:
+	FirQ31(const q31_t * taps, uint16_t ntaps);
+
+	int16_t filter(int16_t x);
+	void reset(void);
+
+private:
+	const q31_t * _taps;
+	uint16_t _ntaps;
+	uint16_t _head;
+	int16_t _history[FIR_MAX_TAPS];
+};
+
+/*
+ * Quaternion integration.
+ * gyro_half_angle() turns raw gyro LSBs into w * dt / 2 in Q30, the same
+ * conversion MahonyQ31 uses; quat_integrate_q30() applies it to q (Q30)
+ * and renormalizes.
+ */
+void gyro_half_angle(const int16_t gyro[3], q31_t scale, q31_t half_dt,
+		q31_t out[3]);
+void quat_integrate_q30(q31_t q[4], const q31_t half_angle[3]);
+
+/*
+ * Block versions, structure of arrays. n samples per axis.
+ * fir_q31_block() reads ntaps - 1 samples of history before in[0].
+ */
+void bias_remove_block(const int16_t * in, int16_t bias, int16_t * out,
+		uint32_t n);
+void calib_apply_block(const CalibQ30 * c, const int16_t * const in[3],
+		int16_t * const out[3], uint32_t n);
+void fir_q31_block(const q31_t * taps, uint16_t ntaps, const int16_t * in,
+		int16_t * out, uint32_t n);
+
+#endif /* IMU_KERNELS_HPP_ */
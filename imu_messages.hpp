@@ -0,0 +1,61 @@
+#ifndef IMU_MESSAGES_HPP_
+#define IMU_MESSAGES_HPP_
+
+#include "Middleware.hpp"
+#include "delta_codec.hpp"
+
+/*
+ * IMU topic messages.
+ * Timestamps are halGetCounterValue() ticks (DWT cycle counter, STM32_HCLK).
+ */
+
+#define IMU_GYRO_VALID		(1 << 0)
+#define IMU_ACC_VALID		(1 << 1)
+#define IMU_MAG_VALID		(1 << 2)
+#define IMU_GPS_VALID		(1 << 3)
+
+struct ImuSample: public BaseMessage {
+	uint32_t timestamp;
+	int16_t gyro[3];
+	int16_t acc[3];
+	int16_t mag[3];
+	int32_t gps[3];
+	uint8_t valid;
+}__attribute__((packed));
+
+/* ImuSample payload fields, for delta encoded remote links. */
+#define IMU_SAMPLE_FIELDS	14
+
+static const uint8_t imu_sample_layout[IMU_SAMPLE_FIELDS] = {
+	4 | DELTA_ORDER2,	/* timestamp */
+	2, 2, 2,			/* gyro */
+	2, 2, 2,			/* acc */
+	2, 2, 2,			/* mag */
+	4, 4, 4,			/* gps */
+	1					/* valid */
+};
+
+/*
+ * Attitude quaternion (w, x, y, z) in Q30, body to earth.
+ */
+struct AttitudeData: public BaseMessage {
+	uint32_t timestamp;
+	int32_t q[4];
+}__attribute__((packed));
+
+/*
+ * Calibration coefficients of one sensor: out = m * (in - bias), m in Q30.
+ */
+#define CALIB_GYRO			0
+#define CALIB_ACC			1
+#define CALIB_MAG			2
+#define CALIB_SENSORS		3
+
+struct CalibData: public BaseMessage {
+	uint8_t sensor;
+	int16_t bias[3];
+	int32_t m[3][3];
+	uint16_t radius;	/* Fitted field magnitude [LSB], magnetometer only. */
+}__attribute__((packed));
+
+#endif /* IMU_MESSAGES_HPP_ */
@@ -0,0 +1,125 @@
+#include "imu_sync.hpp"
+#include "periodic.hpp"
+
+#define US2CNT(us) ((uint32_t) (us) * (halGetCounterFrequency() / 1000000))
+
+ImuSync::ImuSync(const ImuSyncConfig * config) :
+		_config(config), _gyro(config->mode[IMU_GYRO]), _acc(config->mode[IMU_ACC]),
+		_mag(config->mode[IMU_MAG]), _gps(SYNC_NEAREST), _samples(0),
+		_dropped(0), _cycles_sum(0), _cycles_max(0), _start(0) {
+	_rings[IMU_GYRO] = &_gyro;
+	_rings[IMU_ACC] = &_acc;
+	_rings[IMU_MAG] = &_mag;
+	_rings[IMU_GPS] = &_gps;
+}
+
+void ImuSync::push(ImuSensor sensor, uint32_t t, int32_t x, int32_t y,
+		int32_t z) {
+
+	chSysLock();
+	_rings[sensor]->push(t, x, y, z);
+	chSysUnlock();
+}
+
+bool ImuSync::assemble(uint32_t t, ImuSample * msg) {
+	uint32_t max_age[IMU_SENSORS];
+	int32_t v[IMU_SENSORS][3];
+	uint8_t valid = 0;
+
+	for (int s = 0; s < IMU_SENSORS; s++) {
+		max_age[s] = US2CNT(_config->max_age_us[s]);
+	}
+
+	chSysLock();
+	for (int s = 0; s < IMU_SENSORS; s++) {
+		if (_rings[s]->sample(t, max_age[s], v[s])) {
+			valid |= (1 << s);
+		}
+	}
+	chSysUnlock();
+
+	msg->timestamp = t;
+	msg->valid = valid;
+	for (int k = 0; k < 3; k++) {
+		/* Interpolating between two int16_t values cannot overflow them. */
+		msg->gyro[k] = (int16_t) v[IMU_GYRO][k];
+		msg->acc[k] = (int16_t) v[IMU_ACC][k];
+		msg->mag[k] = (int16_t) v[IMU_MAG][k];
+		msg->gps[k] = v[IMU_GPS][k];
+	}
+
+	return (valid != 0);
+}
+
+void ImuSync::stats(ImuSyncStats * stats) {
+
+	chSysLock();
+	stats->samples = _samples;
+	stats->dropped = _dropped;
+	stats->cycles_sum = _cycles_sum;
+	stats->cycles_max = _cycles_max;
+	stats->elapsed = halGetCounterValue() - _start;
+	for (int s = 0; s < IMU_SENSORS; s++) {
+		stats->overruns[s] = _rings[s]->overruns();
+	}
+	chSysUnlock();
+}
+
+void ImuSync::resetStats(void) {
+
+	chSysLock();
+	_samples = 0;
+	_dropped = 0;
+	_cycles_sum = 0;
+	_cycles_max = 0;
+	_start = halGetCounterValue();
+	chSysUnlock();
+}
+
+/*
+ * Assembler thread, arg is the ImuSync instance.
+ */
+msg_t ImuSync::thread(void * arg) {
+	ImuSync * sync = (ImuSync *) arg;
+	Middleware & mw = Middleware::instance();
+	Node n("imusync");
+	Publisher<ImuSample> pub(sync->_config->topic);
+	PeriodicTask task("imu sync", S2ST(1) / sync->_config->rate, PERIODIC_SKIP);
+	ImuSample * msg;
+	uint32_t delay = US2CNT(sync->_config->delay_us);
+	uint32_t start, cycles;
+
+	chRegSetThreadName("IMU SYNC");
+
+	mw.newNode(&n);
+	n.advertise(&pub);
+
+	sync->resetStats();
+
+	while (task.next()) {
+		start = halGetCounterValue();
+		msg = pub.alloc();
+		if (msg != NULL) {
+			sync->assemble(start - delay, msg);
+			pub.broadcast(msg);
+		}
+		cycles = halGetCounterValue() - start;
+
+		chSysLock();
+		if (msg != NULL) {
+			sync->_samples++;
+		} else {
+			sync->_dropped++;
+		}
+		sync->_cycles_sum += cycles;
+		if (cycles > sync->_cycles_max) {
+			sync->_cycles_max = cycles;
+		}
+		chSysUnlock();
+	}
+
+	mw.delNode(&n);
+	chThdExit(RDY_OK);
+
+	return 0;
+}
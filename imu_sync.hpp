@@ -0,0 +1,70 @@
+#ifndef IMU_SYNC_HPP_
+#define IMU_SYNC_HPP_
+
+#include "ch.h"
+#include "hal.h"
+
+#include "Middleware.hpp"
+#include "imu_messages.hpp"
+#include "sensor_sync.hpp"
+
+/*
+ * IMU fusion-input stage.
+ *
+ * Sensor readers push samples stamped with the data-ready interrupt time;
+ * a periodic thread aligns them at a common instant and publishes one
+ * ImuSample per period on a single topic.
+ */
+
+enum ImuSensor {
+	IMU_GYRO = 0,
+	IMU_ACC,
+	IMU_MAG,
+	IMU_GPS,
+	IMU_SENSORS
+};
+
+struct ImuSyncConfig {
+	const char * topic;
+	uint32_t rate;			/* Output rate [Hz], must divide CH_FREQUENCY. */
+	uint32_t delay_us;		/* Output lag, lets linear mode see the sample after t. */
+	uint32_t max_age_us[IMU_SENSORS];	/* Older samples are not valid. */
+	SyncMode mode[IMU_SENSORS];
+};
+
+struct ImuSyncStats {
+	uint32_t samples;
+	uint32_t dropped;		/* alloc() failures */
+	uint32_t cycles_sum;
+	uint32_t cycles_max;
+	uint32_t elapsed;		/* Counter ticks since the first output. */
+	uint32_t overruns[IMU_SENSORS];
+};
+
+class ImuSync {
+public:
+	ImuSync(const ImuSyncConfig * config);
+
+	/* Thread or ISR-latched timestamp, called from the reader threads. */
+	void push(ImuSensor sensor, uint32_t t, int32_t x, int32_t y, int32_t z);
+	bool assemble(uint32_t t, ImuSample * msg);
+	void stats(ImuSyncStats * stats);
+	void resetStats(void);
+
+	static msg_t thread(void * arg);
+
+private:
+	const ImuSyncConfig * _config;
+	SensorRingN<8> _gyro;
+	SensorRingN<4> _acc;
+	SensorRingN<4> _mag;
+	SensorRingN<2> _gps;
+	SensorRing * _rings[IMU_SENSORS];
+	uint32_t _samples;
+	uint32_t _dropped;
+	uint32_t _cycles_sum;
+	uint32_t _cycles_max;
+	uint32_t _start;
+};
+
+#endif /* IMU_SYNC_HPP_ */
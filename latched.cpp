@@ -0,0 +1,27 @@
+#include <string.h>
+
+#include "latched.hpp"
+
+void LatchedBase::publish(const uint8_t * payload) {
+	uint32_t seq = _seq;
+
+	memcpy(&_slots[((seq + 1) & 1) * _size], payload, _size);
+	__sync_synchronize();
+	_seq = seq + 1;
+}
+
+uint32_t LatchedBase::read(uint8_t * payload) const {
+	uint32_t seq;
+
+	do {
+		seq = _seq;
+		if (seq == 0) {
+			return 0;
+		}
+		__sync_synchronize();
+		memcpy(payload, &_slots[(seq & 1) * _size], _size);
+		__sync_synchronize();
+	} while (seq != _seq);
+
+	return seq;
+}
@@ -0,0 +1,151 @@
+#ifndef LATCHED_HPP_
+#define LATCHED_HPP_
+
+#include <string.h>
+
+#include "ch.h"
+
+#include "Middleware.hpp"
+#include "payload.hpp"
+
+/*
+ * Latest-value ("latched") topic.
+ *
+ * Holds the last published message in two slots and a sequence counter.
+ * The writer fills the slot readers are not looking at, then bumps the
+ * sequence; readers copy the current slot and retry if the sequence moved
+ * under them. Reads take no kernel lock and no pool buffer, never wait
+ * for a preempted writer, and late readers get the last value at once.
+ *
+ * One writer at a time (a thread or an ISR); any number of readers.
+ */
+
+/*
+ * Payloads up to this size are copied inline with a fixed-size copy, larger
+ * ones go through the shared out-of-line code.
+ */
+#define LATCHED_INLINE_SIZE	16
+
+/*
+ * Type independent part, on payload bytes: one copy of the code for every
+ * Latched<T>.
+ */
+class LatchedBase {
+public:
+	void publish(const uint8_t * payload);
+
+	/*
+	 * Copies the latest value and returns its sequence number, 0 if nothing
+	 * was published yet. A reader that keeps the number of the value it
+	 * has tells a newer one apart.
+	 */
+	uint32_t read(uint8_t * payload) const;
+
+	uint32_t sequence(void) const {
+		return _seq;
+	}
+
+protected:
+	/* slots: two payloads of size bytes. */
+	LatchedBase(uint8_t * slots, size_t size) :
+			_slots(slots), _size(size), _seq(0) {
+	}
+
+	/* As publish() and read(), for payloads of SIZE bytes. */
+	template<size_t SIZE>
+	void publishFixed(const uint8_t * payload) {
+		uint32_t seq = _seq;
+
+		memcpy(&_slots[((seq + 1) & 1) * SIZE], payload, SIZE);
+		__sync_synchronize();
+		_seq = seq + 1;
+	}
+
+	template<size_t SIZE>
+	uint32_t readFixed(uint8_t * payload) const {
+		uint32_t seq;
+
+		do {
+			seq = _seq;
+			if (seq == 0) {
+				return 0;
+			}
+			__sync_synchronize();
+			memcpy(payload, &_slots[(seq & 1) * SIZE], SIZE);
+			__sync_synchronize();
+		} while (seq != _seq);
+
+		return seq;
+	}
+
+private:
+	uint8_t * _slots;
+	size_t _size;
+	volatile uint32_t _seq;
+};
+
+template<typename T>
+class Latched: public LatchedBase {
+public:
+	Latched(const char * topic = NULL) :
+			LatchedBase(&_value[0][0], SIZE), _topic(topic) {
+	}
+
+	void publish(const T * msg) {
+		if (SIZE <= LATCHED_INLINE_SIZE) {
+			publishFixed<SIZE>(payload(msg));
+		} else {
+			LatchedBase::publish(payload(msg));
+		}
+	}
+
+	uint32_t read(T * msg) const {
+		if (SIZE <= LATCHED_INLINE_SIZE) {
+			return readFixed<SIZE>(payload(msg));
+		}
+		return LatchedBase::read(payload(msg));
+	}
+
+	static msg_t thread(void * arg);
+
+private:
+	enum {
+		SIZE = sizeof(T) - sizeof(BaseMessage)
+	};
+
+	const char * _topic;
+	uint8_t _value[2][SIZE];
+};
+
+/*
+ * Latching thread, arg is the Latched instance: mirrors an existing topic
+ * for publishers that are not latch-aware. Costs a single mailbox slot.
+ */
+template<typename T>
+msg_t Latched<T>::thread(void * arg) {
+	Latched<T> * latch = (Latched<T> *) arg;
+	Middleware & mw = Middleware::instance();
+	Node n("latch");
+	Subscriber<T, 1> sub(latch->_topic);
+	T *d;
+
+	chRegSetThreadName("LATCH");
+
+	mw.newNode(&n);
+	n.subscribe(&sub);
+
+	while (!chThdShouldTerminate()) {
+		n.spin();
+		while ((d = sub.get()) != NULL) {
+			latch->publish(d);
+			sub.release(d);
+		}
+	}
+
+	mw.delNode(&n);
+	chThdExit(RDY_OK);
+
+	return 0;
+}
+
+#endif /* LATCHED_HPP_ */
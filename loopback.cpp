@@ -0,0 +1,181 @@
+#include "loopback.hpp"
+
+LoopbackTransport::LoopbackTransport(void) :
+		_rx_topics(NULL), _head(0), _tail(0), _count(0), _delay(0), _loss(0),
+		_seed(0x12345678) {
+
+	chSemInit(&_frames, 0);
+	chMtxInit(&_lock);
+	resetStats();
+}
+
+void LoopbackTransport::add(SerialTopicRx * topic) {
+
+	topic->next = _rx_topics;
+	_rx_topics = topic;
+}
+
+void LoopbackTransport::setDelay(systime_t delay) {
+
+	_delay = delay;
+}
+
+void LoopbackTransport::setLoss(uint16_t permille) {
+
+	_loss = permille;
+}
+
+void LoopbackTransport::stats(LoopbackStats * stats) {
+
+	chSysLock();
+	*stats = _stats;
+	chSysUnlock();
+}
+
+void LoopbackTransport::resetStats(void) {
+
+	chSysLock();
+	_stats.sent = 0;
+	_stats.delivered = 0;
+	_stats.lost = 0;
+	_stats.full = 0;
+	_stats.unknown = 0;
+	_stats.dropped = 0;
+	chSysUnlock();
+}
+
+/*
+ * Injected loss, LCG draw against the configured rate. Called locked.
+ */
+bool LoopbackTransport::lose(void) {
+
+	if (_loss == 0) {
+		return false;
+	}
+	_seed = _seed * 1664525 + 1013904223;
+
+	return ((_seed >> 16) % 1000) < _loss;
+}
+
+/*
+ * Frames the payload into the queue, from any thread. Senders are
+ * serialized so frames are queued in the order they are signalled.
+ */
+bool LoopbackTransport::send(uint16_t id, const uint8_t * payload,
+		size_t len) {
+	Frame * f;
+	bool ok = false;
+
+	if (len > LOOPBACK_MAX_PAYLOAD) {
+		return false;
+	}
+
+	chMtxLock(&_lock);
+
+	chSysLock();
+	_stats.sent++;
+	if (lose()) {
+		_stats.lost++;
+		ok = true;
+	} else if (_count >= LOOPBACK_QUEUE) {
+		_stats.full++;
+	} else {
+		f = &_queue[_head];
+		chSysUnlock();
+
+		f->due = chTimeNow() + _delay;
+		f->len = frame_encode(id, payload, len, f->data);
+
+		chSysLock();
+		_head = (_head + 1) % LOOPBACK_QUEUE;
+		_count++;
+		chSemSignalI(&_frames);
+		chSchRescheduleS();
+		ok = true;
+	}
+	chSysUnlock();
+
+	chMtxUnlock();
+
+	return ok;
+}
+
+void LoopbackTransport::loop(void) {
+	Middleware & mw = Middleware::instance();
+	Node n("loopback");
+	SerialTopicRx * topic;
+	Frame * f;
+
+	mw.newNode(&n);
+	for (topic = _rx_topics; topic != NULL; topic = topic->next) {
+		topic->advertise(&n);
+	}
+
+	while (!chThdShouldTerminate()) {
+		if (chSemWaitTimeout(&_frames, MS2ST(100)) != RDY_OK) {
+			continue;
+		}
+
+		f = &_queue[_tail];
+		chSysLock();
+		if ((int32_t) (f->due - chTimeNow()) > 0) {
+			chThdSleepS(f->due - chTimeNow());
+		}
+		chSysUnlock();
+
+		for (uint8_t i = 0; i < f->len; i++) {
+			if (!_decoder.push(f->data[i])) {
+				continue;
+			}
+
+			FrameReader reader(_decoder.topic(), _decoder.payload(),
+					_decoder.length());
+
+			while (reader.next()) {
+				dispatch(reader.topic(), reader.payload(), reader.length());
+			}
+			if (reader.malformed()) {
+				_stats.unknown++;
+			}
+		}
+
+		chSysLock();
+		_tail = (_tail + 1) % LOOPBACK_QUEUE;
+		_count--;
+		chSysUnlock();
+	}
+
+	mw.delNode(&n);
+}
+
+void LoopbackTransport::dispatch(uint16_t id, const uint8_t * payload,
+		size_t len) {
+	SerialTopicRx * topic;
+
+	for (topic = _rx_topics; topic != NULL; topic = topic->next) {
+		if (topic->id == id) {
+			break;
+		}
+	}
+
+	if (topic == NULL || !topic->accepts(len)) {
+		_stats.unknown++;
+	} else if (topic->publish(payload, len)) {
+		_stats.delivered++;
+	} else {
+		_stats.dropped++;
+	}
+}
+
+/*
+ * Loopback thread, arg is the LoopbackTransport instance.
+ */
+msg_t LoopbackTransport::thread(void * arg) {
+	LoopbackTransport * l = (LoopbackTransport *) arg;
+
+	chRegSetThreadName("LOOPBACK");
+	l->loop();
+	chThdExit(RDY_OK);
+
+	return 0;
+}
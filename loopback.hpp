@@ -0,0 +1,82 @@
+#ifndef LOOPBACK_HPP_
+#define LOOPBACK_HPP_
+
+#include "ch.h"
+
+#include "serial_frame.hpp"
+#include "serial_topics.hpp"
+
+/*
+ * In-process loopback transport.
+ *
+ * send() frames the payload exactly as the serial transport would (topic
+ * id mapping, COBS, CRC) into a frame queue; the loopback thread decodes
+ * the frames and republishes them through SerialPublisher<T> topics, so
+ * the whole remote path runs without a bus attached. Frames can be held
+ * back by a fixed delay and dropped with a given probability.
+ */
+
+#define LOOPBACK_QUEUE			16
+#define LOOPBACK_MAX_PAYLOAD	64
+
+struct LoopbackStats {
+	uint32_t sent;
+	uint32_t delivered;
+	uint32_t lost;		/* Injected loss. */
+	uint32_t full;		/* Queue full. */
+	uint32_t unknown;	/* No local topic for the id, or size mismatch. */
+	uint32_t dropped;	/* No buffer to republish. */
+};
+
+class LoopbackTransport {
+public:
+	LoopbackTransport(void);
+
+	/* Topics must be added before the thread starts. */
+	void add(SerialTopicRx * topic);
+
+	void setDelay(systime_t delay);
+	void setLoss(uint16_t permille);
+
+	bool send(uint16_t id, const uint8_t * payload, size_t len);
+	void stats(LoopbackStats * stats);
+	void resetStats(void);
+
+	void loop(void);
+	static msg_t thread(void * arg);
+
+private:
+	struct Frame {
+		systime_t due;
+		uint8_t len;
+		uint8_t data[SERIAL_FRAME_SIZE(LOOPBACK_MAX_PAYLOAD)];
+	};
+
+	bool lose(void);
+	void dispatch(uint16_t id, const uint8_t * payload, size_t len);
+
+	SerialTopicRx * _rx_topics;
+	Frame _queue[LOOPBACK_QUEUE];
+	uint8_t _head;
+	uint8_t _tail;
+	uint8_t _count;
+	Semaphore _frames;
+	Mutex _lock;
+	systime_t _delay;
+	uint16_t _loss;
+	uint32_t _seed;
+	FrameDecoder _decoder;
+	LoopbackStats _stats;
+};
+
+/*
+ * Transports<> adapter for a LoopbackTransport instance.
+ */
+template<LoopbackTransport & L>
+struct LoopbackLink {
+	static bool send(uint16_t id, const uint8_t * payload, size_t len) {
+		return L.send(id, payload, len);
+	}
+};
+
+#endif /* LOOPBACK_HPP_ */
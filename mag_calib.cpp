@@ -0,0 +1,103 @@
+#include <math.h>
+
+#include "mag_calib.hpp"
+
+/* Inputs are scaled to about unit range to keep P well conditioned. */
+#define MAG_CALIB_NORM		1024.0f
+#define MAG_CALIB_P0		100.0f
+
+MagCalib::MagCalib(float lambda, uint32_t min_samples) :
+		_lambda(lambda), _min_samples(min_samples) {
+
+	reset();
+}
+
+void MagCalib::reset(void) {
+
+	for (int i = 0; i < MAG_CALIB_PARAMS; i++) {
+		_theta[i] = 0.0f;
+		for (int j = 0; j < MAG_CALIB_PARAMS; j++) {
+			_p[i][j] = (i == j) ? MAG_CALIB_P0 : 0.0f;
+		}
+	}
+	_samples = 0;
+}
+
+void MagCalib::update(int16_t x, int16_t y, int16_t z) {
+	float xn = x / MAG_CALIB_NORM;
+	float yn = y / MAG_CALIB_NORM;
+	float zn = z / MAG_CALIB_NORM;
+	float phi[MAG_CALIB_PARAMS] = { xn * xn, yn * yn, zn * zn, xn, yn, zn };
+	float pphi[MAG_CALIB_PARAMS];
+	float k[MAG_CALIB_PARAMS];
+	float den = _lambda;
+	float err = 1.0f;
+	int i, j;
+
+	/* P is symmetric: P phi is also phi' P. */
+	for (i = 0; i < MAG_CALIB_PARAMS; i++) {
+		pphi[i] = 0.0f;
+		for (j = 0; j < MAG_CALIB_PARAMS; j++) {
+			pphi[i] += _p[i][j] * phi[j];
+		}
+		den += phi[i] * pphi[i];
+		err -= phi[i] * _theta[i];
+	}
+
+	for (i = 0; i < MAG_CALIB_PARAMS; i++) {
+		k[i] = pphi[i] / den;
+		_theta[i] += k[i] * err;
+	}
+
+	for (i = 0; i < MAG_CALIB_PARAMS; i++) {
+		for (j = i; j < MAG_CALIB_PARAMS; j++) {
+			_p[i][j] = (_p[i][j] - k[i] * pphi[j]) / _lambda;
+			_p[j][i] = _p[i][j];
+		}
+	}
+
+	_samples++;
+}
+
+/*
+ * Current fit as a calibration, false until it is a proper ellipsoid.
+ * radius is the mean field magnitude after calibration, in raw LSB.
+ */
+bool MagCalib::solve(CalibQ30 * calib, float * radius) const {
+	float c[3], r[3], g = 1.0f, mean = 0.0f;
+
+	if (_samples < _min_samples) {
+		return false;
+	}
+
+	for (int i = 0; i < 3; i++) {
+		if (_theta[i] <= 0.0f) {
+			return false;
+		}
+		c[i] = -_theta[3 + i] / (2.0f * _theta[i]);
+		g += _theta[i] * c[i] * c[i];
+	}
+
+	for (int i = 0; i < 3; i++) {
+		r[i] = sqrtf(g / _theta[i]);
+		mean += r[i] / 3.0f;
+	}
+
+	for (int i = 0; i < 3; i++) {
+		float s = mean / r[i];
+
+		/* Anything beyond 2:1 is a bad fit, not a soft iron effect. */
+		if (s < 0.5f || s > 2.0f) {
+			return false;
+		}
+
+		calib->bias[i] = (int16_t) lrintf(c[i] * MAG_CALIB_NORM);
+		for (int j = 0; j < 3; j++) {
+			calib->m[i][j] = (i == j) ? Q30(s) : 0;
+		}
+	}
+
+	*radius = mean * MAG_CALIB_NORM;
+
+	return true;
+}
@@ -0,0 +1,43 @@
+#ifndef MAG_CALIB_HPP_
+#define MAG_CALIB_HPP_
+
+#include <stdint.h>
+
+#include "imu_kernels.hpp"
+
+/*
+ * Incremental magnetometer hard/soft-iron estimator.
+ *
+ * Fits the axis-aligned ellipsoid
+ *   A x^2 + B y^2 + C z^2 + D x + E y + F z = 1
+ * with recursive least squares and a forgetting factor: one 6x6 update
+ * per sample, no sample history. Hard iron is the ellipsoid center, soft
+ * iron the per-axis scale back to a sphere of the mean radius.
+ *
+ * Runs in float at a decimated rate; the result is exported as a CalibQ30
+ * for the fixed point per-sample path.
+ */
+
+#define MAG_CALIB_PARAMS	6
+
+class MagCalib {
+public:
+	MagCalib(float lambda, uint32_t min_samples);
+
+	void reset(void);
+	void update(int16_t x, int16_t y, int16_t z);
+	bool solve(CalibQ30 * calib, float * radius) const;
+
+	uint32_t samples(void) const {
+		return _samples;
+	}
+
+private:
+	float _theta[MAG_CALIB_PARAMS];
+	float _p[MAG_CALIB_PARAMS][MAG_CALIB_PARAMS];
+	float _lambda;
+	uint32_t _min_samples;
+	uint32_t _samples;
+};
+
+#endif /* MAG_CALIB_HPP_ */
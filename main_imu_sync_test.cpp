@@ -0,0 +1,640 @@
+/*
+ ChibiOS/RT - Copyright (C) 2006,2007,2008,2009,2010,
+ 2011 Giovanni Di Sirio.
+
+ This file is part of ChibiOS/RT.
+
+ ChibiOS/RT is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 3 of the License, or
+ (at your option) any later version.
+
+ ChibiOS/RT is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "ch.h"
+#include "hal.h"
+#include "shell.h"
+#include "chprintf.h"
+#include "board.h"
+
+#include "Middleware.hpp"
+#include "imu_messages.hpp"
+#include "imu_sync.hpp"
+#include "ahrs.hpp"
+#include "calibration.hpp"
+#include "nmea.hpp"
+
+#define WA_SIZE_256B      THD_WA_SIZE(256)
+#define WA_SIZE_512B      THD_WA_SIZE(512)
+#define WA_SIZE_1K        THD_WA_SIZE(1024)
+
+/*
+ * L3GD20 gyro on SPI1, LSM303DLHC accelerometer/magnetometer on I2C1.
+ */
+#define L3GD20_CTRL_REG1	0x20
+#define L3GD20_CTRL_REG3	0x22
+#define L3GD20_CTRL_REG4	0x23
+#define L3GD20_OUT_X_L		0x28
+#define L3GD20_READ			0x80
+#define L3GD20_AUTOINC		0x40
+
+#define LSM303_ACC_ADDR		0x19
+#define LSM303_MAG_ADDR		0x1E
+#define LSM303_CTRL_REG1_A	0x20
+#define LSM303_CTRL_REG3_A	0x22
+#define LSM303_OUT_X_L_A	0x28
+#define LSM303_AUTOINC_A	0x80
+#define LSM303_CRA_REG_M	0x00
+#define LSM303_CRB_REG_M	0x01
+#define LSM303_MR_REG_M		0x02
+#define LSM303_OUT_X_H_M	0x03
+
+/*
+ * GPS receiver on USART2 (PA2/PA3), NMEA at 9600 bps.
+ */
+#ifndef GPS_SERIAL_DRIVER
+#define GPS_SERIAL_DRIVER	SD2
+#endif
+#define GPS_BAUDRATE		9600
+
+/*===========================================================================*/
+/* IMU sync stage.                                                           */
+/*===========================================================================*/
+
+static const ImuSyncConfig imu_sync_cfg = {
+	"imu",
+	1000,
+	2000,
+	{ 20000, 20000, 20000, 1500000 },	/* GPS: one missed 1 Hz fix. */
+	{ SYNC_LINEAR, SYNC_LINEAR, SYNC_NEAREST, SYNC_NEAREST }
+};
+
+static ImuSync imu_sync(&imu_sync_cfg);
+
+/*===========================================================================*/
+/* Calibration stage.                                                        */
+/*===========================================================================*/
+
+static Calibration calibration("imu", "imu_cal", "calib");
+
+/*===========================================================================*/
+/* Data-ready interrupts.                                                    */
+/*===========================================================================*/
+
+static BinarySemaphore gyro_sem;
+static BinarySemaphore acc_sem;
+static BinarySemaphore mag_sem;
+static volatile uint32_t gyro_t;
+static volatile uint32_t acc_t;
+static volatile uint32_t mag_t;
+
+/*
+ * The timestamp is latched here, the bus transfer happens later in the
+ * reader thread and must not skew it.
+ */
+static void gyro_drdy_cb(EXTDriver *extp, expchannel_t channel) {
+
+	(void) extp;
+	(void) channel;
+	gyro_t = halGetCounterValue();
+	chSysLockFromIsr();
+	chBSemSignalI(&gyro_sem);
+	chSysUnlockFromIsr();
+}
+
+static void acc_drdy_cb(EXTDriver *extp, expchannel_t channel) {
+
+	(void) extp;
+	(void) channel;
+	acc_t = halGetCounterValue();
+	chSysLockFromIsr();
+	chBSemSignalI(&acc_sem);
+	chSysUnlockFromIsr();
+}
+
+static void mag_drdy_cb(EXTDriver *extp, expchannel_t channel) {
+
+	(void) extp;
+	(void) channel;
+	mag_t = halGetCounterValue();
+	chSysLockFromIsr();
+	chBSemSignalI(&mag_sem);
+	chSysUnlockFromIsr();
+}
+
+/*
+ * GPS_STATUS (PA1) shares EXTI line 1 with GYRO_INT2 (PB1) and is currently
+ * wired as a test output, so GPS fixes are stamped by their reader instead
+ * (GpsThread).
+ */
+static const EXTConfig extcfg = { {
+	{ EXT_CH_MODE_DISABLED, NULL },
+	{ EXT_CH_MODE_RISING_EDGE | EXT_CH_MODE_AUTOSTART | EXT_MODE_GPIOB, gyro_drdy_cb },
+	{ EXT_CH_MODE_DISABLED, NULL },
+	{ EXT_CH_MODE_DISABLED, NULL },
+	{ EXT_CH_MODE_DISABLED, NULL },
+	{ EXT_CH_MODE_RISING_EDGE | EXT_CH_MODE_AUTOSTART | EXT_MODE_GPIOB, mag_drdy_cb },
+	{ EXT_CH_MODE_RISING_EDGE | EXT_CH_MODE_AUTOSTART | EXT_MODE_GPIOB, acc_drdy_cb },
+	{ EXT_CH_MODE_DISABLED, NULL },
+	{ EXT_CH_MODE_DISABLED, NULL },
+	{ EXT_CH_MODE_DISABLED, NULL },
+	{ EXT_CH_MODE_DISABLED, NULL },
+	{ EXT_CH_MODE_DISABLED, NULL },
+	{ EXT_CH_MODE_DISABLED, NULL },
+	{ EXT_CH_MODE_DISABLED, NULL },
+	{ EXT_CH_MODE_DISABLED, NULL },
+	{ EXT_CH_MODE_DISABLED, NULL },
+	{ EXT_CH_MODE_DISABLED, NULL },
+	{ EXT_CH_MODE_DISABLED, NULL },
+	{ EXT_CH_MODE_DISABLED, NULL }
+} };
+
+/*===========================================================================*/
+/* Sensor readers.                                                           */
+/*===========================================================================*/
+
+static const SPIConfig spi1cfg = { NULL, GYRO_GPIO, GYRO_CS,
+		SPI_CR1_BR_1 | SPI_CR1_CPOL | SPI_CR1_CPHA };
+
+static const I2CConfig i2c1cfg = { OPMODE_I2C, 400000, FAST_DUTY_CYCLE_2 };
+
+static void gyro_write(uint8_t reg, uint8_t value) {
+	uint8_t txbuf[2] = { reg, value };
+
+	spiSelect(&SPI_DRIVER);
+	spiSend(&SPI_DRIVER, 2, txbuf);
+	spiUnselect(&SPI_DRIVER);
+}
+
+static msg_t i2c_write(uint8_t addr, uint8_t reg, uint8_t value) {
+	uint8_t txbuf[2] = { reg, value };
+
+	return i2cMasterTransmitTimeout(&I2C_DRIVER, addr, txbuf, 2, NULL, 0,
+			MS2ST(10));
+}
+
+static msg_t GyroThread(void *arg) {
+	uint8_t txbuf[7] = { L3GD20_OUT_X_L | L3GD20_READ | L3GD20_AUTOINC };
+	uint8_t rxbuf[7];
+
+	(void) arg;
+	chRegSetThreadName("GYRO");
+
+	gyro_write(L3GD20_CTRL_REG4, 0x10);
+	gyro_write(L3GD20_CTRL_REG3, 0x08);
+	gyro_write(L3GD20_CTRL_REG1, 0xFF);
+
+	while (!chThdShouldTerminate()) {
+		if (chBSemWaitTimeout(&gyro_sem, MS2ST(10)) != RDY_OK) {
+			continue;
+		}
+		spiSelect(&SPI_DRIVER);
+		spiExchange(&SPI_DRIVER, sizeof(txbuf), txbuf, rxbuf);
+		spiUnselect(&SPI_DRIVER);
+		/* Little endian, first byte clocked in during the address phase. */
+		imu_sync.push(IMU_GYRO, gyro_t, (int16_t) ((rxbuf[2] << 8) | rxbuf[1]),
+				(int16_t) ((rxbuf[4] << 8) | rxbuf[3]),
+				(int16_t) ((rxbuf[6] << 8) | rxbuf[5]));
+	}
+
+	return 0;
+}
+
+static msg_t AccMagThread(void *arg) {
+	uint8_t reg;
+	uint8_t rxbuf[6];
+	int16_t * v = (int16_t *) rxbuf;
+	eventmask_t pending;
+
+	(void) arg;
+	chRegSetThreadName("ACC MAG");
+
+	i2cAcquireBus(&I2C_DRIVER);
+	i2c_write(LSM303_ACC_ADDR, LSM303_CTRL_REG1_A, 0x77);
+	i2c_write(LSM303_ACC_ADDR, LSM303_CTRL_REG3_A, 0x10);
+	i2c_write(LSM303_MAG_ADDR, LSM303_CRA_REG_M, 0x1C);
+	i2c_write(LSM303_MAG_ADDR, LSM303_CRB_REG_M, 0x20);
+	i2c_write(LSM303_MAG_ADDR, LSM303_MR_REG_M, 0x00);
+	i2cReleaseBus(&I2C_DRIVER);
+
+	while (!chThdShouldTerminate()) {
+		/* Both sensors share the bus, one thread serializes the transfers. */
+		pending = 0;
+		if (chBSemWaitTimeout(&acc_sem, MS2ST(1)) == RDY_OK) {
+			pending |= 1;
+		}
+		if (chBSemWaitTimeout(&mag_sem, TIME_IMMEDIATE) == RDY_OK) {
+			pending |= 2;
+		}
+
+		if (pending & 1) {
+			reg = LSM303_OUT_X_L_A | LSM303_AUTOINC_A;
+			i2cAcquireBus(&I2C_DRIVER);
+			i2cMasterTransmitTimeout(&I2C_DRIVER, LSM303_ACC_ADDR, &reg, 1, rxbuf,
+					6, MS2ST(10));
+			i2cReleaseBus(&I2C_DRIVER);
+			/* 12 bit, left justified. */
+			imu_sync.push(IMU_ACC, acc_t, v[0] >> 4, v[1] >> 4, v[2] >> 4);
+		}
+
+		if (pending & 2) {
+			reg = LSM303_OUT_X_H_M;
+			i2cAcquireBus(&I2C_DRIVER);
+			i2cMasterTransmitTimeout(&I2C_DRIVER, LSM303_MAG_ADDR, &reg, 1, rxbuf,
+					6, MS2ST(10));
+			i2cReleaseBus(&I2C_DRIVER);
+			/* Big endian, X Z Y order. */
+			imu_sync.push(IMU_MAG, mag_t, (int16_t) ((rxbuf[0] << 8) | rxbuf[1]),
+					(int16_t) ((rxbuf[4] << 8) | rxbuf[5]),
+					(int16_t) ((rxbuf[2] << 8) | rxbuf[3]));
+		}
+	}
+
+	return 0;
+}
+
+/*
+ * GGA fixes as (lat, lon, alt) in 1e-7 deg and cm. The stamp is the
+ * arrival of the sentence's '$', the closest to data-ready the serial
+ * line gives: the receiver sends GGA a fixed time after its fix epoch, so
+ * the stamp lags the fix by that much, not by the thread wakeup.
+ */
+static const SerialConfig gps_serial_cfg = { GPS_BAUDRATE, 0, USART_CR2_STOP1_BITS, 0 };
+static NmeaReader gps_nmea;
+
+static msg_t GpsThread(void *arg) {
+	uint32_t t = 0;
+	msg_t c;
+
+	(void) arg;
+	chRegSetThreadName("GPS");
+
+	while (!chThdShouldTerminate()) {
+		c = chnGetTimeout(&GPS_SERIAL_DRIVER, MS2ST(100));
+		if (c < 0) {
+			continue;
+		}
+		if (c == '$') {
+			t = halGetCounterValue();
+		}
+		if (gps_nmea.feed((char) c)) {
+			const NmeaFix & fix = gps_nmea.fix();
+
+			imu_sync.push(IMU_GPS, t, fix.lat, fix.lon, fix.alt);
+		}
+	}
+
+	return 0;
+}
+
+/*
+ * Downstream consumer, checks the combined topic is delivered at rate.
+ */
+static uint32_t imu_received = 0;
+
+static msg_t ImuSubscriberThread(void *arg) {
+	Middleware & mw = Middleware::instance();
+	Node n("imusub");
+	Subscriber<ImuSample, 5> sub("imu");
+	ImuSample *d;
+
+	(void) arg;
+	chRegSetThreadName("IMU SUB");
+
+	mw.newNode(&n);
+	n.subscribe(&sub);
+
+	while (!chThdShouldTerminate()) {
+		n.spin();
+		while ((d = sub.get()) != NULL) {
+			imu_received++;
+			sub.release(d);
+		}
+	}
+
+	mw.delNode(&n);
+	chThdExit(RDY_OK);
+
+	return 0;
+}
+
+/*===========================================================================*/
+/* Attitude estimator.                                                       */
+/*===========================================================================*/
+
+#define GYRO_SCALE	(0.0175f * 3.14159265f / 180.0f)	/* 500 dps full scale */
+
+static const AhrsConfig ahrs_cfg = { GYRO_SCALE, 2.0f, 0.005f, 1000 };
+
+static msg_t AhrsThread(void *arg) {
+	Middleware & mw = Middleware::instance();
+	Node n("ahrs");
+	Subscriber<ImuSample, 5> sub("imu_cal");
+	Publisher<AttitudeData> pub("attitude");
+	MahonyQ31 ahrs(&ahrs_cfg);
+	ImuSample *d;
+	AttitudeData *a;
+	int16_t gyro[3], acc[3], mag[3];
+	bool mag_ok;
+
+	(void) arg;
+	chRegSetThreadName("AHRS");
+
+	mw.newNode(&n);
+	n.subscribe(&sub);
+	n.advertise(&pub);
+
+	while (!chThdShouldTerminate()) {
+		n.spin();
+		while ((d = sub.get()) != NULL) {
+			if ((d->valid & (IMU_GYRO_VALID | IMU_ACC_VALID))
+					!= (IMU_GYRO_VALID | IMU_ACC_VALID)) {
+				sub.release(d);
+				continue;
+			}
+
+			for (int k = 0; k < 3; k++) {
+				gyro[k] = d->gyro[k];
+				acc[k] = d->acc[k];
+				mag[k] = d->mag[k];
+			}
+			mag_ok = (d->valid & IMU_MAG_VALID);
+
+			a = pub.alloc();
+			if (a != NULL) {
+				a->timestamp = d->timestamp;
+			}
+			sub.release(d);
+
+			ahrs.update(gyro, acc, mag_ok ? mag : NULL);
+
+			if (a != NULL) {
+				for (int k = 0; k < 4; k++) {
+					a->q[k] = ahrs.quaternion()[k];
+				}
+				pub.broadcast(a);
+			}
+		}
+	}
+
+	mw.delNode(&n);
+	chThdExit(RDY_OK);
+
+	return 0;
+}
+
+/*===========================================================================*/
+/* Command line related.                                                     */
+/*===========================================================================*/
+
+#define SHELL_WA_SIZE   THD_WA_SIZE(4096)
+
+static void cmd_mem(BaseSequentialStream *chp, int argc, char *argv[]) {
+	size_t n, size;
+
+	(void) argv;
+	if (argc > 0) {
+		chprintf(chp, "Usage: mem\r\n");
+		return;
+	}
+	n = chHeapStatus(NULL, &size);
+	chprintf(chp, "core free memory : %u bytes\r\n", chCoreStatus());
+	chprintf(chp, "heap fragments   : %u\r\n", n);
+	chprintf(chp, "heap free total  : %u bytes\r\n", size);
+}
+
+static void cmd_threads(BaseSequentialStream *chp, int argc, char *argv[]) {
+	static const char *states[] = { THD_STATE_NAMES };
+	Thread *tp;
+
+	(void) argv;
+	if (argc > 0) {
+		chprintf(chp, "Usage: threads\r\n");
+		return;
+	}
+	chprintf(chp, "    addr    stack prio refs     state time\r\n");
+	tp = chRegFirstThread();
+	do {
+		chprintf(chp, "%.8lx %.8lx %4lu %4lu %9s %lu\r\n", (uint32_t) tp,
+				(uint32_t) tp->p_ctx.r13, (uint32_t) tp->p_prio,
+				(uint32_t) (tp->p_refs - 1), states[tp->p_state],
+				(uint32_t) tp->p_time);
+		tp = chRegNextThread(tp);
+	} while (tp != NULL);
+}
+
+/*
+ * Prints and resets the assembler statistics.
+ * CPU load is the time spent in alloc + alignment + broadcast over the
+ * wall-clock time since the last reset, in hundredths of percent.
+ */
+static void cmd_sync(BaseSequentialStream *chp, int argc, char *argv[]) {
+	ImuSyncStats s;
+	uint32_t load;
+
+	(void) argv;
+	if (argc > 0) {
+		chprintf(chp, "Usage: sync\r\n");
+		return;
+	}
+
+	imu_sync.stats(&s);
+	imu_sync.resetStats();
+
+	load = (s.elapsed >= 10000) ? s.cycles_sum / (s.elapsed / 10000) : 0;
+
+	chprintf(chp, "rate %u Hz - samples %u dropped %u received %u\r\n",
+			imu_sync_cfg.rate, s.samples, s.dropped, imu_received);
+	chprintf(chp, "cycles avg %u max %u - load %u.%02u%%\r\n",
+			s.samples ? s.cycles_sum / (s.samples + s.dropped) : 0, s.cycles_max,
+			load / 100, load % 100);
+	chprintf(chp, "ring overruns gyro %u acc %u mag %u gps %u\r\n",
+			s.overruns[IMU_GYRO], s.overruns[IMU_ACC], s.overruns[IMU_MAG],
+			s.overruns[IMU_GPS]);
+	chprintf(chp, "gps sentences %u fixes %u checksum errors %u\r\n",
+			gps_nmea.stats().sentences, gps_nmea.stats().fixes,
+			gps_nmea.stats().checksum_errors);
+	imu_received = 0;
+}
+
+/*
+ * Prints and resets the calibration stage statistics.
+ */
+static void cmd_calib(BaseSequentialStream *chp, int argc, char *argv[]) {
+	CalibStats s;
+
+	(void) argv;
+	if (argc > 0) {
+		chprintf(chp, "Usage: calib\r\n");
+		return;
+	}
+
+	calibration.stats(&s);
+	calibration.resetStats();
+
+	chprintf(chp, "samples %u - cycles avg %u max %u (budget %u, %u over)\r\n",
+			s.samples, s.samples ? s.cycles_sum / s.samples : 0, s.cycles_max,
+			CALIB_CYCLE_BUDGET, s.over_budget);
+	chprintf(chp, "mag fit samples %u - coefficient updates %u\r\n",
+			s.fit_samples, s.updates);
+}
+
+/*
+ * Cycle count of one filter update, fixed point against the float
+ * reference, and the resulting CPU share at the configured rate.
+ */
+#define AHRS_BENCH_RUNS	1000
+
+static MahonyQ31 bench_fixed(&ahrs_cfg);
+static MahonyFloat bench_float(&ahrs_cfg);
+
+static void cmd_ahrs(BaseSequentialStream *chp, int argc, char *argv[]) {
+	static const int16_t gyro[3] = { 120, -80, 35 };
+	static const int16_t acc[3] = { 40, -25, 995 };
+	static const int16_t mag[3] = { 210, 15, 450 };
+	uint32_t start, fixed_cycles, float_cycles;
+	uint32_t freq = halGetCounterFrequency();
+
+	(void) argv;
+	if (argc > 0) {
+		chprintf(chp, "Usage: ahrs\r\n");
+		return;
+	}
+
+	bench_fixed.reset();
+	start = halGetCounterValue();
+	for (int i = 0; i < AHRS_BENCH_RUNS; i++) {
+		bench_fixed.update(gyro, acc, mag);
+	}
+	fixed_cycles = (halGetCounterValue() - start) / AHRS_BENCH_RUNS;
+
+	bench_float.reset();
+	start = halGetCounterValue();
+	for (int i = 0; i < AHRS_BENCH_RUNS; i++) {
+		bench_float.update(gyro, acc, mag);
+	}
+	float_cycles = (halGetCounterValue() - start) / AHRS_BENCH_RUNS;
+
+	chprintf(chp, "Q31   : %u cycles - %u.%02u%% CPU at %u Hz\r\n", fixed_cycles,
+			fixed_cycles * ahrs_cfg.rate / (freq / 100),
+			(fixed_cycles * ahrs_cfg.rate / (freq / 10000)) % 100, ahrs_cfg.rate);
+	chprintf(chp, "float : %u cycles - %u.%02u%% CPU at %u Hz\r\n", float_cycles,
+			float_cycles * ahrs_cfg.rate / (freq / 100),
+			(float_cycles * ahrs_cfg.rate / (freq / 10000)) % 100, ahrs_cfg.rate);
+}
+
+static const ShellCommand commands[] = { { "mem", cmd_mem }, { "threads",
+		cmd_threads }, { "sync", cmd_sync }, { "ahrs", cmd_ahrs },
+		{ "calib", cmd_calib }, { NULL, NULL } };
+
+static const ShellConfig shell_cfg1 = { (BaseSequentialStream *) &SERIAL_DRIVER,
+		commands };
+
+/*===========================================================================*/
+/* Application threads.                                                      */
+/*===========================================================================*/
+
+/*
+ * Red LED blinker thread, times are in milliseconds.
+ */
+static WORKING_AREA(waThread1, 128);
+static msg_t Thread1(void *arg) {
+
+	(void) arg;
+	chRegSetThreadName("blinker");
+
+	while (TRUE) {
+		palTogglePad(LED_GPIO, LED1);
+		chThdSleepMilliseconds(500);
+	}
+
+	return 0;
+}
+
+/*
+ * Application entry point.
+ */
+int main(void) {
+	Thread *shelltp = NULL;
+
+	/*
+	 * System initializations.
+	 * - HAL initialization, this also initializes the configured device drivers
+	 *   and performs the board-specific initializations.
+	 * - Kernel initialization, the main() function becomes a thread and the
+	 *   RTOS is active.
+	 */
+	halInit();
+	chSysInit();
+
+	/*
+	 * Activates the serial driver 1 using the driver default configuration.
+	 */
+	sdStart(&SERIAL_DRIVER, NULL);
+
+	/*
+	 * Shell manager initialization.
+	 */
+	shellInit();
+
+	/*
+	 * Sensor buses, I2C1 is remapped on PB8/PB9.
+	 */
+	AFIO->MAPR |= AFIO_MAPR_I2C1_REMAP;
+	i2cStart(&I2C_DRIVER, &i2c1cfg);
+	spiStart(&SPI_DRIVER, &spi1cfg);
+
+	chBSemInit(&gyro_sem, TRUE);
+	chBSemInit(&acc_sem, TRUE);
+	chBSemInit(&mag_sem, TRUE);
+	extStart(&EXTD1, &extcfg);
+
+	sdStart(&GPS_SERIAL_DRIVER, &gps_serial_cfg);
+
+	/*
+	 * Creates the blinker thread.
+	 */
+	chThdCreateStatic(waThread1, sizeof(waThread1), NORMALPRIO, Thread1, NULL);
+
+	/*
+	 * Sensor readers run above the assembler so samples are in the rings
+	 * before the instant they are aligned at.
+	 */
+	chThdCreateFromHeap(NULL, WA_SIZE_512B, NORMALPRIO + 3, GyroThread, NULL);
+	chThdCreateFromHeap(NULL, WA_SIZE_512B, NORMALPRIO + 3, AccMagThread, NULL);
+	chThdCreateFromHeap(NULL, WA_SIZE_512B, NORMALPRIO + 3, GpsThread, NULL);
+
+	chThdCreateFromHeap(NULL, WA_SIZE_512B, NORMALPRIO + 1, ImuSubscriberThread,
+			NULL);
+	chThdCreateFromHeap(NULL, WA_SIZE_1K, NORMALPRIO + 1, AhrsThread, NULL);
+	chThdCreateFromHeap(NULL, WA_SIZE_512B, NORMALPRIO + 1,
+			Calibration::applyThread, &calibration);
+	chThdCreateFromHeap(NULL, WA_SIZE_1K, NORMALPRIO, Calibration::fitThread,
+			&calibration);
+
+	chThdSleepMilliseconds(100);
+
+	chThdCreateFromHeap(NULL, WA_SIZE_1K, NORMALPRIO + 2, ImuSync::thread,
+			&imu_sync);
+
+	/*
+	 * Normal main() thread activity, in this demo it does nothing except
+	 * sleeping in a loop and check the button state.
+	 */
+	while (TRUE) {
+		if (!shelltp)
+			shelltp = shellCreate(&shell_cfg1, SHELL_WA_SIZE, NORMALPRIO - 1);
+		else if (chThdTerminated(shelltp)) {
+			chThdRelease(shelltp);
+			shelltp = NULL;
+		}
+		chThdSleepMilliseconds(200);
+	}
+}
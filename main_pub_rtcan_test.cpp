@@ -29,6 +29,10 @@
 #include "topics.h"
 
 #include "uid.h"
+#include "discovery_node.hpp"
+#include "timesync_node.hpp"
+#include "periodic.hpp"
+#include "slot_schedule.hpp"
 
 #include "hrt.h"
 
@@ -38,6 +42,8 @@
 #define WA_SIZE_2K        THD_WA_SIZE(2048)
 
 void remote_sub(const char * topic);
+extern DiscoveryNode discovery;
+extern TimeSyncNode timesync;
 
 /*===========================================================================*/
 /* STM32 id & reset.                                                         */
@@ -124,17 +130,35 @@ static void cmd_reset(BaseSequentialStream *chp, int argc, char *argv[]) {
 	stm32_reset();
 }
 
-static void cmd_remote(BaseSequentialStream *chp, int argc, char *argv[]) {
+static void cmd_discovery(BaseSequentialStream *chp, int argc, char *argv[]) {
+	const DiscoveryStats & stats = discovery.discovery().stats();
 
-	(void) chp;
 	(void) argc;
 	(void) argv;
-	remote_sub("led23");
+	chprintf(chp, "uid %u, led23 cid %u\r\n", discovery.discovery().uid(),
+			discovery.discovery().cid("led23"));
+	chprintf(chp, "tx %u (busy %u), rx %u, conflicts %u, table full %u\r\n",
+			stats.tx_frames, stats.tx_busy, stats.rx_frames, stats.conflicts,
+			stats.full);
+}
+
+static void cmd_timesync(BaseSequentialStream *chp, int argc, char *argv[]) {
+	TimeSyncStats stats;
+
+	(void) argc;
+	(void) argv;
+	timesync.stats(&stats);
+	chprintf(chp, "master %u, %s, time %u us\r\n", timesync.masterUid(),
+			timesync.synchronized() ? "synchronized" : "free running",
+			mwTimeNow());
+	chprintf(chp, "sync tx %u rx %u, follow-up %u, steps %u, error %d us, "
+			"drift %d ppb\r\n", stats.syncs_sent, stats.syncs, stats.follow_ups,
+			stats.steps, stats.error, stats.drift);
 }
 
 static const ShellCommand commands[] = { { "mem", cmd_mem }, { "threads",
-		cmd_threads }, { "reset", cmd_reset }, { "r", cmd_remote },
-		{ NULL, NULL } };
+		cmd_threads }, { "reset", cmd_reset }, { "discovery", cmd_discovery },
+		{ "timesync", cmd_timesync }, { NULL, NULL } };
 
 static const ShellConfig shell_cfg1 = { (BaseSequentialStream *) &SERIAL_DRIVER,
 		commands };
@@ -157,10 +181,26 @@ struct LEDDataDebug: public BaseMessage {
 /*
  * Publisher threads.
  */
+struct LEDStep {
+	char tag;
+	uint8_t pin;
+	bool_t set;
+};
+
+static const LEDStep led23_steps[] = {
+	{ 'A', LED2, true }, { 'B', LED3, false }, { 'C', LED2, false }, { 'D', LED3, true }
+};
+
+/*
+ * led23 goes remote: released every 100 ms just before its RTCAN slot, so
+ * the message does not sit in the queue for most of a cycle.
+ */
 static msg_t PublisherThread1(void *arg) {
 	Middleware & mw = Middleware::instance();
 	Node n("pub1");
 	Publisher<LEDDataDebug> pub("led23");
+	PeriodicTask task("pub led23", MS2ST(100), PERIODIC_SKIP);
+	const LEDStep * step;
 	LEDDataDebug *d;
 	uint8_t cnt = 0;
 	uint32_t nd;
@@ -178,56 +218,26 @@ static msg_t PublisherThread1(void *arg) {
 		return 0;
 	}
 
-	while (TRUE) {
-		d = pub.alloc();
-		if (d != NULL) {
-			d->pin = LED2;
-			d->set = true;
-			d->cnt = cnt++;
-			nd = pub.broadcast(d);
-			chprintf((BaseSequentialStream *) &SERIAL_DRIVER, "A: %x %d\r\n", d,
-					nd);
-		}
-
-		chThdSleepMilliseconds(100);
+	task.align(slot_origin(), slot_phase(&rtcan_schedule, LED23_SLOT, SLOT_LEAD_US,
+			CH_FREQUENCY));
 
+	while (task.next()) {
+		step = &led23_steps[cnt % 4];
 		d = pub.alloc();
 		if (d != NULL) {
-			d->pin = LED3;
-			d->set = false;
-			d->cnt = cnt++;
+			d->pin = step->pin;
+			d->set = step->set;
+			d->cnt = cnt;
 			nd = pub.broadcast(d);
-			chprintf((BaseSequentialStream *) &SERIAL_DRIVER, "B: %x %d\r\n", d,
-					nd);
+			chprintf((BaseSequentialStream *) &SERIAL_DRIVER, "%c: %x %d\r\n",
+					step->tag, d, nd);
 		}
-
-		chThdSleepMilliseconds(100);
-
-		d = pub.alloc();
-		if (d != NULL) {
-			d->pin = LED2;
-			d->set = false;
-			d->cnt = cnt++;
-			nd = pub.broadcast(d);
-			chprintf((BaseSequentialStream *) &SERIAL_DRIVER, "C: %x %d\r\n", d,
-					nd);
-		}
-
-		chThdSleepMilliseconds(100);
-
-		d = pub.alloc();
-		if (d != NULL) {
-			d->pin = LED3;
-			d->set = true;
-			d->cnt = cnt++;
-			nd = pub.broadcast(d);
-			chprintf((BaseSequentialStream *) &SERIAL_DRIVER, "D: %x %d\r\n", d,
-					nd);
-		}
-
-		chThdSleepMilliseconds(100);
+		cnt++;
 	}
 
+	mw.delNode(&n);
+	chThdExit(RDY_OK);
+
 	return 0;
 }
 
@@ -252,7 +262,7 @@ static msg_t SubscriberThread1(void *arg) {
 				"led23 sub QUEUED\r\n");
 	}
 
-	while (TRUE) {
+	while (!chThdShouldTerminate()) {
 		n.spin();
 		while ((d = sub.get()) != NULL) {
 			if (d->set)
@@ -265,11 +275,18 @@ static msg_t SubscriberThread1(void *arg) {
 		}
 	}
 
+	mw.delNode(&n);
+	chThdExit(RDY_OK);
+
 	return 0;
 }
 
-// FIXME
+/*
+ * Remote subscriber for led23, on the id negotiated by discovery.
+ */
 RemoteSubscriberT<LEDDataDebug, 5> rsub("led23");
+DiscoveryNode discovery(stm32_id8());
+TimeSyncNode timesync(stm32_id8());
 
 void remote_sub(const char * topic) {
 	Middleware & mw = Middleware::instance();
@@ -278,11 +295,24 @@ void remote_sub(const char * topic) {
 	pub = mw.findLocalPublisher(topic);
 
 	if (pub) {
-		rsub.id((123 << 8) | stm32_id8());
 		rsub.subscribe(pub);
 	}
 }
 
+static void led23_bind(void * arg, const char * name, uint8_t uid,
+		uint8_t cid) {
+	static bool subscribed = false;
+
+	(void) arg;
+	rsub.id((cid << 8) | uid);
+	if (!subscribed) {
+		remote_sub(name);
+		subscribed = true;
+	}
+	chprintf((BaseSequentialStream *) &SERIAL_DRIVER, "%s: id %u.%u\r\n",
+			name, cid, uid);
+}
+
 /*===========================================================================*/
 /* Application threads.                                                      */
 /*===========================================================================*/
@@ -308,7 +338,7 @@ static msg_t Thread1(void *arg) {
  * Application entry point.
  */
 int main(void) {
-	RTCANConfig rtcan_config = {1000000, 100, 60};
+	RTCANConfig rtcan_config = {RTCAN_BAUDRATE, RTCAN_CYCLE_HZ, RTCAN_SLOTS};
 	Thread *shelltp = NULL;
 
 	/*
@@ -354,9 +384,20 @@ int main(void) {
 	chThdSleepMilliseconds(100);
 
 	/*
-	 * Remote subscriber.
+	 * Discovery, led23 goes on the bus once it has a compact id.
+	 */
+	discovery.discovery().advertise("led23", sizeof(LEDDataDebug), led23_bind,
+			NULL);
+	chThdCreateFromHeap(NULL, WA_SIZE_1K, NORMALPRIO + 2, DiscoveryNode::thread,
+			&discovery);
+
+	/*
+	 * Clock synchronization, mwTimeNow() in the bus timebase.
 	 */
-	remote_sub("led23");
+	chThdCreateFromHeap(NULL, WA_SIZE_512B, NORMALPRIO + 3, TimeSyncNode::rxThread,
+			&timesync);
+	chThdCreateFromHeap(NULL, WA_SIZE_1K, NORMALPRIO + 2, TimeSyncNode::txThread,
+			&timesync);
 
 	chprintf((BaseSequentialStream *) &SERIAL_DRIVER, "sizeof(LEDData): %d",
 			sizeof(LEDData));
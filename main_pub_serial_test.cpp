@@ -27,13 +27,29 @@
 #include "rtcan.h"
 #include "Middleware.hpp"
 #include "topics.h"
+#include "serial_transport.hpp"
+#include "forwarder.hpp"
+#include "periodic.hpp"
+#include "slot_schedule.hpp"
+#include "discovery_node.hpp"
 
 #define WA_SIZE_256B      THD_WA_SIZE(256)
 #define WA_SIZE_512B      THD_WA_SIZE(512)
 #define WA_SIZE_1K        THD_WA_SIZE(1024)
 
-static msg_t RTCANThread(void *arg);
 static msg_t SerialThread(void *arg);
+extern DiscoveryNode discovery;
+
+/*
+ * Serial transport on USART2 (PA2/PA3), the shell stays on SD1.
+ */
+SerialTransport serial(&UARTD2, 115200);
+
+uint8_t stm32_id8(void) {
+	const unsigned long * uid = (const unsigned long *)0x1FFFF7E8;
+
+	return (uid[2] & 0xFF);
+}
 
 void stm32_reset(void) {
 
@@ -110,27 +126,50 @@ static void cmd_reset(BaseSequentialStream *chp, int argc, char *argv[]) {
 	stm32_reset();
 }
 
-static void cmd_rtcan(BaseSequentialStream *chp, int argc, char *argv[]) {
+static void cmd_discovery(BaseSequentialStream *chp, int argc, char *argv[]) {
+	const DiscoveryStats & stats = discovery.discovery().stats();
 
-	(void) chp;
 	(void) argc;
 	(void) argv;
-
-	chThdCreateFromHeap(NULL, WA_SIZE_512B, NORMALPRIO, RTCANThread, NULL);
+	chprintf(chp, "uid %u, led23 cid %u\r\n", discovery.discovery().uid(),
+			discovery.discovery().cid("led23"));
+	chprintf(chp, "tx %u (busy %u), rx %u, conflicts %u, table full %u\r\n",
+			stats.tx_frames, stats.tx_busy, stats.rx_frames, stats.conflicts,
+			stats.full);
 }
 
-static void cmd_serial(BaseSequentialStream *chp, int argc, char *argv[]) {
+static void cmd_link(BaseSequentialStream *chp, int argc, char *argv[]) {
+	SerialStats s;
+	static systime_t last = 0;
+	systime_t now = chTimeNow();
+	uint32_t ms = (now - last) * 1000 / CH_FREQUENCY;
+	uint32_t capacity = (uint32_t) (((uint64_t) serial.speed() / 10 * ms) / 1000);
 
-	(void) chp;
-	(void) argc;
 	(void) argv;
+	if (argc > 0) {
+		chprintf(chp, "Usage: link\r\n");
+		return;
+	}
+
+	serial.stats(&s);
+	serial.resetStats();
+	last = now;
 
-	chThdCreateFromHeap(NULL, WA_SIZE_512B, NORMALPRIO, SerialThread, NULL);
+	chprintf(chp, "tx: %u messages, %u frames, %u payload bytes, %u wire bytes\r\n",
+			s.tx_messages, s.tx_frames, s.tx_bytes, s.tx_wire_bytes);
+	if (capacity > 0) {
+		chprintf(chp, "tx: payload %u%% - wire %u%% of line rate over %u ms\r\n",
+				(s.tx_bytes * 100) / capacity, (s.tx_wire_bytes * 100) / capacity, ms);
+	}
+	chprintf(chp, "rx: %u frames, %u payload bytes\r\n", s.rx.frames, s.rx.bytes);
+	chprintf(chp, "rx errors: crc %u framing %u overrun %u ring %u unknown %u dropped %u\r\n",
+			s.rx.crc_errors, s.rx.framing_errors, s.rx.overruns, s.rx_overruns,
+			s.rx_unknown, s.rx_dropped);
 }
 
 static const ShellCommand commands[] = { { "mem", cmd_mem }, { "threads",
-		cmd_threads }, { "reset", cmd_reset }, { "r", cmd_rtcan }, { "s", cmd_serial },
-		{ NULL, NULL } };
+		cmd_threads }, { "reset", cmd_reset }, { "discovery", cmd_discovery },
+		{ "link", cmd_link }, { NULL, NULL } };
 
 static const ShellConfig shell_cfg1 = { (BaseSequentialStream *) &SERIAL_DRIVER,
 		commands };
@@ -142,18 +181,18 @@ static const ShellConfig shell_cfg1 = { (BaseSequentialStream *) &SERIAL_DRIVER,
 struct LEDData: public BaseMessage {
 	uint8_t pin;
 	bool_t set;
-};
-
-Middleware<RTCAN> mw;
+}__attribute__((packed));
 
 /*
  * Publisher threads.
  */
 static msg_t PublisherThread1(void *arg) {
-	Node n(&mw);
-	Publisher < LEDData > pub("led23");
+	Middleware & mw = Middleware::instance();
+	Node n("pub1");
+	Publisher<LEDData> pub("led23");
 	LEDData *d;
 
+	(void) arg;
 	chRegSetThreadName("PUB THD #1");
 
 	mw.newNode(&n);
@@ -166,7 +205,7 @@ static msg_t PublisherThread1(void *arg) {
 		return 0;
 	}
 
-	while (TRUE) {
+	while (!chThdShouldTerminate()) {
 		palSetPad(TEST_GPIO, TEST1);
 		d = pub.alloc();
 		if (d != NULL) {
@@ -202,59 +241,54 @@ static msg_t PublisherThread1(void *arg) {
 		chThdSleepMilliseconds(500);
 	}
 
+	mw.delNode(&n);
+	chThdExit(RDY_OK);
+
 	return 0;
 }
 
-/*
- * Subscriber threads.
- */
-static msg_t SubscriberThread1(void *arg) {
-	Node n(&mw);
-	Subscriber<LEDData, 5> sub("led23");
+static msg_t PublisherThread2(void *arg) {
+	Middleware & mw = Middleware::instance();
+	Node n("pub2");
+	Publisher<LEDData> pub("led4");
+	PeriodicTask task("pub led4", MS2ST(10), PERIODIC_CATCH_UP);
 	LEDData *d;
+	bool set = true;
 
-	chRegSetThreadName("SUB THD #1");
+	(void) arg;
+	chRegSetThreadName("PUB THD #2");
 
 	mw.newNode(&n);
+	n.advertise(&pub);
 
-	if (n.subscribe(&sub)) {
-		chprintf((BaseSequentialStream*) &SERIAL_DRIVER, "led23 sub OK\r\n");
-	} else {
-		chprintf((BaseSequentialStream*) &SERIAL_DRIVER,
-				"led23 sub QUEUED\r\n");
+	while (task.next()) {
+		d = pub.alloc();
+		if (d != NULL) {
+			d->pin = LED4;
+			d->set = set;
+			pub.broadcast(d);
+		}
+		set = !set;
 	}
 
-	while (TRUE) {
-		n.spin();
-		while ((d = sub.get()) != NULL) {
-			if (d->set)
-				palSetPad(LED_GPIO, d->pin);
-			else
-				palClearPad(LED_GPIO, d->pin);
+	mw.delNode(&n);
+	chThdExit(RDY_OK);
 
-			sub.release(d);
-			palClearPad(TEST_GPIO, TEST2);
-		}
-	}
 	return 0;
 }
 
-static msg_t TxThread(void *arg) {
-	Node n(&mw);
+/*
+ * Subscriber threads.
+ */
+static msg_t SubscriberThread1(void *arg) {
+	Middleware & mw = Middleware::instance();
+	Node n("sub1");
 	Subscriber<LEDData, 5> sub("led23");
+	Subscriber<LEDData, 5> cmd("ledcmd");
 	LEDData *d;
 
-	rtcan_msg_t msg;
-
 	(void) arg;
-	chRegSetThreadName("TX THD");
-
-	msg.id = LED23_ID;
-	msg.type = RTCAN_SRT;
-	msg.callback = NULL;
-	// FIXME
-	msg.size = sizeof(LEDData) - 2;
-	msg.status = RTCAN_MSG_READY;
+	chRegSetThreadName("SUB THD #1");
 
 	mw.newNode(&n);
 
@@ -265,72 +299,94 @@ static msg_t TxThread(void *arg) {
 				"led23 sub QUEUED\r\n");
 	}
 
-	while (TRUE) {
+	/* Commands from the serial link, published by the serial RX thread. */
+	n.subscribe(&cmd);
+
+	while (!chThdShouldTerminate()) {
 		n.spin();
 		while ((d = sub.get()) != NULL) {
-			// FIXME
-			msg.data = (((uint8_t *) d) + 2);
-			rtcanSendSrt(&msg, 50);
-
-			// FIXME
-			while (msg.status != RTCAN_MSG_READY) {
-				chThdYield();
-			}
+			if (d->set)
+				palSetPad(LED_GPIO, d->pin);
+			else
+				palClearPad(LED_GPIO, d->pin);
 
 			sub.release(d);
+			palClearPad(TEST_GPIO, TEST2);
+		}
 
+		while ((d = cmd.get()) != NULL) {
+			if (d->set)
+				palSetPad(LED_GPIO, d->pin);
+			else
+				palClearPad(LED_GPIO, d->pin);
+
+			cmd.release(d);
 		}
 	}
 
+	mw.delNode(&n);
+	chThdExit(RDY_OK);
+
 	return 0;
 }
 
-static msg_t RTCANThread(void *arg) {
-	Node n(&mw);
-	RTCANSubscriber<LEDData, 5> sub("led23");
-
-	(void) arg;
-	chRegSetThreadName("RTCAN THD");
-
-	mw.newNode(&n);
+/*
+ * Remote subscriber for led23, on the id negotiated by discovery.
+ */
+RemoteSubscriberT<LEDData, 5> rsub("led23");
+DiscoveryNode discovery(stm32_id8());
 
-	if (n.subscribe(&sub)) {
-		chprintf((BaseSequentialStream*) &SERIAL_DRIVER,
-				"led23 remote sub OK\r\n");
-	} else {
-		chprintf((BaseSequentialStream*) &SERIAL_DRIVER,
-				"led23 remote sub QUEUED\r\n");
-	}
+static void led23_bind(void * arg, const char * name, uint8_t uid,
+		uint8_t cid) {
+	Middleware & mw = Middleware::instance();
+	static bool subscribed = false;
+	LocalPublisher * pub;
 
-	while (TRUE) {
-		chThdSleepMilliseconds(100);
+	(void) arg;
+	rsub.id((cid << 8) | uid);
+	if (!subscribed) {
+		pub = mw.findLocalPublisher(name);
+		if (pub) {
+			rsub.subscribe(pub);
+			subscribed = true;
+		}
 	}
-
-	return 0;
+	chprintf((BaseSequentialStream *) &SERIAL_DRIVER, "%s: id %u.%u\r\n",
+			name, cid, uid);
 }
 
-static msg_t SerialThread(void *arg) {
 /*
-	Node n(&mw);
-	SerialSubscriber<LEDData, 5> sub("led23");
+ * led4 goes out through a compile-time link list; more links (loopback,
+ * a second UART) would be added to the list, not to the forwarding code.
+ */
+typedef Transports<SerialLink<serial> > Led4Links;
+typedef Forwarder<LEDData, 5, Led4Links> Led4Forwarder;
+static Led4Forwarder led4_forwarder("led4", LED4_ID);
+
+/*
+ * Serial link: led23 and led4 out, ledcmd in, all multiplexed on USART2.
+ * This thread becomes the transmit side of the transport; led23 may wait
+ * up to 20 ms to share a frame with other messages. Started once, from
+ * main(): the transport takes its topics and threads for good.
+ */
+static msg_t SerialThread(void *arg) {
+	SerialSubscriber<LEDData, 5> led23("led23", LED23_ID, MS2ST(20));
+	SerialPublisher<LEDData> ledcmd("ledcmd", LEDCMD_ID);
 
 	(void) arg;
-	chRegSetThreadName("SERIAL THD");
+	chRegSetThreadName("SERIAL TX");
 
-	mw.newNode(&n);
+	serial.add(&led23);
+	serial.add(&ledcmd);
+	serial.start();
 
-	if (n.subscribe(&sub)) {
-		chprintf((BaseSequentialStream*) &SERIAL_DRIVER,
-				"led23 remote sub OK\r\n");
-	} else {
-		chprintf((BaseSequentialStream*) &SERIAL_DRIVER,
-				"led23 remote sub QUEUED\r\n");
-	}
+	chThdCreateFromHeap(NULL, WA_SIZE_512B, NORMALPRIO + 1, SerialTransport::rxThread, &serial);
+	chThdCreateFromHeap(NULL, WA_SIZE_512B, NORMALPRIO + 1, Led4Forwarder::thread, &led4_forwarder);
+
+	chprintf((BaseSequentialStream*) &SERIAL_DRIVER, "serial transport started at %u bps\r\n", serial.speed());
+
+	serial.txLoop();
 
-	while (TRUE) {
-		chThdSleepMilliseconds(100);
-	}
-*/
 	return 0;
 }
 
@@ -359,6 +415,7 @@ static msg_t Thread1(void *arg) {
  * Application entry point.
  */
 int main(void) {
+	RTCANConfig rtcan_config = {RTCAN_BAUDRATE, RTCAN_CYCLE_HZ, RTCAN_SLOTS};
 	Thread *shelltp = NULL;
 
 	/*
@@ -382,7 +439,7 @@ int main(void) {
 	shellInit();
 
 	rtcanInit();
-	rtcanStart (NULL);
+	rtcanStart(&RTCAND1, &rtcan_config);
 
 	/*
 	 * Creates the blinker thread.
@@ -395,6 +452,12 @@ int main(void) {
 	chThdCreateFromHeap(NULL, WA_SIZE_512B, NORMALPRIO + 2, PublisherThread1,
 			NULL);
 
+	/*
+	 * Creates the publisher thread #2.
+	 */
+	chThdCreateFromHeap(NULL, WA_SIZE_512B, NORMALPRIO + 2, PublisherThread2,
+			NULL);
+
 	/*
 	 * Creates the subscriber thread #1.
 	 */
@@ -402,9 +465,20 @@ int main(void) {
 			NULL);
 
 	/*
-	 * Creates the TX thread.
+	 * Creates the serial transport thread.
 	 */
-//	chThdCreateFromHeap (NULL, WA_SIZE_512B, NORMALPRIO, TxThread, NULL);
+	chThdCreateFromHeap(NULL, WA_SIZE_1K, NORMALPRIO, SerialThread, NULL);
+
+	chThdSleepMilliseconds(100);
+
+	/*
+	 * Discovery, led23 goes on the bus once it has a compact id.
+	 */
+	discovery.discovery().advertise("led23", sizeof(LEDData), led23_bind,
+			NULL);
+	chThdCreateFromHeap(NULL, WA_SIZE_1K, NORMALPRIO + 2, DiscoveryNode::thread,
+			&discovery);
+
 	/*
 	 * Normal main() thread activity, in this demo it does nothing except
 	 * sleeping in a loop and check the button state.
@@ -164,7 +164,7 @@ static msg_t PublisherThread1(void *arg) {
 		return 0;
 	}
 
-	while (TRUE) {
+	while (!chThdShouldTerminate()) {
 		palSetPad(TEST_GPIO, TEST1);
 		d = pub.alloc();
 		if (d != NULL) {
@@ -200,6 +200,9 @@ static msg_t PublisherThread1(void *arg) {
 		chThdSleepMilliseconds(500);
 	}
 
+	mw.delNode(&n);
+	chThdExit(RDY_OK);
+
 	return 0;
 }
 
@@ -222,7 +225,7 @@ static msg_t SubscriberThread1(void *arg) {
 				"led23 sub QUEUED\r\n");
 	}
 
-	while (TRUE) {
+	while (!chThdShouldTerminate()) {
 		n.spin();
 		while ((d = sub.get()) != NULL) {
 			if (d->set)
@@ -234,6 +237,10 @@ static msg_t SubscriberThread1(void *arg) {
 			palClearPad(TEST_GPIO, TEST2);
 		}
 	}
+
+	mw.delNode(&n);
+	chThdExit(RDY_OK);
+
 	return 0;
 }
 
@@ -263,7 +270,7 @@ static msg_t TxThread(void *arg) {
 				"led23 sub QUEUED\r\n");
 	}
 
-	while (TRUE) {
+	while (!chThdShouldTerminate()) {
 		n.spin();
 		while ((d = sub.get()) != NULL) {
 			// FIXME
@@ -280,6 +287,9 @@ static msg_t TxThread(void *arg) {
 		}
 	}
 
+	mw.delNode(&n);
+	chThdExit(RDY_OK);
+
 	return 0;
 }
 
@@ -300,10 +310,13 @@ static msg_t RTCANThread(void *arg) {
 				"led23 remote sub QUEUED\r\n");
 	}
 
-	while (TRUE) {
+	while (!chThdShouldTerminate()) {
 		chThdSleepMilliseconds(100);
 	}
 
+	mw.delNode(&n);
+	chThdExit(RDY_OK);
+
 	return 0;
 }
 
@@ -28,12 +28,42 @@
 /*#include "rtcan.h"*/
 
 #include "Middleware.hpp"
+#include "decimating_relay.hpp"
+#include "latched.hpp"
+#include "transports.hpp"
+#include "forwarder.hpp"
+#include "loopback.hpp"
+#include "reliable_topics.hpp"
+#include "delta_codec.hpp"
+#include "imu_messages.hpp"
+#include "node_lifecycle.hpp"
+#include "periodic.hpp"
+#include "probe.hpp"
+#include "reserved_topic.hpp"
+#include "slab.hpp"
+#include "trace.hpp"
 
 #define MAX_SUBSCRIBERS 20
 #define BIG 0
-#define REMOTE 0
+#define REMOTE 1
 #define VERBOSE 1
 
+/* Remote path injection, see remote_start(). */
+#define REMOTE_DELAY_MS			0
+#define REMOTE_LOSS_PERMILLE	0
+#define TEST_REMOTE_ID			100
+#define TEST_RELIABLE_ID		101
+#define TEST_RELIABLE_ACK_ID	102
+
+#define LIFECYCLE_CYCLES		10000
+#define LATENCY_TEST_MS			10000
+#define RELAYS					3
+
+/* Reservation benchmark, see reservation_benchmark(). */
+#define RESERVED_POOL			9
+#define RESERVED_SLOW			19
+#define RESERVED_HOLD_MS		100
+
 #define WA_SIZE_256B      THD_WA_SIZE(256)
 #define WA_SIZE_512B      THD_WA_SIZE(512)
 #define WA_SIZE_1K        THD_WA_SIZE(1024)
@@ -46,6 +76,7 @@ systime_t end_time = 0;
 
 Thread * pubtp = NULL;
 Thread * subtp[MAX_SUBSCRIBERS] = {NULL};
+Thread * relaytp[RELAYS] = {NULL};
 
 /*
  * Messages.
@@ -58,6 +89,39 @@ struct TestData: public BaseMessage {
 #endif /* BIG */
 }__attribute__((packed));
 
+/*
+ * Downsampled topics, the slow subscribers only see their own rate.
+ */
+
+static const DecimationConfig<TestData> test_10hz_config = {
+	"test", "test/10Hz", 100, 10, NULL, 0, 0, NULL, NULL
+};
+
+static const DecimationConfig<TestData> test_1hz_config = {
+	"test", "test/1Hz", 100, 1, NULL, 0, 0, NULL, NULL
+};
+
+/*
+ * FIR mode: the counter as a 16 bit sawtooth through the anti-alias
+ * low-pass, host/decimator_check checks the same filter.
+ */
+static void test_unpack(const TestData * msg, int16_t * x) {
+	x[0] = (int16_t) msg->cnt;
+}
+
+static void test_pack(TestData * msg, const int16_t * y) {
+	msg->cnt = (uint16_t) y[0];
+}
+
+static const DecimationConfig<TestData> test_10hz_fir_config = {
+	"test", "test/10Hz/fir", 100, 10, decimator_lowpass_10x, DECIMATOR_LOWPASS_10X_TAPS, 1,
+	test_unpack, test_pack
+};
+
+static DecimatingRelay<TestData> test_10hz_relay(&test_10hz_config);
+static DecimatingRelay<TestData> test_1hz_relay(&test_1hz_config);
+static DecimatingRelay<TestData> test_10hz_fir_relay(&test_10hz_fir_config);
+
 /*
  * Publisher threads.
  */
@@ -66,8 +130,8 @@ static msg_t PublisherThread100Hz(void *arg) {
 	Middleware & mw = Middleware::instance();
 	Node n("pub1");
 	Publisher<TestData> pub("test");
+	PeriodicTask task("pub 100Hz", MS2ST(10), PERIODIC_CATCH_UP);
 	TestData *msg;
-	systime_t time;
 
 	(void) arg;
 	chRegSetThreadName("PUB 100Hz");
@@ -77,28 +141,15 @@ static msg_t PublisherThread100Hz(void *arg) {
 
 	mw.newNode(&n);
 	n.advertise(&pub);
+	task.advertise(&n);
 
-	time = chTimeNow();
-	while (TRUE) {
+	while (task.next()) {
 		palSetPad(TEST_GPIO, TEST2);
 		msg = pub.alloc();
 		if (msg != NULL) {
 			msg->cnt = cnt++;
 			pub.broadcast(msg);
 		}
-
-		time += MS2ST(10);
-		chThdSleepUntil(time);
-
-		palSetPad(TEST_GPIO, TEST2);
-		msg = pub.alloc();
-		if (msg != NULL) {
-			msg->cnt = cnt++;
-			pub.broadcast(msg);
-		}
-
-		time += MS2ST(10);
-		chThdSleepUntil(time);
 	}
 
 	mw.delNode(&n);
@@ -113,6 +164,7 @@ static msg_t PublisherThreadFlood(void *arg) {
 	Publisher<TestData> pub("test");
 	TestData *msg;
 	uint32_t * nmsg = (uint32_t *)arg;
+	uint8_t topic = trace_topic("test");
 
 	(void) arg;
 	chRegSetThreadName("PUB FLOOD");
@@ -127,19 +179,21 @@ static msg_t PublisherThreadFlood(void *arg) {
 
 	while (cnt < *nmsg) {
 		palSetPad(TEST_GPIO, TEST2);
-		msg = pub.alloc();
+		msg = PROBE_EXPR(PROBE_ALLOC, pub.alloc());
 		if (msg != NULL) {
 			msg->cnt = cnt++;
-			pub.broadcast(msg);
+			TRACE(TRACE_PUBLISH, topic, msg);
+			PROBE(PROBE_BROADCAST, pub.broadcast(msg));
 		}
 
 		chThdYield();
 
 		palSetPad(TEST_GPIO, TEST2);
-		msg = pub.alloc();
+		msg = PROBE_EXPR(PROBE_ALLOC, pub.alloc());
 		if (msg != NULL) {
 			msg->cnt = cnt++;
-			pub.broadcast(msg);
+			TRACE(TRACE_PUBLISH, topic, msg);
+			PROBE(PROBE_BROADCAST, pub.broadcast(msg));
 		}
 		chThdYield();
 	}
@@ -159,9 +213,11 @@ static msg_t SubscriberThreadRT(void *arg) {
 	Middleware & mw = Middleware::instance();
 	Node n("sub1");
 	Subscriber<TestData, 5> sub("test");
+	NodeStop stop;
 	TestData *d;
 	int nsub = ++subscribers;
 	uint16_t cnt = 0;
+	uint8_t topic = trace_topic("test");
 
 	(void) arg;
 	chRegSetThreadName("SUB RT");
@@ -171,16 +227,19 @@ static msg_t SubscriberThreadRT(void *arg) {
 
 	mw.newNode(&n);
 	n.subscribe(&sub);
+	stop.subscribe(&n);
 
-	while (!chThdShouldTerminate()) {
-		n.spin();
+	while (!stop.requested()) {
+		PROBE(PROBE_SPIN, n.spin());
 		palClearPad(TEST_GPIO, TEST2);
-		if ((d = sub.get()) != NULL) {
+		if ((d = PROBE_EXPR(PROBE_GET, sub.get())) != NULL) {
+			TRACE(TRACE_RECEIVE, topic, d);
 //			if (cnt != 0 && (d->cnt - cnt) != 1) {
 //				palTogglePad(LED_GPIO, LED4);
 //			}
 //			cnt = d->cnt;
-			sub.release(d);
+			TRACE(TRACE_RELEASE, topic, d);
+			PROBE(PROBE_RELEASE, sub.release(d));
 		}
 	}
 
@@ -193,12 +252,12 @@ static msg_t SubscriberThreadRT(void *arg) {
 static msg_t SubscriberThread10Hz(void *arg) {
 	Middleware & mw = Middleware::instance();
 	Node n("sub1");
-	Subscriber<TestData, 2> sub("test");
+	Subscriber<TestData, 2> sub((arg != NULL) ? (const char *) arg : "test/10Hz");
+	NodeStop stop;
 	TestData *d;
 	int nsub = ++subscribers;
 	int nmsg = 0;
 
-	(void) arg;
 	chRegSetThreadName("SUB 10Hz");
 #if VERBOSE
 	chprintf((BaseSequentialStream *)&SERIAL_DRIVER, "Subscriber #%2d - 10Hz\r\n", nsub);
@@ -206,8 +265,9 @@ static msg_t SubscriberThread10Hz(void *arg) {
 
 	mw.newNode(&n);
 	n.subscribe(&sub);
+	stop.subscribe(&n);
 
-	while (!chThdShouldTerminate()) {
+	while (!stop.requested()) {
 		n.spin();
 		while ((d = sub.get()) != NULL) {
 			nmsg++;
@@ -228,7 +288,8 @@ static msg_t SubscriberThread10Hz(void *arg) {
 static msg_t SubscriberThread1Hz(void *arg) {
 	Middleware & mw = Middleware::instance();
 	Node n("sub1");
-	Subscriber<TestData, 2> sub("test");
+	Subscriber<TestData, 2> sub("test/1Hz");
+	NodeStop stop;
 	TestData *d;
 	int nsub = ++subscribers;
 	int nmsg = 0;
@@ -241,8 +302,9 @@ static msg_t SubscriberThread1Hz(void *arg) {
 
 	mw.newNode(&n);
 	n.subscribe(&sub);
+	stop.subscribe(&n);
 
-	while (!chThdShouldTerminate()) {
+	while (!stop.requested()) {
 		n.spin();
 		while ((d = sub.get()) != NULL) {
 //			chprintf((BaseSequentialStream *)&SERIAL_DRIVER, "%2d %5d %d\r\n", nsub, d->cnt, chTimeNow());
@@ -264,9 +326,11 @@ static msg_t SubscriberThreadRT2(void *arg) {
 	Middleware & mw = Middleware::instance();
 	Node n("sub1");
 	Subscriber<TestData, 5> sub("test");
+	NodeStop stop;
 	TestData *d;
 	int nsub = ++subscribers;
 	uint16_t cnt = 0;
+	uint8_t topic = trace_topic("test");
 
 	(void) arg;
 	chRegSetThreadName("SUB RT2");
@@ -276,14 +340,55 @@ static msg_t SubscriberThreadRT2(void *arg) {
 
 	mw.newNode(&n);
 	n.subscribe(&sub);
+	stop.subscribe(&n);
 
-	while (!chThdShouldTerminate()) {
-		n.spin();
-		if ((d = sub.get()) != NULL) {
+	while (!stop.requested()) {
+		PROBE(PROBE_SPIN, n.spin());
+		if ((d = PROBE_EXPR(PROBE_GET, sub.get())) != NULL) {
+			TRACE(TRACE_RECEIVE, topic, d);
 //			if (cnt != 0 && (d->cnt - cnt) != 1) {
 //				palTogglePad(LED_GPIO, LED3);
 //			}
 //			cnt = d->cnt;
+			TRACE(TRACE_RELEASE, topic, d);
+			PROBE(PROBE_RELEASE, sub.release(d));
+		}
+	}
+
+	mw.delNode(&n);
+	chThdExit(RDY_OK);
+
+	return 0;
+}
+
+#if REMOTE
+/*
+ * Remote pipeline without a bus: "test" is forwarded to the loopback
+ * transport, framed (id mapping, COBS, CRC), decoded and republished as
+ * "test/remote" for the remote subscriber.
+ */
+static LoopbackTransport loopback;
+typedef Forwarder<TestData, 5, Transports<LoopbackLink<loopback> > > RemoteForwarder;
+static RemoteForwarder remote_forwarder("test", TEST_REMOTE_ID);
+static SerialPublisher<TestData> remote_publisher("test/remote", TEST_REMOTE_ID);
+static uint32_t remote_cnt = 0;
+
+static msg_t RemoteSubscriberThread(void *arg) {
+	Middleware & mw = Middleware::instance();
+	Node n("rsub");
+	Subscriber<TestData, 5> sub("test/remote");
+	TestData *d;
+
+	(void) arg;
+	chRegSetThreadName("SUB REMOTE");
+
+	mw.newNode(&n);
+	n.subscribe(&sub);
+
+	while (!chThdShouldTerminate()) {
+		n.spin();
+		while ((d = sub.get()) != NULL) {
+			remote_cnt++;
 			sub.release(d);
 		}
 	}
@@ -295,28 +400,120 @@ static msg_t SubscriberThreadRT2(void *arg) {
 }
 
 /*
- * Benchmarks.
+ * Reliable variant, on a 100 Hz command topic: "test/cmd" must arrive as
+ * "test/cmd/remote" complete and in order, whatever the injected loss.
  */
-void terminate_subscribers(void) {
-	uint32_t n = 0;
+typedef Transports<LoopbackLink<loopback> > LoopbackLinks;
+typedef ReliableForwarder<TestData, 5, LoopbackLinks> CmdForwarder;
+static CmdForwarder cmd_forwarder("test/cmd", "test/cmd/ack", TEST_RELIABLE_ID, MS2ST(20));
+static ReliableTopicRx<TestData, LoopbackLinks> cmd_rx("test/cmd/remote", TEST_RELIABLE_ID, TEST_RELIABLE_ACK_ID, 5);
+static SerialPublisher<ReliableAckMsg> cmd_ack("test/cmd/ack", TEST_RELIABLE_ACK_ID);
+static uint32_t cmd_cnt = 0;
+static uint32_t cmd_gaps = 0;
+
+static msg_t CmdPublisherThread(void *arg) {
+	Middleware & mw = Middleware::instance();
+	Node n("cmdpub");
+	Publisher<TestData> pub("test/cmd");
+	PeriodicTask task("pub cmd", MS2ST(10), PERIODIC_SKIP);
+	uint32_t cnt = 0;
+	TestData *d;
 
-	for (n = 0; n < MAX_SUBSCRIBERS; n++) {
-		if (subtp[n] != NULL) {
-			chThdTerminate(subtp[n]);
-			chSysLock();
-			chSchReadyI(subtp[n]);
-			chSysUnlock();
+	(void) arg;
+	chRegSetThreadName("PUB CMD");
+
+	mw.newNode(&n);
+	n.advertise(&pub);
+
+	while (task.next()) {
+		if ((d = pub.alloc()) != NULL) {
+			d->cnt = cnt++;
+			pub.broadcast(d);
 		}
 	}
 
-	chSchDoReschedule();
+	mw.delNode(&n);
+	chThdExit(RDY_OK);
 
-	for (n = 0; n < MAX_SUBSCRIBERS; n++) {
-		if (subtp[n] != NULL) {
-			chThdWait(subtp[n]);
-			subtp[n] = NULL;
+	return 0;
+}
+
+static msg_t CmdSubscriberThread(void *arg) {
+	Middleware & mw = Middleware::instance();
+	Node n("cmdsub");
+	Subscriber<TestData, 5> sub("test/cmd/remote");
+	TestData *d;
+
+	(void) arg;
+	chRegSetThreadName("SUB CMD");
+
+	mw.newNode(&n);
+	n.subscribe(&sub);
+
+	while (!chThdShouldTerminate()) {
+		n.spin();
+		while ((d = sub.get()) != NULL) {
+			if (d->cnt != cmd_cnt) {
+				cmd_gaps++;
+			}
+			cmd_cnt = d->cnt + 1;
+			sub.release(d);
 		}
 	}
+
+	mw.delNode(&n);
+	chThdExit(RDY_OK);
+
+	return 0;
+}
+
+void remote_start(void) {
+
+	loopback.add(&remote_publisher);
+	loopback.add(&cmd_rx);
+	loopback.add(&cmd_ack);
+	loopback.setDelay(MS2ST(REMOTE_DELAY_MS));
+	loopback.setLoss(REMOTE_LOSS_PERMILLE);
+
+	chThdCreateFromHeap(NULL, WA_SIZE_512B, NORMALPRIO + 2, RemoteSubscriberThread, NULL);
+	chThdCreateFromHeap(NULL, WA_SIZE_512B, NORMALPRIO + 2, LoopbackTransport::thread, &loopback);
+	chThdCreateFromHeap(NULL, WA_SIZE_512B, NORMALPRIO + 2, RemoteForwarder::thread, &remote_forwarder);
+	chThdCreateFromHeap(NULL, WA_SIZE_512B, NORMALPRIO + 2, CmdSubscriberThread, NULL);
+	chThdCreateFromHeap(NULL, WA_SIZE_512B, NORMALPRIO + 2, CmdForwarder::thread, &cmd_forwarder);
+	chThdCreateFromHeap(NULL, WA_SIZE_512B, NORMALPRIO + 1, CmdPublisherThread, NULL);
+	chThdSleepMilliseconds(100);
+}
+
+void remote_report(void) {
+	LoopbackStats s;
+	ReliableTxStats rs;
+
+	loopback.stats(&s);
+	chprintf((BaseSequentialStream *)&SERIAL_DRIVER, "Remote: %u forwarded, %u sent, %u delivered, %u received\r\n",
+			remote_forwarder.forwarded(), s.sent, s.delivered, remote_cnt);
+	chprintf((BaseSequentialStream *)&SERIAL_DRIVER, "Remote: lost %u (injected), queue full %u, unknown %u, no buffer %u\r\n",
+			s.lost, s.full, s.unknown, s.dropped);
+
+	cmd_forwarder.stats(&rs);
+	chprintf((BaseSequentialStream *)&SERIAL_DRIVER, "Reliable: %u received, %u gaps, %u sent, %u acked, %u nacked, %u timeouts\r\n",
+			cmd_cnt, cmd_gaps, rs.sent, rs.acked, rs.nacked, rs.timeouts);
+}
+#endif /* REMOTE */
+
+/*
+ * Benchmarks.
+ */
+void terminate_subscribers(void) {
+	uint32_t n = 0;
+
+	node_stop(subtp, MAX_SUBSCRIBERS);
+	for (n = 0; n < MAX_SUBSCRIBERS; n++) {
+		subtp[n] = NULL;
+	}
+	node_stop(relaytp, RELAYS);
+	for (n = 0; n < RELAYS; n++) {
+		relaytp[n] = NULL;
+	}
 #if VERBOSE
 	chprintf((BaseSequentialStream *)&SERIAL_DRIVER, "All subscribers deleted - core free memory : %u bytes\r\n", chCoreStatus());
 #endif /* VERBOSE */
@@ -324,26 +521,40 @@ void terminate_subscribers(void) {
 	chThdSleepMilliseconds(100);
 }
 
+/*
+ * Runs for LATENCY_TEST_MS, then stops the publisher, the subscribers and
+ * the relays. nsub subscribers, up to MAX_SUBSCRIBERS.
+ */
 void latency_test(int nsub) {
-	while (1) {
+	int n = 0;
+
+	relaytp[0] = node_create(NORMALPRIO + 1, DecimatingRelay<TestData>::thread, &test_10hz_relay);
+	relaytp[1] = node_create(NORMALPRIO + 1, DecimatingRelay<TestData>::thread, &test_1hz_relay);
+	relaytp[2] = node_create(NORMALPRIO + 1, DecimatingRelay<TestData>::thread, &test_10hz_fir_relay);
+
+	while (n < MAX_SUBSCRIBERS - 1) {
 		if (--nsub <= 0) {
 			break;
 		}
-		if (chThdCreateFromHeap (NULL, WA_SIZE_512B, NORMALPRIO, SubscriberThread10Hz, NULL) == NULL) {
+		/* The first 10 Hz subscriber takes the filtered copy. */
+		if ((subtp[n] = node_create(NORMALPRIO, SubscriberThread10Hz,
+				(n == 0) ? (void *) "test/10Hz/fir" : NULL)) == NULL) {
 			chprintf((BaseSequentialStream *)&SERIAL_DRIVER, "Memory full\r\n", chCoreStatus());
 			break;
 		}
+		n++;
 		chThdSleepMilliseconds(100);
-		if (--nsub <= 0) {
+		if (--nsub <= 0 || n >= MAX_SUBSCRIBERS - 1) {
 			break;
 		}
-		if (chThdCreateFromHeap (NULL, WA_SIZE_512B, NORMALPRIO, SubscriberThread1Hz, NULL) == NULL) {
+		if ((subtp[n] = node_create(NORMALPRIO, SubscriberThread1Hz, NULL)) == NULL) {
 			chprintf((BaseSequentialStream *)&SERIAL_DRIVER, "Memory full\r\n", chCoreStatus());
 			break;
 		}
+		n++;
 	}
 
-	chThdCreateFromHeap (NULL, WA_SIZE_512B, NORMALPRIO + 2, SubscriberThreadRT, NULL);
+	subtp[n] = node_create(NORMALPRIO + 2, SubscriberThreadRT, NULL);
 	chThdSleepMilliseconds(100);
 
 #if VERBOSE
@@ -353,18 +564,55 @@ void latency_test(int nsub) {
 
 	chThdSleepMilliseconds(100);
 
-	if (chThdCreateFromHeap (NULL, WA_SIZE_512B, NORMALPRIO + 1, PublisherThread100Hz, NULL) != NULL) {
+	if ((pubtp = node_create(NORMALPRIO + 1, PublisherThread100Hz, NULL)) != NULL) {
 #if VERBOSE
 		chprintf((BaseSequentialStream *)&SERIAL_DRIVER, "Publisher created\r\n", chCoreStatus());
 #endif
 	} else {
 		chprintf((BaseSequentialStream *)&SERIAL_DRIVER, "Memory full - no publisher\r\n", chCoreStatus());
 	}
+
+	chThdSleepMilliseconds(LATENCY_TEST_MS);
+
+	node_stop(&pubtp, 1);
+	pubtp = NULL;
+	terminate_subscribers();
+	subscribers = 0;
+	cnt = 0;
+}
+
+/*
+ * Hot path cycles of the last test, all zero unless built with PROBES=yes.
+ * The spin figure includes the time blocked waiting for a message.
+ */
+void probe_report(void) {
+	ProbeStats stats[PROBE_COUNT];
+
+	probe_snapshot(stats);
+	chprintf((BaseSequentialStream *)&SERIAL_DRIVER, "probe       count   min   avg    max\r\n");
+	for (int i = 0; i < PROBE_COUNT; i++) {
+		if (stats[i].count > 0) {
+			chprintf((BaseSequentialStream *)&SERIAL_DRIVER, "%-9s %7u %5u %5u %6u\r\n", probe_names[i],
+					stats[i].count, stats[i].min, (uint32_t) (stats[i].sum / stats[i].count), stats[i].max);
+		}
+	}
+}
+
+/*
+ * Cost of one trace event, all zero unless built with TRACE=yes.
+ */
+void trace_benchmark(uint32_t nevents) {
+	uint32_t min, avg, max;
+
+	trace_overhead(nevents, &min, &avg, &max);
+	chprintf((BaseSequentialStream *)&SERIAL_DRIVER, "trace event : min %u avg %u max %u cycles\r\n", min, avg, max);
 }
 
 void throughput_test(uint32_t nsub, uint32_t nmsg) {
 	uint32_t n = 0;
 
+	probe_reset();
+
 #if VERBOSE
 	chprintf((BaseSequentialStream *)&SERIAL_DRIVER, "TEST STARTING - core free memory : %u bytes\r\n", chCoreStatus());
 #endif
@@ -372,7 +620,7 @@ void throughput_test(uint32_t nsub, uint32_t nmsg) {
 	chThdSleepMilliseconds(100);
 
 	while (n < (nsub - 1)) {
-		if ((subtp[n] = chThdCreateFromHeap (NULL, WA_SIZE_512B, NORMALPRIO + 2, SubscriberThreadRT2, NULL)) == NULL) {
+		if ((subtp[n] = node_create(NORMALPRIO + 2, SubscriberThreadRT2, NULL)) == NULL) {
 			chprintf((BaseSequentialStream *)&SERIAL_DRIVER, "Memory full creating subscriber\r\n", chCoreStatus());
 			break;
 		}
@@ -380,12 +628,15 @@ void throughput_test(uint32_t nsub, uint32_t nmsg) {
 		chThdSleepMilliseconds(100);
 	}
 
-	if ((subtp[n] = chThdCreateFromHeap (NULL, WA_SIZE_512B, NORMALPRIO + 2, SubscriberThreadRT, NULL)) == NULL) {
+	if ((subtp[n] = node_create(NORMALPRIO + 2, SubscriberThreadRT, NULL)) == NULL) {
 		chprintf((BaseSequentialStream *)&SERIAL_DRIVER, "Memory full creating subscriber\r\n", chCoreStatus());
 	}
 
 	chThdSleepMilliseconds(100);
 
+	/* The first TRACE_EVENTS events of the flood. */
+	trace_start(false);
+
 	if ((pubtp = chThdCreateFromHeap (NULL, WA_SIZE_512B, NORMALPRIO + 1, PublisherThreadFlood, &nmsg)) == NULL) {
 		chprintf((BaseSequentialStream *)&SERIAL_DRIVER, "Memory full creating publisher\r\n", chCoreStatus());
 	}
@@ -393,6 +644,8 @@ void throughput_test(uint32_t nsub, uint32_t nmsg) {
 	chThdWait(pubtp);
 	pubtp = NULL;
 
+	trace_dump((BaseSequentialStream *)&SERIAL_DRIVER);
+
 #if VERBOSE
 	chprintf((BaseSequentialStream *)&SERIAL_DRIVER, "Throughput test ended: %d subscribers - %d messages in %d ms\r\n", subscribers, cnt, (end_time - start_time));
 #else
@@ -402,7 +655,492 @@ void throughput_test(uint32_t nsub, uint32_t nmsg) {
 	terminate_subscribers();
 	subscribers = 0;
 	cnt = 0;
+
+	probe_report();
 }
+
+/*
+ * Latched topic vs. single slot mailbox, per operation cost in DWT cycles.
+ */
+static Latched<TestData> test_latch;
+
+void latched_benchmark(uint32_t nmsg) {
+	Middleware & mw = Middleware::instance();
+	Node n("bench");
+	Publisher<TestData> pub("test/mailbox");
+	Subscriber<TestData, 1> sub("test/mailbox");
+	TestData *msg, value;
+	uint32_t t0, t1, t2;
+	uint32_t pub_cycles = 0, sub_cycles = 0;
+	uint32_t i;
+
+	mw.newNode(&n);
+	n.advertise(&pub);
+	n.subscribe(&sub);
+
+	for (i = 0; i < nmsg; i++) {
+		t0 = halGetCounterValue();
+		msg = pub.alloc();
+		if (msg != NULL) {
+			msg->cnt = i;
+			pub.broadcast(msg);
+		}
+		t1 = halGetCounterValue();
+		if ((msg = sub.get()) != NULL) {
+			value.cnt = msg->cnt;
+			sub.release(msg);
+		}
+		t2 = halGetCounterValue();
+		pub_cycles += t1 - t0;
+		sub_cycles += t2 - t1;
+	}
+
+	mw.delNode(&n);
+
+	chprintf((BaseSequentialStream *)&SERIAL_DRIVER, "Subscriber<T,1> : publish %u cycles - read %u cycles\r\n", pub_cycles / nmsg, sub_cycles / nmsg);
+
+	/* Late joiner: nothing published yet, then the last value right away. */
+	chprintf((BaseSequentialStream *)&SERIAL_DRIVER, "Latched before publish : %s\r\n", test_latch.read(&value) ? "value" : "empty");
+
+	pub_cycles = 0;
+	sub_cycles = 0;
+	for (i = 0; i < nmsg; i++) {
+		value.cnt = i;
+		t0 = halGetCounterValue();
+		test_latch.publish(&value);
+		t1 = halGetCounterValue();
+		test_latch.read(&value);
+		t2 = halGetCounterValue();
+		pub_cycles += t1 - t0;
+		sub_cycles += t2 - t1;
+	}
+
+	chprintf((BaseSequentialStream *)&SERIAL_DRIVER, "Latched<T>      : publish %u cycles - read %u cycles (last %u)\r\n", pub_cycles / nmsg, sub_cycles / nmsg, value.cnt);
+}
+
+/*
+ * Static Transports<> list vs. virtual link table, three links that only
+ * count bytes so the dispatch itself is what gets measured. Code sizes:
+ *     arm-none-eabi-nm -S --size-sort build/ch.elf | grep dispatch
+ */
+template<int K>
+struct CountLink {
+	static uint32_t bytes;
+
+	static bool send(uint16_t id, const uint8_t * payload, size_t len) {
+		(void) id;
+		(void) payload;
+		bytes += len;
+		return true;
+	}
+};
+
+template<int K>
+uint32_t CountLink<K>::bytes = 0;
+
+typedef Transports<CountLink<0>, CountLink<1>, CountLink<2> > StaticLinks;
+
+static VirtualLinkT<CountLink<0> > vlink0;
+static VirtualLinkT<CountLink<1> > vlink1;
+static VirtualLinkT<CountLink<2> > vlink2;
+static VirtualLink * const vlinks[] = { &vlink0, &vlink1, &vlink2 };
+
+__attribute__((noinline)) unsigned static_dispatch(const TestData * msg) {
+	return StaticLinks::send(1, payload(msg), payloadSize<TestData>());
+}
+
+__attribute__((noinline)) unsigned virtual_dispatch(const TestData * msg) {
+	return virtual_send(vlinks, 3, 1, payload(msg), payloadSize<TestData>());
+}
+
+void transport_benchmark(uint32_t nmsg) {
+	TestData msg;
+	uint32_t t0, static_cycles = 0, virtual_cycles = 0;
+
+	for (uint32_t i = 0; i < nmsg; i++) {
+		msg.cnt = i;
+		t0 = halGetCounterValue();
+		static_dispatch(&msg);
+		static_cycles += halGetCounterValue() - t0;
+
+		t0 = halGetCounterValue();
+		virtual_dispatch(&msg);
+		virtual_cycles += halGetCounterValue() - t0;
+	}
+
+	chprintf((BaseSequentialStream *)&SERIAL_DRIVER, "3 links: static %u cycles - virtual %u cycles per broadcast\r\n", static_cycles / nmsg, virtual_cycles / nmsg);
+}
+
+/*
+ * Delta codec cost on "imu" samples: ramps at the rates of a slowly moving
+ * board plus +-16 LSB of noise, timestamps 1 ms apart on the DWT counter.
+ */
+void delta_benchmark(uint32_t nmsg) {
+	DeltaEncoder enc(imu_sample_layout, IMU_SAMPLE_FIELDS, DELTA_KEYFRAME_INTERVAL);
+	DeltaDecoder dec(imu_sample_layout, IMU_SAMPLE_FIELDS);
+	ImuSample sample, out;
+	uint8_t buf[DELTA_MAX_SIZE(sizeof(ImuSample) - sizeof(BaseMessage), IMU_SAMPLE_FIELDS)];
+	uint32_t t0, enc_cycles = 0, dec_cycles = 0, bytes = 0, errors = 0;
+	uint32_t seed = 1;
+	size_t len;
+
+	memset(&sample, 0, sizeof(sample));
+	for (uint32_t i = 0; i < nmsg; i++) {
+		sample.timestamp = i * (STM32_HCLK / 1000);
+		for (int a = 0; a < 3; a++) {
+			seed = seed * 1664525u + 1013904223u;
+			sample.gyro[a] = (int16_t) (i * (a + 1) + ((seed >> 16) & 31) - 16);
+			sample.acc[a] = (int16_t) ((a == 2 ? 1000 : 0) + ((seed >> 21) & 31) - 16);
+			sample.mag[a] = (int16_t) (i / 64 + ((seed >> 26) & 7) - 4);
+		}
+		sample.valid = IMU_GYRO_VALID | IMU_ACC_VALID | IMU_MAG_VALID;
+
+		t0 = halGetCounterValue();
+		len = enc.encode(payload(&sample), buf);
+		enc_cycles += halGetCounterValue() - t0;
+
+		t0 = halGetCounterValue();
+		if (!dec.decode(buf, len, payload(&out))) {
+			errors++;
+		}
+		dec_cycles += halGetCounterValue() - t0;
+
+		if (memcmp(payload(&out), payload(&sample), payloadSize<ImuSample>()) != 0) {
+			errors++;
+		}
+		bytes += len;
+	}
+
+	chprintf((BaseSequentialStream *)&SERIAL_DRIVER, "Delta imu: %u -> %u.%02u bytes, encode %u cycles - decode %u cycles per sample, %u errors\r\n",
+			payloadSize<ImuSample>(), bytes / nmsg, (bytes % nmsg) * 100 / nmsg, enc_cycles / nmsg, dec_cycles / nmsg, errors);
+}
+
+/*
+ * Node create/destroy cycles: a subscriber and a publisher node, started
+ * and stopped ncycles times. Heap fragments and free memory must not move
+ * after the first cycle, which loads the working area pool.
+ */
+static msg_t LifecycleThread(void *arg) {
+	Middleware & mw = Middleware::instance();
+	Node n("cycle");
+	Subscriber<TestData, 5> sub("test");
+	Publisher<TestData> pub("test/cycle");
+	NodeStop stop;
+	TestData *d;
+
+	(void) arg;
+
+	mw.newNode(&n);
+	n.subscribe(&sub);
+	n.advertise(&pub);
+	stop.subscribe(&n);
+
+	while (!stop.requested()) {
+		n.spin();
+		while ((d = sub.get()) != NULL) {
+			sub.release(d);
+		}
+	}
+
+	mw.delNode(&n);
+	chThdExit(RDY_OK);
+
+	return 0;
+}
+
+void lifecycle_test(uint32_t ncycles) {
+	Thread * tp;
+	size_t fragments[2], heap[2], core[2];
+	uint32_t t0, cycles = 0, failed = 0;
+
+	for (uint32_t i = 0; i <= ncycles; i++) {
+		if (i == 1) {
+			fragments[0] = chHeapStatus(NULL, &heap[0]);
+			core[0] = chCoreStatus();
+		}
+
+		t0 = halGetCounterValue();
+		tp = node_create(NORMALPRIO + 2, LifecycleThread, NULL);
+		if (tp == NULL) {
+			failed++;
+			continue;
+		}
+		node_stop(&tp, 1);
+		if (i > 0) {
+			cycles += halGetCounterValue() - t0;
+		}
+	}
+
+	fragments[1] = chHeapStatus(NULL, &heap[1]);
+	core[1] = chCoreStatus();
+
+	chprintf((BaseSequentialStream *)&SERIAL_DRIVER, "Lifecycle: %u cycles, %u cycles each, %u failed\r\n", ncycles, cycles / ncycles, failed);
+	chprintf((BaseSequentialStream *)&SERIAL_DRIVER, "Lifecycle: heap fragments %u -> %u, heap free %u -> %u, core free %u -> %u bytes\r\n",
+			fragments[0], fragments[1], heap[0], heap[1], core[0], core[1]);
+}
+
+/*
+ * RT latency next to slow subscribers: the RT subscriber (NORMALPRIO + 2)
+ * gets a 1 kHz topic published at NORMALPRIO + 1 while RESERVED_SLOW
+ * subscribers at NORMALPRIO hold each message they get for
+ * RESERVED_HOLD_MS. With a shared pool the slow ones pin every buffer and
+ * alloc() fails; with reservations their class shares 4 buffers, the RT
+ * class keeps its 4 and its latency does not move.
+ */
+struct LatencyData {
+	uint32_t stamp;
+	uint32_t seq;
+};
+
+static const uint8_t reserve_shared[PRIO_CLASSES] = { RESERVED_POOL, RESERVED_POOL, RESERVED_POOL };
+static const uint8_t reserve_classes[PRIO_CLASSES] = { 0, 4, 4 };
+
+static ReservedTopic<LatencyData, RESERVED_POOL> shared_topic(reserve_shared);
+static ReservedTopic<LatencyData, RESERVED_POOL> reserved_topic(reserve_classes);
+
+static uint32_t rt_received, rt_min, rt_max, rt_sum;
+
+static msg_t ReservedThreadRT(void *arg) {
+	ReservedTopic<LatencyData, RESERVED_POOL> * topic = (ReservedTopic<LatencyData, RESERVED_POOL> *) arg;
+	ReservedSubscriber<LatencyData, 4> sub;
+	const LatencyData *d;
+	uint32_t cycles;
+
+	chRegSetThreadName("RESERVED RT");
+	topic->subscribe(&sub, chThdGetPriority());
+
+	while (!chThdShouldTerminate()) {
+		if (!sub.wait(MS2ST(10))) {
+			continue;
+		}
+		while ((d = sub.get()) != NULL) {
+			cycles = halGetCounterValue() - d->stamp;
+			rt_received++;
+			rt_sum += cycles;
+			if (cycles < rt_min) {
+				rt_min = cycles;
+			}
+			if (cycles > rt_max) {
+				rt_max = cycles;
+			}
+			sub.release(d);
+		}
+	}
+
+	topic->unsubscribe(&sub);
+	chThdExit(RDY_OK);
+
+	return 0;
+}
+
+static msg_t ReservedThreadSlow(void *arg) {
+	ReservedTopic<LatencyData, RESERVED_POOL> * topic = (ReservedTopic<LatencyData, RESERVED_POOL> *) arg;
+	ReservedSubscriber<LatencyData, 2> sub;
+	const LatencyData *d;
+
+	chRegSetThreadName("RESERVED SLOW");
+	topic->subscribe(&sub, chThdGetPriority());
+
+	while (!chThdShouldTerminate()) {
+		if (sub.wait(MS2ST(10)) && (d = sub.get()) != NULL) {
+			chThdSleepMilliseconds(RESERVED_HOLD_MS);
+			sub.release(d);
+		}
+	}
+
+	topic->unsubscribe(&sub);
+	chThdExit(RDY_OK);
+
+	return 0;
+}
+
+void reservation_run(ReservedTopic<LatencyData, RESERVED_POOL> * topic, uint32_t nslow, uint32_t nmsg) {
+	Thread * threads[RESERVED_SLOW + 1];
+	ReservedStats stats;
+	LatencyData *d;
+	uint32_t n = 0;
+	tprio_t prio;
+
+	rt_received = 0;
+	rt_min = 0xFFFFFFFF;
+	rt_max = 0;
+	rt_sum = 0;
+	topic->resetStats();
+
+	threads[n++] = node_create(NORMALPRIO + 2, ReservedThreadRT, topic);
+	while (n <= nslow) {
+		threads[n++] = node_create(NORMALPRIO, ReservedThreadSlow, topic);
+	}
+	chThdSleepMilliseconds(10);
+	topic->freeze();
+
+	prio = chThdSetPriority(NORMALPRIO + 1);
+	for (uint32_t i = 0; i < nmsg; i++) {
+		if ((d = topic->alloc()) != NULL) {
+			d->seq = i;
+			d->stamp = halGetCounterValue();
+			topic->broadcast(d);
+		}
+		chThdSleepMilliseconds(1);
+	}
+	chThdSetPriority(prio);
+
+	node_stop(threads, n);
+	topic->stats(&stats);
+
+	chprintf((BaseSequentialStream *)&SERIAL_DRIVER, "%s pool, %2u slow : alloc failed %u - RT %u/%u, latency min %u avg %u max %u cycles - slow dropped %u\r\n",
+			topic->guaranteed() ? "reserved" : "shared  ", nslow, stats.alloc_failed, rt_received, nmsg,
+			(rt_received > 0) ? rt_min : 0, (rt_received > 0) ? rt_sum / rt_received : 0, rt_max,
+			stats.dropped[PRIO_CLASS_NORMAL]);
+}
+
+void reservation_benchmark(uint32_t nmsg) {
+
+	reservation_run(&shared_topic, 0, nmsg);
+	reservation_run(&shared_topic, RESERVED_SLOW, nmsg);
+	reservation_run(&reserved_topic, 0, nmsg);
+	reservation_run(&reserved_topic, RESERVED_SLOW, nmsg);
+}
+
+/*
+ * ReservedTopic::broadcast() cost in DWT cycles with 1..MAX_SUBSCRIBERS
+ * subscribers, walking the subscriber list and from the frozen table. The
+ * subscribers have no threads, their queues are drained between
+ * broadcasts outside the measurement. Largest set first so the frozen
+ * table is allocated once.
+ */
+static const uint8_t reserve_freeze[PRIO_CLASSES] = { 0, 1, 0 };
+static ReservedTopic<LatencyData, 2> freeze_topic(reserve_freeze);
+static ReservedSubscriber<LatencyData, 1> freeze_subs[MAX_SUBSCRIBERS];
+
+static uint32_t freeze_run(uint32_t nsub, uint32_t nmsg, uint32_t * failed) {
+	const LatencyData *d;
+	uint32_t t0, cycles = 0, sent = 0;
+	LatencyData *msg;
+
+	for (uint32_t i = 0; i < nmsg; i++) {
+		if ((msg = freeze_topic.alloc()) != NULL) {
+			t0 = halGetCounterValue();
+			freeze_topic.broadcast(msg);
+			cycles += halGetCounterValue() - t0;
+			sent++;
+		} else {
+			(*failed)++;
+		}
+		for (uint32_t s = 0; s < nsub; s++) {
+			if ((d = freeze_subs[s].get()) != NULL) {
+				freeze_subs[s].release(d);
+			}
+		}
+	}
+
+	return (sent > 0) ? cycles / sent : 0;
+}
+
+void freeze_benchmark(uint32_t nmsg) {
+	uint32_t list[MAX_SUBSCRIBERS], frozen[MAX_SUBSCRIBERS];
+	uint32_t failed = 0;
+
+	for (uint32_t n = MAX_SUBSCRIBERS; n > 0; n--) {
+		for (uint32_t s = 0; s < n; s++) {
+			freeze_topic.subscribe(&freeze_subs[s], NORMALPRIO);
+		}
+		list[n - 1] = freeze_run(n, nmsg, &failed);
+		frozen[n - 1] = freeze_topic.freeze() ? freeze_run(n, nmsg, &failed) : 0;
+		for (uint32_t s = 0; s < n; s++) {
+			freeze_topic.unsubscribe(&freeze_subs[s]);
+		}
+	}
+
+	for (uint32_t n = 1; n <= MAX_SUBSCRIBERS; n++) {
+		chprintf((BaseSequentialStream *)&SERIAL_DRIVER, "broadcast, %2u subscribers : list %u cycles - frozen %u cycles\r\n",
+				n, list[n - 1], frozen[n - 1]);
+	}
+	chprintf((BaseSequentialStream *)&SERIAL_DRIVER, "broadcast : alloc failed %u\r\n", failed);
+}
+
+/*
+ * Shared slab vs. per-topic pools: alloc + free cost per size class in DWT
+ * cycles against a ChibiOS memory pool, and the RAM for the topics of this
+ * benchmark plus a GPS NMEA and a log topic with variable length payloads.
+ * Pools take buffers * largest message for every topic; the arena counts
+ * come from the peak use measured by host/slab_bench.
+ */
+struct SlabTopic {
+	const char * name;
+	size_t size;			/* Largest message. */
+	uint16_t buffers;		/* Publisher + subscriber queues. */
+};
+
+static const SlabTopic slab_topics[] = {
+	{ "test", sizeof(TestData), 15 },
+	{ "test/10Hz", sizeof(TestData), 3 },
+	{ "test/1Hz", sizeof(TestData), 3 },
+	{ "test/remote", sizeof(TestData), 6 },
+	{ "test/cmd", sizeof(TestData), 6 },
+	{ "test/cmd/remote", sizeof(TestData), 6 },
+	{ "test/cmd/ack", sizeof(ReliableAckMsg), 5 },
+	{ "test/mailbox", sizeof(TestData), 2 },
+	{ "health", sizeof(PeriodicHealthMsg), 1 },
+	{ "gps/nmea", sizeof(BaseMessage) + 82, 5 },
+	{ "log", sizeof(BaseMessage) + 128, 9 },
+};
+
+#if BIG
+static const uint16_t slab_counts[SLAB_CLASSES] = { 0, 1, 2, 4, 3, 9 };
+static StaticSlab<SLAB_BYTES(0, 1, 2, 4, 3, 9)> slab(slab_counts);
+#else
+static const uint16_t slab_counts[SLAB_CLASSES] = { 0, 9, 2, 4, 3, 1 };
+static StaticSlab<SLAB_BYTES(0, 9, 2, 4, 3, 1)> slab(slab_counts);
+#endif /* BIG */
+
+static TestData slab_pool_buffers[4];
+
+void slab_benchmark(uint32_t nmsg) {
+	MemoryPool pool;
+	SlabStats stats[SLAB_CLASSES];
+	uint32_t t0, slab_cycles, pool_cycles;
+	uint32_t pools = 0, arena = 0;
+	void * p;
+
+	chPoolInit(&pool, sizeof(TestData), NULL);
+	for (uint32_t i = 0; i < 4; i++) {
+		chPoolFree(&pool, &slab_pool_buffers[i]);
+	}
+
+	pool_cycles = 0;
+	for (uint32_t i = 0; i < nmsg; i++) {
+		t0 = halGetCounterValue();
+		p = chPoolAlloc(&pool);
+		chPoolFree(&pool, p);
+		pool_cycles += halGetCounterValue() - t0;
+	}
+
+	for (uint8_t c = 0; c < SLAB_CLASSES; c++) {
+		if (slab_counts[c] == 0) {
+			continue;
+		}
+		slab_cycles = 0;
+		for (uint32_t i = 0; i < nmsg; i++) {
+			t0 = halGetCounterValue();
+			p = slab.alloc(Slab::classSize(c));
+			slab.free(p);
+			slab_cycles += halGetCounterValue() - t0;
+		}
+		chprintf((BaseSequentialStream *)&SERIAL_DRIVER, "slab %3u bytes : alloc + free %u cycles (pool %u cycles)\r\n",
+				Slab::classSize(c), slab_cycles / nmsg, pool_cycles / nmsg);
+	}
+
+	for (uint32_t k = 0; k < sizeof(slab_topics) / sizeof(slab_topics[0]); k++) {
+		pools += slab_topics[k].buffers * ((slab_topics[k].size + 3) & ~3);
+	}
+	slab.stats(stats);
+	for (uint8_t c = 0; c < SLAB_CLASSES; c++) {
+		arena += stats[c].blocks * Slab::classSize(c);
+	}
+	chprintf((BaseSequentialStream *)&SERIAL_DRIVER, "per-topic pools %u bytes - shared slab %u bytes\r\n", pools, arena);
+}
+
 /*
  * Application entry point.
  */
@@ -417,6 +1155,7 @@ int main(void) {
 	 */
 	halInit();
 	chSysInit();
+	node_lifecycle_init();
 
 	/*
 	 * Activates the serial driver 1 using the driver default configuration.
@@ -435,7 +1174,21 @@ int main(void) {
 	chThdSleepMilliseconds(1000);
 
 //	latency_test(20);
+	latched_benchmark(10000);
+	transport_benchmark(10000);
+	delta_benchmark(10000);
+	lifecycle_test(LIFECYCLE_CYCLES);
+	trace_benchmark(10000);
+	reservation_benchmark(2000);
+	slab_benchmark(10000);
+	freeze_benchmark(2000);
+#if REMOTE
+	remote_start();
+#endif /* REMOTE */
 	throughput_test(1, 1000000);
+#if REMOTE
+	remote_report();
+#endif /* REMOTE */
 
 /*
 	for (uint32_t n = 1; n <= 20; n++) {
@@ -446,19 +1199,6 @@ int main(void) {
 		palSetPort(LED_GPIO, LED1 | LED2 | LED3 | LED4);
 	}
 */
-#if REMOTE
-	Middleware & mw = Middleware::instance();
-	RemoteSubscriberT<TestData, 2> rsub("test");
-	LocalPublisher * pub;
-
-	pub = mw.findLocalPublisher("test");
-
-	if (pub) {
-		rsub.subscribe(pub);
-		chprintf((BaseSequentialStream *)&SERIAL_DRIVER, "Remote subscriber started\r\n");
-	}
-#endif /* REMOTE */
-
 	/* Test ended. */
 	palClearPad(LED_GPIO, LED1);
 	palClearPad(LED_GPIO, LED2);
@@ -18,6 +18,8 @@
  along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <string.h>
+
 #include "ch.h"
 #include "hal.h"
 #include "halconf.h"
@@ -29,6 +31,8 @@
 /*#include "rtcan.h"*/
 
 #include "Middleware.hpp"
+#include "periodic.hpp"
+#include "probe.hpp"
 
 #define WA_SIZE_256B      THD_WA_SIZE(256)
 #define WA_SIZE_512B      THD_WA_SIZE(512)
@@ -137,9 +141,36 @@ static void cmd_sub3(BaseSequentialStream *chp, int argc, char *argv[]) {
 	chThdCreateFromHeap (NULL, WA_SIZE_512B, NORMALPRIO, SubscriberThread3, NULL);
 }
 
+/* Hot path cycles of p2 / s2, build with PROBES=yes. */
+static void cmd_probes(BaseSequentialStream *chp, int argc, char *argv[]) {
+	ProbeStats stats[PROBE_COUNT];
+
+	if (argc == 1 && strcmp(argv[0], "reset") == 0) {
+		probe_reset();
+		return;
+	}
+	if (argc > 0) {
+		chprintf(chp, "Usage: probes [reset]\r\n");
+		return;
+	}
+	if (!USE_PROBES) {
+		chprintf(chp, "probes disabled, build with PROBES=yes\r\n");
+		return;
+	}
+	probe_snapshot(stats);
+	chprintf(chp, "probe       count   min   avg    max\r\n");
+	for (int i = 0; i < PROBE_COUNT; i++) {
+		if (stats[i].count > 0) {
+			chprintf(chp, "%-9s %7u %5u %5u %6u\r\n", probe_names[i], stats[i].count,
+					stats[i].min, (uint32_t) (stats[i].sum / stats[i].count), stats[i].max);
+		}
+	}
+}
+
 static const ShellCommand commands[] =
 		{ { "mem", cmd_mem }, { "threads", cmd_threads },
-				{ "reset", cmd_reset }, { "p2", cmd_pub2 }, { "s2", cmd_sub2 }, { "s3", cmd_sub3 }, { NULL, NULL } };
+				{ "reset", cmd_reset }, { "p2", cmd_pub2 }, { "s2", cmd_sub2 }, { "s3", cmd_sub3 },
+				{ "probes", cmd_probes }, { NULL, NULL } };
 
 static const ShellConfig shell_cfg1 = { (BaseSequentialStream *) &SERIAL_DRIVER,
 		commands };
@@ -180,7 +211,7 @@ static msg_t PublisherThread1(void *arg) {
 		chprintf((BaseSequentialStream*)&SERIAL_DRIVER, "led3 pub FAIL\r\n");
 	}
 
-	while (TRUE) {
+	while (!chThdShouldTerminate()) {
 
 		d = pub1.alloc();
 		if (d != NULL) {
@@ -215,6 +246,9 @@ static msg_t PublisherThread1(void *arg) {
 		chThdSleepMilliseconds(500);
 	}
 
+	mw.delNode(&n);
+	chThdExit(RDY_OK);
+
 	return 0;
 }
 
@@ -222,8 +256,9 @@ static msg_t PublisherThread2(void *arg) {
 	Middleware & mw = Middleware::instance();
 	Node n("pub2");
 	Publisher<LEDData> pub("led4");
+	PeriodicTask task("pub led4", MS2ST(10), PERIODIC_CATCH_UP);
 	LEDData *d;
-	systime_t time;
+	bool set = true;
 
 	(void) arg;
 	chRegSetThreadName("PUB #2");
@@ -236,29 +271,19 @@ static msg_t PublisherThread2(void *arg) {
 		chprintf((BaseSequentialStream *) &SERIAL_DRIVER, "led4 pub FAIL\r\n");
 	}
 
-	time = chTimeNow();
-	while (TRUE) {
-		d = pub.alloc();
+	while (task.next()) {
+		d = PROBE_EXPR(PROBE_ALLOC, pub.alloc());
 		if (d != NULL) {
 			d->pin = LED4;
-			d->set = true;
-			pub.broadcast(d);
-		}
-
-		time += MS2ST(10);
-		chThdSleepUntil(time);
-
-		d = pub.alloc();
-		if (d != NULL) {
-			d->pin = LED4;
-			d->set = false;
-			pub.broadcast(d);
+			d->set = set;
+			PROBE(PROBE_BROADCAST, pub.broadcast(d));
 		}
-
-		time += MS2ST(10);
-		chThdSleepUntil(time);
+		set = !set;
 	}
 
+	mw.delNode(&n);
+	chThdExit(RDY_OK);
+
 	return 0;
 }
 
@@ -307,10 +332,12 @@ static msg_t SubscriberThread1(void *arg) {
 		chprintf((BaseSequentialStream*)&SERIAL_DRIVER, "led3 sub QUEUED\r\n");
 	}
 
-	while (TRUE) {
+	while (!chThdShouldTerminate()) {
 		n.spin();
 	}
 
+	mw.delNode(&n);
+	chThdExit(RDY_OK);
 
 	return 0;
 }
@@ -330,18 +357,20 @@ static msg_t SubscriberThread2(void *arg) {
 
 	n.subscribe(&sub);
 
-	while (TRUE) {
-		n.spin();
-		if ((d = sub.get()) != NULL) {
+	while (!chThdShouldTerminate()) {
+		PROBE(PROBE_SPIN, n.spin());
+		if ((d = PROBE_EXPR(PROBE_GET, sub.get())) != NULL) {
 			if (d->set)
 				palSetPad(LED_GPIO, d->pin);
 			else
 				palClearPad(LED_GPIO, d->pin);
 
-			sub.release(d);
+			PROBE(PROBE_RELEASE, sub.release(d));
 		}
 	}
 
+	mw.delNode(&n);
+	chThdExit(RDY_OK);
 
 	return 0;
 }
@@ -358,7 +387,7 @@ static msg_t SubscriberThread3(void *arg) {
 	mw.newNode(&n);
 	n.subscribe(&sub);
 
-	while (TRUE) {
+	while (!chThdShouldTerminate()) {
 		n.spin();
 		if ((d = sub.get()) != NULL) {
 			palTogglePad(LED_GPIO, LED3);
@@ -366,6 +395,8 @@ static msg_t SubscriberThread3(void *arg) {
 		}
 	}
 
+	mw.delNode(&n);
+	chThdExit(RDY_OK);
 
 	return 0;
 }
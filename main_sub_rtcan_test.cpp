@@ -28,15 +28,20 @@
 #include "chprintf.h"
 
 #include "rtcan.h"
+#include "slot_schedule.hpp"
 #include "Middleware.hpp"
 #include "topics.h"
 
 #include "uid.h"
+#include "discovery_node.hpp"
+#include "timesync_node.hpp"
 
 #define WA_SIZE_256B      THD_WA_SIZE(256)
 #define WA_SIZE_512B      THD_WA_SIZE(512)
 #define WA_SIZE_1K        THD_WA_SIZE(1024)
 
+extern TimeSyncNode timesync;
+
 /*===========================================================================*/
 /* STM32 id & reset.                                                         */
 /*===========================================================================*/
@@ -147,9 +152,23 @@ static void cmd_id(BaseSequentialStream *chp, int argc, char *argv[]) {
 	chprintf(chp, "UID: %d\r\n", stm32_id8());
 }
 
+static void cmd_timesync(BaseSequentialStream *chp, int argc, char *argv[]) {
+	TimeSyncStats stats;
+
+	(void) argc;
+	(void) argv;
+	timesync.stats(&stats);
+	chprintf(chp, "master %u, %s, time %u us\r\n", timesync.masterUid(),
+			timesync.synchronized() ? "synchronized" : "free running",
+			mwTimeNow());
+	chprintf(chp, "sync tx %u rx %u, follow-up %u, steps %u, error %d us, "
+			"drift %d ppb\r\n", stats.syncs_sent, stats.syncs, stats.follow_ups,
+			stats.steps, stats.error, stats.drift);
+}
+
 static const ShellCommand commands[] = { { "mem", cmd_mem }, { "threads",
 		cmd_threads }, { "test", cmd_test }, { "reset", cmd_reset }, { "id",
-		cmd_id }, { NULL, NULL } };
+		cmd_id }, { "timesync", cmd_timesync }, { NULL, NULL } };
 
 static const ShellConfig shell_cfg1 = { (BaseSequentialStream *) &SERIAL_DRIVER,
 		commands };
@@ -170,6 +189,28 @@ struct LEDDataDebug: public BaseMessage {
 }__attribute__((packed));
 
 
+/*
+ * Remote publisher for led23, bound by discovery to whichever node
+ * advertises it.
+ */
+static RemotePublisher rpub("led23", sizeof(LEDDataDebug));
+static DiscoveryNode discovery(stm32_id8());
+TimeSyncNode timesync(stm32_id8());
+
+static void led23_bind(void * arg, const char * name, uint8_t uid,
+		uint8_t cid) {
+	static bool advertised = false;
+
+	(void) arg;
+	rpub.id((cid << 8) | uid);
+	if (!advertised) {
+		Middleware::instance().advertise(&rpub);
+		advertised = true;
+	}
+	chprintf((BaseSequentialStream *) &SERIAL_DRIVER, "%s: id %u.%u\r\n",
+			name, cid, uid);
+}
+
 /*
  * Subscriber threads.
  */
@@ -189,7 +230,7 @@ static msg_t SubscriberThread1(void *arg) {
 		chprintf((BaseSequentialStream*)&SERIAL_DRIVER, "led23 sub QUEUED\r\n");
 	}
 
-	while (TRUE) {
+	while (!chThdShouldTerminate()) {
 		n.spin();
 		while ((d = sub.get()) != NULL) {
 			palSetPad(TEST_GPIO, TEST1);
@@ -203,6 +244,9 @@ static msg_t SubscriberThread1(void *arg) {
 		}
 	}
 
+	mw.delNode(&n);
+	chThdExit(RDY_OK);
+
 	return 0;
 }
 
@@ -223,7 +267,7 @@ static msg_t SubscriberThread2(void *arg) {
 		chprintf((BaseSequentialStream*)&SERIAL_DRIVER, "led23 sub QUEUED\r\n");
 	}
 
-	while (TRUE) {
+	while (!chThdShouldTerminate()) {
 		n.spin();
 		while ((d = sub.get()) != NULL) {
 			chprintf((BaseSequentialStream *) &SERIAL_DRIVER, "pin(%d) = %d\r\n", d->pin, d->set);
@@ -232,6 +276,9 @@ static msg_t SubscriberThread2(void *arg) {
 
 	}
 
+	mw.delNode(&n);
+	chThdExit(RDY_OK);
+
 	return 0;
 }
 
@@ -268,7 +315,7 @@ static msg_t Thread1(void *arg) {
  * Application entry point.
  */
 int main(void) {
-	RTCANConfig rtcan_config = {1000000, 100, 60};
+	RTCANConfig rtcan_config = {RTCAN_BAUDRATE, RTCAN_CYCLE_HZ, RTCAN_SLOTS};
 	Thread *shelltp = NULL;
 
 	/*
@@ -313,10 +360,22 @@ int main(void) {
 	 * Creates the RX thread.
 	 */
 //	chThdCreateFromHeap (NULL, WA_SIZE_512B, NORMALPRIO + 2, RxThread, NULL);
-	Middleware & mw = Middleware::instance();
-	RemotePublisher rpub("led23", sizeof(LEDDataDebug));
-	rpub.id((123 << 8) | 40);
-	mw.advertise(&rpub);
+
+	/*
+	 * Discovery, finds the led23 publisher on the bus.
+	 */
+	discovery.discovery().subscribe("led23", sizeof(LEDDataDebug), led23_bind,
+			NULL);
+	chThdCreateFromHeap(NULL, WA_SIZE_1K, NORMALPRIO + 2, DiscoveryNode::thread,
+			&discovery);
+
+	/*
+	 * Clock synchronization, mwTimeNow() in the bus timebase.
+	 */
+	chThdCreateFromHeap(NULL, WA_SIZE_512B, NORMALPRIO + 3, TimeSyncNode::rxThread,
+			&timesync);
+	chThdCreateFromHeap(NULL, WA_SIZE_1K, NORMALPRIO + 2, TimeSyncNode::txThread,
+			&timesync);
 
 	/*
 	 * Normal main() thread activity, in this demo it does nothing except
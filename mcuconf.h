@@ -141,7 +141,9 @@
  * SERIAL driver system settings.
  */
 #define STM32_SERIAL_USE_USART1             TRUE
+#if !defined(STM32_SERIAL_USE_USART2)
 #define STM32_SERIAL_USE_USART2             TRUE
+#endif
 #define STM32_SERIAL_USE_USART3             FALSE
 #define STM32_SERIAL_USE_UART4              FALSE
 #define STM32_SERIAL_USE_UART5              FALSE
@@ -171,7 +173,9 @@
  * UART driver system settings.
  */
 #define STM32_UART_USE_USART1               FALSE
+#if !defined(STM32_UART_USE_USART2)
 #define STM32_UART_USE_USART2               FALSE
+#endif
 #define STM32_UART_USE_USART3               FALSE
 #define STM32_UART_USART1_IRQ_PRIORITY      12
 #define STM32_UART_USART2_IRQ_PRIORITY      12
@@ -0,0 +1,166 @@
+#include <string.h>
+
+#include "nmea.hpp"
+
+NmeaReader::NmeaReader(void) :
+		_len(0), _in(false) {
+
+	memset(&_fix, 0, sizeof(_fix));
+	memset(&_stats, 0, sizeof(_stats));
+}
+
+/*
+ * Start of field n of the sentence (0 is the address), NULL if there are
+ * fewer fields.
+ */
+static const char * field(const char * s, uint8_t n) {
+
+	while (n > 0) {
+		if (*s == '\0' || *s == '*') {
+			return NULL;
+		}
+		if (*s++ == ',') {
+			n--;
+		}
+	}
+
+	return s;
+}
+
+/*
+ * [-]digits[.digits] scaled by 10^decimals, extra decimals truncated.
+ * False on an empty field.
+ */
+static bool decimal(const char * s, uint8_t decimals, int32_t * out) {
+	bool negative = (*s == '-');
+	bool digits = false;
+	int32_t v = 0;
+
+	if (negative) {
+		s++;
+	}
+	while (*s >= '0' && *s <= '9') {
+		v = v * 10 + (*s++ - '0');
+		digits = true;
+	}
+	if (*s == '.') {
+		s++;
+	}
+	for (uint8_t i = 0; i < decimals; i++) {
+		v *= 10;
+		if (*s >= '0' && *s <= '9') {
+			v += *s++ - '0';
+			digits = true;
+		}
+	}
+
+	*out = negative ? -v : v;
+
+	return digits;
+}
+
+/*
+ * ddmm.mmmmm (dddmm.mmmmm for longitude) and hemisphere to 1e-7 degrees.
+ */
+static bool coordinate(const char * s, const char * hemisphere, int32_t * out) {
+	int32_t v;
+
+	if (!decimal(s, 5, &v)) {
+		return false;
+	}
+
+	/* Degrees, then minutes in 1e-5 to 1e-7 degrees. */
+	v = (v / 10000000) * 10000000 + (v % 10000000) * 10 / 6;
+	*out = (*hemisphere == 'S' || *hemisphere == 'W') ? -v : v;
+
+	return true;
+}
+
+static uint8_t hex(char c) {
+
+	if (c >= '0' && c <= '9') {
+		return c - '0';
+	}
+	if (c >= 'A' && c <= 'F') {
+		return c - 'A' + 10;
+	}
+
+	return 0xFF;
+}
+
+bool NmeaReader::feed(char c) {
+
+	if (c == '$') {
+		_len = 0;
+		_in = true;
+		return false;
+	}
+	if (!_in) {
+		return false;
+	}
+	if (c == '\r' || c == '\n') {
+		_buf[_len] = '\0';
+		_in = false;
+		_stats.sentences++;
+		return parse();
+	}
+	if (_len >= NMEA_MAX_SENTENCE - 1) {
+		_in = false;
+		_stats.overflows++;
+		return false;
+	}
+	_buf[_len++] = c;
+
+	return false;
+}
+
+/*
+ * $GPGGA,time,lat,N,lon,E,quality,satellites,hdop,alt,M,...*hh
+ */
+#define GGA_FIELDS	10
+
+bool NmeaReader::parse(void) {
+	const char * star = strchr(_buf, '*');
+	const char * f[GGA_FIELDS];
+	uint8_t sum = 0;
+	NmeaFix fix;
+	int32_t v;
+
+	if (star == NULL || hex(star[1]) > 15 || hex(star[2]) > 15) {
+		_stats.checksum_errors++;
+		return false;
+	}
+	for (const char * p = _buf; p < star; p++) {
+		sum ^= *p;
+	}
+	if (sum != ((hex(star[1]) << 4) | hex(star[2]))) {
+		_stats.checksum_errors++;
+		return false;
+	}
+
+	if (_len < 6 || strncmp(&_buf[2], "GGA,", 4) != 0) {
+		return false;
+	}
+
+	for (uint8_t i = 0; i < GGA_FIELDS; i++) {
+		f[i] = field(_buf, i);
+		if (f[i] == NULL) {
+			return false;
+		}
+	}
+	if (!decimal(f[6], 0, &v) || v == 0) {
+		return false;
+	}
+	fix.quality = v;
+	fix.satellites = decimal(f[7], 0, &v) ? v : 0;
+
+	if (!coordinate(f[2], f[3], &fix.lat) || !coordinate(f[4], f[5], &fix.lon)
+			|| !decimal(f[9], 2, &fix.alt)) {
+		return false;
+	}
+
+	_fix = fix;
+	_stats.fixes++;
+
+	return true;
+}
@@ -0,0 +1,57 @@
+#ifndef NMEA_HPP_
+#define NMEA_HPP_
+
+#include <stdint.h>
+#include <stddef.h>
+
+/*
+ * NMEA 0183 reader for the GPS receiver, GGA sentences only.
+ *
+ * Bytes are fed one at a time as they come from the serial port; feed()
+ * returns true when it completes a GGA sentence with a valid checksum and
+ * a fix, which fix() then holds. Other sentences, and GGA without a fix,
+ * are skipped. Portable, the caller timestamps the sentences.
+ */
+
+#define NMEA_MAX_SENTENCE	82		/* Including $ and CR LF. */
+
+struct NmeaFix {
+	int32_t lat;		/* [1e-7 deg], north positive. */
+	int32_t lon;		/* [1e-7 deg], east positive. */
+	int32_t alt;		/* Above mean sea level, [cm]. */
+	uint8_t quality;	/* GGA fix quality, 0 is no fix. */
+	uint8_t satellites;
+};
+
+struct NmeaStats {
+	uint32_t sentences;
+	uint32_t fixes;
+	uint32_t checksum_errors;
+	uint32_t overflows;
+};
+
+class NmeaReader {
+public:
+	NmeaReader(void);
+
+	bool feed(char c);
+
+	const NmeaFix & fix(void) const {
+		return _fix;
+	}
+
+	const NmeaStats & stats(void) const {
+		return _stats;
+	}
+
+private:
+	bool parse(void);
+
+	char _buf[NMEA_MAX_SENTENCE];
+	uint8_t _len;
+	bool _in;
+	NmeaFix _fix;
+	NmeaStats _stats;
+};
+
+#endif /* NMEA_HPP_ */
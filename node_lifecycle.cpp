@@ -0,0 +1,47 @@
+#include "ch.h"
+
+#include "Middleware.hpp"
+#include "node_lifecycle.hpp"
+
+static MEMORYPOOL_DECL(node_pool, NODE_WA_SIZE, chCoreAlloc);
+
+static Node stop_node("nodestop");
+static Publisher<NodeStopMsg> stop_pub(NODE_STOP_TOPIC);
+
+void node_lifecycle_init(void) {
+	Middleware & mw = Middleware::instance();
+
+	mw.newNode(&stop_node);
+	stop_node.advertise(&stop_pub);
+}
+
+Thread * node_create(tprio_t prio, tfunc_t pf, void * arg) {
+
+	return chThdCreateFromMemoryPool(&node_pool, prio, pf, arg);
+}
+
+void node_stop(Thread * const * threads, unsigned n) {
+	NodeStopMsg * msg;
+	unsigned i;
+
+	for (i = 0; i < n; i++) {
+		if (threads[i] != NULL) {
+			chThdTerminate(threads[i]);
+		}
+	}
+
+	/*
+	 * A node whose single stop slot is still full has a wakeup pending
+	 * already; threads that are not spinning notice at their next loop.
+	 */
+	msg = stop_pub.alloc();
+	if (msg != NULL) {
+		stop_pub.broadcast(msg);
+	}
+
+	for (i = 0; i < n; i++) {
+		if (threads[i] != NULL) {
+			chThdWait(threads[i]);
+		}
+	}
+}
@@ -0,0 +1,66 @@
+#ifndef NODE_LIFECYCLE_HPP_
+#define NODE_LIFECYCLE_HPP_
+
+#include "ch.h"
+
+#include "Middleware.hpp"
+
+/*
+ * Node thread lifecycle: creation and clean teardown.
+ *
+ * Node threads share one working area size. Their working areas come from
+ * a memory pool fed by the core allocator and return to it when the
+ * thread is joined, so create/destroy cycles never touch the heap and core
+ * memory only grows to the peak number of live nodes.
+ *
+ * A node that can be stopped subscribes a NodeStop next to its topics.
+ * node_stop() marks the threads for termination, then wakes them through
+ * the middleware: one broadcast on NODE_STOP_TOPIC returns every spinner
+ * from spin() like any other message, so it sees chThdShouldTerminate()
+ * and runs its delNode(). Threads are never readied behind the
+ * scheduler's back; chSchReadyI() on a thread waiting on a semaphore or a
+ * timeout corrupts the queue it is in.
+ */
+
+#define NODE_WA_SIZE		THD_WA_SIZE(512)
+#define NODE_STOP_TOPIC		"node/stop"
+
+struct NodeStopMsg: public BaseMessage {
+	uint8_t reserved;
+}__attribute__((packed));
+
+class NodeStop {
+public:
+	NodeStop(void) :
+			_sub(NODE_STOP_TOPIC) {
+	}
+
+	bool subscribe(Node * n) {
+		return n->subscribe(&_sub);
+	}
+
+	/* Drops pending wakeups; true once the thread must terminate. */
+	bool requested(void) {
+		NodeStopMsg * msg;
+
+		while ((msg = _sub.get()) != NULL) {
+			_sub.release(msg);
+		}
+
+		return chThdShouldTerminate();
+	}
+
+private:
+	Subscriber<NodeStopMsg, 1> _sub;
+};
+
+/* Advertises NODE_STOP_TOPIC; before any node_stop(). */
+void node_lifecycle_init(void);
+
+/* NULL if no working area is left. */
+Thread * node_create(tprio_t prio, tfunc_t pf, void * arg);
+
+/* Stops and joins the threads, NULL entries are skipped. */
+void node_stop(Thread * const * threads, unsigned n);
+
+#endif /* NODE_LIFECYCLE_HPP_ */
@@ -0,0 +1,33 @@
+#ifndef PAYLOAD_HPP_
+#define PAYLOAD_HPP_
+
+#include <string.h>
+
+#include "Middleware.hpp"
+
+/*
+ * Message payload access: the bytes after the BaseMessage header, which
+ * belongs to the middleware and must never be copied between messages.
+ */
+
+template<typename T>
+static inline uint8_t * payload(T * msg) {
+	return ((uint8_t *) msg) + sizeof(BaseMessage);
+}
+
+template<typename T>
+static inline const uint8_t * payload(const T * msg) {
+	return ((const uint8_t *) msg) + sizeof(BaseMessage);
+}
+
+template<typename T>
+static inline size_t payloadSize(void) {
+	return sizeof(T) - sizeof(BaseMessage);
+}
+
+template<typename T>
+static inline void copyPayload(T * dst, const T * src) {
+	memcpy(payload(dst), payload(src), payloadSize<T>());
+}
+
+#endif /* PAYLOAD_HPP_ */
@@ -0,0 +1,137 @@
+#include <string.h>
+
+#include "ch.h"
+#include "hal.h"
+
+#include "periodic.hpp"
+
+PeriodicTask::PeriodicTask(const char * name, systime_t period,
+		PeriodicPolicy policy) :
+		_name(name), _period(period), _policy(policy), _release(0), _origin(0),
+		_phase(0),
+		_period_cycles(period * (halGetCounterFrequency() / CH_FREQUENCY)),
+		_wake(0), _started(false), _regular(false), _health(false),
+		_health_every((S2ST(1) >= period) ? S2ST(1) / period : 1),
+		_health_count(0), _health_pub(PERIODIC_HEALTH_TOPIC) {
+
+	memset(&_stats, 0, sizeof(_stats));
+}
+
+void PeriodicTask::align(systime_t origin, systime_t phase) {
+
+	_origin = origin;
+	_phase = phase % _period;
+}
+
+bool PeriodicTask::advertise(Node * n) {
+
+	_health = n->advertise(&_health_pub);
+
+	return _health;
+}
+
+bool PeriodicTask::next(void) {
+	uint32_t now = halGetCounterValue();
+	uint32_t exec = now - _wake;
+	uint32_t interval, jitter;
+	systime_t last, late;
+	bool regular = true;
+
+	if (!_started) {
+		_started = true;
+		exec = 0;
+
+		chSysLock();
+		late = (chTimeNow() - _origin - _phase) % _period;
+		_release = chTimeNow() + ((late == 0) ? 0 : _period - late);
+		sleepUntilS(_release);
+		chSysUnlock();
+	} else {
+		last = _release;
+		_release += _period;
+
+		chSysLock();
+		late = chTimeNow() - last;
+		if (late >= _period) {
+			/* Overrun: the next release is now or already past. */
+			regular = false;
+			_stats.overruns++;
+			if (_policy == PERIODIC_SKIP) {
+				_stats.skipped += late / _period;
+				_release = last + (late / _period + 1) * _period;
+			}
+		}
+		sleepUntilS(_release);
+		chSysUnlock();
+	}
+
+	now = halGetCounterValue();
+	interval = now - _wake;
+	_wake = now;
+
+	chSysLock();
+	_stats.activations++;
+	if (exec > _stats.exec_max) {
+		_stats.exec_max = exec;
+	}
+	if (regular && _regular) {
+		jitter = (interval > _period_cycles) ? interval - _period_cycles : _period_cycles - interval;
+		_stats.jitter_sum += jitter;
+		_stats.jitter_samples++;
+		if (jitter > _stats.jitter_max) {
+			_stats.jitter_max = jitter;
+		}
+	}
+	chSysUnlock();
+	_regular = regular;
+
+	if (_health && ++_health_count >= _health_every) {
+		_health_count = 0;
+		publishHealth();
+	}
+
+	return !chThdShouldTerminate();
+}
+
+/*
+ * Sleeps only for a release up to one period ahead: a release that is now
+ * or past must not wrap into a huge delay.
+ */
+void PeriodicTask::sleepUntilS(systime_t release) {
+
+	if (release - chTimeNow() - 1 < _period) {
+		chThdSleepS(release - chTimeNow());
+	}
+}
+
+void PeriodicTask::stats(PeriodicStats * stats) {
+
+	chSysLock();
+	*stats = _stats;
+	chSysUnlock();
+}
+
+void PeriodicTask::resetStats(void) {
+
+	chSysLock();
+	memset(&_stats, 0, sizeof(_stats));
+	chSysUnlock();
+}
+
+void PeriodicTask::publishHealth(void) {
+	PeriodicHealthMsg * msg;
+	PeriodicStats s;
+
+	if ((msg = _health_pub.alloc()) == NULL) {
+		return;
+	}
+
+	stats(&s);
+	strncpy(msg->task, _name, PERIODIC_NAME_SIZE);
+	msg->activations = s.activations;
+	msg->overruns = s.overruns;
+	msg->skipped = s.skipped;
+	msg->jitter_max = s.jitter_max;
+	msg->exec_max = s.exec_max;
+	_health_pub.broadcast(msg);
+}
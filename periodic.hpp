@@ -0,0 +1,100 @@
+#ifndef PERIODIC_HPP_
+#define PERIODIC_HPP_
+
+#include "ch.h"
+
+#include "Middleware.hpp"
+
+/*
+ * Fixed rate task loop with overrun detection.
+ *
+ *     PeriodicTask task("pub 100Hz", MS2ST(10), PERIODIC_CATCH_UP);
+ *
+ *     while (task.next()) {
+ *         ... publish ...
+ *     }
+ *
+ * next() ends the current iteration and sleeps until the next release,
+ * which is on an absolute grid from the first call and never drifts. An
+ * iteration that ends past the next release is an overrun. With
+ * PERIODIC_CATCH_UP the missed activations then run back to back until the
+ * grid is reached again; with PERIODIC_SKIP they are dropped and the task
+ * waits for the next release in the future.
+ *
+ * Unlike a bare chThdSleepUntil(time), a release already in the past never
+ * turns into a sleep of a whole systime_t wrap.
+ *
+ * align() moves the grid to a phase of the period from a given origin, e.g.
+ * just before a bus slot (slot_schedule.hpp).
+ *
+ * Jitter is the deviation of the wakeup to wakeup interval from the
+ * period, in DWT cycles, over consecutive on-time activations. With
+ * advertise() the statistics are also published on PERIODIC_HEALTH_TOPIC
+ * about once a second.
+ */
+
+#define PERIODIC_HEALTH_TOPIC	"health"
+#define PERIODIC_NAME_SIZE		12
+
+enum PeriodicPolicy {
+	PERIODIC_CATCH_UP,
+	PERIODIC_SKIP
+};
+
+struct PeriodicStats {
+	uint32_t activations;
+	uint32_t overruns;
+	uint32_t skipped;			/* Activations dropped by PERIODIC_SKIP. */
+	uint32_t jitter_max;		/* [cycles] */
+	uint32_t jitter_sum;		/* [cycles] over jitter_samples. */
+	uint32_t jitter_samples;
+	uint32_t exec_max;			/* Wakeup to next(), [cycles]. */
+};
+
+struct PeriodicHealthMsg: public BaseMessage {
+	char task[PERIODIC_NAME_SIZE];
+	uint32_t activations;
+	uint32_t overruns;
+	uint32_t skipped;
+	uint32_t jitter_max;
+	uint32_t exec_max;
+}__attribute__((packed));
+
+class PeriodicTask {
+public:
+	PeriodicTask(const char * name, systime_t period, PeriodicPolicy policy);
+
+	/* Releases at origin + phase + k * period; before the first next(). */
+	void align(systime_t origin, systime_t phase);
+
+	/* Publishes the task health from now on. */
+	bool advertise(Node * n);
+
+	/* Waits for the next activation; false once the thread must terminate. */
+	bool next(void);
+
+	void stats(PeriodicStats * stats);
+	void resetStats(void);
+
+private:
+	void sleepUntilS(systime_t release);
+	void publishHealth(void);
+
+	const char * _name;
+	systime_t _period;
+	PeriodicPolicy _policy;
+	systime_t _release;
+	systime_t _origin;
+	systime_t _phase;
+	uint32_t _period_cycles;
+	uint32_t _wake;				/* DWT at the last wakeup. */
+	bool _started;
+	bool _regular;				/* Last activation was on time. */
+	bool _health;
+	uint32_t _health_every;
+	uint32_t _health_count;
+	Publisher<PeriodicHealthMsg> _health_pub;
+	PeriodicStats _stats;
+};
+
+#endif /* PERIODIC_HPP_ */
@@ -0,0 +1,56 @@
+#include <string.h>
+
+#include "probe.hpp"
+
+/*
+ * The accumulators are updated under the kernel lock on the board and a
+ * mutex on the host: a few cycles, outside the measured interval.
+ */
+#if defined(__x86_64__) || defined(__i386__)
+#include <pthread.h>
+
+static pthread_mutex_t probe_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+#define PROBE_LOCK()	pthread_mutex_lock(&probe_mutex)
+#define PROBE_UNLOCK()	pthread_mutex_unlock(&probe_mutex)
+#else
+#include "ch.h"
+
+#define PROBE_LOCK()	chSysLock()
+#define PROBE_UNLOCK()	chSysUnlock()
+#endif
+
+const char * const probe_names[PROBE_COUNT] = {
+	"alloc", "broadcast", "post", "spin", "get", "release"
+};
+
+static ProbeStats probe_stats[PROBE_COUNT];
+
+void probe_record(ProbeId id, uint32_t cycles) {
+	ProbeStats * s = &probe_stats[id];
+
+	PROBE_LOCK();
+	if (s->count == 0 || cycles < s->min) {
+		s->min = cycles;
+	}
+	if (cycles > s->max) {
+		s->max = cycles;
+	}
+	s->sum += cycles;
+	s->count++;
+	PROBE_UNLOCK();
+}
+
+void probe_snapshot(ProbeStats * stats) {
+
+	PROBE_LOCK();
+	memcpy(stats, probe_stats, sizeof(probe_stats));
+	PROBE_UNLOCK();
+}
+
+void probe_reset(void) {
+
+	PROBE_LOCK();
+	memset(probe_stats, 0, sizeof(probe_stats));
+	PROBE_UNLOCK();
+}
@@ -0,0 +1,89 @@
+#ifndef PROBE_HPP_
+#define PROBE_HPP_
+
+#include <stdint.h>
+#include <stddef.h>
+
+/*
+ * Hot path probes.
+ *
+ * PROBE(id, statement) runs the statement and adds its duration in cycles
+ * to the probe's count / min / max / sum; PROBE_EXPR(id, expr) does the
+ * same for an expression and yields its value, e.g.
+ *     while ((d = PROBE_EXPR(PROBE_GET, sub.get())) != NULL)
+ * Cycles come from the DWT cycle counter on the board
+ * (halGetCounterValue()) and from rdtsc on an x86 host.
+ *
+ * Probes are built with USE_PROBES=1 only (make PROBES=yes on the board);
+ * otherwise both macros are the bare statement or expression, and the
+ * accumulators read as zero.
+ */
+
+#ifndef USE_PROBES
+#define USE_PROBES		0
+#endif
+
+enum ProbeId {
+	PROBE_ALLOC,
+	PROBE_BROADCAST,
+	PROBE_POST,		/* Transport queue post. */
+	PROBE_SPIN,
+	PROBE_GET,
+	PROBE_RELEASE,
+	PROBE_COUNT
+};
+
+struct ProbeStats {
+	uint32_t count;
+	uint32_t min;
+	uint32_t max;
+	uint64_t sum;
+};
+
+extern const char * const probe_names[PROBE_COUNT];
+
+void probe_snapshot(ProbeStats * stats);
+void probe_reset(void);
+
+#if USE_PROBES
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+
+static inline uint32_t probe_now(void) {
+	return (uint32_t) __rdtsc();
+}
+#else
+#include "ch.h"
+#include "hal.h"
+
+static inline uint32_t probe_now(void) {
+	return halGetCounterValue();
+}
+#endif
+
+void probe_record(ProbeId id, uint32_t cycles);
+
+#define PROBE(id, ...) \
+	do { \
+		uint32_t probe_t0_ = probe_now(); \
+		__VA_ARGS__; \
+		probe_record((id), probe_now() - probe_t0_); \
+	} while (0)
+
+#define PROBE_EXPR(id, ...) \
+	({ \
+		uint32_t probe_t0_ = probe_now(); \
+		__typeof__(__VA_ARGS__) probe_r_ = (__VA_ARGS__); \
+		probe_record((id), probe_now() - probe_t0_); \
+		probe_r_; \
+	})
+
+#else
+
+#define PROBE(id, ...)		do { __VA_ARGS__; } while (0)
+#define PROBE_EXPR(id, ...)	(__VA_ARGS__)
+
+#endif /* USE_PROBES */
+
+#endif /* PROBE_HPP_ */
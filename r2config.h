@@ -1,11 +1,14 @@
 #ifndef __R2CONFIG_H__
 #define __R2CONFIG_H__
 
-#include "transport/LedTransport.hpp"
 #include "transport/RTcan.hpp"
 
 /*
  * R2P middleware configuration structure
+ *
+ * Transport is the middleware's own, RTCAN scheduled, transport. Extra
+ * links (serial, loopback) are a compile-time Transports<> list used by
+ * the application, see transports.hpp and forwarder.hpp.
  */
 
 struct Config
@@ -0,0 +1,229 @@
+#include <string.h>
+
+#include "reliable.hpp"
+
+ReliableTx::ReliableTx(uint8_t window, uint32_t timeout, uint8_t epoch) :
+		_window(window), _first(0), _count(0), _epoch(epoch ? epoch : 1),
+		_restarted(false), _base(0), _timeout(timeout) {
+
+	if (_window > RELIABLE_WINDOW_MAX) {
+		_window = RELIABLE_WINDOW_MAX;
+	}
+	memset(_slots, 0, sizeof(_slots));
+	memset(&_stats, 0, sizeof(_stats));
+}
+
+uint16_t ReliableTx::push(void * msg, uint32_t now) {
+	Slot * s = slot(_count);
+
+	s->msg = msg;
+	s->sent = now;
+	s->acked = false;
+	s->nacked = false;
+	_count++;
+	_stats.sent++;
+
+	return _base + _count - 1;
+}
+
+/*
+ * A message is NACKed when one sent after its last transmission got
+ * through, which the acks of a resend still in flight cannot claim.
+ *
+ * Acks of other sessions are stale, except from a receiver without any:
+ * that one restarted, as did one of this session expecting a message
+ * released already or not sent yet. Until the restarted session is
+ * acked, acks without one come from before the restart.
+ */
+void ReliableTx::ack(const ReliableAck * ack) {
+	uint32_t newest = 0;
+	bool seen = false;
+
+	if (ack->epoch != _epoch) {
+		if (ack->epoch == 0 && !_restarted) {
+			_stats.restarts++;
+			restart(_epoch + 1);
+		}
+		return;
+	}
+	if ((uint16_t) (ack->next - _base) > _count) {
+		_stats.restarts++;
+		restart(_epoch + 1);
+		return;
+	}
+	_restarted = false;
+
+	for (uint8_t i = _count; i-- > 0;) {
+		Slot * s = slot(i);
+		int16_t d = (int16_t) (uint16_t) (_base + i - ack->next);
+
+		if (d < 0 || (d > 0 && d <= 16 && (ack->mask & (1 << (d - 1))))) {
+			s->acked = true;
+		}
+
+		if (s->acked) {
+			if (!seen || (int32_t) (s->sent - newest) > 0) {
+				newest = s->sent;
+			}
+			seen = true;
+		} else if (seen && (int32_t) (newest - s->sent) >= 0) {
+			s->nacked = true;
+		}
+	}
+}
+
+void * ReliableTx::release(void) {
+	Slot * s = slot(0);
+	void * msg;
+
+	if (_count == 0 || !s->acked) {
+		return NULL;
+	}
+
+	msg = s->msg;
+	s->msg = NULL;
+	_first = (_first + 1) % RELIABLE_WINDOW_MAX;
+	_base++;
+	_count--;
+	_stats.acked++;
+
+	return msg;
+}
+
+void * ReliableTx::resend(uint32_t now, uint16_t * seq) {
+
+	for (uint8_t i = 0; i < _count; i++) {
+		Slot * s = slot(i);
+
+		if (s->acked) {
+			continue;
+		}
+		if (s->nacked) {
+			_stats.nacked++;
+		} else if (now - s->sent >= _timeout) {
+			_stats.timeouts++;
+		} else {
+			continue;
+		}
+
+		s->sent = now;
+		s->nacked = false;
+		*seq = _base + i;
+
+		return s->msg;
+	}
+
+	return NULL;
+}
+
+void ReliableTx::restart(uint8_t epoch) {
+
+	for (uint8_t i = 0; i < _count; i++) {
+		Slot * s = slot(i);
+
+		s->acked = false;
+		s->nacked = true;
+	}
+	_epoch = epoch ? epoch : 1;
+	_restarted = true;
+	_base = 0;
+}
+
+ReliableRx::ReliableRx(uint8_t window) :
+		_window(window), _first(0), _epoch(0), _flush(false), _next(0) {
+
+	if (_window > RELIABLE_WINDOW_MAX) {
+		_window = RELIABLE_WINDOW_MAX;
+	}
+	memset(_slots, 0, sizeof(_slots));
+	memset(&_stats, 0, sizeof(_stats));
+}
+
+bool ReliableRx::accept(uint8_t epoch, uint16_t seq) {
+	int16_t d;
+
+	_stats.received++;
+	if (_flush) {
+		return false;
+	}
+	if (epoch != _epoch) {
+		if (seq != 0) {
+			_stats.out_of_window++;
+			return false;
+		}
+		_epoch = epoch;
+		_stats.resyncs++;
+		for (uint8_t i = 0; i < _window; i++) {
+			_flush |= (*slot(i) != NULL);
+		}
+		if (_flush) {
+			return false;
+		}
+		_first = 0;
+		_next = 0;
+	}
+
+	d = (int16_t) (uint16_t) (seq - _next);
+	if (d < 0 || (d < _window && *slot(d) != NULL)) {
+		_stats.duplicates++;
+		return false;
+	}
+	if (d >= _window) {
+		_stats.out_of_window++;
+		return false;
+	}
+
+	return true;
+}
+
+void ReliableRx::store(uint16_t seq, void * msg) {
+
+	*slot((uint16_t) (seq - _next)) = msg;
+}
+
+/*
+ * Flushing, the old session's messages come out past its holes, then the
+ * new session starts at 0; its first message is resent after the timeout.
+ */
+void * ReliableRx::deliver(void) {
+	void ** s = slot(0);
+	void * msg = *s;
+
+	if (_flush) {
+		for (uint8_t i = 0; i < _window; i++) {
+			s = slot(i);
+			if (*s != NULL) {
+				msg = *s;
+				*s = NULL;
+				_stats.delivered++;
+				return msg;
+			}
+		}
+		_flush = false;
+		_first = 0;
+		_next = 0;
+		return NULL;
+	}
+
+	if (msg == NULL) {
+		return NULL;
+	}
+
+	*s = NULL;
+	_first = (_first + 1) % RELIABLE_WINDOW_MAX;
+	_next++;
+	_stats.delivered++;
+
+	return msg;
+}
+
+void ReliableRx::ack(ReliableAck * ack) const {
+	ack->epoch = _epoch;
+	ack->next = _next;
+	ack->mask = 0;
+	for (uint8_t i = 1; i < _window; i++) {
+		if (_slots[(_first + i) % RELIABLE_WINDOW_MAX] != NULL) {
+			ack->mask |= 1 << (i - 1);
+		}
+	}
+}
@@ -0,0 +1,165 @@
+#ifndef RELIABLE_HPP_
+#define RELIABLE_HPP_
+
+#include <stdint.h>
+#include <stddef.h>
+
+/*
+ * Reliable delivery for remote topics: sequence numbers, selective
+ * acknowledgement and a bounded retransmit window.
+ *
+ * Each reliable message carries a ReliableHeader in front of its payload.
+ * The receiver answers every message with a ReliableAck: the next
+ * sequence number it expects (all the previous ones are acknowledged) and
+ * a mask of the ones it already holds after it. A hole below the highest
+ * bit of the mask is a NACK and is resent at once; a message not
+ * acknowledged within the timeout is resent as well.
+ *
+ * Sessions: every sender numbers its messages from 0 under an epoch, a
+ * nonzero byte that should change at each boot, and the receiver acks
+ * with the epoch it is following (0 before it has heard a session start).
+ * A receiver takes a new epoch only at its sequence number 0; what it
+ * still holds from the old session after a hole is delivered first,
+ * as the old sender is gone. A sender that gets an ack from a receiver
+ * without a session, or one of its own epoch that does not fit its
+ * window, takes the receiver for restarted: it renumbers its unreleased
+ * messages from 0 under the next epoch and sends them all again. So
+ * either side can reboot mid-run. A sender reboot loses its own
+ * unacknowledged window; if it picks the epoch it had before, the
+ * receiver also drops the first messages as duplicates of the old session
+ * when that was shorter than a window.
+ *
+ * The window is not copied: ReliableTx and ReliableRx only keep message
+ * handles, which stay allocated in the topic's pool until acknowledged
+ * (sender) or delivered in order (receiver). Both are portable; see
+ * reliable_topics.hpp for the middleware side and host/reliable_sim.cpp
+ * for goodput under loss. Topics that do not use them keep the plain
+ * best-effort path, unchanged.
+ */
+
+#define RELIABLE_WINDOW_MAX		16
+
+struct ReliableHeader {
+	uint8_t epoch;
+	uint16_t seq;
+}__attribute__((packed));
+
+struct ReliableAck {
+	uint8_t epoch;		/* Session acked, 0 if none. */
+	uint16_t next;		/* Everything before was received. */
+	uint16_t mask;		/* Bit i: next + 1 + i was received. */
+}__attribute__((packed));
+
+struct ReliableTxStats {
+	uint32_t sent;
+	uint32_t acked;
+	uint32_t nacked;	/* Resent on a NACK. */
+	uint32_t timeouts;	/* Resent on timeout. */
+	uint32_t restarts;	/* Receiver restarted, window renumbered. */
+};
+
+struct ReliableRxStats {
+	uint32_t received;
+	uint32_t delivered;
+	uint32_t duplicates;
+	uint32_t out_of_window;	/* Also other sessions before their start. */
+	uint32_t resyncs;		/* New sessions taken. */
+};
+
+class ReliableTx {
+public:
+	/*
+	 * window <= RELIABLE_WINDOW_MAX, timeout in the caller's time unit,
+	 * epoch nonzero.
+	 */
+	ReliableTx(uint8_t window, uint32_t timeout, uint8_t epoch);
+
+	uint8_t epoch(void) const {
+		return _epoch;
+	}
+
+	bool full(void) const {
+		return _count >= _window;
+	}
+
+	uint8_t pending(void) const {
+		return _count;
+	}
+
+	/* Adds a message to the window, returns its sequence number. */
+	uint16_t push(void * msg, uint32_t now);
+
+	void ack(const ReliableAck * ack);
+
+	/* Acknowledged messages, oldest first, NULL when none is left. */
+	void * release(void);
+
+	/* Messages to send again, NULL when none is due. */
+	void * resend(uint32_t now, uint16_t * seq);
+
+	/* New session: unreleased messages renumbered from 0, all resent. */
+	void restart(uint8_t epoch);
+
+	const ReliableTxStats & stats(void) const {
+		return _stats;
+	}
+
+private:
+	struct Slot {
+		void * msg;
+		uint32_t sent;
+		bool acked;
+		bool nacked;
+	};
+
+	Slot * slot(uint8_t offset) {
+		return &_slots[(_first + offset) % RELIABLE_WINDOW_MAX];
+	}
+
+	Slot _slots[RELIABLE_WINDOW_MAX];
+	uint8_t _window;
+	uint8_t _first;
+	uint8_t _count;
+	uint8_t _epoch;
+	bool _restarted;	/* No ack of the new session yet. */
+	uint16_t _base;		/* Sequence number of the oldest message. */
+	uint32_t _timeout;
+	ReliableTxStats _stats;
+};
+
+class ReliableRx {
+public:
+	ReliableRx(uint8_t window);
+
+	/*
+	 * True if seq is new and in the window, then store() its message.
+	 * Call deliver() after every accept(), taken or not: a new session
+	 * hands back the old one's messages there.
+	 */
+	bool accept(uint8_t epoch, uint16_t seq);
+	void store(uint16_t seq, void * msg);
+
+	/* Messages in sequence order, NULL at the first hole. */
+	void * deliver(void);
+
+	void ack(ReliableAck * ack) const;
+
+	const ReliableRxStats & stats(void) const {
+		return _stats;
+	}
+
+private:
+	void ** slot(uint8_t offset) {
+		return &_slots[(_first + offset) % RELIABLE_WINDOW_MAX];
+	}
+
+	void * _slots[RELIABLE_WINDOW_MAX];
+	uint8_t _window;
+	uint8_t _first;
+	uint8_t _epoch;
+	bool _flush;		/* Old session messages still held. */
+	uint16_t _next;
+	ReliableRxStats _stats;
+};
+
+#endif /* RELIABLE_HPP_ */
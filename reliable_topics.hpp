@@ -0,0 +1,171 @@
+#ifndef RELIABLE_TOPICS_HPP_
+#define RELIABLE_TOPICS_HPP_
+
+#include "ch.h"
+#include "hal.h"
+
+#include "Middleware.hpp"
+#include "payload.hpp"
+#include "reliable.hpp"
+#include "serial_topics.hpp"
+
+/*
+ * Reliable remote topics (reliable.hpp) on top of Transports<> links and
+ * the serial topic bindings, for command and configuration topics.
+ *
+ * Sender: a ReliableForwarder<T,N,Links> takes the messages of a local
+ * topic and holds up to N of them, unreleased, until acknowledged. Acks
+ * come back on a local topic, republished from the link by a
+ * SerialPublisher<ReliableAckMsg>.
+ *
+ * Receiver: a ReliableTopicRx<T,AckLinks> is added to the transport like
+ * a SerialPublisher<T>; it allocates from the local publisher's pool,
+ * broadcasts in sequence order and acks every message on AckLinks.
+ *
+ * Best-effort topics keep using Forwarder and SerialPublisher and pay
+ * nothing for this.
+ */
+
+#define RELIABLE_TICK_MS	1
+
+struct ReliableAckMsg: public BaseMessage {
+	ReliableAck ack;
+}__attribute__((packed));
+
+template<typename T, int N, typename Links>
+class ReliableForwarder {
+public:
+	ReliableForwarder(const char * topic, const char * ack_topic, uint16_t id,
+			systime_t timeout) :
+			_topic(topic), _ack_topic(ack_topic), _id(id), _tx(N, timeout, 1) {
+	}
+
+	void stats(ReliableTxStats * stats) {
+		chSysLock();
+		*stats = _tx.stats();
+		chSysUnlock();
+	}
+
+	static msg_t thread(void * arg);
+
+private:
+	void send(uint16_t seq, const T * msg) {
+		uint8_t frame[sizeof(ReliableHeader) + sizeof(T) - sizeof(BaseMessage)];
+
+		frame[0] = _tx.epoch();
+		frame[1] = seq & 0xFF;
+		frame[2] = seq >> 8;
+		memcpy(&frame[sizeof(ReliableHeader)], payload(msg), payloadSize<T>());
+		Links::send(_id, frame, sizeof(frame));
+	}
+
+	const char * _topic;
+	const char * _ack_topic;
+	uint16_t _id;
+	ReliableTx _tx;
+};
+
+/*
+ * Forwarder thread, arg is the ReliableForwarder instance. Polled, as
+ * retransmissions are due whether messages come in or not. The session
+ * epoch is the cycle counter when the first message comes in, which
+ * varies from boot to boot.
+ */
+template<typename T, int N, typename Links>
+msg_t ReliableForwarder<T, N, Links>::thread(void * arg) {
+	ReliableForwarder<T, N, Links> * fwd = (ReliableForwarder<T, N, Links> *) arg;
+	Middleware & mw = Middleware::instance();
+	Node n("rforwarder");
+	Subscriber<T, N> sub(fwd->_topic);
+	Subscriber<ReliableAckMsg, 4> acks(fwd->_ack_topic);
+	ReliableAckMsg * a;
+	uint16_t seq;
+	T *d;
+
+	chRegSetThreadName("RFORWARDER");
+
+	mw.newNode(&n);
+	n.subscribe(&sub);
+	n.subscribe(&acks);
+
+	while (!chThdShouldTerminate()) {
+		chThdSleepMilliseconds(RELIABLE_TICK_MS);
+
+		while ((a = acks.get()) != NULL) {
+			fwd->_tx.ack(&a->ack);
+			acks.release(a);
+		}
+		while ((d = (T *) fwd->_tx.release()) != NULL) {
+			sub.release(d);
+		}
+		while ((d = (T *) fwd->_tx.resend(chTimeNow(), &seq)) != NULL) {
+			fwd->send(seq, d);
+		}
+		while (!fwd->_tx.full() && (d = sub.get()) != NULL) {
+			if (fwd->_tx.stats().sent == 0) {
+				fwd->_tx.restart(halGetCounterValue());
+			}
+			seq = fwd->_tx.push(d, chTimeNow());
+			fwd->send(seq, d);
+		}
+	}
+
+	mw.delNode(&n);
+	chThdExit(RDY_OK);
+
+	return 0;
+}
+
+template<typename T, typename AckLinks>
+class ReliableTopicRx: public SerialTopicRx {
+public:
+	ReliableTopicRx(const char * topic, uint16_t id, uint16_t ack_id,
+			uint8_t window) :
+			SerialTopicRx(id, sizeof(ReliableHeader) + payloadSize<T>()),
+			_pub(topic), _ack_id(ack_id), _rx(window) {
+	}
+
+	bool advertise(Node * n) {
+		return n->advertise(&_pub);
+	}
+
+	/* Not delivered (no buffer) is not acked: the sender will resend. */
+	bool publish(const uint8_t * data, size_t len) {
+		uint8_t epoch = data[0];
+		uint16_t seq = data[1] | (data[2] << 8);
+		ReliableAck ack;
+		bool ok = true;
+		T * msg;
+
+		(void) len;
+		if (_rx.accept(epoch, seq)) {
+			msg = _pub.alloc();
+			if (msg != NULL) {
+				memcpy(payload(msg), &data[sizeof(ReliableHeader)],
+						payloadSize<T>());
+				_rx.store(seq, msg);
+			} else {
+				ok = false;
+			}
+		}
+		while ((msg = (T *) _rx.deliver()) != NULL) {
+			_pub.broadcast(msg);
+		}
+
+		_rx.ack(&ack);
+		AckLinks::send(_ack_id, (const uint8_t *) &ack, sizeof(ack));
+
+		return ok;
+	}
+
+	const ReliableRxStats & stats(void) const {
+		return _rx.stats();
+	}
+
+private:
+	Publisher<T> _pub;
+	uint16_t _ack_id;
+	ReliableRx _rx;
+};
+
+#endif /* RELIABLE_TOPICS_HPP_ */
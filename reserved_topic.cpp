@@ -0,0 +1,276 @@
+#include <string.h>
+
+#include "ch.h"
+
+#include "reserved_topic.hpp"
+
+PrioClass prio_class(tprio_t prio) {
+
+	if (prio < NORMALPRIO) {
+		return PRIO_CLASS_LOW;
+	}
+	if (prio > NORMALPRIO + 1) {
+		return PRIO_CLASS_RT;
+	}
+	return PRIO_CLASS_NORMAL;
+}
+
+ReservedSubscriberBase::ReservedSubscriberBase(uint8_t * queue, uint8_t size) :
+		_topic(NULL), _next(NULL), _queue(queue), _size(size), _head(0),
+		_count(0), _class(PRIO_CLASS_LOW) {
+
+	chBSemInit(&_sem, TRUE);
+}
+
+bool ReservedSubscriberBase::wait(systime_t timeout) {
+
+	return chBSemWaitTimeout(&_sem, timeout) == RDY_OK;
+}
+
+const void * ReservedSubscriberBase::get(void) {
+	uint8_t i;
+
+	chSysLock();
+	if (_count == 0) {
+		chSysUnlock();
+		return NULL;
+	}
+	i = _queue[_head];
+	_head = (_head + 1) % _size;
+	_count--;
+	chSysUnlock();
+
+	return _topic->buffer(i);
+}
+
+void ReservedSubscriberBase::release(const void * msg) {
+
+	chSysLock();
+	_topic->releaseS(this, _topic->index(msg));
+	chSysUnlock();
+}
+
+ReservedTopicBase::ReservedTopicBase(uint8_t * buffers, size_t size, uint8_t n,
+		uint8_t * refs, uint8_t * crefs, const uint8_t * reserve) :
+		_buffers(buffers), _size(size), _n(n), _refs(refs), _crefs(crefs),
+		_reserve(reserve), _subscribers(NULL), _table(NULL), _table_size(0),
+		_frozen(false) {
+
+	memset(_refs, 0, n);
+	memset(_runs, 0, sizeof(_runs));
+	memset(_crefs, 0, n * PRIO_CLASSES);
+	memset(_held, 0, sizeof(_held));
+	memset(&_stats, 0, sizeof(_stats));
+}
+
+void ReservedTopicBase::subscribe(ReservedSubscriberBase * sub, tprio_t prio) {
+
+	sub->_topic = this;
+	sub->_class = prio_class(prio);
+
+	chSysLock();
+	sub->_next = _subscribers;
+	_subscribers = sub;
+	_frozen = false;
+	chSysUnlock();
+}
+
+void ReservedTopicBase::unsubscribe(ReservedSubscriberBase * sub) {
+	ReservedSubscriberBase ** p;
+
+	chSysLock();
+	_frozen = false;
+	for (p = &_subscribers; *p != NULL; p = &(*p)->_next) {
+		if (*p == sub) {
+			*p = sub->_next;
+			break;
+		}
+	}
+	while (sub->_count > 0) {
+		releaseS(sub, sub->_queue[sub->_head]);
+		sub->_head = (sub->_head + 1) % sub->_size;
+		sub->_count--;
+	}
+	chSysUnlock();
+}
+
+bool ReservedTopicBase::freeze(void) {
+	ReservedSubscriberBase * sub;
+	ReservedSubscriberBase ** table;
+	uint8_t n = 0;
+
+	chSysLock();
+	for (sub = _subscribers; sub != NULL; sub = sub->_next) {
+		n++;
+	}
+	if (n > _table_size) {
+		table = (ReservedSubscriberBase **) chCoreAllocI(n * sizeof(*table));
+		if (table == NULL) {
+			chSysUnlock();
+			return false;
+		}
+		_table = table;
+		_table_size = n;
+	}
+
+	/* Real-time class first, list order within a class. */
+	n = 0;
+	for (int c = PRIO_CLASSES - 1; c >= 0; c--) {
+		_runs[c] = 0;
+		for (sub = _subscribers; sub != NULL; sub = sub->_next) {
+			if (sub->_class == c) {
+				_table[n++] = sub;
+				_runs[c]++;
+			}
+		}
+	}
+	_frozen = true;
+	chSysUnlock();
+
+	return true;
+}
+
+bool ReservedTopicBase::guaranteed(void) const {
+	unsigned total = 1;
+
+	for (int c = 0; c < PRIO_CLASSES; c++) {
+		total += _reserve[c];
+	}
+
+	return total <= _n;
+}
+
+void ReservedTopicBase::stats(ReservedStats * stats) {
+
+	chSysLock();
+	*stats = _stats;
+	chSysUnlock();
+}
+
+void ReservedTopicBase::resetStats(void) {
+
+	chSysLock();
+	memset(&_stats, 0, sizeof(_stats));
+	chSysUnlock();
+}
+
+void * ReservedTopicBase::alloc(void) {
+
+	chSysLock();
+	for (uint8_t i = 0; i < _n; i++) {
+		if (_refs[i] == 0) {
+			_refs[i] = 1;
+			chSysUnlock();
+			return buffer(i);
+		}
+	}
+	_stats.alloc_failed++;
+	chSysUnlock();
+
+	return NULL;
+}
+
+inline void ReservedTopicBase::queueS(ReservedSubscriberBase * sub, uint8_t i) {
+
+	sub->_queue[(sub->_head + sub->_count) % sub->_size] = i;
+	sub->_count++;
+	chBSemSignalI(&sub->_sem);
+}
+
+/*
+ * Queues the buffer to the subscriber if its class can still pin it. A
+ * buffer counts once against a class however many of its subscribers hold
+ * it.
+ */
+inline void ReservedTopicBase::deliverS(ReservedSubscriberBase * sub, uint8_t i,
+		uint8_t * crefs) {
+	uint8_t c = sub->_class;
+
+	if (sub->_count == sub->_size) {
+		_stats.overflow++;
+		return;
+	}
+	if (crefs[c] == 0) {
+		if (_held[c] >= _reserve[c]) {
+			_stats.dropped[c]++;
+			return;
+		}
+		_held[c]++;
+	}
+	crefs[c]++;
+	_refs[i]++;
+	queueS(sub, i);
+	_stats.delivered[c]++;
+}
+
+/*
+ * Same deliveries from the frozen table, one class run at a time.
+ */
+inline void ReservedTopicBase::deliverFrozenS(uint8_t i, uint8_t * crefs) {
+	ReservedSubscriberBase * const * sub = _table;
+	ReservedSubscriberBase * const * end;
+	uint8_t n;
+
+	for (int c = PRIO_CLASSES - 1; c >= 0; c--) {
+		end = sub + _runs[c];
+		n = 0;
+		if (crefs[c] != 0 || _held[c] < _reserve[c]) {
+			for (; sub < end; sub++) {
+				if ((*sub)->_count == (*sub)->_size) {
+					_stats.overflow++;
+					continue;
+				}
+				queueS(*sub, i);
+				n++;
+			}
+		} else {
+			for (; sub < end; sub++) {
+				if ((*sub)->_count == (*sub)->_size) {
+					_stats.overflow++;
+				} else {
+					_stats.dropped[c]++;
+				}
+			}
+		}
+		if (n > 0) {
+			if (crefs[c] == 0) {
+				_held[c]++;
+			}
+			crefs[c] += n;
+			_refs[i] += n;
+			_stats.delivered[c] += n;
+		}
+	}
+}
+
+/*
+ * Delivers to every subscriber, from the frozen table when there is one,
+ * then drops the publisher reference.
+ */
+void ReservedTopicBase::broadcast(void * msg) {
+	uint8_t i = index(msg);
+	uint8_t * crefs = &_crefs[i * PRIO_CLASSES];
+	ReservedSubscriberBase * sub;
+
+	chSysLock();
+	_stats.published++;
+	if (_frozen) {
+		deliverFrozenS(i, crefs);
+	} else {
+		for (sub = _subscribers; sub != NULL; sub = sub->_next) {
+			deliverS(sub, i, crefs);
+		}
+	}
+	_refs[i]--;
+	chSchRescheduleS();
+	chSysUnlock();
+}
+
+void ReservedTopicBase::releaseS(ReservedSubscriberBase * sub, uint8_t i) {
+	uint8_t * crefs = &_crefs[i * PRIO_CLASSES];
+
+	if (--crefs[sub->_class] == 0) {
+		_held[sub->_class]--;
+	}
+	_refs[i]--;
+}
@@ -0,0 +1,184 @@
+#ifndef RESERVED_TOPIC_HPP_
+#define RESERVED_TOPIC_HPP_
+
+#include "ch.h"
+
+/*
+ * Topic with per priority class buffer reservations.
+ *
+ * A shared pool topic lets any subscriber pin buffers until it releases
+ * them: a few slow low priority subscribers holding their queue full are
+ * enough to make alloc() fail for the real-time chain. Here every
+ * subscriber belongs to a class from its thread priority (prio_class())
+ * and each class may pin at most reserve[class] buffers of the pool,
+ * however many subscribers it has. A delivery that would pin one more
+ * buffer than its class reserve is dropped for that subscriber and
+ * counted instead.
+ *
+ * With N >= 1 + sum(reserve) the reservations cover the whole pool
+ * (guaranteed()): alloc() never fails and the real-time class always has
+ * its buffers, so nothing ever waits on a lower priority thread and no
+ * priority inheritance is needed.
+ *
+ * Once setup is over, freeze() copies the subscriber list into a
+ * contiguous table from core memory, grouped by class with the real-time
+ * class first. broadcast() then decides once per class whether the buffer
+ * can be pinned and settles the class counters once per class, leaving
+ * only the queue insertion per subscriber; real-time subscribers are also
+ * woken first. subscribe() and unsubscribe() still work and thaw the
+ * topic: broadcast() goes back to the list until the next freeze(), which
+ * reuses the table if it is large enough.
+ */
+
+#define PRIO_CLASSES		3
+
+enum PrioClass {
+	PRIO_CLASS_LOW,		/* Below NORMALPRIO. */
+	PRIO_CLASS_NORMAL,	/* NORMALPRIO and NORMALPRIO + 1. */
+	PRIO_CLASS_RT		/* Above NORMALPRIO + 1. */
+};
+
+PrioClass prio_class(tprio_t prio);
+
+struct ReservedStats {
+	uint32_t published;
+	uint32_t alloc_failed;
+	uint32_t delivered[PRIO_CLASSES];
+	uint32_t dropped[PRIO_CLASSES];		/* Class reserve exhausted. */
+	uint32_t overflow;					/* Subscriber queue full. */
+};
+
+class ReservedTopicBase;
+
+class ReservedSubscriberBase {
+public:
+	/* True when something was delivered, false on timeout. */
+	bool wait(systime_t timeout);
+
+protected:
+	/* queue: size buffer indices. */
+	ReservedSubscriberBase(uint8_t * queue, uint8_t size);
+
+	/* Oldest delivered message, NULL if none. */
+	const void * get(void);
+	void release(const void * msg);
+
+private:
+	friend class ReservedTopicBase;
+
+	ReservedTopicBase * _topic;
+	ReservedSubscriberBase * _next;
+	uint8_t * _queue;
+	uint8_t _size;
+	uint8_t _head;
+	uint8_t _count;
+	uint8_t _class;
+	BinarySemaphore _sem;
+};
+
+/*
+ * Type independent part: buffer accounting and delivery, on indices.
+ */
+class ReservedTopicBase {
+public:
+	void subscribe(ReservedSubscriberBase * sub, tprio_t prio);
+
+	/* Unlinks the subscriber and releases what it still has queued. */
+	void unsubscribe(ReservedSubscriberBase * sub);
+
+	/* False, and left as it was, when the table does not fit in core memory. */
+	bool freeze(void);
+
+	bool frozen(void) const {
+		return _frozen;
+	}
+
+	bool guaranteed(void) const;
+	void stats(ReservedStats * stats);
+	void resetStats(void);
+
+protected:
+	/*
+	 * buffers: n messages of size bytes; refs: n counters; crefs: n *
+	 * PRIO_CLASSES counters; reserve: PRIO_CLASSES buffers per class.
+	 */
+	ReservedTopicBase(uint8_t * buffers, size_t size, uint8_t n, uint8_t * refs,
+			uint8_t * crefs, const uint8_t * reserve);
+
+	void * alloc(void);
+	void broadcast(void * msg);
+
+private:
+	friend class ReservedSubscriberBase;
+
+	uint8_t index(const void * msg) const {
+		return (uint8_t) (((const uint8_t *) msg - _buffers) / _size);
+	}
+
+	void * buffer(uint8_t i) const {
+		return _buffers + i * _size;
+	}
+
+	void queueS(ReservedSubscriberBase * sub, uint8_t i);
+	void deliverS(ReservedSubscriberBase * sub, uint8_t i, uint8_t * crefs);
+	void deliverFrozenS(uint8_t i, uint8_t * crefs);
+	void releaseS(ReservedSubscriberBase * sub, uint8_t i);
+
+	uint8_t * _buffers;
+	size_t _size;
+	uint8_t _n;
+	uint8_t * _refs;			/* Publisher + subscribers holding the buffer. */
+	uint8_t * _crefs;			/* Per class holders. */
+	const uint8_t * _reserve;
+	uint8_t _held[PRIO_CLASSES];	/* Buffers pinned by each class. */
+	ReservedSubscriberBase * _subscribers;
+	ReservedSubscriberBase ** _table;	/* Frozen copy of _subscribers. */
+	uint8_t _table_size;
+	uint8_t _runs[PRIO_CLASSES];		/* Table entries per class. */
+	bool _frozen;
+	ReservedStats _stats;
+};
+
+template<typename T, int N>
+class ReservedTopic: public ReservedTopicBase {
+public:
+	ReservedTopic(const uint8_t * reserve) :
+			ReservedTopicBase((uint8_t *) _buffers, sizeof(T), N, _refs,
+					&_crefs[0][0], reserve) {
+	}
+
+	/* NULL only when the reservations do not cover the pool. */
+	T * alloc(void) {
+		return (T *) ReservedTopicBase::alloc();
+	}
+
+	void broadcast(T * msg) {
+		ReservedTopicBase::broadcast(msg);
+	}
+
+private:
+	T _buffers[N];
+	uint8_t _refs[N];
+	uint8_t _crefs[N][PRIO_CLASSES];
+};
+
+template<typename T, int Q>
+class ReservedSubscriber: public ReservedSubscriberBase {
+public:
+	ReservedSubscriber(void) :
+			ReservedSubscriberBase(_indices, Q) {
+	}
+
+	const T * get(void) {
+		return (const T *) ReservedSubscriberBase::get();
+	}
+
+	void release(const T * msg) {
+		ReservedSubscriberBase::release(msg);
+	}
+
+private:
+	uint8_t _indices[Q];
+};
+
+#endif /* RESERVED_TOPIC_HPP_ */
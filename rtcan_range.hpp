@@ -0,0 +1,98 @@
+#ifndef RTCAN_RANGE_HPP_
+#define RTCAN_RANGE_HPP_
+
+#include <string.h>
+
+#include "ch.h"
+#include "hal.h"
+
+#include "rtcan.h"
+
+/*
+ * Receives a whole range of RTCAN ids, (cid << 8) | any uid, for the
+ * protocols in which every node sends on an id of its own (discovery,
+ * clock synchronization): a RemotePublisher takes a single id. The filter
+ * is set straight on the RTCAN driver with a mask on the cid byte; frames
+ * are queued from the RTCAN callback, up to N, and taken by a thread with
+ * get(). Frames are at most 8 bytes, one CAN frame, and must carry the
+ * sender's uid themselves. Each frame is stamped with the DWT counter in
+ * the callback, at the end of frame plus the interrupt latency.
+ */
+
+#define RTCAN_RANGE_MASK	0xFF00
+
+template<int N>
+class RTCANRange {
+public:
+	RTCANRange(uint8_t cid, uint16_t size) :
+			_head(0), _count(0), _overruns(0) {
+		_msg.id = cid << 8;
+		_msg.type = RTCAN_SRT;
+		_msg.callback = callback;
+		_msg.params = this;
+		_msg.size = size;
+		_msg.data = _rx;
+		_msg.status = RTCAN_MSG_READY;
+		chSemInit(&_sem, 0);
+	}
+
+	void start(void) {
+		rtcanReceiveMask(&RTCAND1, &_msg, RTCAN_RANGE_MASK);
+	}
+
+	/*
+	 * Oldest frame, false if none came within timeout. stamp, if not NULL,
+	 * gets its reception DWT count.
+	 */
+	bool get(void * data, systime_t timeout, uint32_t * stamp = NULL) {
+
+		if (chSemWaitTimeout(&_sem, timeout) != RDY_OK) {
+			return false;
+		}
+		chSysLock();
+		memcpy(data, _queue[_head], _msg.size);
+		if (stamp != NULL) {
+			*stamp = _stamps[_head];
+		}
+		_head = (_head + 1) % N;
+		_count--;
+		chSysUnlock();
+
+		return true;
+	}
+
+	uint32_t overruns(void) const {
+		return _overruns;
+	}
+
+private:
+	static void callback(rtcan_msg_t * msgp) {
+		RTCANRange<N> * r = (RTCANRange<N> *) msgp->params;
+		uint32_t stamp = halGetCounterValue();
+		uint8_t tail;
+
+		chSysLockFromIsr();
+		if (r->_count < N) {
+			tail = (r->_head + r->_count) % N;
+			memcpy(r->_queue[tail], r->_rx, msgp->size);
+			r->_stamps[tail] = stamp;
+			r->_count++;
+			chSemSignalI(&r->_sem);
+		} else {
+			r->_overruns++;
+		}
+		msgp->status = RTCAN_MSG_READY;
+		chSysUnlockFromIsr();
+	}
+
+	rtcan_msg_t _msg;
+	uint8_t _rx[8];
+	uint8_t _queue[N][8];
+	uint32_t _stamps[N];
+	uint8_t _head;
+	uint8_t _count;
+	uint32_t _overruns;
+	Semaphore _sem;
+};
+
+#endif /* RTCAN_RANGE_HPP_ */
@@ -0,0 +1,116 @@
+#include "sensor_sync.hpp"
+
+/*
+ * Counter timestamps wrap, compare them through the signed difference.
+ */
+static inline int32_t tdiff(uint32_t a, uint32_t b) {
+	return (int32_t) (a - b);
+}
+
+SensorRing::SensorRing(SyncSample * buffer, uint16_t size, SyncMode mode) :
+		_buffer(buffer), _size(size), _head(0), _count(0), _mode(mode), _overruns(0) {
+}
+
+void SensorRing::reset(void) {
+	_head = 0;
+	_count = 0;
+	_overruns = 0;
+}
+
+/*
+ * i = 0 is the oldest sample, i = count - 1 the newest.
+ */
+const SyncSample & SensorRing::at(uint16_t i) const {
+	uint16_t idx = _head + _size - _count + i;
+
+	if (idx >= _size) {
+		idx -= _size;
+	}
+
+	return _buffer[idx];
+}
+
+void SensorRing::push(uint32_t t, int32_t x, int32_t y, int32_t z) {
+	SyncSample * s = &_buffer[_head];
+
+	s->t = t;
+	s->v[0] = x;
+	s->v[1] = y;
+	s->v[2] = z;
+
+	if (++_head >= _size) {
+		_head = 0;
+	}
+
+	if (_count < _size) {
+		_count++;
+	} else {
+		/* Oldest sample dropped, the assembler is lagging behind. */
+		_overruns++;
+	}
+}
+
+/*
+ * Value of the sensor at time t.
+ * Returns false when there is no sample, or when the closest one is older
+ * than max_age ticks.
+ */
+bool SensorRing::sample(uint32_t t, uint32_t max_age, int32_t out[3]) const {
+	int16_t i;
+
+	if (_count == 0) {
+		return false;
+	}
+
+	/* Newest sample at or before t, scanning backwards: usually 1-2 steps. */
+	for (i = _count - 1; i >= 0; i--) {
+		if (tdiff(at(i).t, t) <= 0) {
+			break;
+		}
+	}
+
+	if (i < 0) {
+		/* t older than the whole ring: best we have is the oldest sample. */
+		const SyncSample & b = at(0);
+
+		if ((uint32_t) tdiff(b.t, t) > max_age) {
+			return false;
+		}
+		out[0] = b.v[0];
+		out[1] = b.v[1];
+		out[2] = b.v[2];
+		return true;
+	}
+
+	const SyncSample & a = at(i);
+
+	if (i == _count - 1) {
+		/* No sample after t yet: hold the newest one. */
+		if ((uint32_t) tdiff(t, a.t) > max_age) {
+			return false;
+		}
+		out[0] = a.v[0];
+		out[1] = a.v[1];
+		out[2] = a.v[2];
+		return true;
+	}
+
+	const SyncSample & b = at(i + 1);
+	uint32_t span = b.t - a.t;
+	uint32_t dt = t - a.t;
+
+	if (_mode == SYNC_NEAREST || span == 0) {
+		const SyncSample & s = (dt <= span - dt) ? a : b;
+
+		out[0] = s.v[0];
+		out[1] = s.v[1];
+		out[2] = s.v[2];
+		return true;
+	}
+
+	for (int k = 0; k < 3; k++) {
+		out[k] = a.v[k] + (int32_t) (((int64_t) (b.v[k] - a.v[k]) * dt) / span);
+	}
+
+	return true;
+}
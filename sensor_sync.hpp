@@ -0,0 +1,70 @@
+#ifndef SENSOR_SYNC_HPP_
+#define SENSOR_SYNC_HPP_
+
+#include <stdint.h>
+#include <stddef.h>
+
+/*
+ * Sensor time alignment.
+ *
+ * Every sensor owns a bounded ring of timestamped 3-axis samples. The
+ * timestamp is the counter value latched in the data-ready interrupt, not
+ * the time the bus transfer completed. The assembler asks each ring for
+ * its value at a common instant, either interpolated or nearest.
+ *
+ * Platform independent: the caller provides locking around push/sample.
+ */
+
+enum SyncMode {
+	SYNC_NEAREST = 0,
+	SYNC_LINEAR
+};
+
+struct SyncSample {
+	uint32_t t;
+	int32_t v[3];
+};
+
+class SensorRing {
+public:
+	SensorRing(SyncSample * buffer, uint16_t size, SyncMode mode);
+
+	void push(uint32_t t, int32_t x, int32_t y, int32_t z);
+	bool sample(uint32_t t, uint32_t max_age, int32_t out[3]) const;
+	void reset(void);
+
+	uint16_t count(void) const {
+		return _count;
+	}
+
+	uint32_t overruns(void) const {
+		return _overruns;
+	}
+
+	SyncMode mode(void) const {
+		return _mode;
+	}
+
+private:
+	const SyncSample & at(uint16_t i) const;
+
+	SyncSample * _buffer;
+	uint16_t _size;
+	uint16_t _head;
+	uint16_t _count;
+	SyncMode _mode;
+	uint32_t _overruns;
+};
+
+template<uint16_t N>
+class SensorRingN: public SensorRing {
+public:
+	SensorRingN(SyncMode mode) :
+			SensorRing(_storage, N, mode) {
+	}
+
+private:
+	SyncSample _storage[N];
+};
+
+#endif /* SENSOR_SYNC_HPP_ */
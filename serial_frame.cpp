@@ -0,0 +1,264 @@
+#include <string.h>
+
+#include "serial_frame.hpp"
+
+/*
+ * CRC-16/CCITT-FALSE, nibble table: 32 bytes of flash, two lookups a byte.
+ */
+static const uint16_t crc16_table[16] = {
+	0x0000, 0x1021, 0x2042, 0x3063, 0x4084, 0x50A5, 0x60C6, 0x70E7,
+	0x8108, 0x9129, 0xA14A, 0xB16B, 0xC18C, 0xD1AD, 0xE1CE, 0xF1EF
+};
+
+uint16_t crc16(uint16_t crc, const uint8_t * data, size_t len) {
+
+	while (len--) {
+		crc = (crc << 4) ^ crc16_table[(crc >> 12) ^ (*data >> 4)];
+		crc = (crc << 4) ^ crc16_table[(crc >> 12) ^ (*data & 0x0F)];
+		data++;
+	}
+
+	return crc;
+}
+
+/*
+ * Streaming COBS encoder, so frames are encoded straight into the
+ * transmit buffer without an intermediate copy.
+ */
+struct CobsEncoder {
+	uint8_t * out;
+	size_t write;
+	size_t code_idx;
+	uint8_t code;
+
+	CobsEncoder(uint8_t * buffer) :
+			out(buffer), write(1), code_idx(0), code(1) {
+	}
+
+	void put(uint8_t c) {
+		if (c == 0) {
+			out[code_idx] = code;
+			code = 1;
+			code_idx = write++;
+			return;
+		}
+
+		out[write++] = c;
+		if (++code == 0xFF) {
+			out[code_idx] = code;
+			code = 1;
+			code_idx = write++;
+		}
+	}
+
+	size_t finish(void) {
+		out[code_idx] = code;
+		return write;
+	}
+};
+
+size_t cobs_encode(const uint8_t * in, size_t len, uint8_t * out) {
+	CobsEncoder enc(out);
+
+	while (len--) {
+		enc.put(*in++);
+	}
+
+	return enc.finish();
+}
+
+/*
+ * Returns the decoded length, 0 on malformed input or if it does not fit.
+ */
+size_t cobs_decode(const uint8_t * in, size_t len, uint8_t * out, size_t size) {
+	size_t read = 0, write = 0;
+	uint8_t code;
+
+	while (read < len) {
+		code = in[read];
+		if (code == 0 || read + code > len || write + code > size + 1) {
+			return 0;
+		}
+		read++;
+
+		for (uint8_t i = 1; i < code; i++) {
+			out[write++] = in[read++];
+		}
+
+		if (code != 0xFF && read != len) {
+			if (write >= size) {
+				return 0;
+			}
+			out[write++] = 0;
+		}
+	}
+
+	return write;
+}
+
+size_t frame_encode(uint16_t topic, const uint8_t * payload, size_t len,
+		uint8_t * out) {
+	CobsEncoder enc(out);
+	uint8_t id[2] = { (uint8_t) topic, (uint8_t) (topic >> 8) };
+	uint16_t crc;
+	size_t n;
+
+	crc = crc16(0xFFFF, id, 2);
+	crc = crc16(crc, payload, len);
+
+	enc.put(id[0]);
+	enc.put(id[1]);
+	for (size_t i = 0; i < len; i++) {
+		enc.put(payload[i]);
+	}
+	enc.put((uint8_t) crc);
+	enc.put((uint8_t) (crc >> 8));
+
+	n = enc.finish();
+	out[n++] = 0;
+
+	return n;
+}
+
+FrameDecoder::FrameDecoder(void) {
+
+	reset();
+	resetStats();
+}
+
+void FrameDecoder::reset(void) {
+
+	_count = 0;
+	_length = 0;
+	_overrun = false;
+}
+
+void FrameDecoder::resetStats(void) {
+
+	_stats.frames = 0;
+	_stats.bytes = 0;
+	_stats.crc_errors = 0;
+	_stats.framing_errors = 0;
+	_stats.overruns = 0;
+}
+
+/*
+ * Returns true when c completes a valid frame; topic(), payload() and
+ * length() then describe it until the next call.
+ */
+bool FrameDecoder::push(uint8_t c) {
+	size_t n;
+	uint16_t crc;
+
+	if (c != 0) {
+		if (_count < sizeof(_buffer)) {
+			_buffer[_count++] = c;
+		} else {
+			_overrun = true;
+		}
+		return false;
+	}
+
+	/* Delimiter. */
+	if (_count == 0) {
+		return false;
+	}
+
+	if (_overrun) {
+		_stats.overruns++;
+		reset();
+		return false;
+	}
+
+	n = cobs_decode(_buffer, _count, _frame, sizeof(_frame));
+	_count = 0;
+	if (n < 4) {
+		_stats.framing_errors++;
+		return false;
+	}
+
+	crc = crc16(0xFFFF, _frame, n - 2);
+	if (crc != (_frame[n - 2] | (_frame[n - 1] << 8))) {
+		_stats.crc_errors++;
+		return false;
+	}
+
+	_length = n - 4;
+	_stats.frames++;
+	_stats.bytes += _length;
+
+	return true;
+}
+
+FrameBatch::FrameBatch(void) :
+		_length(0), _count(0), _due(0) {
+}
+
+bool FrameBatch::add(uint16_t id, const uint8_t * payload, size_t len,
+		uint32_t due) {
+
+	if (len > 0xFF || _length + SERIAL_RECORD_SIZE(len) > sizeof(_data)) {
+		return false;
+	}
+
+	_data[_length++] = (uint8_t) id;
+	_data[_length++] = (uint8_t) (id >> 8);
+	_data[_length++] = (uint8_t) len;
+	memcpy(&_data[_length], payload, len);
+	_length += len;
+
+	if (_count++ == 0 || (int32_t) (due - _due) < 0) {
+		_due = due;
+	}
+
+	return true;
+}
+
+size_t FrameBatch::encode(uint8_t * out) {
+	size_t n;
+
+	if (_count == 1) {
+		n = frame_encode(_data[0] | (_data[1] << 8), &_data[3], _data[2], out);
+	} else {
+		n = frame_encode(SERIAL_BATCH_ID, _data, _length, out);
+	}
+	_length = 0;
+	_count = 0;
+
+	return n;
+}
+
+FrameReader::FrameReader(uint16_t topic, const uint8_t * payload, size_t len) :
+		_data(payload), _size(len), _offset(0), _frame_topic(topic), _topic(0),
+		_payload(NULL), _length(0) {
+}
+
+bool FrameReader::next(void) {
+
+	if (_frame_topic != SERIAL_BATCH_ID) {
+		if (_offset > 0) {
+			return false;
+		}
+		_topic = _frame_topic;
+		_payload = _data;
+		_length = _size;
+		_offset = _size;
+		return true;
+	}
+
+	if (_offset == _size) {
+		return false;
+	}
+	if (_offset + SERIAL_RECORD_SIZE(0) > _size
+			|| _offset + SERIAL_RECORD_SIZE(_data[_offset + 2]) > _size) {
+		_offset = _size + 1;
+		return false;
+	}
+
+	_topic = _data[_offset] | (_data[_offset + 1] << 8);
+	_length = _data[_offset + 2];
+	_payload = &_data[_offset + 3];
+	_offset += SERIAL_RECORD_SIZE(_length);
+
+	return true;
+}
@@ -0,0 +1,152 @@
+#ifndef SERIAL_FRAME_HPP_
+#define SERIAL_FRAME_HPP_
+
+#include <stdint.h>
+#include <stddef.h>
+
+/*
+ * Serial framing for middleware messages.
+ *
+ * Frame: COBS(topic id [2, LE] | payload | CRC16 [2, LE]) followed by a
+ * 0x00 delimiter. COBS removes every zero from the frame body, so a
+ * receiver resynchronizes at the next delimiter after any byte loss.
+ * The CRC is CRC-16/CCITT-FALSE (poly 0x1021, init 0xFFFF) over id and
+ * payload.
+ *
+ * Small messages can be coalesced into one batch frame, topic id
+ * SERIAL_BATCH_ID, whose payload is a sequence of records:
+ * id [2, LE] | length [1] | payload. It saves the delimiter, COBS code,
+ * CRC and idle gap of every message but the first.
+ */
+
+#define SERIAL_MAX_PAYLOAD	128
+
+/* Worst case encoded size, delimiter included. */
+#define SERIAL_FRAME_SIZE(n)	((n) + 4 + ((n) + 4) / 254 + 2)
+
+#define SERIAL_BATCH_ID			0xFFFF
+#define SERIAL_RECORD_SIZE(n)	((n) + 3)
+
+uint16_t crc16(uint16_t crc, const uint8_t * data, size_t len);
+
+size_t cobs_encode(const uint8_t * in, size_t len, uint8_t * out);
+size_t cobs_decode(const uint8_t * in, size_t len, uint8_t * out, size_t size);
+
+size_t frame_encode(uint16_t topic, const uint8_t * payload, size_t len,
+		uint8_t * out);
+
+struct FrameStats {
+	uint32_t frames;
+	uint32_t bytes;
+	uint32_t crc_errors;
+	uint32_t framing_errors;
+	uint32_t overruns;
+};
+
+/*
+ * Byte stream frame decoder.
+ */
+class FrameDecoder {
+public:
+	FrameDecoder(void);
+
+	bool push(uint8_t c);
+	void reset(void);
+	void resetStats(void);
+
+	uint16_t topic(void) const {
+		return _frame[0] | (_frame[1] << 8);
+	}
+
+	const uint8_t * payload(void) const {
+		return &_frame[2];
+	}
+
+	size_t length(void) const {
+		return _length;
+	}
+
+	const FrameStats & stats(void) const {
+		return _stats;
+	}
+
+private:
+	uint8_t _buffer[SERIAL_FRAME_SIZE(SERIAL_MAX_PAYLOAD)];
+	uint8_t _frame[SERIAL_MAX_PAYLOAD + 4];
+	size_t _count;
+	size_t _length;
+	bool _overrun;
+	FrameStats _stats;
+};
+
+/*
+ * Messages waiting to go out in one frame. Each message comes with the
+ * time it must be sent by; due() is the earliest of them.
+ */
+class FrameBatch {
+public:
+	FrameBatch(void);
+
+	/* False if the message does not fit: encode() the batch first. */
+	bool add(uint16_t id, const uint8_t * payload, size_t len, uint32_t due);
+
+	/* A lone message goes out as a plain frame. Empties the batch. */
+	size_t encode(uint8_t * out);
+
+	unsigned count(void) const {
+		return _count;
+	}
+
+	size_t length(void) const {
+		return _length;
+	}
+
+	uint32_t due(void) const {
+		return _due;
+	}
+
+private:
+	uint8_t _data[SERIAL_MAX_PAYLOAD];
+	size_t _length;
+	unsigned _count;
+	uint32_t _due;
+};
+
+/*
+ * Messages of a decoded frame: the frame itself, or each record of a
+ * batch.
+ */
+class FrameReader {
+public:
+	FrameReader(uint16_t topic, const uint8_t * payload, size_t len);
+
+	/* False at the end, or on a truncated record. */
+	bool next(void);
+
+	uint16_t topic(void) const {
+		return _topic;
+	}
+
+	const uint8_t * payload(void) const {
+		return _payload;
+	}
+
+	size_t length(void) const {
+		return _length;
+	}
+
+	bool malformed(void) const {
+		return _offset > _size;
+	}
+
+private:
+	const uint8_t * _data;
+	size_t _size;
+	size_t _offset;
+	uint16_t _frame_topic;
+	uint16_t _topic;
+	const uint8_t * _payload;
+	size_t _length;
+};
+
+#endif /* SERIAL_FRAME_HPP_ */
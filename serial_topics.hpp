@@ -0,0 +1,118 @@
+#ifndef SERIAL_TOPICS_HPP_
+#define SERIAL_TOPICS_HPP_
+
+#include <string.h>
+
+#include "Middleware.hpp"
+#include "payload.hpp"
+
+/*
+ * Bindings between local topics and a framed link (serial_frame.hpp):
+ * a SerialSubscriber<T,N> hands local messages to the link, a
+ * SerialPublisher<T> republishes decoded payloads locally. Shared by the
+ * serial and loopback transports.
+ */
+
+/*
+ * Local topic sent over the link. latency is how long a message may wait
+ * to be coalesced with others (serial transport only); 0 still coalesces
+ * the messages queued while the link is busy. size is the largest
+ * message, length() the one returned by the last get().
+ */
+class SerialTopicTx {
+public:
+	SerialTopicTx(uint16_t id, size_t size, systime_t latency) :
+			id(id), size(size), latency(latency), next(NULL) {
+	}
+
+	virtual bool subscribe(Node * n) = 0;
+	virtual const uint8_t * get(void) = 0;
+	virtual void release(void) = 0;
+
+	virtual size_t length(void) const {
+		return size;
+	}
+
+	uint16_t id;
+	size_t size;
+	systime_t latency;
+	SerialTopicTx * next;
+};
+
+template<typename T, int N>
+class SerialSubscriber: public SerialTopicTx {
+public:
+	SerialSubscriber(const char * topic, uint16_t id, systime_t latency = 0) :
+			SerialTopicTx(id, payloadSize<T>(), latency), _sub(topic), _msg(NULL) {
+	}
+
+	bool subscribe(Node * n) {
+		return n->subscribe(&_sub);
+	}
+
+	const uint8_t * get(void) {
+		_msg = _sub.get();
+		return (_msg != NULL) ? payload(_msg) : NULL;
+	}
+
+	void release(void) {
+		_sub.release(_msg);
+		_msg = NULL;
+	}
+
+private:
+	Subscriber<T, N> _sub;
+	T * _msg;
+};
+
+/*
+ * Remote topic republished locally. Messages of any other length than
+ * size are not accepted unless the topic says otherwise.
+ */
+class SerialTopicRx {
+public:
+	SerialTopicRx(uint16_t id, size_t size) :
+			id(id), size(size), next(NULL) {
+	}
+
+	virtual bool advertise(Node * n) = 0;
+	virtual bool publish(const uint8_t * data, size_t len) = 0;
+
+	virtual bool accepts(size_t len) const {
+		return len == size;
+	}
+
+	uint16_t id;
+	size_t size;
+	SerialTopicRx * next;
+};
+
+template<typename T>
+class SerialPublisher: public SerialTopicRx {
+public:
+	SerialPublisher(const char * topic, uint16_t id) :
+			SerialTopicRx(id, payloadSize<T>()), _pub(topic) {
+	}
+
+	bool advertise(Node * n) {
+		return n->advertise(&_pub);
+	}
+
+	bool publish(const uint8_t * data, size_t len) {
+		T * msg = _pub.alloc();
+
+		(void) len;
+		if (msg == NULL) {
+			return false;
+		}
+		memcpy(payload(msg), data, payloadSize<T>());
+		_pub.broadcast(msg);
+
+		return true;
+	}
+
+private:
+	Publisher<T> _pub;
+};
+
+#endif /* SERIAL_TOPICS_HPP_ */
@@ -0,0 +1,318 @@
+#include "serial_transport.hpp"
+
+SerialTransport * SerialTransport::_instances[SERIAL_MAX_UARTS] = { NULL };
+
+SerialTransport::SerialTransport(UARTDriver * uartp, uint32_t speed) :
+		_uartp(uartp), _tx_topics(NULL), _rx_topics(NULL), _tx_index(0),
+		_tx_len(0), _rx_head(0), _rx_tail(0) {
+
+	_config.txend1_cb = txend;
+	_config.txend2_cb = NULL;
+	_config.rxend_cb = NULL;
+	_config.rxchar_cb = rxchar;
+	_config.rxerr_cb = NULL;
+	_config.speed = speed;
+	_config.cr1 = 0;
+	_config.cr2 = USART_CR2_STOP1_BITS;
+	_config.cr3 = 0;
+
+	chBSemInit(&_tx_sem, FALSE);
+	chMtxInit(&_tx_lock);
+	chBSemInit(&_rx_sem, TRUE);
+	resetStats();
+}
+
+void SerialTransport::add(SerialTopicTx * topic) {
+
+	topic->next = _tx_topics;
+	_tx_topics = topic;
+}
+
+void SerialTransport::add(SerialTopicRx * topic) {
+
+	topic->next = _rx_topics;
+	_rx_topics = topic;
+}
+
+void SerialTransport::start(void) {
+
+	for (int i = 0; i < SERIAL_MAX_UARTS; i++) {
+		if (_instances[i] == NULL || _instances[i] == this) {
+			_instances[i] = this;
+			break;
+		}
+	}
+
+	uartStart(_uartp, &_config);
+}
+
+/*
+ * Frames a payload and sends it right away, from any thread.
+ */
+bool SerialTransport::send(uint16_t id, const uint8_t * payload, size_t len) {
+
+	if (len > SERIAL_MAX_PAYLOAD) {
+		return false;
+	}
+
+	chMtxLock(&_tx_lock);
+	append(id, payload, len);
+	flush();
+	chMtxUnlock();
+
+	return true;
+}
+
+void SerialTransport::stats(SerialStats * stats) {
+
+	chSysLock();
+	*stats = _stats;
+	stats->rx = _decoder.stats();
+	chSysUnlock();
+}
+
+void SerialTransport::resetStats(void) {
+
+	chSysLock();
+	_stats.tx_messages = 0;
+	_stats.tx_frames = 0;
+	_stats.tx_bytes = 0;
+	_stats.tx_wire_bytes = 0;
+	_stats.rx_unknown = 0;
+	_stats.rx_dropped = 0;
+	_stats.rx_overruns = 0;
+	_decoder.resetStats();
+	chSysUnlock();
+}
+
+SerialTransport * SerialTransport::find(UARTDriver * uartp) {
+
+	for (int i = 0; i < SERIAL_MAX_UARTS; i++) {
+		if (_instances[i] != NULL && _instances[i]->_uartp == uartp) {
+			return _instances[i];
+		}
+	}
+
+	return NULL;
+}
+
+/*
+ * DMA done with the buffer, it can be refilled.
+ */
+void SerialTransport::txend(UARTDriver * uartp) {
+	SerialTransport * t = find(uartp);
+
+	chSysLockFromIsr();
+	chBSemSignalI(&t->_tx_sem);
+	chSysUnlockFromIsr();
+}
+
+void SerialTransport::rxchar(UARTDriver * uartp, uint16_t c) {
+	SerialTransport * t = find(uartp);
+	uint16_t next = (t->_rx_head + 1) % SERIAL_RX_RING;
+
+	if (next == t->_rx_tail) {
+		t->_stats.rx_overruns++;
+		return;
+	}
+	t->_rx_ring[t->_rx_head] = (uint8_t) c;
+	t->_rx_head = next;
+
+	chSysLockFromIsr();
+	chBSemSignalI(&t->_rx_sem);
+	chSysUnlockFromIsr();
+}
+
+/*
+ * Frames into the current buffer, handing it to the DMA first if the frame
+ * would not fit. Called with _tx_lock held.
+ */
+void SerialTransport::append(uint16_t id, const uint8_t * payload, size_t len) {
+
+	if (_tx_len + SERIAL_FRAME_SIZE(len) > SERIAL_TX_BUFFER) {
+		flush();
+	}
+
+	_tx_len += frame_encode(id, payload, len, _tx_buffer[_tx_index] + _tx_len);
+	_stats.tx_messages++;
+	_stats.tx_frames++;
+	_stats.tx_bytes += len;
+}
+
+/*
+ * Adds a message to the pending batch, emitting the batch first if it is
+ * full. Messages too large for a batch go out on their own. Called with
+ * _tx_lock held.
+ */
+void SerialTransport::coalesce(uint16_t id, const uint8_t * payload,
+		size_t len, systime_t due) {
+
+	if (!_batch.add(id, payload, len, due)) {
+		emit();
+		if (!_batch.add(id, payload, len, due)) {
+			append(id, payload, len);
+			return;
+		}
+	}
+	_stats.tx_messages++;
+	_stats.tx_bytes += len;
+}
+
+/*
+ * Frames the pending batch into the current buffer. Called with _tx_lock
+ * held.
+ */
+void SerialTransport::emit(void) {
+
+	if (_batch.count() == 0) {
+		return;
+	}
+
+	if (_tx_len + SERIAL_FRAME_SIZE(_batch.length()) > SERIAL_TX_BUFFER) {
+		flush();
+	}
+
+	_tx_len += _batch.encode(_tx_buffer[_tx_index] + _tx_len);
+	_stats.tx_frames++;
+}
+
+/*
+ * Waits for the other buffer to leave, then starts this one and swaps.
+ * Called with _tx_lock held.
+ */
+void SerialTransport::flush(void) {
+
+	if (_tx_len == 0) {
+		return;
+	}
+
+	chBSemWait(&_tx_sem);
+	uartStartSend(_uartp, _tx_len, _tx_buffer[_tx_index]);
+	_stats.tx_wire_bytes += _tx_len;
+	_tx_index ^= 1;
+	_tx_len = 0;
+}
+
+void SerialTransport::txLoop(void) {
+	Middleware & mw = Middleware::instance();
+	Node n("serialtx");
+	SerialTopicTx * topic;
+	const uint8_t * data;
+	bool sent;
+
+	mw.newNode(&n);
+	for (topic = _tx_topics; topic != NULL; topic = topic->next) {
+		topic->subscribe(&n);
+	}
+
+	while (!chThdShouldTerminate()) {
+		if (_batch.count() == 0) {
+			n.spin();
+		} else {
+			chThdSleepMilliseconds(SERIAL_POLL_MS);
+		}
+
+		/* Round robin over the topics, one message each per pass. */
+		chMtxLock(&_tx_lock);
+		do {
+			sent = false;
+			for (topic = _tx_topics; topic != NULL; topic = topic->next) {
+				if ((data = topic->get()) != NULL) {
+					coalesce(topic->id, data, topic->length(),
+							chTimeNow() + topic->latency);
+					topic->release();
+					sent = true;
+				}
+			}
+		} while (sent);
+
+		if (_batch.count() > 0
+				&& (int32_t) (chTimeNow() - _batch.due()) >= 0) {
+			emit();
+			flush();
+		}
+		chMtxUnlock();
+	}
+
+	mw.delNode(&n);
+}
+
+void SerialTransport::rxLoop(void) {
+	Middleware & mw = Middleware::instance();
+	Node n("serialrx");
+	SerialTopicRx * topic;
+	uint8_t c;
+
+	mw.newNode(&n);
+	for (topic = _rx_topics; topic != NULL; topic = topic->next) {
+		topic->advertise(&n);
+	}
+
+	while (!chThdShouldTerminate()) {
+		chBSemWaitTimeout(&_rx_sem, MS2ST(100));
+
+		while (_rx_tail != _rx_head) {
+			c = _rx_ring[_rx_tail];
+			_rx_tail = (_rx_tail + 1) % SERIAL_RX_RING;
+
+			if (!_decoder.push(c)) {
+				continue;
+			}
+
+			FrameReader reader(_decoder.topic(), _decoder.payload(),
+					_decoder.length());
+
+			while (reader.next()) {
+				dispatch(reader.topic(), reader.payload(), reader.length());
+			}
+			if (reader.malformed()) {
+				_stats.rx_unknown++;
+			}
+		}
+	}
+
+	mw.delNode(&n);
+}
+
+void SerialTransport::dispatch(uint16_t id, const uint8_t * payload,
+		size_t len) {
+	SerialTopicRx * topic;
+
+	for (topic = _rx_topics; topic != NULL; topic = topic->next) {
+		if (topic->id == id) {
+			break;
+		}
+	}
+
+	if (topic == NULL || !topic->accepts(len)) {
+		_stats.rx_unknown++;
+	} else if (!topic->publish(payload, len)) {
+		_stats.rx_dropped++;
+	}
+}
+
+/*
+ * Transmit thread, arg is the SerialTransport instance.
+ */
+msg_t SerialTransport::txThread(void * arg) {
+	SerialTransport * t = (SerialTransport *) arg;
+
+	chRegSetThreadName("SERIAL TX");
+	t->txLoop();
+	chThdExit(RDY_OK);
+
+	return 0;
+}
+
+/*
+ * Receive thread, arg is the SerialTransport instance.
+ */
+msg_t SerialTransport::rxThread(void * arg) {
+	SerialTransport * t = (SerialTransport *) arg;
+
+	chRegSetThreadName("SERIAL RX");
+	t->rxLoop();
+	chThdExit(RDY_OK);
+
+	return 0;
+}
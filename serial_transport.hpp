@@ -0,0 +1,110 @@
+#ifndef SERIAL_TRANSPORT_HPP_
+#define SERIAL_TRANSPORT_HPP_
+
+#include "ch.h"
+#include "hal.h"
+
+#include "Middleware.hpp"
+#include "serial_frame.hpp"
+#include "serial_topics.hpp"
+
+/*
+ * Binary serial transport: middleware topics multiplexed on one UART.
+ *
+ * Outgoing messages are framed (serial_frame.hpp) back to back into one
+ * of two buffers; a full buffer is handed to the UART DMA while the other
+ * one fills. Messages of the subscribed topics are coalesced into batch
+ * frames: whatever queued up while the DMA was busy, and up to each
+ * topic's latency budget. Incoming bytes are queued by the UART character callback and
+ * decoded by the receive thread, which republishes each frame locally.
+ * Topic ids are the ones in topics.h.
+ *
+ * Besides its own subscribers, any thread can send() a payload; that is
+ * what SerialLink uses to put the transport in a Transports<> list.
+ */
+
+#define SERIAL_TX_BUFFER	256
+#define SERIAL_RX_RING		256
+#define SERIAL_MAX_UARTS	2
+#define SERIAL_POLL_MS		1	/* While a batch waits for its deadline. */
+
+struct SerialStats {
+	uint32_t tx_messages;
+	uint32_t tx_frames;		/* Frames on the wire, batches count once. */
+	uint32_t tx_bytes;		/* Payload bytes. */
+	uint32_t tx_wire_bytes;	/* Framed bytes sent. */
+	uint32_t rx_unknown;	/* Valid frames for unknown topics or sizes. */
+	uint32_t rx_dropped;	/* No buffer to republish. */
+	uint32_t rx_overruns;	/* Receive ring full. */
+	FrameStats rx;
+};
+
+class SerialTransport {
+public:
+	SerialTransport(UARTDriver * uartp, uint32_t speed);
+
+	/* Topics must be added before start(). */
+	void add(SerialTopicTx * topic);
+	void add(SerialTopicRx * topic);
+
+	void start(void);
+	bool send(uint16_t id, const uint8_t * payload, size_t len);
+	void stats(SerialStats * stats);
+	void resetStats(void);
+
+	uint32_t speed(void) const {
+		return _config.speed;
+	}
+
+	void txLoop(void);
+	void rxLoop(void);
+
+	static msg_t txThread(void * arg);
+	static msg_t rxThread(void * arg);
+
+private:
+	static SerialTransport * find(UARTDriver * uartp);
+	static void txend(UARTDriver * uartp);
+	static void rxchar(UARTDriver * uartp, uint16_t c);
+
+	void append(uint16_t id, const uint8_t * payload, size_t len);
+	void coalesce(uint16_t id, const uint8_t * payload, size_t len,
+			systime_t due);
+	void emit(void);
+	void flush(void);
+	void dispatch(uint16_t id, const uint8_t * payload, size_t len);
+
+	static SerialTransport * _instances[SERIAL_MAX_UARTS];
+
+	UARTDriver * _uartp;
+	UARTConfig _config;
+	SerialTopicTx * _tx_topics;
+	SerialTopicRx * _rx_topics;
+
+	uint8_t _tx_buffer[2][SERIAL_TX_BUFFER];
+	uint8_t _tx_index;
+	size_t _tx_len;
+	BinarySemaphore _tx_sem;
+	Mutex _tx_lock;
+	FrameBatch _batch;
+
+	uint8_t _rx_ring[SERIAL_RX_RING];
+	volatile uint16_t _rx_head;
+	volatile uint16_t _rx_tail;
+	BinarySemaphore _rx_sem;
+	FrameDecoder _decoder;
+
+	SerialStats _stats;
+};
+
+/*
+ * Transports<> adapter for a SerialTransport instance.
+ */
+template<SerialTransport & S>
+struct SerialLink {
+	static bool send(uint16_t id, const uint8_t * payload, size_t len) {
+		return S.send(id, payload, len);
+	}
+};
+
+#endif /* SERIAL_TRANSPORT_HPP_ */
@@ -0,0 +1,134 @@
+#include <string.h>
+
+#include "slab.hpp"
+
+/*
+ * Kernel lock on the board, a mutex on the host.
+ */
+#if defined(__x86_64__) || defined(__i386__)
+#include <pthread.h>
+
+static pthread_mutex_t slab_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+#define SLAB_LOCK()		pthread_mutex_lock(&slab_mutex)
+#define SLAB_UNLOCK()	pthread_mutex_unlock(&slab_mutex)
+#else
+#include "ch.h"
+
+#define SLAB_LOCK()		chSysLock()
+#define SLAB_UNLOCK()	chSysUnlock()
+#endif
+
+Slab::Slab(void * arena, size_t size, const uint16_t * counts) :
+		_arena((uint8_t *) arena) {
+	uint8_t * p = _arena;
+	uint8_t * end = _arena + size;
+	Block * b;
+
+	memset(_stats, 0, sizeof(_stats));
+
+	for (uint8_t c = 0; c < SLAB_CLASSES; c++) {
+		_free[c] = NULL;
+		for (uint16_t i = 0; i < counts[c] && p + classSize(c) <= end; i++) {
+			b = (Block *) p;
+			b->next = _free[c];
+			_free[c] = b;
+			p += classSize(c);
+			_stats[c].blocks++;
+		}
+		_end[c] = p;
+	}
+}
+
+uint8_t Slab::sizeClass(size_t size) {
+
+	if (size <= classSize(0)) {
+		return 0;
+	}
+	if (size > SLAB_MAX_SIZE) {
+		return SLAB_CLASSES;
+	}
+
+	return (uint8_t) (32 - __builtin_clz((uint32_t) size - 1) - SLAB_MIN_SHIFT);
+}
+
+uint8_t Slab::classOf(const void * block) const {
+	uint8_t c = 0;
+
+	while (c < SLAB_CLASSES && (const uint8_t *) block >= _end[c]) {
+		c++;
+	}
+
+	return c;
+}
+
+void * Slab::alloc(size_t size) {
+	uint8_t want = sizeClass(size);
+	Block * b;
+
+	if (want == SLAB_CLASSES) {
+		return NULL;
+	}
+
+	SLAB_LOCK();
+	for (uint8_t c = want; c < SLAB_CLASSES; c++) {
+		b = _free[c];
+		if (b == NULL) {
+			continue;
+		}
+		_free[c] = b->next;
+		_stats[want].allocs++;
+		if (c != want) {
+			_stats[want].spilled++;
+		}
+		if (++_stats[c].used > _stats[c].peak) {
+			_stats[c].peak = _stats[c].used;
+		}
+		SLAB_UNLOCK();
+		return b;
+	}
+	_stats[want].failed++;
+	SLAB_UNLOCK();
+
+	return NULL;
+}
+
+void Slab::free(void * block) {
+	uint8_t c = classOf(block);
+	Block * b = (Block *) block;
+
+	if (block == NULL || (uint8_t *) block < _arena || c == SLAB_CLASSES) {
+		return;
+	}
+
+	SLAB_LOCK();
+	b->next = _free[c];
+	_free[c] = b;
+	_stats[c].used--;
+	SLAB_UNLOCK();
+}
+
+size_t Slab::blockSize(const void * block) const {
+	uint8_t c = classOf(block);
+
+	return (c == SLAB_CLASSES) ? 0 : classSize(c);
+}
+
+void Slab::stats(SlabStats * stats) {
+
+	SLAB_LOCK();
+	memcpy(stats, _stats, sizeof(_stats));
+	SLAB_UNLOCK();
+}
+
+void Slab::resetStats(void) {
+
+	SLAB_LOCK();
+	for (uint8_t c = 0; c < SLAB_CLASSES; c++) {
+		_stats[c].peak = _stats[c].used;
+		_stats[c].allocs = 0;
+		_stats[c].spilled = 0;
+		_stats[c].failed = 0;
+	}
+	SLAB_UNLOCK();
+}
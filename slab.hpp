@@ -0,0 +1,88 @@
+#ifndef SLAB_HPP_
+#define SLAB_HPP_
+
+#include <stdint.h>
+#include <stddef.h>
+
+/*
+ * Shared slab allocator with power of two size classes.
+ *
+ * A topic pool is sized for its largest message times its worst case
+ * number of buffers in flight, and no other topic can use what it leaves
+ * idle. A slab arena is carved once into blocks of 8, 16, ... 256 bytes,
+ * counts[c] blocks of class c, each class with its own free list: alloc()
+ * takes the smallest class that fits and pops its list, free() finds the
+ * class from the block address and pushes it back, both in a bounded
+ * number of steps under the kernel lock. When a class runs dry the
+ * request spills to the next larger one and is counted as such, so an
+ * arena sized for typical traffic degrades by wasting bytes rather than
+ * by failing. Variable length payloads (NMEA sentences, log strings) pay
+ * for their actual size rounded up to a power of two.
+ *
+ * The arena must be 4 byte aligned, and so is every block.
+ * StaticSlab<SLAB_BYTES(...)> holds its own arena.
+ */
+
+#define SLAB_MIN_SHIFT		3		/* 8 byte blocks, room for the list link. */
+#define SLAB_CLASSES		6		/* 8 .. 256 bytes. */
+#define SLAB_MAX_SIZE		(1 << (SLAB_MIN_SHIFT + SLAB_CLASSES - 1))
+
+/* Arena bytes for the given blocks per class. */
+#define SLAB_BYTES(n8, n16, n32, n64, n128, n256) \
+	((n8) * 8 + (n16) * 16 + (n32) * 32 + (n64) * 64 + (n128) * 128 + (n256) * 256)
+
+struct SlabStats {
+	uint16_t blocks;
+	uint16_t used;
+	uint16_t peak;
+	uint32_t allocs;
+	uint32_t spilled;		/* Requests of this class served by a larger one. */
+	uint32_t failed;		/* Requests of this class with every fitting class empty. */
+};
+
+class Slab {
+public:
+	/* Blocks that do not fit in size bytes are left out. */
+	Slab(void * arena, size_t size, const uint16_t * counts);
+
+	/* NULL when no class from size up has a free block. */
+	void * alloc(size_t size);
+	void free(void * block);
+
+	size_t blockSize(const void * block) const;
+
+	void stats(SlabStats * stats);
+	void resetStats(void);
+
+	/* Smallest class holding size bytes, SLAB_CLASSES if none. */
+	static uint8_t sizeClass(size_t size);
+
+	static size_t classSize(uint8_t c) {
+		return (size_t) 1 << (SLAB_MIN_SHIFT + c);
+	}
+
+private:
+	struct Block {
+		Block * next;
+	};
+
+	uint8_t classOf(const void * block) const;
+
+	uint8_t * _arena;
+	uint8_t * _end[SLAB_CLASSES];	/* Class c blocks end here. */
+	Block * _free[SLAB_CLASSES];
+	SlabStats _stats[SLAB_CLASSES];
+};
+
+template<size_t BYTES>
+class StaticSlab: public Slab {
+public:
+	StaticSlab(const uint16_t * counts) :
+			Slab(_arena, BYTES, counts) {
+	}
+
+private:
+	uint32_t _arena[(BYTES + 3) / 4];
+};
+
+#endif /* SLAB_HPP_ */
@@ -0,0 +1,28 @@
+#include "slot_schedule.hpp"
+
+const SlotSchedule rtcan_schedule = { RTCAN_CYCLE_HZ, RTCAN_SLOTS };
+
+static volatile uint32_t origin = 0;
+
+uint32_t slot_offset_us(const SlotSchedule * schedule, uint16_t slot) {
+
+	return (uint32_t) ((uint64_t) slot * 1000000 / ((uint64_t) schedule->cycle_hz * schedule->slots));
+}
+
+uint32_t slot_phase(const SlotSchedule * schedule, uint16_t slot,
+		uint32_t lead_us, uint32_t tick_hz) {
+	uint32_t cycle_us = 1000000 / schedule->cycle_hz;
+	uint32_t us = (slot_offset_us(schedule, slot) + cycle_us - lead_us % cycle_us) % cycle_us;
+
+	return (uint32_t) ((uint64_t) us * tick_hz / 1000000);
+}
+
+uint32_t slot_origin(void) {
+
+	return origin;
+}
+
+void slot_set_origin(uint32_t t) {
+
+	origin = t;
+}
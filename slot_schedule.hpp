@@ -0,0 +1,49 @@
+#ifndef SLOT_SCHEDULE_HPP_
+#define SLOT_SCHEDULE_HPP_
+
+#include <stdint.h>
+
+/*
+ * RTCAN slot schedule, for releasing remote publishers just before their
+ * slot.
+ *
+ * The RTCAN cycle repeats RTCAN_CYCLE_HZ times a second and is split into
+ * RTCAN_SLOTS equal slots; a publisher that fires at an arbitrary point
+ * of the cycle waits on average half a cycle for its slot. slot_phase()
+ * gives the release phase within the cycle that ends lead_us before the
+ * slot opens, in ticks of tick_hz rounded down, so the release is never
+ * later than the slot minus the lead. It goes to PeriodicTask::align()
+ * with slot_origin(); the task period must be a multiple of the cycle.
+ *
+ * The origin is the local chTimeNow() of a cycle start; the transport
+ * updates it with slot_set_origin() when it resynchronizes, it is 0 (the
+ * cycle starts with the system tick) until then.
+ */
+
+#define RTCAN_BAUDRATE		1000000
+#define RTCAN_CYCLE_HZ		100
+#define RTCAN_SLOTS			60
+
+/*
+ * Default lead before the slot. It must cover the wakeup jitter plus the
+ * time from wakeup to frame queued, or the frame waits a whole cycle.
+ */
+#define SLOT_LEAD_US		200
+
+struct SlotSchedule {
+	uint32_t cycle_hz;
+	uint16_t slots;
+};
+
+extern const SlotSchedule rtcan_schedule;
+
+/* Slot start from the cycle start. */
+uint32_t slot_offset_us(const SlotSchedule * schedule, uint16_t slot);
+
+uint32_t slot_phase(const SlotSchedule * schedule, uint16_t slot,
+		uint32_t lead_us, uint32_t tick_hz);
+
+uint32_t slot_origin(void);
+void slot_set_origin(uint32_t origin);
+
+#endif /* SLOT_SCHEDULE_HPP_ */
@@ -0,0 +1,179 @@
+#include <string.h>
+
+#include "timesync.hpp"
+
+/* PI loop gains on the offset error: phase 1/2, rate 1/8 per SYNC. */
+#define TIMESYNC_KP_SHIFT		1
+#define TIMESYNC_KI				8
+
+/* Keeps d * _drift in range and the reference clear of local wraps. */
+#define TIMESYNC_REBASE_US		0x40000000
+
+TimeSync::TimeSync(uint8_t uid) :
+		_uid(uid), _master(TIMESYNC_NO_MASTER), _seq(0), _started(false),
+		_heard(0), _next_sync(0), _sync_pending(false), _follow_pending(false),
+		_follow_seq(0), _follow_time(0), _rx_valid(false), _rx_seq(0),
+		_rx_local(0), _locked(false), _stepped(false), _ref_local(0),
+		_ref_time(0), _drift(0) {
+
+	memset(&_stats, 0, sizeof(_stats));
+}
+
+uint32_t TimeSync::now(uint32_t local) const {
+	int32_t d = (int32_t) (local - _ref_local);
+
+	return _ref_time + d + (int32_t) (((int64_t) d * _drift) / 1000000000);
+}
+
+void TimeSync::tick(uint32_t local) {
+
+	if (!_started) {
+		_started = true;
+		_heard = local;
+	}
+
+	if ((int32_t) (local - _ref_local) > TIMESYNC_REBASE_US) {
+		_ref_time = now(local);
+		_ref_local = local;
+	}
+
+	if (master()) {
+		if ((int32_t) (local - _next_sync) >= 0) {
+			_sync_pending = true;
+			_next_sync += TIMESYNC_PERIOD_US;
+			if ((int32_t) (local - _next_sync) >= 0) {
+				_next_sync = local + TIMESYNC_PERIOD_US;
+			}
+		}
+	} else if ((int32_t) (local - _heard) > TIMESYNC_TIMEOUT * TIMESYNC_PERIOD_US) {
+		/* No master: take over, the timebase tracked so far goes on. */
+		_master = _uid;
+		_next_sync = local;
+		_rx_valid = false;
+	}
+}
+
+bool TimeSync::pending(TimeSyncFrame * frame) {
+
+	memset(frame, 0, sizeof(*frame));
+	frame->uid = _uid;
+
+	if (_sync_pending) {
+		_sync_pending = false;
+		frame->type = TIMESYNC_SYNC;
+		frame->seq = ++_seq;
+		return true;
+	}
+
+	if (_follow_pending) {
+		_follow_pending = false;
+		frame->type = TIMESYNC_FOLLOW_UP;
+		frame->seq = _follow_seq;
+		frame->time = _follow_time;
+		return true;
+	}
+
+	return false;
+}
+
+void TimeSync::sent(const TimeSyncFrame * frame, uint32_t local) {
+
+	if (frame->type == TIMESYNC_SYNC && master()) {
+		_follow_pending = true;
+		_follow_seq = frame->seq;
+		_follow_time = now(local);
+		_stats.syncs_sent++;
+	}
+}
+
+void TimeSync::receive(const TimeSyncFrame * frame, uint32_t local) {
+
+	if (frame->uid == _uid) {
+		return;
+	}
+
+	if (frame->type == TIMESYNC_SYNC) {
+		if (master()) {
+			if (frame->uid > _uid) {
+				return;
+			}
+			/* Lower uid master: follow it from the current timebase. */
+			_ref_time = now(local);
+			_ref_local = local;
+			_locked = true;
+			_stepped = false;
+			_follow_pending = false;
+			_master = frame->uid;
+		} else if (_master == TIMESYNC_NO_MASTER || frame->uid < _master) {
+			_master = frame->uid;
+		} else if (frame->uid != _master) {
+			return;
+		}
+
+		_heard = local;
+		_rx_valid = true;
+		_rx_seq = frame->seq;
+		_rx_local = local;
+		_stats.syncs++;
+	} else if (frame->type == TIMESYNC_FOLLOW_UP) {
+		if (frame->uid != _master || !_rx_valid || frame->seq != _rx_seq) {
+			return;
+		}
+		_rx_valid = false;
+		_stats.follow_ups++;
+		follow(_rx_local, frame->time);
+	}
+}
+
+/*
+ * One (local, master time) pair of the same instant.
+ */
+void TimeSync::follow(uint32_t local, uint32_t time) {
+	uint32_t d = local - _ref_local;
+	uint32_t predicted;
+	int32_t error;
+
+	if (_stepped) {
+		/* Second pair after a step: the rate from the two. */
+		_drift = (int32_t) (((int64_t) (int32_t) (time - _ref_time - d) * 1000000000) / d);
+		_stats.drift = _drift;
+		_ref_local = local;
+		_ref_time = time;
+		_stepped = false;
+		_locked = true;
+		return;
+	}
+
+	if (!_locked) {
+		step(local, time);
+		return;
+	}
+
+	predicted = now(local);
+	error = (int32_t) (time - predicted);
+	_stats.error = error;
+
+	if (error > TIMESYNC_STEP_US || error < -TIMESYNC_STEP_US || d == 0) {
+		step(local, time);
+		return;
+	}
+
+	/* A short interval (new master out of phase) says little about rate. */
+	if (d >= TIMESYNC_PERIOD_US / 2) {
+		_drift += (int32_t) (((int64_t) error * 1000000000) / d / TIMESYNC_KI);
+	}
+	_stats.drift = _drift;
+	_ref_local = local;
+	_ref_time = predicted + (error >> TIMESYNC_KP_SHIFT);
+}
+
+void TimeSync::step(uint32_t local, uint32_t time) {
+
+	_ref_local = local;
+	_ref_time = time;
+	_drift = 0;
+	_stats.drift = 0;
+	_locked = false;
+	_stepped = true;
+	_stats.steps++;
+}
@@ -0,0 +1,128 @@
+#ifndef TIMESYNC_HPP_
+#define TIMESYNC_HPP_
+
+#include <stdint.h>
+#include <stddef.h>
+
+/*
+ * Bus-wide clock synchronization.
+ *
+ * The master sends a SYNC frame every TIMESYNC_PERIOD_US, then a
+ * FOLLOW_UP with its time at the instant the SYNC actually left (two-step,
+ * as in PTP): queueing and slot waits before transmission do not matter,
+ * only the two timestamps do. Slaves pair the local reception time of each
+ * SYNC with the master time of its FOLLOW_UP and track offset and drift
+ * with a PI loop; the CAN frame is seen by every node at the same instant,
+ * so no path delay is measured.
+ *
+ * now() maps the local microsecond clock to the shared timebase. Before
+ * the first SYNC it is the local clock. A node that hears no master for
+ * TIMESYNC_TIMEOUT periods takes over, continuing the timebase it tracked;
+ * of two masters the lower uid wins. An error beyond TIMESYNC_STEP_US
+ * (first lock, master change) steps the clock and restarts the drift
+ * estimate.
+ *
+ * The engine is portable and takes the local time in microseconds from
+ * the caller; the accuracy is that of the SYNC transmit and receive
+ * timestamps. See timesync_node.hpp for the middleware side and
+ * host/timesync_sim.cpp for measurements with clock skew.
+ */
+
+#define TIMESYNC_PERIOD_US		100000
+#define TIMESYNC_TIMEOUT		3		/* [periods] */
+#define TIMESYNC_STEP_US		500
+#define TIMESYNC_NO_MASTER		0xFF
+
+enum TimeSyncType {
+	TIMESYNC_SYNC = 1, TIMESYNC_FOLLOW_UP = 2
+};
+
+struct TimeSyncFrame {
+	uint8_t type;
+	uint8_t uid;
+	uint8_t seq;
+	uint8_t reserved;
+	uint32_t time;		/* FOLLOW_UP: master time of the SYNC, [us]. */
+}__attribute__((packed));
+
+struct TimeSyncStats {
+	uint32_t syncs_sent;
+	uint32_t syncs;			/* Received from the master. */
+	uint32_t follow_ups;	/* Matched to their SYNC. */
+	uint32_t steps;
+	int32_t error;			/* Last offset error before correction, [us]. */
+	int32_t drift;			/* Local clock rate error, [ppb]. */
+};
+
+class TimeSync {
+public:
+	TimeSync(uint8_t uid);
+
+	/* Call at least every few milliseconds. */
+	void tick(uint32_t local);
+
+	/* Next frame to send, if any. */
+	bool pending(TimeSyncFrame * frame);
+
+	/* The frame left the node at local time local (SYNC only matters). */
+	void sent(const TimeSyncFrame * frame, uint32_t local);
+
+	/* A frame was received at local time local. */
+	void receive(const TimeSyncFrame * frame, uint32_t local);
+
+	/* Shared time at local time local, [us]. */
+	uint32_t now(uint32_t local) const;
+
+	uint8_t uid(void) const {
+		return _uid;
+	}
+
+	bool master(void) const {
+		return _master == _uid;
+	}
+
+	bool synchronized(void) const {
+		return master() || _locked;
+	}
+
+	uint8_t masterUid(void) const {
+		return _master;
+	}
+
+	const TimeSyncStats & stats(void) const {
+		return _stats;
+	}
+
+private:
+	void follow(uint32_t local, uint32_t time);
+	void step(uint32_t local, uint32_t time);
+
+	uint8_t _uid;
+	uint8_t _master;
+	uint8_t _seq;
+	bool _started;
+	uint32_t _heard;		/* Local time of the last master SYNC. */
+
+	/* Master side. */
+	uint32_t _next_sync;
+	bool _sync_pending;
+	bool _follow_pending;
+	uint8_t _follow_seq;
+	uint32_t _follow_time;
+
+	/* Slave side. */
+	bool _rx_valid;
+	uint8_t _rx_seq;
+	uint32_t _rx_local;
+	bool _locked;
+	bool _stepped;			/* One FOLLOW_UP since the last step. */
+
+	/* now() = _ref_time + d + d * _drift / 1e9, d = local - _ref_local. */
+	uint32_t _ref_local;
+	uint32_t _ref_time;
+	int32_t _drift;
+
+	TimeSyncStats _stats;
+};
+
+#endif /* TIMESYNC_HPP_ */
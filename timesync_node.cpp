@@ -0,0 +1,190 @@
+#include "ch.h"
+#include "hal.h"
+
+#include "periodic.hpp"
+#include "slot_schedule.hpp"
+#include "timesync_node.hpp"
+
+static TimeSyncNode * instance = NULL;
+
+TimeSyncNode::TimeSyncNode(uint8_t uid) :
+		_sync(uid), _last(0), _cycles(0), _local(0),
+		_cycles_us(halGetCounterFrequency() / 1000000), _tx_stamp(0),
+		_rx(TIMESYNC_CID, sizeof(TimeSyncFrame)) {
+
+	_tx.id = TIMESYNC_ID(uid);
+	_tx.type = RTCAN_SRT;
+	_tx.callback = txCallback;
+	_tx.params = this;
+	_tx.size = sizeof(TimeSyncFrame);
+	_tx.data = (uint8_t *) &_tx_frame;
+	_tx.status = RTCAN_MSG_READY;
+	chSemInit(&_tx_sem, 0);
+
+	instance = this;
+}
+
+/*
+ * Extends the DWT counter to microseconds; called at least every cycle by
+ * the transmit thread, well within a counter wrap.
+ */
+uint32_t TimeSyncNode::localS(void) {
+	uint32_t now = halGetCounterValue();
+
+	_cycles += now - _last;
+	_last = now;
+	_local += _cycles / _cycles_us;
+	_cycles %= _cycles_us;
+
+	return _local;
+}
+
+/*
+ * Local time at an earlier DWT count, taken in an interrupt.
+ */
+uint32_t TimeSyncNode::localAtS(uint32_t stamp) {
+	uint32_t local = localS();
+
+	return local - (_last - stamp) / _cycles_us;
+}
+
+void TimeSyncNode::txCallback(rtcan_msg_t * msgp) {
+	TimeSyncNode * t = (TimeSyncNode *) msgp->params;
+	uint32_t stamp = halGetCounterValue();
+
+	chSysLockFromIsr();
+	t->_tx_stamp = stamp;
+	msgp->status = RTCAN_MSG_READY;
+	chSemSignalI(&t->_tx_sem);
+	chSysUnlockFromIsr();
+}
+
+/*
+ * Sends a frame and waits for the end of its transmission, stamped by
+ * txCallback(); false if it did not leave within a cycle. A frame given up
+ * on may still go out later, unmatched: no FOLLOW_UP is sent for it.
+ */
+bool TimeSyncNode::send(const TimeSyncFrame * frame, uint32_t * stamp) {
+
+	if (_tx.status != RTCAN_MSG_READY) {
+		return false;
+	}
+
+	_tx_frame = *frame;
+	chSemReset(&_tx_sem, 0);
+	rtcanSendSrt(&_tx, 1000 / RTCAN_CYCLE_HZ);
+
+	if (chSemWaitTimeout(&_tx_sem, MS2ST(1000 / RTCAN_CYCLE_HZ)) != RDY_OK) {
+		return false;
+	}
+
+	chSysLock();
+	*stamp = _tx_stamp;
+	chSysUnlock();
+
+	return true;
+}
+
+uint32_t TimeSyncNode::now(void) {
+	uint32_t t;
+
+	chSysLock();
+	t = _sync.now(localS());
+	chSysUnlock();
+
+	return t;
+}
+
+bool TimeSyncNode::synchronized(void) {
+	bool s;
+
+	chSysLock();
+	s = _sync.synchronized();
+	chSysUnlock();
+
+	return s;
+}
+
+uint8_t TimeSyncNode::masterUid(void) {
+
+	return _sync.masterUid();
+}
+
+void TimeSyncNode::stats(TimeSyncStats * stats) {
+
+	chSysLock();
+	*stats = _sync.stats();
+	chSysUnlock();
+}
+
+msg_t TimeSyncNode::txThread(void * arg) {
+	TimeSyncNode * t = (TimeSyncNode *) arg;
+	PeriodicTask task("timesync", MS2ST(1000 / RTCAN_CYCLE_HZ), PERIODIC_SKIP);
+	TimeSyncFrame frame;
+	uint32_t stamp;
+	bool more;
+
+	chRegSetThreadName("TIMESYNC TX");
+
+	task.align(slot_origin(),
+			slot_phase(&rtcan_schedule, TIMESYNC_SLOT, SLOT_LEAD_US, CH_FREQUENCY));
+
+	while (task.next()) {
+		chSysLock();
+		t->_sync.tick(t->localS());
+		more = t->_sync.pending(&frame);
+		chSysUnlock();
+
+		/*
+		 * The SYNC is stamped when it has left, its FOLLOW_UP goes out
+		 * right after it in the same cycle.
+		 */
+		while (more) {
+			if (!t->send(&frame, &stamp)) {
+				break;
+			}
+
+			chSysLock();
+			t->_sync.sent(&frame, t->localAtS(stamp));
+			more = t->_sync.pending(&frame);
+			chSysUnlock();
+		}
+	}
+
+	chThdExit(RDY_OK);
+
+	return 0;
+}
+
+msg_t TimeSyncNode::rxThread(void * arg) {
+	TimeSyncNode * t = (TimeSyncNode *) arg;
+	TimeSyncFrame frame;
+	uint32_t stamp;
+
+	chRegSetThreadName("TIMESYNC RX");
+
+	t->_rx.start();
+
+	while (!chThdShouldTerminate()) {
+		if (!t->_rx.get(&frame, MS2ST(100), &stamp)) {
+			continue;
+		}
+
+		chSysLock();
+		t->_sync.receive(&frame, t->localAtS(stamp));
+		chSysUnlock();
+	}
+
+	chThdExit(RDY_OK);
+
+	return 0;
+}
+
+uint32_t mwTimeNow(void) {
+
+	if (instance == NULL) {
+		return chTimeNow() * (1000000 / CH_FREQUENCY);
+	}
+
+	return instance->now();
+}
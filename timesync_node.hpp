@@ -0,0 +1,77 @@
+#ifndef TIMESYNC_NODE_HPP_
+#define TIMESYNC_NODE_HPP_
+
+#include "ch.h"
+
+#include "discovery.hpp"
+#include "rtcan_range.hpp"
+#include "timesync.hpp"
+
+#if CH_FREQUENCY != 1000
+#error "TimeSyncNode expects a 1 ms system tick"
+#endif
+
+/*
+ * Clock synchronization (timesync.hpp) on RTCAN.
+ *
+ * Each node sends its frames on its own id, TIMESYNC_ID(uid) in the
+ * TIMESYNC_CID range that discovery leaves alone, straight through RTCAN
+ * rather than a remote topic: the SYNC timestamp has to come from the
+ * transmit complete callback. Frames from the other nodes come in through
+ * an RTCANRange on the whole range. The local clock is the DWT cycle
+ * counter extended to 32 bit microseconds.
+ *
+ * The transmit thread runs once per RTCAN cycle, released SLOT_LEAD_US
+ * before TIMESYNC_SLOT. A SYNC is stamped in the transmit complete
+ * interrupt and a frame received in the receive interrupt, both at the end
+ * of the frame: a SYNC that waits for the bus or misses its slot still
+ * carries the instant it left. The interrupt latencies are the sync error
+ * (host/timesync_sim.cpp gives it against the stamp jitter).
+ *
+ * mwTimeNow() is the shared time in microseconds, the same on every
+ * synchronized node; it is chTimeNow() in microseconds until a
+ * TimeSyncNode exists.
+ */
+
+#define TIMESYNC_ID(uid)	((TIMESYNC_CID << 8) | (uid))
+
+#ifndef TIMESYNC_SLOT
+#define TIMESYNC_SLOT		0
+#endif
+
+class TimeSyncNode {
+public:
+	TimeSyncNode(uint8_t uid);
+
+	/* Shared time, [us]. */
+	uint32_t now(void);
+
+	bool synchronized(void);
+	uint8_t masterUid(void);
+	void stats(TimeSyncStats * stats);
+
+	/* Threads, arg is the TimeSyncNode instance. */
+	static msg_t txThread(void * arg);
+	static msg_t rxThread(void * arg);
+
+private:
+	bool send(const TimeSyncFrame * frame, uint32_t * stamp);
+	uint32_t localS(void);
+	uint32_t localAtS(uint32_t stamp);
+	static void txCallback(rtcan_msg_t * msgp);
+
+	TimeSync _sync;
+	uint32_t _last;				/* DWT at the last localS(). */
+	uint32_t _cycles;			/* Not yet counted in _local. */
+	uint32_t _local;
+	uint32_t _cycles_us;
+	rtcan_msg_t _tx;
+	TimeSyncFrame _tx_frame;
+	uint32_t _tx_stamp;			/* DWT at the end of the last frame sent. */
+	Semaphore _tx_sem;
+	RTCANRange<4> _rx;
+};
+
+uint32_t mwTimeNow(void);
+
+#endif /* TIMESYNC_NODE_HPP_ */
@@ -5,6 +5,10 @@
 #define LED2_ID			1012
 #define LED3_ID			1013
 #define LED4_ID			1014
+#define LEDCMD_ID		1020
+
+/* RTCAN slots of the remote topics, see slot_schedule.hpp. */
+#define LED23_SLOT		12
 
 #define PWM1_ID			2011
 #define PWM2_ID			2012
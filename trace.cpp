@@ -0,0 +1,208 @@
+#include <string.h>
+
+#include "ch.h"
+#include "hal.h"
+#include "chprintf.h"
+
+#include "trace.hpp"
+
+#if USE_TRACE
+
+#if (TRACE_EVENTS & (TRACE_EVENTS - 1)) != 0
+#error "TRACE_EVENTS must be a power of two"
+#endif
+
+static TraceEvent trace_ring[TRACE_EVENTS];
+static uint32_t trace_count;	/* Events written since trace_start(). */
+static bool trace_on;
+static bool trace_wrap;
+
+static const char * trace_topics[TRACE_MAX_TOPICS];
+static uint8_t trace_ntopics;
+
+static inline void trace_record(uint16_t thread, TraceType type, uint8_t topic,
+		uint32_t ptr) {
+	TraceEvent * e;
+
+	if (!trace_on) {
+		return;
+	}
+
+	e = &trace_ring[trace_count & (TRACE_EVENTS - 1)];
+	e->time = halGetCounterValue();
+	e->ptr = ptr;
+	e->thread = thread;
+	e->type = type;
+	e->topic = topic;
+
+	if (++trace_count == TRACE_EVENTS && !trace_wrap) {
+		trace_on = false;
+	}
+}
+
+/*
+ * Context switch hook, in the kernel lock: the event belongs to the thread
+ * that runs next.
+ */
+extern "C" void trace_switch(void * ntp, void * otp) {
+	Thread * tp = (Thread *) ntp;
+
+	(void) otp;
+	trace_record((uint16_t) (uint32_t) tp, TRACE_SWITCH, TRACE_NO_TOPIC,
+			(uint32_t) tp->p_name);
+}
+
+void trace_eventI(TraceType type, uint8_t topic, const void * ptr) {
+
+	trace_record((uint16_t) (uint32_t) chThdSelf(), type, topic, (uint32_t) ptr);
+}
+
+void trace_event(TraceType type, uint8_t topic, const void * ptr) {
+
+	chSysLock();
+	trace_eventI(type, topic, ptr);
+	chSysUnlock();
+}
+
+uint8_t trace_topic(const char * name) {
+	uint8_t id = TRACE_NO_TOPIC;
+
+	chSysLock();
+	for (uint8_t i = 0; i < trace_ntopics; i++) {
+		if (strcmp(trace_topics[i], name) == 0) {
+			id = i;
+			break;
+		}
+	}
+	if (id == TRACE_NO_TOPIC && trace_ntopics < TRACE_MAX_TOPICS) {
+		id = trace_ntopics;
+		trace_topics[trace_ntopics++] = name;
+	}
+	chSysUnlock();
+
+	return id;
+}
+
+void trace_start(bool wrap) {
+
+	chSysLock();
+	trace_count = 0;
+	trace_wrap = wrap;
+	trace_on = true;
+	chSysUnlock();
+}
+
+void trace_stop(void) {
+
+	chSysLock();
+	trace_on = false;
+	chSysUnlock();
+}
+
+/*
+ * One line per event, numbers in hex:
+ *     TRACE <cycles per second> <events written> <events held>
+ *     N <topic> <name>
+ *     S <time> <thread> <name>                  context switch
+ *     P|R|F|M <time> <thread> <topic> <ptr>     publish, receive, release, mark
+ *     END
+ */
+void trace_dump(BaseSequentialStream * chp) {
+	static const char types[] = "SPRFM";
+	uint32_t n, first;
+	const TraceEvent * e;
+
+	trace_stop();
+
+	n = (trace_count < TRACE_EVENTS) ? trace_count : TRACE_EVENTS;
+	first = trace_count - n;
+
+	chprintf(chp, "TRACE %u %u %u\r\n", halGetCounterFrequency(), trace_count, n);
+	for (uint8_t i = 0; i < trace_ntopics; i++) {
+		chprintf(chp, "N %x %s\r\n", i, trace_topics[i]);
+	}
+	for (uint32_t i = first; i < trace_count; i++) {
+		e = &trace_ring[i & (TRACE_EVENTS - 1)];
+		if (e->type == TRACE_SWITCH) {
+			chprintf(chp, "S %08x %04x %s\r\n", e->time, e->thread,
+					(e->ptr != 0) ? (const char *) e->ptr : "?");
+		} else {
+			chprintf(chp, "%c %08x %04x %x %08x\r\n", types[e->type], e->time,
+					e->thread, e->topic, e->ptr);
+		}
+	}
+	chprintf(chp, "END\r\n");
+}
+
+/*
+ * Times trace_event() calls of a wrapping trace, the ring contents are
+ * dropped afterwards.
+ */
+void trace_overhead(uint32_t n, uint32_t * min, uint32_t * avg, uint32_t * max) {
+	uint32_t t0, cycles, sum = 0;
+
+	*min = 0xFFFFFFFF;
+	*max = 0;
+
+	trace_start(true);
+	for (uint32_t i = 0; i < n; i++) {
+		t0 = halGetCounterValue();
+		trace_event(TRACE_MARK, TRACE_NO_TOPIC, NULL);
+		cycles = halGetCounterValue() - t0;
+
+		sum += cycles;
+		if (cycles < *min) {
+			*min = cycles;
+		}
+		if (cycles > *max) {
+			*max = cycles;
+		}
+	}
+	trace_stop();
+	trace_count = 0;
+
+	*avg = (n > 0) ? sum / n : 0;
+}
+
+#else
+
+uint8_t trace_topic(const char * name) {
+
+	(void) name;
+	return TRACE_NO_TOPIC;
+}
+
+void trace_start(bool wrap) {
+
+	(void) wrap;
+}
+
+void trace_stop(void) {
+}
+
+void trace_event(TraceType type, uint8_t topic, const void * ptr) {
+
+	(void) type;
+	(void) topic;
+	(void) ptr;
+}
+
+void trace_eventI(TraceType type, uint8_t topic, const void * ptr) {
+
+	(void) type;
+	(void) topic;
+	(void) ptr;
+}
+
+void trace_dump(BaseSequentialStream * chp) {
+
+	(void) chp;
+}
+
+void trace_overhead(uint32_t n, uint32_t * min, uint32_t * avg, uint32_t * max) {
+
+	(void) n;
+	*min = *avg = *max = 0;
+}
+
+#endif /* USE_TRACE */
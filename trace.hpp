@@ -0,0 +1,84 @@
+#ifndef TRACE_HPP_
+#define TRACE_HPP_
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "ch.h"
+#include "hal.h"
+
+/*
+ * Middleware event trace.
+ *
+ * Fixed size binary events (cycle timestamp, thread, type, topic, message
+ * pointer) go to a RAM ring: publish / receive / release from the
+ * TRACE() call sites, and a switch event from the scheduler's context
+ * switch hook (chconf.h) with the name of the thread that runs next. Each
+ * event is a constant number of stores under the kernel lock, no loop and
+ * no allocation; trace_overhead() measures it.
+ *
+ * trace_dump() prints the ring as text lines over a serial stream, which
+ * host/trace_json turns into a Chrome trace / Perfetto JSON timeline.
+ *
+ * Only built with USE_TRACE=1 (make TRACE=yes); otherwise TRACE() is
+ * empty, there is no ring and the functions do nothing.
+ */
+
+#ifndef USE_TRACE
+#define USE_TRACE			0
+#endif
+
+/* Ring size in events, a power of two; 12 bytes each. */
+#ifndef TRACE_EVENTS
+#define TRACE_EVENTS		128
+#endif
+
+#define TRACE_MAX_TOPICS	16
+#define TRACE_NO_TOPIC		0xFF
+
+enum TraceType {
+	TRACE_SWITCH,		/* ptr is the thread name. */
+	TRACE_PUBLISH,
+	TRACE_RECEIVE,
+	TRACE_RELEASE,
+	TRACE_MARK
+};
+
+struct TraceEvent {
+	uint32_t time;		/* DWT cycles. */
+	uint32_t ptr;
+	uint16_t thread;	/* Low half of the Thread address. */
+	uint8_t type;
+	uint8_t topic;
+};
+
+/* Topic id for the events, registered on first use. */
+uint8_t trace_topic(const char * name);
+
+/*
+ * Starts a new trace. A wrapping trace keeps the last TRACE_EVENTS events,
+ * otherwise tracing stops once the ring is full.
+ */
+void trace_start(bool wrap);
+void trace_stop(void);
+
+void trace_event(TraceType type, uint8_t topic, const void * ptr);
+void trace_eventI(TraceType type, uint8_t topic, const void * ptr);
+
+/* Stops tracing and prints the held events, oldest first. */
+void trace_dump(BaseSequentialStream * chp);
+
+/* Cycles per trace_event(): min, average and max over n calls. */
+void trace_overhead(uint32_t n, uint32_t * min, uint32_t * avg, uint32_t * max);
+
+#if USE_TRACE
+#define TRACE(type, topic, ptr)	trace_event((type), (topic), (ptr))
+#else
+#define TRACE(type, topic, ptr) \
+	do { \
+		(void) (topic); \
+		(void) (ptr); \
+	} while (0)
+#endif /* USE_TRACE */
+
+#endif /* TRACE_HPP_ */
@@ -0,0 +1,78 @@
+#ifndef TRANSPORTS_HPP_
+#define TRANSPORTS_HPP_
+
+#include <stdint.h>
+#include <stddef.h>
+
+/*
+ * Compile-time transport list.
+ *
+ * A link is any type with a static
+ *     bool send(uint16_t id, const uint8_t * payload, size_t len);
+ * Transports<A, B, C>::send() calls each of them in turn; every call is
+ * resolved at compile time and inlines, there is no table and no virtual
+ * call. A link that is not listed is never instantiated and costs nothing,
+ * and Transports<> compiles to an empty function.
+ */
+
+template<typename ... Links>
+struct Transports;
+
+template<>
+struct Transports<> {
+	static const unsigned count = 0;
+
+	static inline unsigned send(uint16_t id, const uint8_t * payload,
+			size_t len) {
+		(void) id;
+		(void) payload;
+		(void) len;
+		return 0;
+	}
+};
+
+template<typename Link, typename ... Links>
+struct Transports<Link, Links...> {
+	static const unsigned count = 1 + Transports<Links...>::count;
+
+	/* Returns the number of links that accepted the message. */
+	static inline unsigned send(uint16_t id, const uint8_t * payload,
+			size_t len) {
+		unsigned n = Link::send(id, payload, len) ? 1 : 0;
+
+		return n + Transports<Links...>::send(id, payload, len);
+	}
+};
+
+/*
+ * Run-time equivalent, for comparison: a table of links behind a virtual
+ * send().
+ */
+class VirtualLink {
+public:
+	virtual ~VirtualLink(void) {
+	}
+
+	virtual bool send(uint16_t id, const uint8_t * payload, size_t len) = 0;
+};
+
+template<typename Link>
+class VirtualLinkT: public VirtualLink {
+public:
+	bool send(uint16_t id, const uint8_t * payload, size_t len) {
+		return Link::send(id, payload, len);
+	}
+};
+
+static inline unsigned virtual_send(VirtualLink * const * links, unsigned n,
+		uint16_t id, const uint8_t * payload, size_t len) {
+	unsigned sent = 0;
+
+	for (unsigned i = 0; i < n; i++) {
+		sent += links[i]->send(id, payload, len) ? 1 : 0;
+	}
+
+	return sent;
+}
+
+#endif /* TRANSPORTS_HPP_ */